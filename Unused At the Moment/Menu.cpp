@@ -3,7 +3,7 @@
 
 /* Code for state transitions.  Defines the paths between all the states, and
  * which inputs trigger movement between states.	*/
-const menuNextState_t nextState [] =
+const menuNextState_t nextState [] PROGMEM =
 {
 //	State			Input			Next State
 	{ST_DASHBRD,	BUTTON_BACK,	ST_DASHBRD},
@@ -21,23 +21,35 @@ const menuNextState_t nextState [] =
   {0,		0,		0}
 };
 
+/* Menu text.  Kept in flash, since RAM is scarce. */
+const char textDashBrd[] PROGMEM = "DashBrd";
+const char textConfig[] PROGMEM = "Config";
+const char textProfiles[] PROGMEM = "Profiles";
+const char textS[] PROGMEM = "S";
+const char textI[] PROGMEM = "I";
+const char textO[] PROGMEM = "O";
+const char textM[] PROGMEM = "M";
+const char textP[] PROGMEM = "P";
+const char textD[] PROGMEM = "D";
+const char textNone[] PROGMEM = "";
+
 /* Code for state functions.  Defines the function performed in each state
  * as well as a text description displayed to the user at each state. */
-const menuState_t menu_state [] =
+const menuState_t menu_state [] PROGMEM =
 {
-//State			//Text		//Function
-  {ST_DASHBRD,	"DashBrd",	MenuDashBoard},
-  {ST_CONFIG,	"Config",	MenuConfig},
-  {ST_ATUNE,	"",			MenuATune},
-  {ST_PROFILE,	"Profiles",	MenuProfile},
-  {ST_SP,		"S",		MenuSetpoint},
-  {ST_IN,		"I",		MenuInput},
-  {ST_OUT,		"O",		MenuOutput},
-  {ST_MAN,		"M",		MenuManual},
-  {ST_P,		"P",		MenuPTerm},
-  {ST_I,		"I",		MenuITerm},
-  {ST_D,		"D",		MenuDTerm},
-  {ST_PV,		"",		MenuPV},
+//State			//Text			//Function
+  {ST_DASHBRD,	textDashBrd,	MenuDashBoard},
+  {ST_CONFIG,	textConfig,		MenuConfig},
+  {ST_ATUNE,	textNone,		MenuATune},
+  {ST_PROFILE,	textProfiles,	MenuProfile},
+  {ST_SP,		textS,			MenuSetpoint},
+  {ST_IN,		textI,			MenuInput},
+  {ST_OUT,		textO,			MenuOutput},
+  {ST_MAN,		textM,			MenuManual},
+  {ST_P,		textP,			MenuPTerm},
+  {ST_I,		textI,			MenuITerm},
+  {ST_D,		textD,			MenuDTerm},
+  {ST_PV,		textNone,		MenuPV},
 
   //This tells the main loop to stop.
   //If it is removed, the program will crash!
@@ -51,14 +63,14 @@ byte mIndex = 0;
 byte mDrawIndex = 0;
 byte editDepth = 0;
 
-byte mMain[] = {0,1,2,3};
-byte mDash[] = {4,5,6,7};
-byte mConfig[] = {8,9,10,11};
-byte *mMenu[] = {mMain, mDash, mConfig};
+const byte mMain[] PROGMEM = {0,1,2,3};
+const byte mDash[] PROGMEM = {4,5,6,7};
+const byte mConfig[] PROGMEM = {8,9,10,11};
+const byte * const mMenu[] PROGMEM = {mMain, mDash, mConfig};
 const byte TYPE_NAV=0;
 const byte TYPE_VAL=1;
 const byte TYPE_OPT=2;
-char profname[] = {'N','o',' ','P','r','o','f'};
+const char profname[] PROGMEM = "No Prof";
 
 LiquidCrystal lcd(A1, A0, 4, 7, 8, 9);			//Initialize the LCD
 AnalogButton button(A3, 0, 253, 454, 657);		//Initialize the buttons
@@ -81,7 +93,7 @@ void MenuATune ()
 void MenuProfile ()
 {
   if(runningProfile)lcd.print(F("Cancel "));		//Print menu item.
-  else lcd.print(profname);
+  else lcd.print((const __FlashStringHelper *)profname);
 }
 
 void MenuSetpoint ()
@@ -122,8 +134,9 @@ void MenuPV ()
 void drawLCD()
 {
   boolean highlightFirst = (mDrawIndex==mIndex);
-  drawItem(0,highlightFirst, mMenu[curMenu][mDrawIndex]);
-  drawItem(1,!highlightFirst, mMenu[curMenu][mDrawIndex+1]);
+  const byte *menu = (const byte *)pgm_read_word(&mMenu[curMenu]);
+  drawItem(0,highlightFirst, pgm_read_byte(&menu[mDrawIndex]));
+  drawItem(1,!highlightFirst, pgm_read_byte(&menu[mDrawIndex+1]));
   if(editing) lcd.setCursor(editDepth, highlightFirst?0:1);
 }
 
@@ -372,7 +385,7 @@ void updown(bool up)
         mIndex++;
       }
     }
-    highlightedIndex = mMenu[curMenu][mIndex];
+    highlightedIndex = pgm_read_byte(&((const byte *)pgm_read_word(&mMenu[curMenu]))[mIndex]);
   }
 }
 
@@ -43,19 +43,20 @@ typedef struct
   uint8_t nextState;
 } menuNextState_t;
 
-extern const rom menuNextState_t nextState[];
+extern const menuNextState_t nextState[] PROGMEM;
 
 /* Code for state functions.  Defines the function performed in each state
- * as well as a text description displayed to the user at each state. */
+ * as well as a text description displayed to the user at each state.  The
+ * table and its text live in flash (PROGMEM); read them with pgm_read_*. */
 
 typedef struct
 {
   uint8_t state;
-  const rom char *text;
+  const char *text;
   uint8_t (* StateFunction) (uint8 input);
 } menuState_t;
 
-extern const rom menuState_t state[];
+extern const menuState_t state[] PROGMEM;
 
 //State function initializations
 uint8 MenuPV(uint8 input);
@@ -0,0 +1,128 @@
+/******************************************************************************
+ *
+ *	Filename:		AdaptiveSampler.cpp
+ *
+ *	Description:	Picks the sample period from what the process is doing.
+ *					While the error or the rate of change is large (after a
+ *					setpoint step, or when a load hits), the PID needs to
+ *					run often.  Once things settle, it can run much less
+ *					often, which saves CPU time and serial traffic.
+ *
+ *					The period drops to the fastest allowed as soon as the
+ *					process gets busy, but only climbs back one doubling at a
+ *					time, after the process has been quiet for a while.  The
+ *					gap between "busy" and "quiet" keeps the period from
+ *					flapping when the error hovers near a band's edge.
+ *
+ *					Whoever uses the period has to rescale anything that
+ *					depends on it (the PID's gains, for one).
+ *
+ *****************************************************************************/
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include <stdint.h>
+#include <math.h>
+#include "AdaptiveSampler.h"
+
+/******************************************************************************
+ *
+ *	Function:		AdaptiveSampler (Class Initializer)
+ *
+ *****************************************************************************/
+
+AdaptiveSampler::AdaptiveSampler()
+{
+	fastPeriod = SAMPLER_FAST_PERIOD;
+	slowPeriod = SAMPLER_SLOW_PERIOD;
+	errorBand = SAMPLER_ERROR_BAND;
+	rateBand = SAMPLER_RATE_BAND;
+	period = SAMPLER_FAST_PERIOD;
+	quietTime = 0;
+}
+
+bool AdaptiveSampler::SetLimits(unsigned long fastMs, unsigned long slowMs)
+{
+	if ((fastMs == 0) || (fastMs > slowMs))
+	{
+		return false;
+	}
+
+	fastPeriod = fastMs;
+	slowPeriod = slowMs;
+	SetPeriod(period);
+	return true;
+}
+
+bool AdaptiveSampler::SetBands(double error, double rate)
+{
+	if ((error <= 0) || (rate <= 0))
+	{
+		return false;
+	}
+
+	errorBand = error;
+	rateBand = rate;
+	return true;
+}
+
+void AdaptiveSampler::SetPeriod(unsigned long mSec)
+{
+	period = (mSec < fastPeriod) ? fastPeriod :
+		((mSec > slowPeriod) ? slowPeriod : mSec);
+	quietTime = 0;
+}
+
+unsigned long AdaptiveSampler::GetPeriod()
+{
+	return period;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Update
+ *
+ *	Description:	Decides how long to wait before the next sample.  An
+ *					unknown (NAN) error or rate counts as neither busy nor
+ *					quiet, so the period holds.
+ *
+ *	Parameters:		error - setpoint minus process value [C]
+ *					rate - process value's rate of change [C/sec]
+ *
+ *	Return Value:	the next sample period [mSec]
+ *
+ *****************************************************************************/
+
+unsigned long AdaptiveSampler::Update(double error, double rate)
+{
+	error = fabs(error);
+	rate = fabs(rate);
+
+	if ((error > errorBand) || (rate > rateBand))
+	{
+		// Busy:  go fast right away.
+		period = fastPeriod;
+		quietTime = 0;
+	}
+	else if ((error < errorBand / 2) && (rate < rateBand / 2))
+	{
+		// Quiet:  slow down a step at a time.
+		quietTime += period;
+		if ((quietTime >= SAMPLER_HOLD_TIME) && (period < slowPeriod))
+		{
+			period *= 2;
+			if (period > slowPeriod)
+			{
+				period = slowPeriod;
+			}
+			quietTime = 0;
+		}
+	}
+	else
+	{
+		quietTime = 0;
+	}
+
+	return period;
+}
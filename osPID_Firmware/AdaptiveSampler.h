@@ -0,0 +1,53 @@
+#ifndef ADAPTIVE_SAMPLER_H
+#define ADAPTIVE_SAMPLER_H
+
+// Off the Arduino (in tools/adaptive_sim.cpp) there's no Arduino.h.
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include <stdint.h>
+
+// Default limits on the sample period.  The MAX31855 takes about 100 mSec to
+// convert, so sampling any faster than that just reads the same value again.
+#define SAMPLER_FAST_PERIOD		100		// [mSec]
+#define SAMPLER_SLOW_PERIOD		2000	// [mSec]
+
+// Default bands.  Outside either one, the process is "busy" and is sampled as
+// fast as allowed.  Inside half of both, it's "quiet", and the period doubles
+// for every SAMPLER_HOLD_TIME it stays that way.  In between, the period
+// stays where it is.
+#define SAMPLER_ERROR_BAND		2.0		// |setpoint - PV| [C]
+#define SAMPLER_RATE_BAND		0.2		// |dPV/dt| [C/sec]
+#define SAMPLER_HOLD_TIME		5000	// [mSec]
+
+class AdaptiveSampler
+{
+public:
+	// Initialize the class.
+	AdaptiveSampler();
+
+	// Set the fastest & slowest sample periods [mSec].
+	bool SetLimits(unsigned long fastMs, unsigned long slowMs);
+
+	// Set the error [C] and rate [C/sec] bands.
+	bool SetBands(double error, double rate);
+
+	// Force the sample period (it's clamped to the limits).
+	void SetPeriod(unsigned long mSec);
+
+	// Fetch the sample period [mSec].
+	unsigned long GetPeriod();
+
+	// Pick the next sample period.  Call once per sample.
+	unsigned long Update(double error, double rate);
+
+private:
+	unsigned long fastPeriod;			// limits [mSec]
+	unsigned long slowPeriod;
+	double errorBand;					// bands [C], [C/sec]
+	double rateBand;
+	unsigned long period;				// sample period [mSec]
+	unsigned long quietTime;			// time spent quiet [mSec]
+};
+
+#endif
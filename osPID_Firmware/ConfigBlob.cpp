@@ -0,0 +1,238 @@
+/******************************************************************************
+ *
+ *	Filename:		ConfigBlob.cpp
+ *
+ *	Description:	Packs the controller's settings (everything in EEPROM
+ *					but the relay wear counts, the run checkpoints & run
+ *					summaries, and the blank profile area) into one blob
+ *					with a header and a CRC, and unpacks one back into
+ *					EEPROM.  The sketch sends & receives blobs over the
+ *					serial port, so a whole unit can be set up from a file
+ *					in one transfer; on a PC, tools/config_tool.cpp shows,
+ *					compares & edits them.
+ *
+ *					Both directions go a byte at a time, so a blob is never
+ *					held in RAM.  An import checks the header before
+ *					anything is written, and only writes the EEPROM bytes
+ *					that actually change.  The CRC can only be checked once
+ *					all the data is in, so the caller has to deal with a
+ *					blob that was damaged on the way (see ConfigImportEnd in
+ *					the sketch).
+ *
+ *****************************************************************************/
+
+#include <stdint.h>
+#include "ConfigBlob.h"
+#include "EEPROMLayout.h"
+#include "ModbusRtu.h"
+#include "Recipe.h"
+#include "ZoneEngine.h"
+
+// The parts of EEPROM in a blob, in order.
+static const configRange_t configRanges[] PROGMEM =
+{
+	{ DIR_ADDR,			PROF_NAME_ADDR - DIR_ADDR },
+	{ INPUT_TYPE_ADDR,	OUTPUT_OPTIMIZE_ADDR + 1 - INPUT_TYPE_ADDR },
+	{ RECIPE_ADDR,		RECIPE_COUNT * sizeof(recipe_t) },
+	{ SPLIT_ADDR,		STATS_TOLERANCE_ADDR + 4 - SPLIT_ADDR },
+	{ ZONE_ADDR,		ZONE_COUNT * sizeof(zoneRecord_t) },
+};
+
+#define CONFIG_RANGES	(sizeof(configRanges) / sizeof(configRanges[0]))
+
+/******************************************************************************
+ *
+ *	Function:		ConfigBlob (Class Initializer)
+ *
+ *	Parameters:		read - reads a byte of EEPROM
+ *					write - writes a byte of EEPROM
+ *
+ *****************************************************************************/
+
+ConfigBlob::ConfigBlob(configRead_t read, configWrite_t write)
+{
+	this->read = read;
+	this->write = write;
+	Start();
+	state = CONFIG_STATE_IDLE;
+}
+
+uint16_t ConfigBlob::GetSize()
+{
+	uint16_t size = CONFIG_HEADER_SIZE + CONFIG_CHECK_SIZE;
+	uint8_t i;
+
+	for (i = 0; i < CONFIG_RANGES; i++)
+	{
+		size += pgm_read_word(&configRanges[i].length);
+	}
+	return size;
+}
+
+void ConfigBlob::Start()
+{
+	state = CONFIG_STATE_RUNNING;
+	position = 0;
+	range = 0;
+	offset = 0;
+	crc = 0xFFFF;
+	writes = 0;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Export
+ *
+ *	Description:	Fetches the next byte of the blob:  the header, then the
+ *					EEPROM data, then the CRC.  Call Start first.
+ *
+ *	Parameters:		data - the byte
+ *
+ *	Return Value:	true if there was one, false once the blob is done
+ *
+ *****************************************************************************/
+
+bool ConfigBlob::Export(uint8_t *data)
+{
+	uint16_t size = GetSize();
+
+	if ((state != CONFIG_STATE_RUNNING) || (position >= size))
+	{
+		return false;
+	}
+
+	if (position < CONFIG_HEADER_SIZE)
+	{
+		*data = HeaderByte(position);
+	}
+	else if (position < size - CONFIG_CHECK_SIZE)
+	{
+		*data = read(NextAddress());
+	}
+	else
+	{
+		// The CRC, low byte first.  The check covers everything before it.
+		*data = (position == size - CONFIG_CHECK_SIZE) ? crc : crc >> 8;
+		position++;
+		if (position == size)
+		{
+			state = CONFIG_STATE_DONE;
+		}
+		return true;
+	}
+
+	crc = ModbusCrcUpdate(crc, *data);
+	position++;
+	return true;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Import
+ *
+ *	Description:	Takes the next byte of a blob.  Each header byte must be
+ *					what this firmware would send, or the import stops
+ *					before anything is written.  Each data byte is written
+ *					to EEPROM if it's different from what's there.  Call
+ *					Start first.
+ *
+ *	Parameters:		data - the byte
+ *
+ *	Return Value:	CONFIG_STATE_RUNNING until the last byte
+ *					CONFIG_STATE_DONE if the blob was good
+ *					CONFIG_STATE_BAD_HEADER if it's not for this firmware
+ *					CONFIG_STATE_BAD_CHECK if it was damaged
+ *
+ *****************************************************************************/
+
+configState_t ConfigBlob::Import(uint8_t data)
+{
+	uint16_t size = GetSize();
+	uint16_t address;					// where the byte goes
+
+	if (state != CONFIG_STATE_RUNNING)
+	{
+		return state;
+	}
+
+	if (position < CONFIG_HEADER_SIZE)
+	{
+		if (data != HeaderByte(position))
+		{
+			state = CONFIG_STATE_BAD_HEADER;
+			return state;
+		}
+	}
+	else if (position < size - CONFIG_CHECK_SIZE)
+	{
+		address = NextAddress();
+		if (read(address) != data)
+		{
+			write(address, data);
+			writes++;
+		}
+	}
+	else
+	{
+		if (data != (uint8_t)((position == size - CONFIG_CHECK_SIZE) ?
+			crc : crc >> 8))
+		{
+			state = CONFIG_STATE_BAD_CHECK;
+			return state;
+		}
+		position++;
+		if (position == size)
+		{
+			state = CONFIG_STATE_DONE;
+		}
+		return state;
+	}
+
+	crc = ModbusCrcUpdate(crc, data);
+	position++;
+	return state;
+}
+
+configState_t ConfigBlob::GetState()
+{
+	return state;
+}
+
+uint16_t ConfigBlob::GetWrites()
+{
+	return writes;
+}
+
+// The header:  magic, layout version & data size.
+uint8_t ConfigBlob::HeaderByte(uint8_t index)
+{
+	uint16_t dataSize = GetSize() - CONFIG_HEADER_SIZE - CONFIG_CHECK_SIZE;
+
+	switch (index)
+	{
+	case 0:
+		return CONFIG_MAGIC_0;
+	case 1:
+		return CONFIG_MAGIC_1;
+	case 2:
+		return EEPROM_NO_RESET;
+	case 3:
+		return dataSize & 0xFF;
+	default:
+		return dataSize >> 8;
+	}
+}
+
+// Walk through the ranges a byte at a time.
+uint16_t ConfigBlob::NextAddress()
+{
+	uint16_t address = pgm_read_word(&configRanges[range].address) + offset;
+
+	offset++;
+	if (offset == pgm_read_word(&configRanges[range].length))
+	{
+		range++;
+		offset = 0;
+	}
+	return address;
+}
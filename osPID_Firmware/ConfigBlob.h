@@ -0,0 +1,83 @@
+#ifndef CONFIG_BLOB_H
+#define CONFIG_BLOB_H
+
+#include <stdint.h>
+
+// A configuration blob is:
+//
+//		'o' 'C'		magic
+//		version		EEPROM_NO_RESET of the firmware that made it
+//		size		bytes of data (2 bytes, low byte first)
+//		data		the EEPROM bytes in each of configRanges, in order
+//		check		Modbus CRC-16 of everything before it (2 bytes, low
+//					byte first)
+#define CONFIG_MAGIC_0		'o'
+#define CONFIG_MAGIC_1		'C'
+#define CONFIG_HEADER_SIZE	5			// [bytes]
+#define CONFIG_CHECK_SIZE	2			// [bytes]
+
+// Over the serial port, an import is acknowledged every CONFIG_CHUNK bytes
+// (so EEPROM writes can't overrun the receive buffer), and given up if
+// nothing arrives for CONFIG_TIMEOUT.
+#define CONFIG_CHUNK		32			// [bytes]
+#define CONFIG_TIMEOUT		2000		// [mSec]
+
+typedef struct							// a stretch of EEPROM in the blob
+{
+	uint16_t address;
+	uint16_t length;					// [bytes]
+} configRange_t;
+
+typedef enum							// how an export or import is going
+{
+	CONFIG_STATE_IDLE,					// Not started.
+	CONFIG_STATE_RUNNING,				// Part way through.
+	CONFIG_STATE_DONE,					// All there, and the check matched.
+	CONFIG_STATE_BAD_HEADER,			// Not a blob for this firmware;
+										// nothing was written.
+	CONFIG_STATE_BAD_CHECK,				// The data was written, but the
+										// check didn't match.
+} configState_t;
+
+typedef uint8_t (*configRead_t)(uint16_t address);
+typedef void (*configWrite_t)(uint16_t address, uint8_t data);
+
+class ConfigBlob
+{
+public:
+	// Initialize the class, with the functions that read & write EEPROM.
+	ConfigBlob(configRead_t read, configWrite_t write);
+
+	// Fetch the size of a blob [bytes].
+	static uint16_t GetSize();
+
+	// Start an export or an import from the beginning.
+	void Start();
+
+	// Fetch the next byte to export.  False once the blob is done.
+	bool Export(uint8_t *data);
+
+	// Take the next byte of a blob being imported.
+	configState_t Import(uint8_t data);
+
+	// Find how the export or import is going.
+	configState_t GetState();
+
+	// Fetch the number of EEPROM bytes the import changed.
+	uint16_t GetWrites();
+
+private:
+	configRead_t read;					// reads a byte of EEPROM
+	configWrite_t write;				// writes one
+	configState_t state;
+	uint16_t position;					// bytes of the blob so far
+	uint8_t range;						// data range we're in
+	uint16_t offset;					// bytes into it
+	uint16_t crc;						// check of the bytes so far
+	uint16_t writes;					// EEPROM bytes changed
+
+	uint8_t HeaderByte(uint8_t index);	// Fetch a byte of the header.
+	uint16_t NextAddress();				// Fetch the next data address.
+};
+
+#endif
@@ -31,56 +31,11 @@
 
 #include <EEPROM.h>
 #include <stdint.h>
+#include "Trace.h"
+#include "EEPROMLayout.h"
 
-// These are the EEPROM addresses where important stuff is stored.  Note that
-// we need to leave enough room so that nothing overlaps, or else stuff will be
-// overwritten.  Also note that our processor (Atmega328P) has 1024 bytes of
-// EEPROM, so the addresses cannot exceed that.  Also, the address type is a
-// uint16_t (since uint8_t can't exceed 255).
-
-// EEPROM management variable
-#define RESET_ADDR			0	// 1 byte
-
-// Tuning parameters
-#define DIR_ADDR			1	// 1 byte - char
-#define KP_ADDR				2	// 4 bytes - double
-#define KI_ADDR				6	// 4 bytes - double
-#define KD_ADDR				10	// 4 bytes - double
-
-// Dashboard settings
-#define MODE_ADDR			14	// 1 byte - char
-#define SP_ADDR				15	// 4 bytes - double
-#define OUTPUT_ADDR			19	// 4 bytes - double
-
-// Tuning variables
-#define TUNE_STEP_ADDR		23	// 4 bytes - double
-#define TUNE_NOISE_ADDR		27	// 4 bytes - double
-#define TUNE_LOOKBACK_ADDR	31	// 4 bytes - double
-
-// Profile variables (136 bytes)
-#define PROF_NAME_ADDR		35	// string - 8 bytes (including NULL)
-#define PROF_TYPES_ADDR		43	// 24 bytes of profile data
-#define PROF_VALS_ADDR		67	// 85 bytes of profile data
-#define PROF_TIMES_ADDR		152	// 20 bytes of profile data
-
-// Input Card variables (# bytes depends on the card)
-#define INPUT_TYPE_ADDR		172	// 1 byte - char
-#define INPUT_REFRES_ADDR	173	// 4 bytes - double
-#define INPUT_BETA_ADDR		176	// 4 bytes - double
-#define INPUT_REFTEMP_ADDR	180	// 4 bytes - double
-#define INPUT_DIV_ADDR		184	// 4 bytes - double
-
-// Output Card variables (# bytes depends on the card)
-#define OUTPUT_RELAY_ADDR	300	// 1 byte - char
-#define OUTPUT_WINDOW_ADDR	301	// 4 bytes - unsigned long
-
-// EEPROM address 0 holds a value used to automatically trigger an EEPROM reset
-// If this value is not equal to a certain value (defined by EEPROM_RESET
-// below), then this module will reload all variables from EEPROM.  This is
-// usually done after a firmware update or reset.  Note that values stored in
-// EEPROM are of type uint8_t.
-#define EEPROM_RESET		0	// "Please reset me to default values."
-#define EEPROM_NO_RESET		2	// "Don't reset me."
+// The EEPROM addresses are listed in EEPROMLayout.h, which the host tools
+// share.
 
 /******************************************************************************
  *
@@ -107,15 +62,17 @@ template <class T> int EEPROM_writeAnything(int address, const T& data)
 		// If the data is different from what's there...
 		if (EEPROM.read(address) != *ptr)
 		{
-			// Write the data to EEPROM.
+			// Write the data to EEPROM.  Each byte takes about 3.3 mSec.
+			TRACE_BEGIN(TRACE_EEPROM, address);
 			EEPROM.write(address, *ptr);
+			TRACE_END(TRACE_EEPROM, address);
 		}
 		
 		// Increment the address.
 		address++;
 		
 		// Increment the pointer.
-		*ptr++;
+		ptr++;
 	}
 	
 	// Return the number of bytes written to EEPROM.
@@ -145,10 +102,10 @@ template <class T> int EEPROM_readAnything(int address, T& data)
 	for (i = 0; i < sizeof(data); i++)
 	{
 		// Read the data.
-		*ptr = EEPROM.read(address++);
+		*ptr = EEPROM.read(address);
 		
 		// Increment the pointer.
-		*ptr++;
+		ptr++;
 		
 		// Increment the address.
 		address++;
@@ -0,0 +1,156 @@
+/******************************************************************************
+ *
+ *	Filename:		EEPROMLayout.h
+ *
+ *	Description:	Where each setting is kept in EEPROM.  It includes
+ *					nothing from the Arduino, so the host tools (see
+ *					tools/config_tool.cpp) can read & edit the settings with
+ *					the same addresses the firmware uses.
+ *
+ *****************************************************************************/
+
+#ifndef EEPROM_LAYOUT_H
+#define EEPROM_LAYOUT_H
+
+// These are the EEPROM addresses where important stuff is stored.  Note that
+// we need to leave enough room so that nothing overlaps, or else stuff will be
+// overwritten.  Also note that our processor (Atmega328P) has 1024 bytes of
+// EEPROM, so the addresses cannot exceed that.  Also, the address type is a
+// uint16_t (since uint8_t can't exceed 255).
+
+// EEPROM management variable
+#define RESET_ADDR			0	// 1 byte
+
+// Tuning parameters
+#define DIR_ADDR			1	// 1 byte - char
+#define KP_ADDR				2	// 4 bytes - double
+#define KI_ADDR				6	// 4 bytes - double
+#define KD_ADDR				10	// 4 bytes - double
+
+// Dashboard settings
+#define MODE_ADDR			14	// 1 byte - char
+#define SP_ADDR				15	// 4 bytes - double
+#define OUTPUT_ADDR			19	// 4 bytes - double
+
+// Tuning variables
+#define TUNE_STEP_ADDR		23	// 4 bytes - double
+#define TUNE_NOISE_ADDR		27	// 4 bytes - double
+#define TUNE_LOOKBACK_ADDR	31	// 4 bytes - double
+
+// Profile variables (136 bytes)
+#define PROF_NAME_ADDR		35	// string - 8 bytes (including NULL)
+#define PROF_TYPES_ADDR		43	// 24 bytes of profile data
+#define PROF_VALS_ADDR		67	// 85 bytes of profile data
+#define PROF_TIMES_ADDR		152	// 20 bytes of profile data
+
+// Input Card variables (# bytes depends on the card)
+#define INPUT_TYPE_ADDR		172	// 1 byte - char
+#define INPUT_REFRES_ADDR	173	// 4 bytes - double
+#define INPUT_BETA_ADDR		177	// 4 bytes - double
+#define INPUT_REFTEMP_ADDR	181	// 4 bytes - double
+#define INPUT_DIV_ADDR		185	// 4 bytes - double
+#define INPUT_MODEL_ADDR	189	// 1 byte - char
+#define INPUT_SH_A_ADDR		190	// 4 bytes - double
+#define INPUT_SH_B_ADDR		194	// 4 bytes - double
+#define INPUT_SH_C_ADDR		198	// 4 bytes - double
+#define INPUT_FAILOVER_ADDR	202	// 1 byte - char
+#define INPUT_SAFE_OUT_ADDR	203	// 4 bytes - double
+#define INPUT_MAX_RATE_ADDR	207	// 4 bytes - double
+
+// Controller variables
+#define CTRL_TYPE_ADDR		212	// 1 byte - char
+#define MODEL_GAIN_ADDR		213	// 4 bytes - double
+#define MODEL_TAU_ADDR		217	// 4 bytes - double
+#define MODEL_DEADTIME_ADDR	221	// 4 bytes - double
+#define SAFETY_ALARM_ADDR	225	// 1 byte - char
+#define ESTIMATOR_ADDR		226	// 1 byte - char
+#define EST_TC_NOISE_ADDR	227	// 4 bytes - double
+#define EST_TH_NOISE_ADDR	231	// 4 bytes - double
+
+// Serial port variables
+#define PROTOCOL_ADDR		235	// 1 byte - char
+#define MODBUS_ID_ADDR		236	// 1 byte - char
+
+// Sampling variables
+#define ADAPTIVE_ADDR		237	// 1 byte - char
+
+// PID setpoint weights
+#define PID_BETA_ADDR		238	// 4 bytes - double
+#define PID_GAMMA_ADDR		242	// 4 bytes - double
+
+// On/off control variables
+#define ONOFF_DIFF_ADDR		246	// 4 bytes - double
+#define ONOFF_MIN_ON_ADDR	250	// 4 bytes - unsigned long
+#define ONOFF_MIN_OFF_ADDR	254	// 4 bytes - unsigned long
+
+// Recipe variables
+#define RECIPE_ACTIVE_ADDR	258	// 1 byte - char
+
+// Cascade tuning parameters
+#define CASC_OUTER_KP_ADDR	259	// 4 bytes - double
+#define CASC_OUTER_KI_ADDR	263	// 4 bytes - double
+#define CASC_OUTER_KD_ADDR	267	// 4 bytes - double
+#define CASC_INNER_KP_ADDR	271	// 4 bytes - double
+#define CASC_INNER_KI_ADDR	275	// 4 bytes - double
+#define CASC_INNER_KD_ADDR	279	// 4 bytes - double
+
+// Setpoint ramp variables
+#define RAMP_RATE_ADDR		283	// 4 bytes - double
+#define RAMP_ACCEL_ADDR		287	// 4 bytes - double
+
+// PID derivative filter
+#define PID_DFILTER_ADDR	291	// 4 bytes - double
+
+// Output Card variables (# bytes depends on the card)
+#define OUTPUT_RELAY_ADDR	300	// 1 byte - char
+#define OUTPUT_WINDOW_ADDR	301	// 4 bytes - unsigned long
+#define OUTPUT_OPTIMIZE_ADDR	305	// 1 byte - char
+
+// Relay operation counts.  These aren't reset with the settings.  They're
+// saved to each of RELAY_WEAR_SLOTS slots in turn (wear leveling), every
+// RELAY_WEAR_SAVE_OPS operations.
+#define RELAY_WEAR_ADDR		320	// RELAY_WEAR_SLOTS x 10 bytes - relayWear_t
+#define RELAY_WEAR_SLOTS	8
+#define RELAY_WEAR_SAVE_OPS	20
+
+// Recipes:  RECIPE_COUNT (at most 8) stored sets of setpoint, tunings,
+// direction, sensor & output window.  Each has its own check, so one can be
+// read without looking at the others.
+#define RECIPE_ADDR			400	// RECIPE_COUNT x 25 bytes - recipe_t
+#define RECIPE_COUNT		8
+
+// Run checkpoints:  the mode, recipe, output & time into the run, saved to
+// each of CHECKPOINT_SLOTS slots in turn (wear leveling) every
+// checkpointPeriod while running.  At one a minute, each cell is written
+// once every 16 minutes, so 100,000 writes last three years of running.
+#define CHECKPOINT_ADDR		600	// CHECKPOINT_SLOTS x 14 bytes - checkpoint_t
+#define CHECKPOINT_SLOTS	16
+
+// Split-range output variables
+#define SPLIT_ADDR			824	// 1 byte - char
+#define SPLIT_DEADBAND_ADDR	825	// 4 bytes - double
+#define SPLIT_HEAT_GAIN_ADDR	829	// 4 bytes - double
+#define SPLIT_COOL_GAIN_ADDR	833	// 4 bytes - double
+#define SPLIT_HEAT_OFF_ADDR	837	// 4 bytes - unsigned long
+#define SPLIT_COOL_OFF_ADDR	841	// 4 bytes - unsigned long
+
+// Run statistics:  the tolerance band, and a summary of each of the last
+// RUN_SUMMARY_SLOTS runs, saved to each slot in turn as a run ends.
+#define STATS_TOLERANCE_ADDR	845	// 4 bytes - double
+#define RUN_SUMMARY_ADDR	852	// RUN_SUMMARY_SLOTS x 33 bytes - runSummary_t
+#define RUN_SUMMARY_SLOTS	4
+
+// Zone control:  each zone's setpoint, tunings, output window & direction
+// (ZONE_COUNT of them; see ZoneEngine.h).
+#define ZONE_ADDR			984	// ZONE_COUNT x 19 bytes - zoneRecord_t
+
+// EEPROM address 0 holds a value used to automatically trigger an EEPROM reset
+// If this value is not equal to a certain value (defined by EEPROM_RESET
+// below), then this module will reload all variables from EEPROM.  This is
+// usually done after a firmware update or reset.  Note that values stored in
+// EEPROM are of type uint8_t.
+#define EEPROM_RESET		0	// "Please reset me to default values."
+#define EEPROM_NO_RESET		17	// "Don't reset me."  Change this when the
+								// layout above changes.
+
+#endif
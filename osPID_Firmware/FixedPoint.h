@@ -0,0 +1,52 @@
+/******************************************************************************
+ *
+ *	Filename:		FixedPoint.h
+ *
+ *	Description:	Helpers for signed 16.16 fixed-point numbers.  The AVR has
+ *					no floating-point hardware, so anything that runs every
+ *					sample (models, filters, conversions) should keep its
+ *					state in fixed point and only convert to/from double at
+ *					the edges.  A fixed_t holds values from -32768 to +32767
+ *					with a resolution of 1/65536, which is plenty for
+ *					temperatures in degrees C.
+ *
+ *****************************************************************************/
+
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <stdint.h>
+
+typedef int32_t fixed_t;				// signed 16.16 fixed-point number
+
+#define FIXED_SHIFT		16				// number of fractional bits
+#define FIXED_ONE		((fixed_t)1 << FIXED_SHIFT)	// 1.0 in fixed point
+
+// Convert an integer to fixed point.
+#define FIXED_FROM_INT(i)	((fixed_t)(i) << FIXED_SHIFT)
+
+// Convert a double to fixed point (rounds to the nearest step).
+static inline fixed_t FixedFromDouble(double value)
+{
+	return (fixed_t)(value * (double)FIXED_ONE + ((value < 0) ? -0.5 : 0.5));
+}
+
+// Convert fixed point to a double.
+static inline double FixedToDouble(fixed_t value)
+{
+	return (double)value / (double)FIXED_ONE;
+}
+
+// Multiply two fixed-point numbers.
+static inline fixed_t FixedMul(fixed_t a, fixed_t b)
+{
+	return (fixed_t)(((int64_t)a * (int64_t)b) >> FIXED_SHIFT);
+}
+
+// Divide two fixed-point numbers.  The caller must make sure b is not zero.
+static inline fixed_t FixedDiv(fixed_t a, fixed_t b)
+{
+	return (fixed_t)(((int64_t)a << FIXED_SHIFT) / b);
+}
+
+#endif
@@ -23,11 +23,12 @@
 #include <Arduino.h>
 #include <stdint.h>
 #include "InputCard.h"
+#include "PowerSave.h"
 
 #ifdef TEMP_INPUT_V110
-const char inputCardVersion[5] = "IID1";
-#else ifdefined TEMP_INPUT_V120
-const char inputCardVersion[5] = "IID2";
+const char inputCardVersion[5] PROGMEM = "IID1";
+#elif defined TEMP_INPUT_V120
+const char inputCardVersion[5] PROGMEM = "IID2";
 #endif
 
 uint8_t thermistorPin = A6;
@@ -36,8 +37,10 @@ uint8_t thermocoupleMISO = 12;
 uint8_t thermocoupleCLK = 13;
 
 #ifdef TEMP_INPUT_V120
-#include "MAX31855.h"
-MAX31855 thermocouple(thermocoupleMISO, thermocoupleCS, thermocoupleCLK);
+#include "TypeK.h"
+
+// MAX31855 data word
+#define MAX31855_FAULT	0x00010000UL	// any fault (open or shorted)
 #endif
 
 #ifdef TEMP_INPUT_V110
@@ -78,12 +81,23 @@ InputCard::InputCard(byte pinThermistor, byte pinCS, byte pinMISO, byte pinCLK)
 	thermocoupleMISO = pinMISO;
 	thermocoupleCLK = pinCLK;
 	
+#ifdef TEMP_INPUT_V120
+	// Set up the thermocouple chip's pins (idle with chip deselected).
+	pinMode(thermocoupleCS, OUTPUT);
+	digitalWrite(thermocoupleCS, HIGH);
+	pinMode(thermocoupleCLK, OUTPUT);
+	digitalWrite(thermocoupleCLK, LOW);
+	pinMode(thermocoupleMISO, INPUT);
+#endif
+	
 	// Set default coefficients.
 	inputType = INPUT_SENSOR_THERMISTOR;// default input type is thermocouple
 	thermRes = 10000;					// default thermistor is 10 kOhm @ 25 C
 	thermRefTemp = 25;
 	thermBeta = 3575;					// default thermistor beta is 3575
 	refRes = 10000;						// default thermistor has ref resistor 10 Ohm
+	calCount = 0;
+	SetThermistorCoeffs(thermRes, thermRefTemp, thermBeta, refRes);
 }
 
 #if (defined(TEMP_INPUT_V110) || defined(TEMP_INPUT_V120))
@@ -139,7 +153,11 @@ inputSensor_t InputCard::GetSensorType()
 *
 * Function:	SetThermistorCoeffs
 *
-* Description:	Sets the thermistor's calibration coefficients.
+* Description:	Sets the thermistor's calibration coefficients, and
+*		switches to the Beta model.  The Beta model is the
+*		Steinhart-Hart model with C = 0, so it's converted to
+*		Steinhart-Hart coefficients here, once, and sampling uses
+*		the same math for both models.
 *
 ******************************************************************************/
 
@@ -149,6 +167,12 @@ void InputCard::SetThermistorCoeffs(double res, double temp, double beta, double
 	  thermRefTemp = temp;	//thermistor's reference temperature
 	  thermBeta = beta;		//thermistor's beta coefficient
 	  refRes = divider;		//value of resistor used for thermistor's voltage divider
+
+	  // 1/T = 1/To + 1/B * ln(R/Ro) = (1/To - ln(Ro)/B) + (1/B) * ln(R)
+	  thermModel = INPUT_THERM_BETA;
+	  shA = 1.0 / (temp + 273.15) - log(res) / beta;
+	  shB = 1.0 / beta;
+	  shC = 0;
 }
 
 double InputCard::GetThermistorRefRes()
@@ -171,51 +195,403 @@ double InputCard::GetThermistorDiv()
 	return refRes;
 }
 
-double InputCard::CalcSteinhart(float R)
+/******************************************************************************
+ *
+ *	Function:		SetSteinhartCoeffs
+ *
+ *	Description:	Sets Steinhart-Hart coefficients, and switches to the
+ *					Steinhart-Hart model:
+ *
+ *						1/T = A + B * ln(R) + C * ln(R)^3
+ *
+ *					where T is in Kelvin and R in Ohms.
+ *
+ *	Return Value:	enumerated error code
+ *
+ *****************************************************************************/
+
+inputResult_t InputCard::SetSteinhartCoeffs(double A, double B, double C)
+{
+	// Start as a pessimist :(
+	inputResult_t result = INPUT_RESULT_INVALID;
+	
+	// Resistance must fall as temperature rises (B > 0).
+	if ((B > 0) && !isnan(A) && !isnan(C))
+	{
+		thermModel = INPUT_THERM_STEINHART;
+		shA = A;
+		shB = B;
+		shC = C;
+		
+		// If we got here, we're ok :)
+		result = INPUT_RESULT_OK;
+	}
+	
+	return result;
+}
+
+void InputCard::GetSteinhartCoeffs(double *A, double *B, double *C)
+{
+	*A = shA;
+	*B = shB;
+	*C = shC;
+}
+
+inputThermModel_t InputCard::GetThermistorModel()
+{
+	return thermModel;
+}
+
+/******************************************************************************
+ *
+ *	Function:		CalcSteinhart
+ *
+ *	Description:	Calculates the thermistor's temperature from its
+ *					resistance with the Steinhart-Hart equation.  The
+ *					coefficients are worked out ahead of time (whichever model
+ *					is in use), so this is all a sample costs.
+ *
+ *	Parameters:		R - thermistor resistance [Ohms]
+ *
+ *	Return Value:	temperature [C]
+ *
+ *****************************************************************************/
+
+double InputCard::CalcSteinhart(double R)
+{
+	double lnR;		// ln(R)
+
+	lnR = log(R);
+
+	return 1.0 / (shA + (shB + shC * lnR * lnR) * lnR) - 273.15;
+}
+
+/******************************************************************************
+ *
+ *	Function:		ReadThermistorRes
+ *
+ *	Description:	Reads the thermistor's resistance.  Several readings are
+ *					averaged, since this is used for calibration, not in the
+ *					sampling path.
+ *
+ *	Parameters:		res - resistance [Ohms]
+ *
+ *	Return Value:	enumerated error code
+ *
+ *****************************************************************************/
+
+inputResult_t InputCard::ReadThermistorRes(double *res)
 {
-	float steinhart;	// eventually this will be temperature [C]
+	uint16_t counts = 0;	// sum of ADC readings
+	uint8_t i;
+
+	for (i = 0; i < 16; i++)
+	{
+		counts += SleepAnalogRead(thermistorPin);
+	}
 
-	steinhart = R / thermRes;					// (R/Ro)
-	steinhart = log(steinhart);					// ln(R/Ro)
-	steinhart /= thermBeta;						// 1/B * ln(R/Ro)
-	steinhart += 1.0 / (thermRefTemp + 273.15);	// + (1/To)
-	steinhart = 1.0 / steinhart;				// Invert
-	steinhart -= 273.15;						// convert to C
+	// If the reading is stuck at a rail, the thermistor's open or shorted.
+	if ((counts <= 16 * THERM_RAIL_MARGIN) ||
+		(counts >= 16 * (1023 - THERM_RAIL_MARGIN)))
+	{
+		return INPUT_RESULT_FAIL;
+	}
+
+	*res = refRes / (16 * 1024.0 / counts - 1);
 
-	return steinhart;
+	return INPUT_RESULT_OK;
 }
 
-double InputCard::ReadFromCard()
+/******************************************************************************
+ *
+ *	Function:		AddCalibrationPoint
+ *
+ *	Description:	Records the thermistor's resistance right now, along with
+ *					the true temperature (from a reference thermometer or a
+ *					known bath).  Points should be spread over the range the
+ *					thermistor will be used in.
+ *
+ *	Parameters:		refTemp - reference temperature [C]
+ *
+ *	Return Value:	enumerated error code
+ *
+ *****************************************************************************/
+
+inputResult_t InputCard::AddCalibrationPoint(double refTemp)
 {
-	double temp = NAN;	// sensor temperature
+	double res;				// thermistor resistance [Ohms]
+	inputResult_t result;
+
+	if (calCount >= INPUT_CAL_POINTS)
+	{
+		return INPUT_RESULT_INVALID;
+	}
+
+	result = ReadThermistorRes(&res);
+	if (result == INPUT_RESULT_OK)
+	{
+		calLogRes[calCount] = log(res);
+		calTemp[calCount] = refTemp;
+		calCount++;
+	}
+
+	return result;
+}
+
+uint8_t InputCard::GetCalibrationCount()
+{
+	return calCount;
+}
+
+void InputCard::ClearCalibration()
+{
+	calCount = 0;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Calibrate
+ *
+ *	Description:	Fits Steinhart-Hart coefficients to the calibration points
+ *					and starts using them.  With 3 points the fit is exact;
+ *					with more, it's a least-squares fit of 1/T.  This runs
+ *					once, so it uses floating point.
+ *
+ *					The AVR's double is only 32 bits, and the columns of the
+ *					fit (1, ln R & ln(R)^3) are nearly parallel, so solving
+ *					the normal equations would lose most of the precision.
+ *					Instead the columns are orthogonalized first (modified
+ *					Gram-Schmidt QR), which keeps the fit's own error to about
+ *					a thousandth of a degree.
+ *
+ *	Return Value:	enumerated error code
+ *
+ *****************************************************************************/
+
+inputResult_t InputCard::Calibrate()
+{
+	double q[3][INPUT_CAL_POINTS];		// orthonormal columns
+	double r[3][3];						// upper-triangular factor
+	double z[3];						// Q' * (1/T)
+	double coeff[3];					// A, B & C
+	double y;							// 1/T [1/K]
+	uint8_t i;
+	uint8_t j;
+	uint8_t k;
+
+	if (calCount < 3)
+	{
+		return INPUT_RESULT_INVALID;
+	}
+
+	// Columns are 1, ln R & ln(R)^3.
+	for (i = 0; i < calCount; i++)
+	{
+		q[0][i] = 1;
+		q[1][i] = calLogRes[i];
+		q[2][i] = calLogRes[i] * calLogRes[i] * calLogRes[i];
+	}
+
+	// Orthonormalize the columns.
+	for (j = 0; j < 3; j++)
+	{
+		for (k = 0; k < j; k++)
+		{
+			r[k][j] = 0;
+			for (i = 0; i < calCount; i++)
+			{
+				r[k][j] += q[k][i] * q[j][i];
+			}
+			for (i = 0; i < calCount; i++)
+			{
+				q[j][i] -= r[k][j] * q[k][i];
+			}
+		}
+
+		r[j][j] = 0;
+		for (i = 0; i < calCount; i++)
+		{
+			r[j][j] += q[j][i] * q[j][i];
+		}
+		r[j][j] = sqrt(r[j][j]);
+
+		// If the points don't span the model, give up.
+		if (r[j][j] == 0)
+		{
+			return INPUT_RESULT_INVALID;
+		}
+
+		for (i = 0; i < calCount; i++)
+		{
+			q[j][i] /= r[j][j];
+		}
+	}
+
+	// Project 1/T onto the columns.
+	for (j = 0; j < 3; j++)
+	{
+		z[j] = 0;
+		for (i = 0; i < calCount; i++)
+		{
+			y = 1.0 / (calTemp[i] + 273.15);
+			z[j] += q[j][i] * y;
+		}
+	}
+
+	// Back-substitute for the coefficients.
+	for (j = 3; j-- > 0; )
+	{
+		coeff[j] = z[j];
+		for (k = j + 1; k < 3; k++)
+		{
+			coeff[j] -= r[j][k] * coeff[k];
+		}
+		coeff[j] /= r[j][j];
+	}
+
+	return SetSteinhartCoeffs(coeff[0], coeff[1], coeff[2]);
+}
+
+/******************************************************************************
+ *
+ *	Function:		ReadFromCard
+ *
+ *	Description:	Reads the selected sensor, and notes when the reading
+ *					was taken, so whoever uses it can work with the real time
+ *					between readings instead of assuming a fixed period.
+ *
+ *	Parameters:		sample - the temperature [C] (or NAN if the sensor has
+ *						failed), the result & the capture time
+ *
+ *	Return Value:	enumerated error code
+ *
+ *****************************************************************************/
+
+inputResult_t InputCard::ReadFromCard(inputSample_t *sample)
+{
+	sample->status = ReadSensor(inputType, &sample->value);
+	sample->time = micros();
+
+	return sample->status;
+}
+
+/******************************************************************************
+ *
+ *	Function:		ReadSensor
+ *
+ *	Description:	Reads one of the card's sensors, regardless of which one
+ *					is selected, and checks it for hardware faults.  A
+ *					thermocouple fault is reported by the chip.  A thermistor
+ *					fault shows up as an ADC reading stuck at a rail.
+ *
+ *	Parameters:		sensor - which sensor to read
+ *					temp - the temperature [C], or NAN if the sensor failed
+ *
+ *	Return Value:	enumerated error code
+ *
+ *****************************************************************************/
+
+inputResult_t InputCard::ReadSensor(inputSensor_t sensor, double *temp)
+{
+	// Start as a pessimist :(
+	inputResult_t result = INPUT_RESULT_FAIL;
+	
+	*temp = NAN;
 	
 	// If we're using a thermocouple...
-	if(inputType == INPUT_SENSOR_THERMOCOUPLE)
+	if (sensor == INPUT_SENSOR_THERMOCOUPLE)
 	{
+#ifdef TEMP_INPUT_V120
+		// Read both junctions from the thermocouple chip...
+		uint32_t data = ReadThermocoupleChip();
+
+		// If there wasn't an error...
+		if (!(data & MAX31855_FAULT))
+		{
+			// Pull out the signed hot-junction (bits 31-18) and cold-junction
+			// (bits 15-4) readings, and linearize them.
+			int16_t hot = (int16_t)(data >> 16) >> 2;
+			int16_t cold = (int16_t)(data & 0xFFFF) >> 4;
+			*temp = TypeKLinearize(hot, cold) / 16.0;
+			result = INPUT_RESULT_OK;
+		}
+#else
 		// Read temperature from the thermocouple chip...
-		temp = thermocouple.readThermocouple(CELSIUS);
+		double reading = thermocouple.readThermocouple(CELSIUS);
 
-		// If there was an error...
-		if (temp == FAULT_OPEN || temp == FAULT_SHORT_GND || temp == FAULT_SHORT_VCC)
+		// If there wasn't an error...
+		if (reading != FAULT_OPEN && reading != FAULT_SHORT_GND &&
+			reading != FAULT_SHORT_VCC)
 		{
-			// Set an error value.
-			temp = NAN;
+			*temp = reading;
+			result = INPUT_RESULT_OK;
 		}
+#endif
 	}
 	// If we're using a thermistor...
-	else if(inputType == INPUT_SENSOR_THERMISTOR)
+	else if (sensor == INPUT_SENSOR_THERMISTOR)
+	{
+		// Read the analog pin, with the CPU asleep to keep it quiet.
+		int counts = SleepAnalogRead(thermistorPin);
+
+		// If the reading isn't stuck at a rail...
+		if ((counts > THERM_RAIL_MARGIN) &&
+			(counts < 1023 - THERM_RAIL_MARGIN))
+		{
+			// Convert to resistance.
+			double R = refRes / (1024.0/(float)counts - 1);
+
+			// Convert to temperature.
+			*temp = CalcSteinhart(R);
+			result = INPUT_RESULT_OK;
+		}
+	}
+	else
 	{
-		// Read the analog pin.
-		int counts = analogRead(thermistorPin);
+		result = INPUT_RESULT_INVALID;
+	}
+
+	return result;
+}
 
-		// Convert to resistance.
-		int R = refRes / (1024.0/(float)counts - 1);
+#ifdef TEMP_INPUT_V120
 
-		// Convert to temperature.
-		temp = CalcSteinhart(R);
+/******************************************************************************
+ *
+ *	Function:		ReadThermocoupleChip
+ *
+ *	Description:	Reads the MAX31855's 32-bit data word.  The chip puts out
+ *					its first bit when selected, and each following bit on a
+ *					falling clock edge.  The word holds the hot-junction
+ *					temperature, the cold-junction temperature & fault bits.
+ *
+ *	Return Value:	raw data word
+ *
+ *****************************************************************************/
+
+uint32_t InputCard::ReadThermocoupleChip()
+{
+	uint32_t data = 0;
+	uint8_t i;
+
+	digitalWrite(thermocoupleCS, LOW);
+
+	for (i = 0; i < 32; i++)
+	{
+		data <<= 1;
+		if (digitalRead(thermocoupleMISO))
+		{
+			data |= 1;
+		}
+		digitalWrite(thermocoupleCLK, HIGH);
+		digitalWrite(thermocoupleCLK, LOW);
 	}
 
-	return temp;
+	digitalWrite(thermocoupleCS, HIGH);
+
+	return data;
 }
 
+#endif
+
 #endif /*TEMP_INPUT_V110 || TEMP_INPUT_V120*/
@@ -8,6 +8,10 @@
 //#define TEMP_INPUT_V110
 #define TEMP_INPUT_V120
 
+// Thermistor ADC readings this close to either rail mean the thermistor is
+// open (high rail) or shorted (low rail).
+#define THERM_RAIL_MARGIN	4				// [counts]
+
 typedef enum							// status from functions
 {
 	INPUT_RESULT_OK,					// All is well!
@@ -16,6 +20,23 @@ typedef enum							// status from functions
 	INPUT_RESULT_NOT_IMPLEMENTED,		// It's my fault.
 } inputResult_t;
 
+typedef struct							// one reading, as captured
+{
+	double value;						// temperature [C], or NAN
+	inputResult_t status;				// INPUT_RESULT_OK if value is good
+	unsigned long time;					// micros() when it was read
+} inputSample_t;
+
+typedef enum							// thermistor conversion model
+{
+	INPUT_THERM_BETA = 0,				// Beta model (R, T & Beta)
+	INPUT_THERM_STEINHART,				// Steinhart-Hart model (A, B & C)
+} inputThermModel_t;
+
+// Most reference points the thermistor calibration can use.  The
+// Steinhart-Hart model needs at least 3.
+#define INPUT_CAL_POINTS	5
+
 typedef enum							// type of sensor used
 {
 	INPUT_SENSOR_THERMOCOUPLE = 0,		// thermocouple
@@ -49,8 +70,35 @@ public:
 	// Fetch the value of resistor used for thermistor's voltage divider.
 	double GetThermistorDiv();
 	
-	// Read data from card.
-	double ReadFromCard();
+	// Set Steinhart-Hart coefficients for thermistor.
+	inputResult_t SetSteinhartCoeffs(double A, double B, double C);
+	
+	// Fetch the Steinhart-Hart coefficients in use (for either model).
+	void GetSteinhartCoeffs(double *A, double *B, double *C);
+	
+	// Find which model converts the thermistor's resistance.
+	inputThermModel_t GetThermistorModel();
+	
+	// Read the thermistor's resistance.
+	inputResult_t ReadThermistorRes(double *res);
+	
+	// Record a thermistor calibration point at a reference temperature.
+	inputResult_t AddCalibrationPoint(double refTemp);
+	
+	// Find how many calibration points have been recorded.
+	uint8_t GetCalibrationCount();
+	
+	// Forget the recorded calibration points.
+	void ClearCalibration();
+	
+	// Fit Steinhart-Hart coefficients to the calibration points.
+	inputResult_t Calibrate();
+	
+	// Read the selected sensor, and note when.
+	inputResult_t ReadFromCard(inputSample_t *sample);
+	
+	// Read one sensor, whichever type is selected.
+	inputResult_t ReadSensor(inputSensor_t sensor, double *temp);
   
 private:
 	inputSensor_t inputType;			// type of sensor we're using
@@ -58,9 +106,21 @@ private:
 	double thermRefTemp;				// thermistor's reference temperature
 	double thermBeta;					// thermistor's beta coefficient
 	double refRes;						// value of resistor used for thermistor's voltage divider
+	inputThermModel_t thermModel;		// which model the coefficients came from
+	double shA;							// Steinhart-Hart coefficients in use
+	double shB;
+	double shC;
+	uint8_t calCount;					// calibration points recorded
+	double calLogRes[INPUT_CAL_POINTS];	// ln(resistance) at each point
+	double calTemp[INPUT_CAL_POINTS];	// reference temperature at each point [C]
 
 	// Calculate the thermistor's temperature from a resistance.
-	double CalcSteinhart(float R);
+	double CalcSteinhart(double R);
+
+#ifdef TEMP_INPUT_V120
+	// Read the thermocouple chip's raw data.
+	uint32_t ReadThermocoupleChip();
+#endif
 };
 
 #endif
@@ -0,0 +1,304 @@
+/******************************************************************************
+ *
+ *	Filename:		ModbusRtu.cpp
+ *
+ *	Description:	The protocol half of a Modbus RTU slave.  It takes a
+ *					complete request frame, checks it, carries it out against
+ *					a table of registers, and builds the response in the same
+ *					buffer.  Getting frames on and off the wire is up to
+ *					ModbusSlave, so this half has no hardware in it and can be
+ *					tested on a PC (tools/modbus_hammer.cpp).
+ *
+ *					Registers are 16 bits.  The table is in flash, indexed by
+ *					register address, so finding a register takes the same
+ *					time no matter how many there are.  Holding and input
+ *					registers are the same table.
+ *
+ *					Supported functions are 03 & 04 (read registers), 06
+ *					(write one register) & 16 (write several).  A multiple
+ *					write checks that every register is writable before
+ *					changing any, but if one of the values is refused, the
+ *					ones before it stay written.
+ *
+ *****************************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ModbusRtu.h"
+
+// CRC-16 (polynomial 0xA001, reflected) of every possible byte.
+static const uint16_t crcTable[256] PROGMEM =
+{
+	0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+	0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+	0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+	0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+	0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+	0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+	0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+	0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+	0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+	0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+	0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+	0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+	0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+	0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+	0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+	0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+	0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+	0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+	0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+	0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+	0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+	0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+	0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+	0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+	0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+	0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+	0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+	0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+	0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+	0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+	0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+	0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040
+};
+
+/******************************************************************************
+ *
+ *	Function:		ModbusCrc
+ *
+ *	Description:	Calculates the CRC that ends every Modbus RTU frame, a
+ *					byte at a time from a table.  The CRC is sent low byte
+ *					first.
+ *
+ *	Parameters:		data - the bytes to check
+ *					length - number of bytes
+ *
+ *	Return Value:	the CRC
+ *
+ *****************************************************************************/
+
+uint16_t ModbusCrc(const uint8_t *data, uint8_t length)
+{
+	uint16_t crc = 0xFFFF;
+
+	while (length--)
+	{
+		crc = (crc >> 8) ^ pgm_read_word(&crcTable[(uint8_t)crc ^ *data++]);
+	}
+
+	return crc;
+}
+
+// Add one more byte to a CRC (start from 0xFFFF), for data that arrives a
+// byte at a time.
+uint16_t ModbusCrcUpdate(uint16_t crc, uint8_t data)
+{
+	return (crc >> 8) ^ pgm_read_word(&crcTable[(uint8_t)crc ^ data]);
+}
+
+/******************************************************************************
+ *
+ *	Function:		ModbusRtu (Class Initializer)
+ *
+ *****************************************************************************/
+
+ModbusRtu::ModbusRtu()
+{
+	slaveAddress = 1;					// default address is 1
+	registers = NULL;
+	registerCount = 0;
+}
+
+bool ModbusRtu::SetAddress(uint8_t address)
+{
+	if ((address < 1) || (address > 247))
+	{
+		return false;
+	}
+
+	slaveAddress = address;
+	return true;
+}
+
+uint8_t ModbusRtu::GetAddress()
+{
+	return slaveAddress;
+}
+
+void ModbusRtu::SetRegisters(const modbusRegister_t *table, uint8_t count)
+{
+	registers = table;
+	registerCount = count;
+}
+
+void ModbusRtu::GetRegister(uint16_t address, modbusRegister_t *reg)
+{
+	memcpy_P(reg, &registers[address], sizeof(modbusRegister_t));
+}
+
+/******************************************************************************
+ *
+ *	Function:		Exception
+ *
+ *	Description:	Turns a request into an exception response:  the
+ *					function code with its top bit set, then the reason.
+ *
+ *	Parameters:		frame - the request
+ *					code - exception code
+ *
+ *	Return Value:	length of the response (before the CRC)
+ *
+ *****************************************************************************/
+
+uint8_t ModbusRtu::Exception(uint8_t *frame, uint8_t code)
+{
+	frame[1] |= 0x80;
+	frame[2] = code;
+	return 3;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Process
+ *
+ *	Description:	Carries out a request frame.  Frames for another slave,
+ *					or with a bad CRC, are ignored.  Broadcasts are carried
+ *					out, but not answered.
+ *
+ *	Parameters:		frame - the request, which is replaced by the response;
+ *						must hold MODBUS_FRAME_SIZE bytes
+ *					length - length of the request [bytes]
+ *
+ *	Return Value:	length of the response, or 0 if there isn't one
+ *
+ *****************************************************************************/
+
+uint8_t ModbusRtu::Process(uint8_t *frame, uint8_t length)
+{
+	modbusRegister_t reg;				// a register's table entry
+	uint16_t crc;
+	uint16_t start;						// first register
+	uint16_t count;						// number of registers
+	uint16_t value;
+	uint16_t i;
+	uint8_t n;							// response length
+
+	// Ignore frames that are too short, for someone else, or damaged.
+	if ((length < 4) ||
+		((frame[0] != slaveAddress) && (frame[0] != MODBUS_BROADCAST)))
+	{
+		return 0;
+	}
+	crc = ModbusCrc(frame, length - 2);
+	if ((frame[length - 2] != (uint8_t)crc) ||
+		(frame[length - 1] != (uint8_t)(crc >> 8)))
+	{
+		return 0;
+	}
+
+	start = ((uint16_t)frame[2] << 8) | frame[3];
+	count = ((uint16_t)frame[4] << 8) | frame[5];
+
+	switch (frame[1])
+	{
+	case MODBUS_READ_HOLDING:
+	case MODBUS_READ_INPUT:
+		if ((length != 8) || (count < 1) || (count > MODBUS_MAX_REGISTERS))
+		{
+			n = Exception(frame, MODBUS_ILLEGAL_VALUE);
+		}
+		else if (start + count > registerCount)
+		{
+			n = Exception(frame, MODBUS_ILLEGAL_ADDRESS);
+		}
+		else
+		{
+			frame[2] = (uint8_t)(2 * count);
+			n = 3;
+			for (i = 0; i < count; i++)
+			{
+				GetRegister(start + i, &reg);
+				value = reg.read();
+				frame[n++] = (uint8_t)(value >> 8);
+				frame[n++] = (uint8_t)value;
+			}
+		}
+		break;
+
+	case MODBUS_WRITE_SINGLE:
+		// The response echoes the request.
+		n = 6;
+		if (length != 8)
+		{
+			n = Exception(frame, MODBUS_ILLEGAL_VALUE);
+		}
+		else if (start >= registerCount)
+		{
+			n = Exception(frame, MODBUS_ILLEGAL_ADDRESS);
+		}
+		else
+		{
+			GetRegister(start, &reg);
+			if (reg.write == NULL)
+			{
+				n = Exception(frame, MODBUS_ILLEGAL_ADDRESS);
+			}
+			else if (!reg.write(count))
+			{
+				n = Exception(frame, MODBUS_ILLEGAL_VALUE);
+			}
+		}
+		break;
+
+	case MODBUS_WRITE_MULTIPLE:
+		// The response is the start & count.
+		n = 6;
+		if ((length < 9) || (count < 1) || (count > MODBUS_MAX_REGISTERS) ||
+			(frame[6] != 2 * count) || (length != 9 + 2 * count))
+		{
+			n = Exception(frame, MODBUS_ILLEGAL_VALUE);
+			break;
+		}
+		if (start + count > registerCount)
+		{
+			n = Exception(frame, MODBUS_ILLEGAL_ADDRESS);
+			break;
+		}
+		for (i = 0; i < count; i++)
+		{
+			GetRegister(start + i, &reg);
+			if (reg.write == NULL)
+			{
+				n = Exception(frame, MODBUS_ILLEGAL_ADDRESS);
+				break;
+			}
+		}
+		for (i = 0; (i < count) && (n == 6); i++)
+		{
+			GetRegister(start + i, &reg);
+			value = ((uint16_t)frame[7 + 2 * i] << 8) | frame[8 + 2 * i];
+			if (!reg.write(value))
+			{
+				n = Exception(frame, MODBUS_ILLEGAL_VALUE);
+			}
+		}
+		break;
+
+	default:
+		n = Exception(frame, MODBUS_ILLEGAL_FUNCTION);
+		break;
+	}
+
+	// Nobody answers a broadcast.
+	if (frame[0] == MODBUS_BROADCAST)
+	{
+		return 0;
+	}
+
+	crc = ModbusCrc(frame, n);
+	frame[n++] = (uint8_t)crc;
+	frame[n++] = (uint8_t)(crc >> 8);
+
+	return n;
+}
@@ -0,0 +1,89 @@
+#ifndef MODBUS_RTU_H
+#define MODBUS_RTU_H
+
+#include <stdint.h>
+
+// The register table lives in flash.  Off the AVR (in tools/modbus_hammer.cpp)
+// flash is just memory.
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+#include <string.h>
+#ifndef PROGMEM
+#define PROGMEM
+#define memcpy_P	memcpy
+#define pgm_read_word(p)	(*(const uint16_t *)(p))
+#endif
+#endif
+
+// Largest frame handled [bytes].  The biggest is a write of
+// MODBUS_MAX_REGISTERS registers:  address, function, start, count, byte
+// count, the values & the CRC.
+#define MODBUS_MAX_REGISTERS	16
+#define MODBUS_FRAME_SIZE		(9 + 2 * MODBUS_MAX_REGISTERS)
+
+// Function codes
+#define MODBUS_READ_HOLDING		0x03	// read holding registers
+#define MODBUS_READ_INPUT		0x04	// read input registers
+#define MODBUS_WRITE_SINGLE		0x06	// write a single register
+#define MODBUS_WRITE_MULTIPLE	0x10	// write multiple registers
+
+// Exception codes
+#define MODBUS_ILLEGAL_FUNCTION	0x01	// function code not supported
+#define MODBUS_ILLEGAL_ADDRESS	0x02	// register doesn't exist (or is
+										// read-only)
+#define MODBUS_ILLEGAL_VALUE	0x03	// value or count not allowed
+
+// Address every slave listens to.  Nobody answers it.
+#define MODBUS_BROADCAST		0
+
+// Fetch a register's value.
+typedef uint16_t (*modbusRead_t)(void);
+
+// Change a register's value.  Returns false if the value isn't allowed.
+typedef bool (*modbusWrite_t)(uint16_t value);
+
+typedef struct							// one register, kept in flash
+{
+	modbusRead_t read;					// fetches the value
+	modbusWrite_t write;				// changes it, or NULL if read-only
+} modbusRegister_t;
+
+// Calculate a Modbus CRC-16.
+uint16_t ModbusCrc(const uint8_t *data, uint8_t length);
+
+// Add a byte to a Modbus CRC-16 (start from 0xFFFF).
+uint16_t ModbusCrcUpdate(uint16_t crc, uint8_t data);
+
+class ModbusRtu
+{
+public:
+	// Initialize the class.
+	ModbusRtu();
+
+	// Set the address this slave answers to (1 to 247).
+	bool SetAddress(uint8_t address);
+
+	// Fetch the address this slave answers to.
+	uint8_t GetAddress();
+
+	// Set the register table (in flash).  Register N is entry N.
+	void SetRegisters(const modbusRegister_t *table, uint8_t count);
+
+	// Carry out a request, and replace it with the response.  Returns the
+	// response's length, or 0 if there's nothing to send back.
+	uint8_t Process(uint8_t *frame, uint8_t length);
+
+private:
+	uint8_t slaveAddress;				// address we answer to
+	const modbusRegister_t *registers;	// register table (in flash)
+	uint8_t registerCount;				// number of registers
+
+	// Fetch a register's table entry.
+	void GetRegister(uint16_t address, modbusRegister_t *reg);
+
+	// Turn a frame into an exception response.
+	uint8_t Exception(uint8_t *frame, uint8_t code);
+};
+
+#endif
@@ -0,0 +1,187 @@
+/******************************************************************************
+ *
+ *	Filename:		ModbusSlave.cpp
+ *
+ *	Description:	Puts a Modbus RTU slave on the serial port.  In RTU mode,
+ *					a frame ends when the line has been quiet for 3.5
+ *					characters.  Polling Serial.available() from the main loop
+ *					can't time that reliably, so it's done with interrupts:
+ *
+ *					-	A pin change interrupt on the RX pin fires on every
+ *						edge of every incoming byte, and restarts Timer1.
+ *					-	If Timer1 reaches the 3.5 character gap without being
+ *						restarted, the frame is complete.
+ *
+ *					The bytes themselves are received into the Arduino core's
+ *					serial buffer as usual.  Poll then carries out the
+ *					request (see ModbusRtu.cpp) and sends the response.  The
+ *					Timer1 interrupt also wakes the CPU from idle sleep, so a
+ *					response starts on the next pass through the main loop.
+ *
+ *					The gap is timed from the last edge in the last byte,
+ *					which can be up to 9 bits before the byte ends, so a gap
+ *					as short as 2.6 characters may end a frame.  That's still
+ *					well over the 1.5 characters allowed inside a frame.
+ *
+ *					Timer1 isn't otherwise used (Timer0 runs millis() and
+ *					Timer2 runs the buzzer).
+ *
+ *****************************************************************************/
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "ModbusSlave.h"
+#include "Trace.h"
+
+// Timer1 counts at the CPU clock / 64.
+#define TIMER1_PRESCALE		64
+
+// Bits per character in RTU mode (start, 8 data, parity or 2nd stop, stop).
+#define RTU_CHAR_BITS		11
+
+static volatile bool frameReady = false;	// line has gone quiet
+
+/******************************************************************************
+ *
+ *	Function:		PCINT2_vect (Interrupt Service Routine)
+ *
+ *	Description:	The RX pin changed, so a byte is arriving.  Start timing
+ *					the gap again.
+ *
+ *****************************************************************************/
+
+ISR(PCINT2_vect)
+{
+	TCNT1 = 0;
+	TIFR1 = (1 << OCF1A);
+	TIMSK1 |= (1 << OCIE1A);
+}
+
+/******************************************************************************
+ *
+ *	Function:		TIMER1_COMPA_vect (Interrupt Service Routine)
+ *
+ *	Description:	The line has been quiet for the whole gap, so the frame
+ *					is over.
+ *
+ *****************************************************************************/
+
+ISR(TIMER1_COMPA_vect)
+{
+	TIMSK1 &= ~(1 << OCIE1A);
+	frameReady = true;
+}
+
+/******************************************************************************
+ *
+ *	Function:		ModbusSlave (Class Initializer)
+ *
+ *****************************************************************************/
+
+ModbusSlave::ModbusSlave()
+{
+}
+
+/******************************************************************************
+ *
+ *	Function:		Begin
+ *
+ *	Description:	Starts timing frames on the serial port.  The port must
+ *					already be running (Serial.begin) at the given baud rate.
+ *
+ *	Parameters:		baud - the serial port's baud rate
+ *
+ *****************************************************************************/
+
+void ModbusSlave::Begin(unsigned long baud)
+{
+	unsigned long gap;					// quiet time that ends a frame [uSec]
+
+	if (baud > MODBUS_FIXED_GAP_BAUD)
+	{
+		gap = MODBUS_FIXED_GAP;
+	}
+	else
+	{
+		gap = 3500000UL * RTU_CHAR_BITS / baud;
+	}
+
+	// Timer1 in CTC mode, interrupt off until a byte arrives.
+	TIMSK1 = 0;
+	TCCR1A = 0;
+	TCCR1B = (1 << WGM12) | (1 << CS11) | (1 << CS10);
+	OCR1A = gap * clockCyclesPerMicrosecond() / TIMER1_PRESCALE;
+
+	// Throw away anything that arrived before now.
+	while (Serial.available() > 0)
+	{
+		Serial.read();
+	}
+	frameReady = false;
+
+	// Watch the RX pin (PD0).
+	PCMSK2 |= (1 << PCINT16);
+	PCICR |= (1 << PCIE2);
+}
+
+void ModbusSlave::End()
+{
+	PCMSK2 &= ~(1 << PCINT16);
+	if (PCMSK2 == 0)
+	{
+		PCICR &= ~(1 << PCIE2);
+	}
+	TIMSK1 = 0;
+	TCCR1B = 0;
+	frameReady = false;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Poll
+ *
+ *	Description:	If a whole frame has arrived, carries it out and sends
+ *					the response.  Frames too long for the buffer are
+ *					dropped, as the master would see for a damaged frame.
+ *
+ *****************************************************************************/
+
+void ModbusSlave::Poll()
+{
+	uint8_t length = 0;					// bytes in the frame
+	bool overflow = false;				// frame didn't fit
+
+	if (!frameReady)
+	{
+		return;
+	}
+	frameReady = false;
+
+	while (Serial.available() > 0)
+	{
+		if (length < sizeof(frame))
+		{
+			frame[length++] = Serial.read();
+		}
+		else
+		{
+			Serial.read();
+			overflow = true;
+		}
+	}
+
+	if (overflow)
+	{
+		return;
+	}
+
+	TRACE_BEGIN(TRACE_MODBUS, frame[1]);
+	length = Process(frame, length);
+	if (length > 0)
+	{
+		Serial.write(frame, length);
+	}
+	TRACE_END(TRACE_MODBUS, length);
+}
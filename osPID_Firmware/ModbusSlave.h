@@ -0,0 +1,32 @@
+#ifndef MODBUS_SLAVE_H
+#define MODBUS_SLAVE_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "ModbusRtu.h"
+
+// Above this baud rate, the gap that ends a frame is fixed (Modbus over
+// serial line, section 2.5.1.1).
+#define MODBUS_FIXED_GAP_BAUD	19200
+#define MODBUS_FIXED_GAP		1750	// [microseconds]
+
+class ModbusSlave : public ModbusRtu
+{
+public:
+	// Initialize the class.
+	ModbusSlave();
+
+	// Start answering requests on the serial port.
+	void Begin(unsigned long baud);
+
+	// Stop answering requests, and give the serial port back.
+	void End();
+
+	// Answer a request if one has arrived.  Call this from the main loop.
+	void Poll();
+
+private:
+	uint8_t frame[MODBUS_FRAME_SIZE];	// request, then response
+};
+
+#endif
@@ -0,0 +1,227 @@
+/******************************************************************************
+ *
+ *	Filename:		NumberFormat.cpp
+ *
+ *	Description:	Turns numbers into text for the LCD and the serial port,
+ *					with a fixed number of decimals, right-aligned in a
+ *					field, into a buffer the caller provides.
+ *
+ *					Print's own print(double) converts a digit at a time
+ *					with floating-point multiplies and divides, each costing
+ *					hundreds of cycles on the AVR, and it pulls that code
+ *					into flash.  Here the number is scaled to an integer
+ *					once, and its digits are found by subtracting powers of
+ *					ten (from a table in flash):  at most 9 32-bit subtracts
+ *					per digit, no division at all.  Fixed-point numbers
+ *					don't need even the one floating-point multiply.
+ *
+ *					tools/format_bench.cpp checks the output against printf
+ *					and times it on a PC.
+ *
+ *****************************************************************************/
+
+#include <stdint.h>
+#include <math.h>
+#include "NumberFormat.h"
+
+// The table of powers and "Error" live in flash.  Off the AVR (in
+// tools/format_bench.cpp) flash is just memory.
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#ifndef pgm_read_byte
+#define pgm_read_byte(p)	(*(const uint8_t *)(p))
+#endif
+#ifndef pgm_read_dword
+#define pgm_read_dword(p)	(*(const uint32_t *)(p))
+#endif
+#endif
+
+#define DIGITS		10					// digits in the largest int32_t
+
+static const uint32_t powers[DIGITS] PROGMEM =
+{
+	1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+	10000UL, 1000UL, 100UL, 10UL, 1UL,
+};
+
+static const char errorText[] PROGMEM = "Error";
+
+/******************************************************************************
+ *
+ *	Function:		FormatScaled
+ *
+ *	Description:	Formats an integer that's been scaled by 10^decimals.
+ *					Leading zeros are dropped, except the one before the
+ *					decimal point.  If the number (or "Error") is narrower
+ *					than width, it's padded on the left with spaces.
+ *
+ *	Parameters:		buffer - where to put the text (FORMAT_SIZE characters)
+ *					value - the number, times 10^decimals, or FORMAT_ERROR
+ *					decimals - digits after the decimal point (0 to 9)
+ *					width - field width (0 for no padding; less than
+ *						FORMAT_SIZE)
+ *
+ *	Return Value:	buffer
+ *
+ *****************************************************************************/
+
+char *FormatScaled(char *buffer, int32_t value, uint8_t decimals,
+	uint8_t width)
+{
+	char text[FORMAT_SIZE];				// the number, left-aligned
+	char *p = text;
+	uint32_t magnitude;					// what's left to convert
+	uint32_t power;						// place value of this digit
+	char digit;
+	char letter;						// of "Error"
+	bool started = false;				// true once a digit is kept
+	uint8_t i;
+	uint8_t length;
+
+	if (decimals >= DIGITS)
+	{
+		decimals = DIGITS - 1;
+	}
+
+	if (value == FORMAT_ERROR)
+	{
+		for (i = 0; (letter = pgm_read_byte(&errorText[i])) != '\0'; i++)
+		{
+			*p++ = letter;
+		}
+	}
+	else
+	{
+		if (value < 0)
+		{
+			*p++ = '-';
+			magnitude = (uint32_t)0 - (uint32_t)value;
+		}
+		else
+		{
+			magnitude = (uint32_t)value;
+		}
+
+		// Most significant digit first.  Skip leading zeros until the
+		// units digit.
+		for (i = 0; i < DIGITS; i++)
+		{
+			power = pgm_read_dword(&powers[i]);
+			digit = '0';
+			while (magnitude >= power)
+			{
+				magnitude -= power;
+				digit++;
+			}
+
+			if ((digit != '0') || started || (i >= DIGITS - 1 - decimals))
+			{
+				if ((i == DIGITS - decimals) && (decimals > 0))
+				{
+					*p++ = '.';
+				}
+				*p++ = digit;
+				started = true;
+			}
+		}
+	}
+
+	// Right-align the text in the buffer.
+	length = p - text;
+	p = buffer;
+	if (width >= FORMAT_SIZE)
+	{
+		width = FORMAT_SIZE - 1;
+	}
+	for (i = length; i < width; i++)
+	{
+		*p++ = ' ';
+	}
+	for (i = 0; i < length; i++)
+	{
+		*p++ = text[i];
+	}
+	*p = '\0';
+
+	return buffer;
+}
+
+/******************************************************************************
+ *
+ *	Function:		FormatFixed
+ *
+ *	Description:	Formats a 16.16 fixed-point number, rounded to the
+ *					nearest last digit (halves away from zero, as
+ *					FormatDouble does).  The whole & fractional parts are
+ *					scaled separately, so everything fits in 32 bits.
+ *
+ *	Parameters:		buffer - where to put the text (FORMAT_SIZE characters)
+ *					value - the number
+ *					decimals - digits after the decimal point (0 to
+ *						FORMAT_FIXED_DECIMALS)
+ *					width - field width (0 for no padding)
+ *
+ *	Return Value:	buffer
+ *
+ *****************************************************************************/
+
+char *FormatFixed(char *buffer, fixed_t value, uint8_t decimals,
+	uint8_t width)
+{
+	uint32_t scale;						// 10^decimals
+	uint32_t magnitude;					// value without its sign
+	int32_t scaled;						// magnitude * scale, rounded
+
+	if (decimals > FORMAT_FIXED_DECIMALS)
+	{
+		decimals = FORMAT_FIXED_DECIMALS;
+	}
+
+	scale = pgm_read_dword(&powers[DIGITS - 1 - decimals]);
+
+	magnitude = (value < 0) ? (uint32_t)0 - (uint32_t)value : (uint32_t)value;
+	scaled = (int32_t)((magnitude >> FIXED_SHIFT) * scale +
+		(((magnitude & (FIXED_ONE - 1)) * scale + FIXED_ONE / 2) >>
+		FIXED_SHIFT));
+
+	return FormatScaled(buffer, (value < 0) ? -scaled : scaled, decimals,
+		width);
+}
+
+/******************************************************************************
+ *
+ *	Function:		FormatDouble
+ *
+ *	Description:	Formats a double, rounded to the nearest last digit.  It
+ *					costs one floating-point multiply to scale it.
+ *
+ *	Parameters:		buffer - where to put the text (FORMAT_SIZE characters)
+ *					value - the number
+ *					decimals - digits after the decimal point (0 to 9)
+ *					width - field width (0 for no padding)
+ *
+ *	Return Value:	buffer
+ *
+ *****************************************************************************/
+
+char *FormatDouble(char *buffer, double value, uint8_t decimals,
+	uint8_t width)
+{
+	if (decimals >= DIGITS)
+	{
+		decimals = DIGITS - 1;
+	}
+
+	value *= (double)pgm_read_dword(&powers[DIGITS - 1 - decimals]);
+	if (isnan(value) || (value >= 2147483647.0) || (value <= -2147483647.0))
+	{
+		return FormatScaled(buffer, FORMAT_ERROR, decimals, width);
+	}
+
+	return FormatScaled(buffer,
+		(int32_t)(value + ((value < 0) ? -0.5 : 0.5)), decimals, width);
+}
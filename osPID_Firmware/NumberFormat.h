@@ -0,0 +1,32 @@
+#ifndef NUMBER_FORMAT_H
+#define NUMBER_FORMAT_H
+
+#include <stdint.h>
+#include "FixedPoint.h"
+
+// Buffer size that holds any formatted number:  sign, 10 digits, decimal
+// point & terminating NULL, with a little to spare.  Widths must be less
+// than this.
+#define FORMAT_SIZE		16
+
+// A scaled value that means "no value".  It's shown as "Error".
+#define FORMAT_ERROR	INT32_MIN
+
+// Most decimals FormatFixed can show.
+#define FORMAT_FIXED_DECIMALS	4
+
+// Format an integer that's been scaled by 10^decimals (123 with 1 decimal is
+// "12.3"), right-aligned in width characters (0 for no padding).  Returns
+// buffer.
+char *FormatScaled(char *buffer, int32_t value, uint8_t decimals,
+	uint8_t width);
+
+// Format a 16.16 fixed-point number.
+char *FormatFixed(char *buffer, fixed_t value, uint8_t decimals,
+	uint8_t width);
+
+// Format a double.  NaN, and numbers too big to show, come out as "Error".
+char *FormatDouble(char *buffer, double value, uint8_t decimals,
+	uint8_t width);
+
+#endif
@@ -17,17 +17,31 @@
  *						Output card with 1 SSR & 2 relay output. Similar to
  *						V1.20 except LED mount orientation.
  *
+ *					Every relay operation is counted, so the firmware can
+ *					keep track of how much life the relays have left.  With
+ *					the optimizer on (see RelayOptimizer.cpp), each window
+ *					is planned to switch the relay as seldom as it can.
+ *
+ *					For split-range output, the other relay drives a cooler,
+ *					time-proportioned over the same window.  Either side's
+ *					relay can be given a minimum off time, so a compressor
+ *					isn't restarted before its pressures have equalized.
+ *					For zone control, the other relay runs a second zone's
+ *					heater the same way, and each side can have a window of
+ *					its own.
+ *
  *****************************************************************************/
 
 #include <Arduino.h>
 #include <stdint.h>
 #include "OutputCard.h"
+#include "Trace.h"
 
 byte pinRelay1;				// pin attached to relay 1
 byte pinRelay2;				// pin attached to relay 2
 byte outputRelay;			// relay used for output functions
 
-const char outputVersion[5] = "OID1";
+const char outputVersion[5] PROGMEM = "OID1";
 
 #if defined(DIGITAL_OUTPUT_V120) || defined(DIGITAL_OUTPUT_V150)
 
@@ -42,6 +56,33 @@ OutputCard::OutputCard(byte relay1Pin, byte relay2pin)
 {
 	outputRelay = 0;					// Default to use relay 2.
 	windowSize = 10000;					// Set window size for 10 seconds.
+	shutdown = false;					// Relays are allowed to turn on.
+	windowStart = 0;					// Start with the relay off.
+	windowLength = windowSize;
+	onTime = 0;
+	onFirst = true;
+	dutyValue = 0;
+	relayOn = false;
+	nextEdge = 0;
+	optimize = false;					// Switch the plain way.
+	error = 0;
+	relayState[0] = false;
+	relayState[1] = false;
+	switchCount[0] = 0;
+	switchCount[1] = 0;
+	split = false;						// Only the output relay is driven.
+	coolStart = 0;
+	coolLength = windowSize;
+	coolOnTime = 0;
+	coolValue = 0;
+	coolOn = false;
+	coolEdge = 0;
+	minOffTime[0] = 0;					// No short-cycle protection.
+	minOffTime[1] = 0;
+	offSince[0] = 0;					// Any protection starts at reset, in
+	offSince[1] = 0;					// case a relay was on just before.
+	sideWindow[0] = 0;					// Both sides use the output window.
+	sideWindow[1] = 0;
 	
 	pinRelay1 = relay1Pin;				// Remember the relay pins.
 	pinRelay2 = relay2pin;
@@ -64,17 +105,13 @@ outputResult_t OutputCard::SetRelayState(bool relay, bool state)
 {
 	outputResult_t result = OUTPUT_RESULT_OK;
 	
-	if (relay == 0)
+	if (shutdown)
 	{
-		digitalWrite(pinRelay1, state);
-	}
-	else if (relay == 1)
-	{
-		digitalWrite(pinRelay2, state);
+		result = OUTPUT_RESULT_FAIL;
 	}
 	else
 	{
-		result = OUTPUT_RESULT_INVALID;
+		WriteRelay(relay, state);
 	}
 
 	return result;
@@ -82,15 +119,15 @@ outputResult_t OutputCard::SetRelayState(bool relay, bool state)
 
 /******************************************************************************
  *
- *	Function:		SetRelayState
+ *	Function:		GetRelayState
  *
- *	Description:	Turn a relay on or off.
+ *	Description:	Find whether a relay is on or off.
  *
- *	Parameters:		relay - which relay to change
- *					state - desired state of relay (true = on; false = off)
+ *	Parameters:		relay - which relay to check
+ *					state - state of relay (true = on; false = off)
  *
  *****************************************************************************/
-outputResult_t  GetRelayState(bool relay, bool *state)
+outputResult_t OutputCard::GetRelayState(bool relay, bool *state)
 {
 	outputResult_t result = OUTPUT_RESULT_OK;
 	
@@ -133,6 +170,16 @@ void OutputCard::SetOutputWindow(double seconds)
 	if (mSec != windowSize)				// Store the new value (if necessary).
 	{
 		windowSize = mSec;
+		if (!optimize)					// (The optimizer plans the next
+		{								// window with the new size.)
+			PlainWindow(false);
+			Schedule(millis());
+		}
+		PlainWindow(true);
+		if (split)
+		{
+			ScheduleCool(millis());
+		}
 	}
 }
 
@@ -145,40 +192,582 @@ unsigned long OutputCard::GetOutputWindow()
  *
  *	Function:		SetOutputRelay
  *
- *	Description:	Set which relay is used by the output functions.
+ *	Description:	Set which relay is used by the output functions.  In
+ *					split range, the cool side moves to the other one.
  *
  *	Parameters:		relay - which relay is used
  *
  *****************************************************************************/
-void SetOutputRelay(bool relay)
+void OutputCard::SetOutputRelay(bool relay)
 {
 	outputRelay = relay;
+	if (!shutdown)
+	{
+		WriteRelay(relay, relayOn);
+		if (split)
+		{
+			WriteRelay(!relay, coolOn);
+		}
+	}
 }
 
+/******************************************************************************
+ *
+ *	Function:		SetOutput
+ *
+ *	Description:	Sets how much of each output window the relay is on.
+ *					This only works out when the relay should next switch;
+ *					Service does the switching.  Calling it again with the
+ *					same value costs next to nothing.  With the optimizer
+ *					on, the new value is used from the next window.
+ *
+ *	Parameters:		value - output [%]
+ *
+ *****************************************************************************/
 void OutputCard::SetOutput(double value)
 {
-	unsigned long wind;	// time relay is on + time relay is off [milliseconds]
-	unsigned long oVal;	// time relay is on [milliseconds]
+	if (value == dutyValue)
+	{
+		return;
+	}
+
+	dutyValue = value;
+	if (!optimize)
+	{
+		PlainWindow(false);
+		Schedule(millis());
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		Service
+ *
+ *	Description:	Switches the output relay (and the cool side's, in split
+ *					range) if its next edge is due.  Call this as often as
+ *					you like (at least once a millisecond for the best
+ *					timing); between edges it does nothing but compare
+ *					times.  Since edges are placed relative to the window,
+ *					not to when this is called, a late call delays one edge
+ *					but doesn't shift the ones after it.
+ *
+ *****************************************************************************/
+void OutputCard::Service()
+{
+	unsigned long now = millis();
+
+	if ((long)(now - nextEdge) >= 0)
+	{
+		Schedule(now);
+	}
+	if (split && ((long)(now - coolEdge) >= 0))
+	{
+		ScheduleCool(now);
+	}
+}
+
+unsigned long OutputCard::GetNextEdge()
+{
+	if (split && ((int32_t)(coolEdge - nextEdge) < 0))
+	{
+		return coolEdge;
+	}
+	return nextEdge;
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetOptimize
+ *
+ *	Description:	Turns the switching optimizer on or off.  Turning it on
+ *					takes effect at the next window; turning it off, right
+ *					away.
+ *
+ *	Parameters:		optimize - true to plan windows with the optimizer
+ *
+ *****************************************************************************/
+void OutputCard::SetOptimize(bool optimize)
+{
+	if (optimize == this->optimize)
+	{
+		return;
+	}
+
+	this->optimize = optimize;
+	optimizer.Reset();
+	if (!optimize)
+	{
+		PlainWindow(false);
+		onFirst = true;
+		Schedule(millis());
+	}
+}
+
+bool OutputCard::GetOptimize()
+{
+	return optimize;
+}
+
+// The optimizer stretches the window while the error is small.
+void OutputCard::SetError(double error)
+{
+	this->error = error;
+}
+
+unsigned long OutputCard::GetSwitchCount(bool relay)
+{
+	return switchCount[relay];
+}
+
+void OutputCard::SetSwitchCount(bool relay, unsigned long count)
+{
+	switchCount[relay] = count;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Schedule
+ *
+ *	Description:	Puts the relay in the state it should have right now, and
+ *					works out when it should next change.  The relay is on
+ *					for onTime of each window:  at its start, or (if the
+ *					optimizer says so) at its end.  If it's on (or off) for
+ *					the whole window, the next "edge" is the start of the
+ *					next window, where it's checked again.  The relay is
+ *					only written if its state actually changes.
+ *
+ *	Parameters:		now - the time [milliseconds]
+ *
+ *****************************************************************************/
+void OutputCard::Schedule(unsigned long now)
+{
+	unsigned long elapsed;				// time into the window [mSec]
+	unsigned long offTime;				// time off before the on-time
+	bool on;							// relay should be on
+
+	// Catch up to the window we're in, skipping any that were missed.
+	elapsed = now - windowStart;
+	if (elapsed >= windowLength)
+	{
+		windowStart += elapsed - (elapsed % windowLength);
+		StartWindow();
+		elapsed = now - windowStart;
+		if (elapsed >= windowLength)
+		{
+			// The new window is shorter than the time already past.
+			windowStart = now;
+			elapsed = 0;
+		}
+	}
+
+	if (onFirst)
+	{
+		on = (elapsed < onTime);
+		if (on && (onTime < windowLength))
+		{
+			nextEdge = windowStart + onTime;
+		}
+		else
+		{
+			nextEdge = windowStart + windowLength;
+		}
+	}
+	else
+	{
+		offTime = windowLength - onTime;
+		on = (elapsed >= offTime);
+		if (!on && (onTime > 0))
+		{
+			nextEdge = windowStart + offTime;
+		}
+		else
+		{
+			nextEdge = windowStart + windowLength;
+		}
+	}
+
+	if (shutdown || (on == relayOn) || (on && Hold(false, now, &nextEdge)))
+	{
+		return;
+	}
+
+	relayOn = on;
+	if (!on)
+	{
+		offSince[0] = now;
+	}
+	WriteRelay(outputRelay, on);
+}
+
+/******************************************************************************
+ *
+ *	Function:		ScheduleCool
+ *
+ *	Description:	Does for the cool side's relay what Schedule does for
+ *					the output relay, the plain way:  every window is
+ *					coolLength long, with coolOnTime at its start.  (Split
+ *					range never has both sides on, so the two relays are
+ *					never on together.)
+ *
+ *	Parameters:		now - the time [milliseconds]
+ *
+ *****************************************************************************/
+void OutputCard::ScheduleCool(unsigned long now)
+{
+	unsigned long elapsed;				// time into the window [mSec]
+	bool on;							// relay should be on
+
+	elapsed = now - coolStart;
+	if (elapsed >= coolLength)
+	{
+		coolStart += elapsed - (elapsed % coolLength);
+		elapsed = now - coolStart;
+	}
+
+	on = (elapsed < coolOnTime);
+	if (on && (coolOnTime < coolLength))
+	{
+		coolEdge = coolStart + coolOnTime;
+	}
+	else
+	{
+		coolEdge = coolStart + coolLength;
+	}
+
+	if (shutdown || (on == coolOn) || (on && Hold(true, now, &coolEdge)))
+	{
+		return;
+	}
+
+	coolOn = on;
+	if (!on)
+	{
+		offSince[1] = now;
+	}
+	WriteRelay(!outputRelay, on);
+}
+
+/******************************************************************************
+ *
+ *	Function:		PlainWindow
+ *
+ *	Description:	Works out a side's window & on-time when it's switched
+ *					the plain way.  The window is the side's own (see
+ *					SetSideWindow) or windowSize long, unless
+ *					its off-time would then be shorter than the side's
+ *					minimum off time; then it's stretched until the
+ *					off-time is the minimum, and the on-time with it, so
+ *					the output is the same.  (At 30% with a 3 minute
+ *					minimum, the relay is on for 77 seconds out of 257.)
+ *					Past OUTPUT_MAX_STRETCH, the side is simply on for the
+ *					whole (stretched) window.
+ *
+ *	Parameters:		cool - false for the heat side, true for the cool side
+ *
+ *****************************************************************************/
+void OutputCard::PlainWindow(bool cool)
+{
+	double duty = cool ? coolValue : dutyValue;	// side's output [%]
+	double length = Window(cool);		// its window [mSec]
+	uint32_t on;						// its on-time [mSec]
+
+	if ((duty < 100) &&
+		((100 - duty) * length / 100 < minOffTime[cool]))
+	{
+		length = minOffTime[cool] * 100.0 / (100 - duty);
+	}
+
+	if (length > OUTPUT_MAX_STRETCH)
+	{
+		length = OUTPUT_MAX_STRETCH;
+		on = OUTPUT_MAX_STRETCH;
+	}
+	else
+	{
+		on = (uint32_t)(duty * length / 100);
+	}
+
+	if (cool)
+	{
+		coolLength = (uint32_t)length;
+		coolOnTime = on;
+	}
+	else
+	{
+		windowLength = (uint32_t)length;
+		onTime = on;
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		Hold
+ *
+ *	Description:	Finds whether a side's relay, which is off and due to
+ *					turn on, has to stay off a while longer for its minimum
+ *					off time.  Stretched windows make this rare; it's for
+ *					an output that rises during the off-time, and for the
+ *					optimizer's windows.  If so, its next edge is brought forward (if
+ *					need be) to when that time is up, so it's checked again
+ *					then; the on-time it misses isn't made up, but the PID
+ *					takes care of that.
+ *
+ *	Parameters:		cool - false for the heat side, true for the cool side
+ *					now - the time [milliseconds]
+ *					edge - the side's next edge [milliseconds]
+ *
+ *	Return Value:	true if the relay must stay off
+ *
+ *****************************************************************************/
+bool OutputCard::Hold(bool cool, unsigned long now, uint32_t *edge)
+{
+	uint32_t ready = offSince[cool] + minOffTime[cool];	// when it may turn on
+
+	if (now - offSince[cool] >= minOffTime[cool])
+	{
+		return false;
+	}
+
+	if ((int32_t)(ready - *edge) < 0)
+	{
+		*edge = ready;
+	}
+	return true;
+}
+
+/******************************************************************************
+ *
+ *	Function:		StartWindow
+ *
+ *	Description:	Sets up a new output window.  Without the optimizer,
+ *					every window is the same:  windowSize long (or longer,
+ *					for the minimum off time), with onTime (set by
+ *					SetOutput) at its start.
+ *
+ *****************************************************************************/
+void OutputCard::StartWindow()
+{
+	relayPlan_t plan;					// the optimizer's plan
+
+	if (!optimize)
+	{
+		onFirst = true;
+		return;
+	}
+
+	optimizer.Plan(Window(false), dutyValue, error, &plan);
+	windowLength = plan.window;
+	onTime = plan.onTime;
+	onFirst = plan.onFirst;
+}
+
+/******************************************************************************
+ *
+ *	Function:		WriteRelay
+ *
+ *	Description:	Switches a relay, and counts the operation.  Nothing
+ *					happens if the relay is already in that state.
+ *
+ *	Parameters:		relay - which relay to change
+ *					state - desired state of relay (true = on; false = off)
+ *
+ *****************************************************************************/
+void OutputCard::WriteRelay(bool relay, bool state)
+{
+	if (relayState[relay] == state)
+	{
+		return;
+	}
+
+	relayState[relay] = state;
+	switchCount[relay]++;
+	digitalWrite(relay ? pinRelay2 : pinRelay1, state ? HIGH : LOW);
+	TRACE_INSTANT(TRACE_RELAY, relay * 2 + state);
+}
+
+/******************************************************************************
+ *
+ *	Function:		Shutdown
+ *
+ *	Description:	Turns off both relays and keeps them off, no matter what
+ *					the output functions are asked to do, until Restart is
+ *					called.  Used by the safety supervisor.
+ *
+ *****************************************************************************/
+void OutputCard::Shutdown()
+{
+	unsigned long now = millis();
+
+	shutdown = true;
+	if (relayOn)
+	{
+		relayOn = false;
+		offSince[0] = now;
+	}
+	if (coolOn)
+	{
+		coolOn = false;
+		offSince[1] = now;
+	}
+	WriteRelay(0, false);
+	WriteRelay(1, false);
+}
+
+void OutputCard::Restart()
+{
+	shutdown = false;
+	Schedule(millis());
+	if (split)
+	{
+		ScheduleCool(millis());
+	}
+}
+
+bool OutputCard::IsShutdown()
+{
+	return shutdown;
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetSplit
+ *
+ *	Description:	Turns split-range output on or off.  While it's on, the
+ *					relay not used for output is the cool side's, and
+ *					SetCoolOutput sets how much of each window it's on.
+ *					Turning it off turns that relay off.
+ *
+ *	Parameters:		split - true to drive the cool side
+ *
+ *****************************************************************************/
+void OutputCard::SetSplit(bool split)
+{
+	if (split == this->split)
+	{
+		return;
+	}
+
+	this->split = split;
+	if (split)
+	{
+		coolStart = millis();
+		ScheduleCool(coolStart);
+	}
+	else if (coolOn)
+	{
+		coolOn = false;
+		offSince[1] = millis();
+		WriteRelay(!outputRelay, false);
+	}
+}
+
+bool OutputCard::GetSplit()
+{
+	return split;
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetCoolOutput
+ *
+ *	Description:	Sets how much of each output window the cool side's
+ *					relay is on.  Like SetOutput, it only works out when the
+ *					relay should next switch, and costs next to nothing when
+ *					the value hasn't changed.
+ *
+ *	Parameters:		value - cool side's output [%]
+ *
+ *****************************************************************************/
+void OutputCard::SetCoolOutput(double value)
+{
+	if (value == coolValue)
+	{
+		return;
+	}
 
-	wind  = millis() % windowSize;
-/*
-	wind = (millis() - windowStartTime);
-	if (wind > windowSize)
-	{ 
-		wind -= windowSize;
-		windowStartTime += windowSize;
+	coolValue = value;
+	PlainWindow(true);
+	if (split)
+	{
+		ScheduleCool(millis());
 	}
-*/
-	oVal = (unsigned long)(value * (double)windowSize / 100.0);
+}
 
-	if (outputRelay == 0)		//activate selected relay
+/******************************************************************************
+ *
+ *	Function:		SetMinOffTime
+ *
+ *	Description:	Sets the least time a side's relay stays off once it
+ *					turns off, whatever its output asks for.  A compressor
+ *					usually needs a few minutes.  Without the optimizer,
+ *					the side's windows are stretched so their off-time is
+ *					never shorter, and its output is still met on average.
+ *
+ *	Parameters:		cool - false for the heat (output) side, true for the
+ *						cool side
+ *					mSec - minimum off time [milliseconds], or 0 for none
+ *
+ *****************************************************************************/
+void OutputCard::SetMinOffTime(bool cool, unsigned long mSec)
+{
+	minOffTime[cool] = mSec;
+	if (cool || !optimize)
 	{
-		digitalWrite(pinRelay1 ,(oVal > wind) ? HIGH : LOW);
+		PlainWindow(cool);
 	}
-	else if (outputRelay == 1)
+}
+
+unsigned long OutputCard::GetMinOffTime(bool cool)
+{
+	return minOffTime[cool];
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetSideWindow
+ *
+ *	Description:	Gives a side's relay an output window of its own, so two
+ *					zones can each be time-proportioned to suit their
+ *					heaters.  Like SetOutputWindow, it takes effect right
+ *					away.
+ *
+ *	Parameters:		cool - false for the output relay's side, true for the
+ *						other relay's
+ *					mSec - the side's window [milliseconds] (at least 500),
+ *						or 0 to go back to the output window
+ *
+ *****************************************************************************/
+void OutputCard::SetSideWindow(bool cool, unsigned long mSec)
+{
+	if ((mSec != 0) && (mSec < 500))
+	{
+		mSec = 500;
+	}
+	if (mSec == sideWindow[cool])
 	{
-		digitalWrite(pinRelay2 ,(oVal > wind) ? HIGH : LOW);
+		return;
 	}
+
+	sideWindow[cool] = mSec;
+	if (cool)
+	{
+		PlainWindow(true);
+		if (split)
+		{
+			ScheduleCool(millis());
+		}
+	}
+	else if (!optimize)
+	{
+		PlainWindow(false);
+		Schedule(millis());
+	}
+}
+
+// A side's window, before any stretching.
+uint32_t OutputCard::Window(bool cool)
+{
+	return (sideWindow[cool] != 0) ? sideWindow[cool] : windowSize;
 }
 
 #endif /* DIGITAL_OUTPUT_V120 & DIGITAL_OUTPUT_V150 */
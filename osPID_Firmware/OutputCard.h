@@ -2,11 +2,21 @@
 #define OUTPUT_CARD_H
 
 #include <Arduino.h>
+#include "RelayOptimizer.h"
 
 // UNCOMMENT THE APPROPRIATE DEFINE STATEMENT FOR THE CARD BEING USED.
 //#define DIGITAL_OUTPUT_V120
 #define DIGITAL_OUTPUT_V150
 
+// Number of switching operations (on or off) a relay is rated for.  Check the
+// relay's data sheet; at full load, mechanical relays are often rated for
+// about 100,000.
+#define RELAY_RATED_OPS		100000UL
+
+// Longest a window is stretched for a minimum off time [mSec] (about 12 days,
+// so edge times can still be compared).
+#define OUTPUT_MAX_STRETCH	0x40000000UL
+
 typedef enum							// status from functions
 {
 	OUTPUT_RESULT_OK,					// All is well!
@@ -32,10 +42,76 @@ public:
 	unsigned long GetOutputWindow();		// Get the output period.
 	void SetOutputRelay(bool relay);		// Set which relay is used.
 	void SetOutput(double value);			// Set % of output period relay is on.
+	void Service();							// Switch the relay if it's time.
+	unsigned long GetNextEdge();			// Get when the relay next switches.
+
+	// Switching optimizer
+	void SetOptimize(bool optimize);		// Turn the optimizer on or off.
+	bool GetOptimize();						// Find if it's on.
+	void SetError(double error);			// Tell it the control error [C].
+
+	// Relay wear
+	unsigned long GetSwitchCount(bool relay);	// Get a relay's operations.
+	void SetSwitchCount(bool relay, unsigned long count);	// Restore them.
+	
+	// Safety shutdown
+	void Shutdown();						// Turn off both relays & keep them off.
+	void Restart();							// Allow the relays to turn on again.
+	bool IsShutdown();						// Find if the relays are held off.
+
+	// Split-range output:  the other relay cools, time-proportioned over
+	// the same window.
+	void SetSplit(bool split);				// Turn the cool side on or off.
+	bool GetSplit();						// Find if it's on.
+	void SetCoolOutput(double value);		// Set % of period cool relay is on.
+
+	// Short-cycle protection (for a compressor) on the heat (false) or
+	// cool (true) side's relay
+	void SetMinOffTime(bool cool, unsigned long mSec);	// Least time off.
+	unsigned long GetMinOffTime(bool cool);	// Get it [mSec].
+
+	// Zone control:  each relay runs its own zone, over its own window.
+	void SetSideWindow(bool cool, unsigned long mSec);	// Set a side's
+											// window, or 0 to share the
+											// output window.
 
 private:
-//	uint32_t windowStartTime;
+	bool shutdown;							// true when relays are held off
 	uint32_t windowSize;					// output period [milliseconds]
+	uint32_t windowStart;					// start of this window [mSec]
+	uint32_t windowLength;					// length of this window [mSec]
+	uint32_t onTime;						// relay on-time per window [mSec]
+	bool onFirst;							// on-time starts the window
+	double dutyValue;						// output [%]
+	bool relayOn;							// output relay's state
+	uint32_t nextEdge;						// when to switch next [mSec]
+	bool optimize;							// true to use the optimizer
+	double error;							// control error [C]
+	RelayOptimizer optimizer;				// plans windows when optimizing
+	bool relayState[2];						// what each relay pin is set to
+	unsigned long switchCount[2];			// operations of each relay
+	bool split;								// true to drive the cool side
+	uint32_t coolStart;						// start of its window [mSec]
+	uint32_t coolLength;					// length of its window [mSec]
+	uint32_t coolOnTime;					// its on-time per window [mSec]
+	double coolValue;						// its output [%]
+	bool coolOn;							// its relay's state
+	uint32_t coolEdge;						// when to switch it next [mSec]
+	uint32_t minOffTime[2];					// least off time of each side's
+											// relay [mSec]
+	uint32_t offSince[2];					// when each side's relay last
+											// turned off [mSec]
+	uint32_t sideWindow[2];					// each side's own window
+											// [mSec], or 0
+
+	void Schedule(unsigned long now);		// Switch the relay, & plan the next.
+	void ScheduleCool(unsigned long now);	// The same for the cool side.
+	void PlainWindow(bool cool);			// Plan a side's window plainly.
+	uint32_t Window(bool cool);				// Get a side's window [mSec].
+	bool Hold(bool cool, unsigned long now, uint32_t *edge);	// Keep a
+											// side off until its time's up.
+	void StartWindow();						// Plan the window just started.
+	void WriteRelay(bool relay, bool state);	// Switch a relay & count it.
 };
 
 #endif
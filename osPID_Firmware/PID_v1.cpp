@@ -0,0 +1,583 @@
+/******************************************************************************
+ *
+ *	Filename:		PID_v1.cpp
+ *
+ *	Source:			github.com/br3ttb/Arduino-PID-Library
+ *
+ *	Description:	Local copy of Brett Beauregard's Arduino PID Library,
+ *					version 1.  Unlike the original, Compute does not keep its
+ *					own timer:  the main loop samples the input on a fixed
+ *					schedule and calls Compute once per sample, so the PID
+ *					never skips a sample because of a millisecond of jitter.
+ *					Anything else that runs in step with the PID (such as the
+ *					Smith predictor) stays in sync with it.
+ *
+ *					Also unlike the original:
+ *
+ *					-	The integral term doesn't wind up while the output is
+ *						saturated.  It stops integrating in the direction of
+ *						the limit (conditional integration), and bleeds back
+ *						toward the value that just holds the output at the
+ *						limit (back-calculation).
+ *					-	Switching from manual to automatic preloads the
+ *						integral term so the first output equals the manual
+ *						one, proportional term included.
+ *					-	Compute can be given the time its input was read, and
+ *						then integrates & differentiates over the real time
+ *						since the last input.  Loop jitter doesn't show up
+ *						as derivative noise.
+ *					-	The derivative term can be filtered (first order).
+ *					-	The proportional and derivative terms see a weighted
+ *						setpoint (beta & gamma).  A beta below 1 tames the
+ *						overshoot after a setpoint step; a gamma of 0 (the
+ *						default) keeps the derivative off the setpoint, so a
+ *						step doesn't kick the output.
+ *
+ *****************************************************************************/
+
+#include <math.h>
+#include "PID_v1_local.h"	//called "local" in case library is installed on IDE
+
+/******************************************************************************
+ *
+ *	Function:		PID (Class Initializer)
+ *
+ *	Description:	Links the PID to the input, output & setpoint, and sets
+ *					the initial tuning parameters.
+ *
+ *****************************************************************************/
+
+PID::PID(double* input, double* output, double* setpoint,
+	double Kp, double Ki, double Kd, int ControllerDirection)
+{
+	myOutput = output;
+	myInput = input;
+	mySetpoint = setpoint;
+	myRate = NULL;
+	inAuto = false;
+	controllerDirection = DIRECT;
+	kp = 0;
+	ki = 0;
+	kd = 0;
+	beta = 1;
+	gamma = 0;
+	trackGain = 0;
+	dFiltered = 0;
+	filterTime = 0;
+	lastTime = 0;
+	timeValid = false;
+
+	// Default output limits match the Arduino's PWM range.
+	SetOutputLimits(0, 255);
+
+	// Default sample time is 0.1 seconds.
+	SampleTime = 100;
+
+	SetControllerDirection(ControllerDirection);
+	SetTunings(Kp, Ki, Kd);
+}
+
+/******************************************************************************
+ *
+ *	Function:		Compute
+ *
+ *	Description:	Calculates a new output from the input & setpoint,
+ *					assuming it's been one sample time since the last one.
+ *					Does nothing in manual mode.
+ *
+ *	Return Value:	true if a new output was calculated
+ *
+ *****************************************************************************/
+
+bool PID::Compute()
+{
+	return Update(1);
+}
+
+/******************************************************************************
+ *
+ *	Function:		Compute
+ *
+ *	Description:	Calculates a new output from an input read at a known
+ *					time, using the real time since the last input.  Does
+ *					nothing in manual mode.  The first sample after
+ *					switching to automatic is taken to be one sample time
+ *					long.
+ *
+ *	Parameters:		time - when the input was read [microseconds]
+ *
+ *	Return Value:	true if a new output was calculated
+ *
+ *****************************************************************************/
+
+bool PID::Compute(unsigned long time)
+{
+	double ratio = 1;					// sample length [sample times]
+
+	if (!inAuto)
+	{
+		return false;
+	}
+
+	if (timeValid)
+	{
+		ratio = (time - lastTime) / (SampleTime * 1000.0);
+		if ((ratio < PID_MIN_DT_RATIO) || (ratio > PID_MAX_DT_RATIO))
+		{
+			ratio = 1;
+		}
+	}
+	lastTime = time;
+	timeValid = true;
+
+	return Update(ratio);
+}
+
+/******************************************************************************
+ *
+ *	Function:		Update
+ *
+ *	Description:	Calculates a new output for a sample "ratio" sample times
+ *					long.  The integral grows in proportion to the sample's
+ *					length, and the derivative is the change over it divided
+ *					by its length, then filtered:
+ *
+ *					output = kp * (beta * SP - PV) + ITerm
+ *							+ kd * filter((gamma * dSP - dPV) / ratio)
+ *
+ *					The filter is first order, with its time constant in
+ *					seconds, so it smooths the same whatever the sample time.
+ *
+ *	Parameters:		ratio - the sample's length [sample times]
+ *
+ *	Return Value:	true if a new output was calculated
+ *
+ *****************************************************************************/
+
+bool PID::Update(double ratio)
+{
+	double input;						// process value
+	double setpoint;
+	double error;						// setpoint - process value
+	double dInput;						// change in process value, per
+										// sample time
+	double dRaw;						// unfiltered derivative, per sample
+										// time
+	double seconds;						// the sample's length [seconds]
+	double pTerm;						// proportional term
+	double dTerm;						// derivative term
+	double iStep;						// change in the integral term
+	double track;						// back-calculation gain, this sample
+	double output;						// new output
+
+	if (!inAuto)
+	{
+		return false;
+	}
+
+	input = *myInput;
+	setpoint = *mySetpoint;
+	error = setpoint - input;
+
+	// If something else already knows the input's rate of change, use that
+	// instead of differencing a noisy input.
+	if (myRate != NULL)
+	{
+		dInput = *myRate * SampleTime / 1000.0;
+	}
+	else
+	{
+		dInput = (input - lastInput) / ratio;
+	}
+
+	dRaw = gamma * (setpoint - lastSetpoint) / ratio - dInput;
+	if (filterTime > 0)
+	{
+		seconds = ratio * SampleTime / 1000.0;
+		dFiltered += (dRaw - dFiltered) * seconds / (filterTime + seconds);
+	}
+	else
+	{
+		dFiltered = dRaw;
+	}
+
+	pTerm = kp * (beta * setpoint - input);
+	dTerm = kd * dFiltered;
+
+	// Integrate, unless the output is already saturated and this would
+	// only push it further past the limit.
+	iStep = ki * ratio * error;
+	output = pTerm + ITerm + iStep + dTerm;
+	if (!((output > outMax) && (iStep > 0)) &&
+		!((output < outMin) && (iStep < 0)))
+	{
+		ITerm += iStep;
+	}
+
+	// If the output is saturated, pull the integral term back toward the
+	// value that would just hold it at the limit.
+	output = pTerm + ITerm + dTerm;
+	track = trackGain * ratio;
+	if (track > 1)
+	{
+		track = 1;
+	}
+	if (output > outMax)
+	{
+		ITerm += track * (outMax - output);
+		output = outMax;
+	}
+	else if (output < outMin)
+	{
+		ITerm += track * (outMin - output);
+		output = outMin;
+	}
+	*myOutput = output;
+
+	// Remember some variables for next time.
+	lastInput = input;
+	lastSetpoint = setpoint;
+
+	return true;
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetRateInput
+ *
+ *	Description:	Links the derivative term to an estimate of the input's
+ *					rate of change, such as one from a Kalman filter.
+ *
+ *	Parameters:		rate - input's rate of change [units per second], or NULL
+ *						to difference the input instead
+ *
+ *****************************************************************************/
+
+void PID::SetRateInput(double* rate)
+{
+	myRate = rate;
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetTunings
+ *
+ *	Description:	Changes the tuning parameters.  The integral and
+ *					derivative gains are scaled to the sample time here, so
+ *					Compute doesn't have to.
+ *
+ *****************************************************************************/
+
+void PID::SetTunings(double Kp, double Ki, double Kd)
+{
+	double SampleTimeInSec;
+
+	if (Kp < 0 || Ki < 0 || Kd < 0)
+	{
+		return;
+	}
+
+	dispKp = Kp;
+	dispKi = Ki;
+	dispKd = Kd;
+
+	SampleTimeInSec = ((double)SampleTime) / 1000;
+	kp = Kp;
+	ki = Ki * SampleTimeInSec;
+	kd = Kd / SampleTimeInSec;
+
+	if (controllerDirection == REVERSE)
+	{
+		kp = (0 - kp);
+		ki = (0 - ki);
+		kd = (0 - kd);
+	}
+
+	SetTracking();
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetWeights
+ *
+ *	Description:	Sets how much of the setpoint the proportional and
+ *					derivative terms see.  The integral term always sees all
+ *					of it, so the process still settles on the setpoint.
+ *
+ *	Parameters:		beta - proportional setpoint weight (0 to 1)
+ *					gamma - derivative setpoint weight (0 to 1)
+ *
+ *****************************************************************************/
+
+void PID::SetWeights(double beta, double gamma)
+{
+	if ((beta < 0) || (beta > 1) || (gamma < 0) || (gamma > 1))
+	{
+		return;
+	}
+
+	// Changing beta changes the proportional term.  Move the difference
+	// into the integral term, so the output doesn't jump.
+	ITerm += kp * (this->beta - beta) * *mySetpoint;
+
+	this->beta = beta;
+	this->gamma = gamma;
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetTracking
+ *
+ *	Description:	Works out how quickly the integral term is pulled back
+ *					when the output saturates.  The usual rule of thumb
+ *					(Astrom & Hagglund) tracks with a time constant of
+ *					sqrt(Ti * Td), or Ti without a derivative term:  slow
+ *					enough that a brief saturation doesn't throw away the
+ *					integral, fast enough to stop it winding up.
+ *
+ *****************************************************************************/
+
+void PID::SetTracking()
+{
+	double trackTime;					// tracking time constant [seconds]
+
+	if ((dispKp <= 0) || (dispKi <= 0))
+	{
+		// No integral term (conditional integration is enough), or no
+		// proportional term to scale Ti & Td by.
+		trackGain = 0;
+		return;
+	}
+
+	trackTime = dispKp / dispKi;
+	if (dispKd > 0)
+	{
+		trackTime = sqrt(trackTime * dispKd / dispKp);
+	}
+
+	trackGain = (SampleTime / 1000.0) / trackTime;
+	if (trackGain > 1)
+	{
+		trackGain = 1;
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetSampleTime
+ *
+ *	Description:	Sets how often Compute is called, and rescales the
+ *					integral and derivative gains to match.
+ *
+ *	Parameters:		newSampleTime - sample period [milliseconds]
+ *
+ *****************************************************************************/
+
+void PID::SetSampleTime(int newSampleTime)
+{
+	double ratio;
+
+	if (newSampleTime > 0)
+	{
+		ratio = (double)newSampleTime / (double)SampleTime;
+		ki *= ratio;
+		kd /= ratio;
+		SampleTime = (unsigned long)newSampleTime;
+		SetTracking();
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetDerivativeFilter
+ *
+ *	Description:	Sets the time constant of the first-order filter on the
+ *					derivative term.  A tenth or so of the derivative time
+ *					(Kd / Kp) takes the edge off sensor noise & quantization
+ *					without losing much of the derivative's lead.
+ *
+ *	Parameters:		seconds - time constant [seconds], or 0 for no filter
+ *
+ *****************************************************************************/
+
+void PID::SetDerivativeFilter(double seconds)
+{
+	if (seconds < 0)
+	{
+		return;
+	}
+
+	filterTime = seconds;
+}
+
+double PID::GetDerivativeFilter()
+{
+	return filterTime;
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetOutputLimits
+ *
+ *	Description:	Clamps the output to a range.  The integral term isn't
+ *					clamped with it:  with beta below 1 it's offset from the
+ *					output, and Compute keeps it from winding up anyway.
+ *
+ *****************************************************************************/
+
+void PID::SetOutputLimits(double min, double max)
+{
+	if (min >= max)
+	{
+		return;
+	}
+
+	outMin = min;
+	outMax = max;
+
+	if (inAuto)
+	{
+		if (*myOutput > outMax)
+		{
+			*myOutput = outMax;
+		}
+		else if (*myOutput < outMin)
+		{
+			*myOutput = outMin;
+		}
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetMode
+ *
+ *	Description:	Switches between manual (0) and automatic (1) mode.  When
+ *					switching to automatic, the PID picks up where the manual
+ *					output left off.
+ *
+ *****************************************************************************/
+
+void PID::SetMode(int mode)
+{
+	bool newAuto = (mode == AUTOMATIC);
+
+	if (newAuto && !inAuto)
+	{
+		// We just went from manual to auto.
+		Initialize();
+	}
+
+	inAuto = newAuto;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Initialize
+ *
+ *	Description:	Preloads the integral term so the first output in
+ *					automatic equals the manual output, and switching
+ *					doesn't bump it.  (The original loaded the manual output
+ *					into the integral term, so the proportional term still
+ *					bumped it.)  The derivative term starts at zero.  If the
+ *					process is so far from the setpoint that the integral
+ *					term would have to leave the output range, the output
+ *					moves as far as it has to.
+ *
+ *****************************************************************************/
+
+void PID::Initialize()
+{
+	double output;						// output to pick up from
+
+	output = *myOutput;
+	if (output > outMax)
+	{
+		output = outMax;
+	}
+	else if (output < outMin)
+	{
+		output = outMin;
+	}
+
+	lastInput = *myInput;
+	lastSetpoint = *mySetpoint;
+	dFiltered = 0;
+	timeValid = false;
+
+	// Work out the integral term as if beta were 1, so at the setpoint it's
+	// the output needed to hold there, and keep that within the output
+	// limits.  A large error then still moves the output right away,
+	// instead of leaving the integral term to work off a huge offset.
+	ITerm = output - kp * (lastSetpoint - lastInput);
+	if (ITerm > outMax)
+	{
+		ITerm = outMax;
+	}
+	else if (ITerm < outMin)
+	{
+		ITerm = outMin;
+	}
+
+	// Then move the part of the proportional term beta leaves out into it.
+	ITerm += kp * (1 - beta) * lastSetpoint;
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetControllerDirection
+ *
+ *	Description:	A direct-acting process (such as a heater) rises when the
+ *					output rises.  A reverse-acting one (such as a cooler)
+ *					falls.  Reverse acting flips the signs of the gains.  (The
+ *					original library only flipped them in automatic mode, so
+ *					a change made in manual mode was lost.)
+ *
+ *****************************************************************************/
+
+void PID::SetControllerDirection(int direction)
+{
+	if (direction != controllerDirection)
+	{
+		kp = (0 - kp);
+		ki = (0 - ki);
+		kd = (0 - kd);
+	}
+
+	controllerDirection = direction;
+}
+
+double PID::GetKp()
+{
+	return dispKp;
+}
+
+double PID::GetKi()
+{
+	return dispKi;
+}
+
+double PID::GetKd()
+{
+	return dispKd;
+}
+
+double PID::GetBeta()
+{
+	return beta;
+}
+
+double PID::GetGamma()
+{
+	return gamma;
+}
+
+int PID::GetMode()
+{
+	return inAuto ? AUTOMATIC : MANUAL;
+}
+
+int PID::GetDirection()
+{
+	return controllerDirection;
+}
@@ -0,0 +1,135 @@
+/******************************************************************************
+ *
+ *	Filename:		PID_v1_local.h
+ *
+ *	Description:	Local copy of Brett Beauregard's Arduino PID Library,
+ *					version 1.  It's called "local" in case the library is
+ *					installed on the IDE.
+ *
+ *****************************************************************************/
+
+#ifndef PID_V1_LOCAL_H
+#define PID_V1_LOCAL_H
+
+// Off the Arduino (in tools/pid_benchmark.cpp) there's no Arduino.h.
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stddef.h>
+#endif
+
+// Controller modes
+#define MANUAL		0
+#define AUTOMATIC	1
+
+// Controller directions
+#define DIRECT		0
+#define REVERSE		1
+
+// Limits on the measured time between samples, as a fraction of the sample
+// time.  Outside them (a stall, or a clock that's been reset), the sample
+// is taken to be one sample time long.
+#define PID_MIN_DT_RATIO	0.1
+#define PID_MAX_DT_RATIO	10.0
+
+class PID
+{
+public:
+	// Initialize the class.
+	PID(double* input, double* output, double* setpoint,
+		double Kp, double Ki, double Kd, int ControllerDirection);
+
+	// Set manual (0) or automatic (1) mode.
+	void SetMode(int mode);
+
+	// Calculate a new output.  Call this once per sample period.
+	bool Compute();
+
+	// Calculate a new output from an input read at "time" [microseconds].
+	// The integral & derivative terms use the real time since the last
+	// input, not the sample time.
+	bool Compute(unsigned long time);
+
+	// Clamp the output to a range.
+	void SetOutputLimits(double min, double max);
+
+	// Take the derivative from a rate of change [per second] instead of
+	// differencing the input.  NULL goes back to differencing.
+	void SetRateInput(double* rate);
+
+	// Set the tuning parameters.
+	void SetTunings(double Kp, double Ki, double Kd);
+
+	// Set how much of the setpoint the proportional (beta) and derivative
+	// (gamma) terms see, from 0 to 1.
+	void SetWeights(double beta, double gamma);
+
+	// Set direct (0) or reverse (1) acting.
+	void SetControllerDirection(int direction);
+
+	// Set how often Compute is called [milliseconds].
+	void SetSampleTime(int newSampleTime);
+
+	// Set the derivative filter's time constant [seconds], or 0 for none.
+	void SetDerivativeFilter(double seconds);
+
+	// Fetch the derivative filter's time constant [seconds].
+	double GetDerivativeFilter();
+
+	// Fetch the tuning parameters, as the user entered them.
+	double GetKp();
+	double GetKi();
+	double GetKd();
+
+	// Fetch the setpoint weights.
+	double GetBeta();
+	double GetGamma();
+
+	// Fetch the mode & direction.
+	int GetMode();
+	int GetDirection();
+
+private:
+	// Set up for a bumpless transfer from manual to automatic.
+	void Initialize();
+
+	// Calculate a new output, for a sample "ratio" sample times long.
+	bool Update(double ratio);
+
+	// Work out how fast the integral term tracks a saturated output.
+	void SetTracking();
+
+	double dispKp;						// tuning parameters in user units
+	double dispKi;
+	double dispKd;
+
+	double kp;							// proportional gain
+	double ki;							// integral gain (per sample)
+	double kd;							// derivative gain (per sample)
+	double beta;						// setpoint weight on proportional
+	double gamma;						// setpoint weight on derivative
+	double trackGain;					// back-calculation gain (per sample)
+
+	int controllerDirection;			// DIRECT or REVERSE
+
+	double *myInput;					// process value
+	double *myOutput;					// controller output
+	double *mySetpoint;					// setpoint
+	double *myRate;						// input's rate of change, or NULL
+
+	double ITerm;						// integral term
+	double lastInput;					// process value at last sample
+	double lastSetpoint;				// setpoint at last sample
+	double dFiltered;					// filtered derivative (per sample
+										// time)
+	double filterTime;					// derivative filter [seconds]
+	unsigned long lastTime;				// time of last input [uSec]
+	bool timeValid;						// lastTime can be used
+
+	unsigned long SampleTime;			// sample period [milliseconds]
+	double outMin;						// output limits
+	double outMax;
+	bool inAuto;						// true in automatic mode
+};
+
+#endif
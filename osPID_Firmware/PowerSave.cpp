@@ -0,0 +1,197 @@
+/******************************************************************************
+ *
+ *	Filename:		PowerSave.cpp
+ *
+ *	Description:	Keeps the CPU asleep when there's nothing to do.  The main
+ *					loop only has work when a timer tick or a serial byte
+ *					arrives, so between passes it sleeps in IDLE mode.  Every
+ *					interrupt wakes it, including Timer0's tick (about once a
+ *					millisecond), so relay timing and millis() are unchanged.
+ *
+ *					Thermistor readings are taken in ADC noise reduction
+ *					mode, which stops the CPU and most of the clocks while
+ *					the ADC converts, so their switching noise doesn't get
+ *					into the reading.
+ *
+ *					To show it's working, this keeps track of the time spent
+ *					asleep, and of how long it takes a scheduled task to start
+ *					after the time it was due (wake-up latency).  The
+ *					latency is the whole milliseconds from millis(), plus
+ *					the time into the current tick from Timer0's counter.
+ *
+ *****************************************************************************/
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/sleep.h>
+#include "PowerSave.h"
+#include "Trace.h"
+
+// Timer0 counts at the CPU clock / 64 (set up by the Arduino core).
+#define TIMER0_PRESCALE		64
+
+static unsigned long statsStart;		// micros() when stats were cleared
+static unsigned long asleep;			// time asleep since then [uSec]
+static uint16_t maxLatency;				// worst wake-up latency [uSec]
+static uint16_t adcReads;				// conversions done asleep
+
+// The ADC interrupt only has to wake the CPU (and, when tracing, note the
+// reading).
+#if TRACE_ENABLED
+ISR(ADC_vect)
+{
+	TRACE_ISR(TRACE_ADC, ADC);
+}
+#else
+EMPTY_INTERRUPT(ADC_vect);
+#endif
+
+/******************************************************************************
+ *
+ *	Function:		SleepIdle
+ *
+ *	Description:	Puts the CPU in IDLE sleep.  The timers, UART & ADC keep
+ *					running, and any interrupt wakes the CPU.  Call this at
+ *					the end of each pass through the main loop.
+ *
+ *****************************************************************************/
+
+void SleepIdle(void)
+{
+	unsigned long start;				// micros() before sleeping
+
+	start = micros();
+
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	sleep_enable();
+	sleep_cpu();
+	sleep_disable();
+
+	asleep += micros() - start;
+}
+
+/******************************************************************************
+ *
+ *	Function:		SleepAnalogRead
+ *
+ *	Description:	Reads an analog pin.  analogRead selects the pin and
+ *					takes a first reading, which is thrown away (it lets the
+ *					input settle after switching).  The reading that's kept is
+ *					taken in ADC noise reduction sleep.  If anything else
+ *					wakes the CPU first, it goes back to sleep until the
+ *					conversion is done.
+ *
+ *					The UART stops while the CPU sleeps, so this waits for
+ *					anything being sent to finish first.
+ *
+ *	Parameters:		pin - analog pin to read
+ *
+ *	Return Value:	ADC reading (0 to 1023)
+ *
+ *****************************************************************************/
+
+uint16_t SleepAnalogRead(uint8_t pin)
+{
+#if SLEEP_ADC_NOISE_REDUCTION
+	analogRead(pin);
+	Serial.flush();
+
+	ADCSRA |= (1 << ADIE);
+	set_sleep_mode(SLEEP_MODE_ADC);
+	sleep_enable();
+	do
+	{
+		// Going to sleep starts the conversion.
+		sleep_cpu();
+	} while (ADCSRA & (1 << ADSC));
+	sleep_disable();
+	ADCSRA &= ~(1 << ADIE);
+
+	adcReads++;
+	return ADC;
+#else
+	return analogRead(pin);
+#endif
+}
+
+/******************************************************************************
+ *
+ *	Function:		SleepCheckLatency
+ *
+ *	Description:	Measures how late a scheduled task is starting.  Call
+ *					this as soon as the task is found to be due.  A task
+ *					held up past several ticks (by a long serial command, or
+ *					an LCD update) is measured in full, up to about 65 mSec;
+ *					later than that reads as 65535.  millis() now & then
+ *					skips a count, so it can read up to a millisecond long.
+ *
+ *	Parameters:		due - when the task was due [millis()]
+ *
+ *****************************************************************************/
+
+void SleepCheckLatency(unsigned long due)
+{
+	unsigned long late;					// whole milliseconds late
+	uint8_t count;						// Timer0's count into this tick
+	unsigned long latency;				// [uSec]
+	uint8_t oldSREG = SREG;
+
+	// Read the two together.  An overflow that's pending means millis()
+	// hasn't counted this tick yet (as in the core's micros()).
+	cli();
+	late = millis() - due;
+	count = TCNT0;
+	if ((TIFR0 & (1 << TOV0)) && (count < 255))
+	{
+		late++;
+	}
+	SREG = oldSREG;
+
+	if (late > 0xFFFF / 1000)
+	{
+		latency = 0xFFFF;
+	}
+	else
+	{
+		latency = late * 1000 +
+			(uint16_t)count * TIMER0_PRESCALE / clockCyclesPerMicrosecond();
+		if (latency > 0xFFFF)
+		{
+			latency = 0xFFFF;
+		}
+	}
+	if (latency > maxLatency)
+	{
+		maxLatency = latency;
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		SleepGetStats
+ *
+ *	Description:	Hands back the statistics gathered since the last call,
+ *					and clears them.  Call this at least once an hour, or the
+ *					microsecond counts will wrap around.
+ *
+ *	Parameters:		stats - where to put the statistics
+ *
+ *****************************************************************************/
+
+void SleepGetStats(sleepStats_t *stats)
+{
+	unsigned long now;					// micros() right now
+
+	now = micros();
+
+	stats->elapsed = now - statsStart;
+	stats->asleep = asleep;
+	stats->maxLatency = maxLatency;
+	stats->adcReads = adcReads;
+
+	statsStart = now;
+	asleep = 0;
+	maxLatency = 0;
+	adcReads = 0;
+}
@@ -0,0 +1,34 @@
+#ifndef POWER_SAVE_H
+#define POWER_SAVE_H
+
+#include <stdint.h>
+
+// Set to 0 to take thermistor readings the ordinary way.  In ADC noise
+// reduction sleep, the UART and Timer0 stop for each conversion (about 0.1
+// mSec), so millis() loses that much time, and a serial byte arriving at
+// that instant may be garbled.
+#define SLEEP_ADC_NOISE_REDUCTION	1
+
+typedef struct							// where the time went
+{
+	unsigned long elapsed;				// time covered [microseconds]
+	unsigned long asleep;				// time spent in idle sleep [uSec]
+	uint16_t maxLatency;				// worst time from when a task was due
+										// to when it started [uSec]
+	uint16_t adcReads;					// conversions done asleep
+} sleepStats_t;
+
+// Sleep until the next interrupt (at most about 1 mSec, the timer tick).
+void SleepIdle(void);
+
+// Read an analog pin with the CPU asleep, for a quieter reading.
+uint16_t SleepAnalogRead(uint8_t pin);
+
+// Note that a scheduled task due at millis() "due" is starting, and
+// measure how late it is.
+void SleepCheckLatency(unsigned long due);
+
+// Fetch the statistics since the last call, and start over.
+void SleepGetStats(sleepStats_t *stats);
+
+#endif
@@ -0,0 +1,85 @@
+/******************************************************************************
+ *
+ *	Filename:		Recipe.cpp
+ *
+ *	Description:	Helpers for recipes:  stored sets of setpoint, tunings,
+ *					direction, sensor & output window that an operator can
+ *					switch between.  The sketch keeps them in EEPROM, each
+ *					with its own check value, so any one of them can be read
+ *					(and trusted) without reading the rest.
+ *
+ *****************************************************************************/
+
+#include <stdint.h>
+#include "Recipe.h"
+
+/******************************************************************************
+ *
+ *	Function:		RecipeSetName
+ *
+ *	Description:	Names a recipe.  Leading spaces are skipped, and only the
+ *					first RECIPE_NAME_SIZE - 1 characters are kept.  With no
+ *					name, it's called "rcp <number>".
+ *
+ *	Parameters:		recipe - the recipe
+ *					name - its name, or NULL
+ *					number - its number (1 to 9)
+ *
+ *****************************************************************************/
+
+void RecipeSetName(recipe_t *recipe, const char *name, uint8_t number)
+{
+	uint8_t i;
+
+	while ((name != 0) && (*name == ' '))
+	{
+		name++;
+	}
+
+	for (i = 0; i < RECIPE_NAME_SIZE; i++)
+	{
+		recipe->name[i] = '\0';
+	}
+
+	if ((name == 0) || (*name == '\0'))
+	{
+		recipe->name[0] = 'r';
+		recipe->name[1] = 'c';
+		recipe->name[2] = 'p';
+		recipe->name[3] = ' ';
+		recipe->name[4] = (char)('0' + number);
+		return;
+	}
+
+	for (i = 0; (i < RECIPE_NAME_SIZE - 1) && (name[i] != '\0'); i++)
+	{
+		recipe->name[i] = name[i];
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		RecipeCheck
+ *
+ *	Description:	Adds up a recipe's bytes (all but the check itself),
+ *					starting from 0xA5, so a blank recipe (all 0xFF, or
+ *					all 0) doesn't pass.
+ *
+ *	Parameters:		recipe - the recipe
+ *
+ *	Return Value:	the check value
+ *
+ *****************************************************************************/
+
+uint8_t RecipeCheck(const recipe_t *recipe)
+{
+	const uint8_t *p = (const uint8_t *)recipe;
+	uint8_t sum = 0xA5;
+	uint8_t i;
+
+	for (i = 0; i < sizeof(recipe_t) - 1; i++)
+	{
+		sum += p[i];
+	}
+	return sum;
+}
@@ -0,0 +1,32 @@
+#ifndef RECIPE_H
+#define RECIPE_H
+
+#include <stdint.h>
+
+#define RECIPE_NAME_SIZE	7			// 6 characters (fits the LCD) & NULL
+
+// Flags
+#define RECIPE_REVERSE		0x01		// reverse acting
+#define RECIPE_THERMISTOR	0x02		// read the thermistor
+
+// A recipe, as it's kept in EEPROM:  25 bytes.  Floats and packing keep
+// that the same off the AVR, where a double is 8 bytes.
+typedef struct __attribute__((packed))
+{
+	char name[RECIPE_NAME_SIZE];		// shown on the LCD
+	int16_t setpoint;					// [0.1 C]
+	float kp;							// tunings
+	float ki;
+	float kd;
+	uint8_t flags;						// RECIPE_REVERSE, RECIPE_THERMISTOR
+	uint16_t window;					// output window [0.1 sec]
+	uint8_t check;						// RecipeCheck of the rest
+} recipe_t;
+
+// Name a recipe.  An empty name (or NULL) names it by its number.
+void RecipeSetName(recipe_t *recipe, const char *name, uint8_t number);
+
+// Calculate a recipe's check value.  Blank EEPROM doesn't pass.
+uint8_t RecipeCheck(const recipe_t *recipe);
+
+#endif
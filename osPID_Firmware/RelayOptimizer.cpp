@@ -0,0 +1,149 @@
+/******************************************************************************
+ *
+ *	Filename:		RelayOptimizer.cpp
+ *
+ *	Description:	Plans the relay's on-time one output window at a time,
+ *					so a mechanical relay switches as seldom as it can
+ *					without changing the average output:
+ *
+ *					-	The on-time is rounded to a step of the window, so
+ *						small wobbles in the PID's output don't move the
+ *						edges.
+ *					-	A pulse (on or off) too short to be worth a relay
+ *						operation is skipped.
+ *					-	What rounding & skipping leave out is carried into
+ *						the next window, so over a few windows the relay is
+ *						on for as long as the PID asked.
+ *					-	The on-time goes at the start of the window if the
+ *						last window ended on, and at the end otherwise, so
+ *						on-times in neighbouring windows merge into one.
+ *						That halves the switching at any steady output.
+ *					-	While the error is small, the window is stretched,
+ *						so there are fewer windows to switch in.
+ *
+ *					Since a plan covers a whole window, a new output takes
+ *					effect at the next window, not straight away.
+ *
+ *****************************************************************************/
+
+#include <stdint.h>
+#include <math.h>
+#include "RelayOptimizer.h"
+
+/******************************************************************************
+ *
+ *	Function:		RelayOptimizer (Class Initializer)
+ *
+ *****************************************************************************/
+
+RelayOptimizer::RelayOptimizer()
+{
+	dutyStep = RELAY_DUTY_STEP;
+	minPulse = RELAY_MIN_PULSE;
+	quietBand = RELAY_QUIET_BAND;
+	stretch = RELAY_STRETCH;
+	Reset();
+}
+
+// A step of 0 turns rounding off.
+void RelayOptimizer::SetDutyStep(uint8_t dutyStep)
+{
+	this->dutyStep = dutyStep;
+}
+
+void RelayOptimizer::SetMinPulse(uint32_t minPulse)
+{
+	this->minPulse = minPulse;
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetStretch
+ *
+ *	Description:	Sets how far the window is stretched while the process
+ *					is close to the setpoint.  A multiplier of 1 turns
+ *					stretching off.
+ *
+ *	Parameters:		quietBand - error band [C]
+ *					stretch - window multiplier (1 or more)
+ *
+ *****************************************************************************/
+
+void RelayOptimizer::SetStretch(double quietBand, uint8_t stretch)
+{
+	this->quietBand = quietBand;
+	this->stretch = (stretch < 1) ? 1 : stretch;
+}
+
+void RelayOptimizer::Reset()
+{
+	carry = 0;
+	endedOn = false;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Plan
+ *
+ *	Description:	Works out how long the next window is, how long the relay
+ *					is on during it, and whether that's at its start or end.
+ *
+ *	Parameters:		window - output window [mSec]
+ *					duty - output the PID asked for [%]
+ *					error - setpoint - process value [C]
+ *					plan - where to put the plan
+ *
+ *****************************************************************************/
+
+void RelayOptimizer::Plan(uint32_t window, double duty, double error,
+	relayPlan_t *plan)
+{
+	int32_t wanted;						// on-time asked for, plus carry
+	int32_t step;						// rounding step [mSec]
+	int32_t onTime;
+
+	if (fabs(error) < quietBand)
+	{
+		window *= stretch;
+	}
+
+	if (duty < 0)
+	{
+		duty = 0;
+	}
+	else if (duty > 100)
+	{
+		duty = 100;
+	}
+
+	// Round to the nearest step, then skip pulses that are too short.
+	wanted = (int32_t)(duty * window / 100.0 + 0.5) + carry;
+	step = (int32_t)window * dutyStep / 100;
+	onTime = (step > 0) ? ((wanted + step / 2) / step) * step : wanted;
+	if (onTime < (int32_t)minPulse)
+	{
+		onTime = 0;
+	}
+	else if (onTime > (int32_t)window - (int32_t)minPulse)
+	{
+		onTime = window;
+	}
+
+	// Carry what was left out, but never more than a window's worth, so a
+	// long stretch at 0% or 100% doesn't bank up a debt.
+	carry = wanted - onTime;
+	if (carry > (int32_t)window)
+	{
+		carry = window;
+	}
+	else if (carry < -(int32_t)window)
+	{
+		carry = -(int32_t)window;
+	}
+
+	// Join up with the last window's on-time, if it ended on.
+	plan->window = window;
+	plan->onTime = onTime;
+	plan->onFirst = endedOn;
+	endedOn = (onTime == (int32_t)window) || ((onTime > 0) && !endedOn);
+}
@@ -0,0 +1,54 @@
+#ifndef RELAY_OPTIMIZER_H
+#define RELAY_OPTIMIZER_H
+
+#include <stdint.h>
+
+// Defaults.  On-times are rounded to RELAY_DUTY_STEP % of the window; an on
+// (or off) pulse shorter than RELAY_MIN_PULSE is skipped.  What rounding &
+// skipping leave out is carried into the next window, so the average output
+// is unchanged.  While the error is within RELAY_QUIET_BAND, the window is
+// stretched by RELAY_STRETCH.
+#define RELAY_DUTY_STEP		5			// [%]
+#define RELAY_MIN_PULSE		1000		// [mSec]
+#define RELAY_QUIET_BAND	1.0			// |setpoint - PV| [C]
+#define RELAY_STRETCH		2			// window multiplier when quiet
+
+typedef struct							// what the relay does for one window
+{
+	uint32_t window;					// window length [mSec]
+	uint32_t onTime;					// time on [mSec]
+	bool onFirst;						// true if the on-time starts the
+										// window, false if it ends it
+} relayPlan_t;
+
+class RelayOptimizer
+{
+public:
+	// Initialize the class.
+	RelayOptimizer();
+
+	// Set the step on-times are rounded to [% of the window].
+	void SetDutyStep(uint8_t dutyStep);
+
+	// Set the smallest on or off pulse [mSec].
+	void SetMinPulse(uint32_t minPulse);
+
+	// Set the error band [C] & window multiplier for quiet times.
+	void SetStretch(double quietBand, uint8_t stretch);
+
+	// Forget the carried on-time & the last window's state.
+	void Reset();
+
+	// Plan the next window.
+	void Plan(uint32_t window, double duty, double error, relayPlan_t *plan);
+
+private:
+	uint8_t dutyStep;					// rounding step [%]
+	uint32_t minPulse;					// smallest pulse [mSec]
+	double quietBand;					// error band for stretching [C]
+	uint8_t stretch;					// window multiplier when quiet
+	int32_t carry;						// on-time owed [mSec]
+	bool endedOn;						// true if the last window ended on
+};
+
+#endif
@@ -0,0 +1,168 @@
+/******************************************************************************
+ *
+ *	Filename:		RunStats.cpp
+ *
+ *	Description:	Keeps a running summary of the process:  the lowest,
+ *					highest & mean process value and its standard deviation,
+ *					the share of the time it was within tolerance, and the
+ *					mean output (a measure of the energy used).  Nothing is
+ *					kept per sample, so a summary costs the same however
+ *					long it runs.
+ *
+ *					The mean & standard deviation use Welford's method,
+ *					which updates the mean and the sum of squared
+ *					differences from it with each sample.  Summing the
+ *					squares of the values instead would lose the variance
+ *					to cancellation (and overflow) at process temperatures.
+ *					Each sample is weighted by the time it stands for, since
+ *					the sample period adapts (West's weighted form).  The
+ *					mean carries 32 fractional bits, so a sample still moves
+ *					it after weeks of them.
+ *
+ *****************************************************************************/
+
+#include <stdint.h>
+#include <math.h>
+#include "RunStats.h"
+
+/******************************************************************************
+ *
+ *	Function:		RunStats (Class Initializer)
+ *
+ *****************************************************************************/
+
+RunStats::RunStats()
+{
+	Reset();
+}
+
+void RunStats::Reset()
+{
+	weight = 0;
+	mean = 0;
+	m2 = 0;
+	min = 0;
+	max = 0;
+	inTolerance = 0;
+	outputSum = 0;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Add
+ *
+ *	Description:	Takes a sample.  Once the total weight reaches
+ *					STATS_MAX_WEIGHT (about 25 days), every weighted sum is
+ *					halved first.  That keeps each mean & share as it was,
+ *					and the sums inside their types; from then on, older
+ *					samples count for less than new ones.
+ *
+ *	Parameters:		value - process value [C, fixed point]
+ *					output - output [%, fixed point]
+ *					inTolerance - true if value was within tolerance
+ *					weight - time the sample stands for [mSec]
+ *
+ *****************************************************************************/
+
+void RunStats::Add(fixed_t value, fixed_t output, bool inTolerance,
+	unsigned long weight)
+{
+	int64_t x = (int64_t)value << FIXED_SHIFT;	// value [32.32]
+	int64_t delta;						// from the old mean [32.32]
+
+	if (weight == 0)
+	{
+		return;
+	}
+
+	if (this->weight == 0)
+	{
+		min = value;
+		max = value;
+	}
+	else
+	{
+		min = (value < min) ? value : min;
+		max = (value > max) ? value : max;
+	}
+
+	if (this->weight + weight >= STATS_MAX_WEIGHT)
+	{
+		this->weight /= 2;
+		m2 /= 2;
+		this->inTolerance /= 2;
+		outputSum /= 2;
+	}
+	this->weight += weight;
+
+	// Welford:  move the mean by this sample's share of the difference,
+	// then add the difference from the old mean times the difference from
+	// the new one.
+	delta = x - mean;
+	mean += delta * (int64_t)weight / (int64_t)this->weight;
+	m2 += (((delta >> FIXED_SHIFT) * ((x - mean) >> FIXED_SHIFT)) >>
+		FIXED_SHIFT) * (int64_t)weight;
+
+	if (inTolerance)
+	{
+		this->inTolerance += weight;
+	}
+	outputSum += (int64_t)output * (int64_t)weight;
+}
+
+bool RunStats::IsEmpty()
+{
+	return (weight == 0);
+}
+
+fixed_t RunStats::GetMin()
+{
+	return min;
+}
+
+fixed_t RunStats::GetMax()
+{
+	return max;
+}
+
+fixed_t RunStats::GetMean()
+{
+	return (fixed_t)(mean >> FIXED_SHIFT);
+}
+
+fixed_t RunStats::GetStdDev()
+{
+	if (weight == 0)
+	{
+		return 0;
+	}
+	return FixedFromDouble(sqrt(FixedToDouble(m2 / weight)));
+}
+
+fixed_t RunStats::GetInTolerance()
+{
+	if (weight == 0)
+	{
+		return 0;
+	}
+	return (fixed_t)(((int64_t)inTolerance * FIXED_FROM_INT(100)) / weight);
+}
+
+fixed_t RunStats::GetOutput()
+{
+	if (weight == 0)
+	{
+		return 0;
+	}
+	return (fixed_t)(outputSum / weight);
+}
+
+void RunStats::Summarize(runSummary_t *summary)
+{
+	summary->min = GetMin();
+	summary->max = GetMax();
+	summary->mean = GetMean();
+	summary->stdDev = GetStdDev();
+	summary->inTolerance = GetInTolerance();
+	summary->output = GetOutput();
+}
@@ -0,0 +1,76 @@
+#ifndef RUN_STATS_H
+#define RUN_STATS_H
+
+#include <stdint.h>
+#include "FixedPoint.h"
+
+// Past this much weight [mSec], every sum is halved (see Add).
+#define STATS_MAX_WEIGHT	0x80000000UL
+
+typedef struct							// a summary, as saved in EEPROM
+{
+	uint16_t sequence;					// goes up by one per summary
+	uint8_t recipe;						// recipe loaded (0 for none)
+	uint32_t duration;					// [seconds]
+	fixed_t min;						// process value [C]
+	fixed_t max;
+	fixed_t mean;
+	fixed_t stdDev;
+	fixed_t inTolerance;				// time within tolerance [%]
+	fixed_t output;						// mean output [%]
+	uint16_t check;						// check of the above (the sketch's
+										// RecordCheck)
+} runSummary_t;
+
+class RunStats
+{
+public:
+	// Initialize the class, empty.
+	RunStats();
+
+	// Forget everything so far.
+	void Reset();
+
+	// Take a sample:  the process value [C, fixed point], the output [%,
+	// fixed point], whether the process value was within tolerance of the
+	// setpoint, and the time the sample stands for [mSec].
+	void Add(fixed_t value, fixed_t output, bool inTolerance,
+		unsigned long weight);
+
+	// True if no samples have been taken since the last Reset.
+	bool IsEmpty();
+
+	// Fetch the lowest & highest process values [C, fixed point].
+	fixed_t GetMin();
+	fixed_t GetMax();
+
+	// Fetch the mean process value, and its standard deviation [C, fixed
+	// point].
+	fixed_t GetMean();
+	fixed_t GetStdDev();
+
+	// Fetch the share of the time the process value was within tolerance
+	// [%, fixed point].
+	fixed_t GetInTolerance();
+
+	// Fetch the mean output [%, fixed point].
+	fixed_t GetOutput();
+
+	// Fill in a summary's statistics (the caller fills in the rest).
+	void Summarize(runSummary_t *summary);
+
+private:
+	uint32_t weight;					// total weight [mSec]
+	int64_t mean;						// mean process value [C, 32.32
+										// fixed point]
+	int64_t m2;							// weighted sum of squared
+										// differences from the mean [C^2
+										// mSec, fixed point]
+	fixed_t min;						// [C]
+	fixed_t max;						// [C]
+	uint32_t inTolerance;				// weight within tolerance [mSec]
+	int64_t outputSum;					// weighted sum of the output [%
+										// mSec, fixed point]
+};
+
+#endif
@@ -0,0 +1,233 @@
+/******************************************************************************
+ *
+ *	Filename:		SafetySupervisor.cpp
+ *
+ *	Description:	Keeps a broken controller from cooking something.  It
+ *					does two jobs:
+ *
+ *					1.	Runs the AVR's hardware watchdog.  Each task checks
+ *						in when it makes progress, and the watchdog is only
+ *						petted once all of them have.  If any task hangs, the
+ *						watchdog resets the processor.
+ *
+ *					2.	Watches for thermal runaway.  If the output is at
+ *						100% but the process value doesn't rise, the sensor
+ *						has probably come loose from the heater.  If the
+ *						output is at 0% but the process value keeps rising,
+ *						a relay has probably welded shut.  Either way, an
+ *						alarm is latched and the caller should shut off the
+ *						outputs.
+ *
+ *					Check takes the time as a parameter rather than reading
+ *					the clock, so it can be exercised in a simulation
+ *					(tools/safety_test.cpp).  Off the AVR there's no watchdog,
+ *					and Begin & Service only keep track of the check-ins.
+ *
+ *****************************************************************************/
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include <stdint.h>
+#include <math.h>
+#ifdef __AVR__
+#include <avr/wdt.h>
+#endif
+#include "SafetySupervisor.h"
+
+/******************************************************************************
+ *
+ *	Function:		SafetySupervisor (Class Initializer)
+ *
+ *****************************************************************************/
+
+SafetySupervisor::SafetySupervisor()
+{
+	progress = 0;
+	reverseActing = false;
+	SetLimits(SAFETY_FULL_ON_TIME, SAFETY_MIN_RISE, SAFETY_OFF_HOLD_TIME,
+		SAFETY_MAX_RISE);
+	ClearAlarm();
+}
+
+/******************************************************************************
+ *
+ *	Function:		Begin
+ *
+ *	Description:	Starts the watchdog.  Its timeout is longer than the
+ *					slowest sample period, so a healthy controller always
+ *					pets it in time.
+ *
+ *****************************************************************************/
+
+void SafetySupervisor::Begin()
+{
+	progress = 0;
+#ifdef __AVR__
+	wdt_enable(WDTO_4S);
+#endif
+}
+
+/******************************************************************************
+ *
+ *	Function:		Service
+ *
+ *	Description:	Pets the watchdog, but only if every task has checked in
+ *					since the last time.  Call this from the main loop; it
+ *					costs next to nothing when there's nothing to do.
+ *
+ *****************************************************************************/
+
+void SafetySupervisor::Service()
+{
+	if ((progress & SAFETY_TASK_ALL) == SAFETY_TASK_ALL)
+	{
+#ifdef __AVR__
+		wdt_reset();
+#endif
+		progress = 0;
+	}
+}
+
+void SafetySupervisor::SetLimits(unsigned int fullOnSec, double minimumRise,
+	unsigned int offHoldSec, double maximumRise)
+{
+	fullOnTime = fullOnSec * 1000UL;
+	minRise = minimumRise;
+	offHoldTime = offHoldSec * 1000UL;
+	maxRise = maximumRise;
+}
+
+void SafetySupervisor::SetReverse(bool reverse)
+{
+	reverseActing = reverse;
+}
+
+safetyAlarm_t SafetySupervisor::GetAlarm()
+{
+	return alarm;
+}
+
+void SafetySupervisor::SetAlarm(safetyAlarm_t newAlarm)
+{
+	alarm = newAlarm;
+}
+
+void SafetySupervisor::ClearAlarm()
+{
+	alarm = SAFETY_ALARM_NONE;
+	fullOnTiming = false;
+	offTiming = false;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Check
+ *
+ *	Description:	Looks for thermal runaway.  Once an alarm is latched, it
+ *					stays latched until ClearAlarm is called.
+ *
+ *	Parameters:		processValue - process value [C], or NAN if unknown
+ *					output - controller output [%]
+ *					now - current time [milliseconds]
+ *
+ *	Return Value:	the latched alarm
+ *
+ *****************************************************************************/
+
+safetyAlarm_t SafetySupervisor::Check(double processValue, double output,
+	unsigned long now)
+{
+	double rise;						// PV change in the output's direction
+
+	// Without a process value, there's nothing to go on.  Start over when
+	// it comes back.
+	if (isnan(processValue))
+	{
+		fullOnTiming = false;
+		offTiming = false;
+		return alarm;
+	}
+
+	// If the output is full on, the process value should be moving.
+	if (output >= 100)
+	{
+		if (!fullOnTiming)
+		{
+			fullOnTiming = true;
+			fullOnStart = now;
+			fullOnValue = processValue;
+		}
+
+		rise = processValue - fullOnValue;
+		if (reverseActing)
+		{
+			rise = -rise;
+		}
+
+		// If it moved, start timing again from here.
+		if (rise >= minRise)
+		{
+			fullOnStart = now;
+			fullOnValue = processValue;
+		}
+		else if (now - fullOnStart >= fullOnTime)
+		{
+			if (alarm == SAFETY_ALARM_NONE)
+			{
+				alarm = SAFETY_ALARM_NO_RISE;
+			}
+		}
+	}
+	else
+	{
+		fullOnTiming = false;
+	}
+
+	// If the output is off, the process value shouldn't keep moving once
+	// it's had time to coast.
+	if (output <= 0)
+	{
+		if (!offTiming)
+		{
+			offTiming = true;
+			offWatching = false;
+			offStart = now;
+		}
+		else if (!offWatching)
+		{
+			if (now - offStart >= offHoldTime)
+			{
+				offWatching = true;
+				offValue = processValue;
+			}
+		}
+		else
+		{
+			rise = processValue - offValue;
+			if (reverseActing)
+			{
+				rise = -rise;
+			}
+
+			// Measure the rise from the lowest point.
+			if (rise < 0)
+			{
+				offValue = processValue;
+			}
+			else if (rise >= maxRise)
+			{
+				if (alarm == SAFETY_ALARM_NONE)
+				{
+					alarm = SAFETY_ALARM_RISE_WHEN_OFF;
+				}
+			}
+		}
+	}
+	else
+	{
+		offTiming = false;
+	}
+
+	return alarm;
+}
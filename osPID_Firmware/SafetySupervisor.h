@@ -0,0 +1,87 @@
+#ifndef SAFETY_SUPERVISOR_H
+#define SAFETY_SUPERVISOR_H
+
+// Off the Arduino (in tools/safety_test.cpp) there's no Arduino.h.
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include <stdint.h>
+
+// Tasks that must check in before the watchdog is petted.  Each is a bit.
+#define SAFETY_TASK_LOOP		0x01	// main loop is running
+#define SAFETY_TASK_SAMPLE		0x02	// input is being sampled
+#define SAFETY_TASK_ALL			(SAFETY_TASK_LOOP | SAFETY_TASK_SAMPLE)
+
+// Default limits.  The process is running away if the output has been at
+// 100% for SAFETY_FULL_ON_TIME without the process value rising by
+// SAFETY_MIN_RISE.  An output is stuck on if, once the output has been at 0%
+// for SAFETY_OFF_HOLD_TIME (to let the process coast), the process value
+// still rises by SAFETY_MAX_RISE.
+#define SAFETY_FULL_ON_TIME		600		// [seconds]
+#define SAFETY_MIN_RISE			2.0		// [C]
+#define SAFETY_OFF_HOLD_TIME	300		// [seconds]
+#define SAFETY_MAX_RISE			10.0	// [C]
+
+typedef enum							// reasons for an alarm
+{
+	SAFETY_ALARM_NONE = 0,				// All is well!
+	SAFETY_ALARM_NO_RISE,				// full output, but PV isn't rising
+	SAFETY_ALARM_RISE_WHEN_OFF,			// no output, but PV is rising
+} safetyAlarm_t;
+
+class SafetySupervisor
+{
+public:
+	// Initialize the class.
+	SafetySupervisor();
+
+	// Start the hardware watchdog.
+	void Begin();
+
+	// Report that a task has made progress.
+	void CheckIn(uint8_t task) { progress |= task; }
+
+	// Pet the watchdog if every task has made progress.
+	void Service();
+
+	// Check the process for runaway.  Call once per sample period.
+	safetyAlarm_t Check(double processValue, double output,
+		unsigned long now);
+
+	// Set the limits used by Check.
+	void SetLimits(unsigned int fullOnSec, double minRise,
+		unsigned int offHoldSec, double maxRise);
+
+	// Set direct (false) or reverse (true) acting.
+	void SetReverse(bool reverse);
+
+	// Find the latched alarm.
+	safetyAlarm_t GetAlarm();
+
+	// Latch an alarm (such as one remembered from before a reset).
+	void SetAlarm(safetyAlarm_t newAlarm);
+
+	// Clear the latched alarm & restart the checks.
+	void ClearAlarm();
+
+private:
+	volatile uint8_t progress;			// tasks that have checked in
+	safetyAlarm_t alarm;				// latched alarm
+	bool reverseActing;					// true if output makes PV fall
+
+	unsigned long fullOnTime;			// limits [milliseconds], [C]
+	double minRise;
+	unsigned long offHoldTime;
+	double maxRise;
+
+	bool fullOnTiming;					// output is at 100%
+	unsigned long fullOnStart;			// when PV was last seen rising
+	double fullOnValue;					// PV at that time [C]
+
+	bool offTiming;						// output is at 0%
+	bool offWatching;					// done coasting; watching for rise
+	unsigned long offStart;				// when output went to 0%
+	double offValue;					// lowest PV since coasting [C]
+};
+
+#endif
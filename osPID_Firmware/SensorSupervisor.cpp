@@ -0,0 +1,328 @@
+/******************************************************************************
+ *
+ *	Filename:		SensorSupervisor.cpp
+ *
+ *	Description:	Watches both sensors on the input card, and decides where
+ *					the process value comes from.  Every sample, both sensors
+ *					are read and checked for:
+ *
+ *					-	faults reported by the thermocouple chip
+ *					-	a thermistor reading stuck at either ADC rail (open
+ *						or shorted thermistor)
+ *					-	a change too fast to be real
+ *
+ *					Since every sample is checked, a fault is caught in the
+ *					same sample it first shows up in.
+ *
+ *					Normally the process value comes from the sensor selected
+ *					on the input card (the primary).  If it fails and failover
+ *					is enabled, the other sensor (the backup) takes over.  To
+ *					keep the PID from seeing a bump, the difference between
+ *					the two sensors is tracked while both are good, and added
+ *					to the backup's readings.  A sensor that has failed
+ *					isn't trusted again until it has given
+ *					SENSOR_RECOVERY_SAMPLES good readings in a row, each
+ *					consistent with the one before; then a primary takes
+ *					over again.  If no sensor can be trusted, Read fails and
+ *					the caller should put the output in a safe state.
+ *
+ *****************************************************************************/
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "SensorSupervisor.h"
+
+/******************************************************************************
+ *
+ *	Function:		SensorSupervisor (Class Initializer)
+ *
+ *	Parameters:		card - the input card to watch
+ *
+ *****************************************************************************/
+
+SensorSupervisor::SensorSupervisor(InputCard *card)
+{
+	uint8_t i;
+
+	inputCard = card;
+	failover = true;					// default is to use the backup
+	maxRate = 5;						// default maximum is 5 C/sec
+	samplePeriod = 1000;				// default sample period is 1 second
+	primarySensor = card->GetSensorType();
+	activeSensor = primarySensor;
+	offset = 0;
+	offsetValid = false;
+	faultSeen = false;
+	lastFaultTime = 0;
+
+	for (i = 0; i < 2; i++)
+	{
+		health[i].valid = false;
+		health[i].lastTime = 0;
+		health[i].goodCount = 0;
+		health[i].recovering = false;
+		health[i].faultCount = 0;
+	}
+}
+
+void SensorSupervisor::SetFailover(bool enable)
+{
+	failover = enable;
+}
+
+bool SensorSupervisor::GetFailover()
+{
+	return failover;
+}
+
+void SensorSupervisor::SetMaxRate(double degPerSec)
+{
+	if (degPerSec > 0)
+	{
+		maxRate = degPerSec;
+	}
+}
+
+double SensorSupervisor::GetMaxRate()
+{
+	return maxRate;
+}
+
+void SensorSupervisor::SetSamplePeriod(unsigned long mSec)
+{
+	samplePeriod = mSec;
+}
+
+inputSensor_t SensorSupervisor::GetActiveSensor()
+{
+	return activeSensor;
+}
+
+/******************************************************************************
+ *
+ *	Function:		GetReading
+ *
+ *	Description:	Hands back what a sensor read during the last call to
+ *					Read.  The backup's reading is corrected by the measured
+ *					offset, the same way Read does it, so readings from both
+ *					sensors can be compared or combined.
+ *
+ *	Parameters:		sensor - which sensor
+ *					temp - the reading [C]
+ *
+ *	Return Value:	true if the reading was believable
+ *
+ *****************************************************************************/
+
+bool SensorSupervisor::GetReading(inputSensor_t sensor, double *temp)
+{
+	if (!health[sensor].valid || health[sensor].recovering)
+	{
+		return false;
+	}
+
+	*temp = health[sensor].lastValue;
+	if (sensor != primarySensor)
+	{
+		*temp += offset;
+	}
+
+	return true;
+}
+
+bool SensorSupervisor::GetRawReading(inputSensor_t sensor, double *temp)
+{
+	if (!health[sensor].valid || health[sensor].recovering)
+	{
+		return false;
+	}
+
+	*temp = health[sensor].lastValue;
+	return true;
+}
+
+uint16_t SensorSupervisor::GetFaultCount(inputSensor_t sensor)
+{
+	return health[sensor].faultCount;
+}
+
+bool SensorSupervisor::GetTimeSinceFault(unsigned long *mSec)
+{
+	if (!faultSeen)
+	{
+		return false;
+	}
+
+	*mSec = millis() - lastFaultTime;
+	return true;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Check
+ *
+ *	Description:	Reads a sensor and decides whether to believe it.  After
+ *					a fault, the next reading is not rate-checked (there's
+ *					nothing good to compare it to), so it's not believed
+ *					either:  it only starts a run of readings that have to
+ *					agree with each other.  The sensor is believed again once
+ *					the run reaches SENSOR_RECOVERY_SAMPLES.  A reading that
+ *					jumped to a wrong value and stayed there can't get in
+ *					on the strength of one reading.
+ *
+ *	Parameters:		sensor - which sensor to read
+ *					temp - the reading [C]
+ *
+ *	Return Value:	true if the reading is believable
+ *
+ *****************************************************************************/
+
+bool SensorSupervisor::Check(inputSensor_t sensor, double *temp)
+{
+	sensorHealth_t *h = &health[sensor];
+	double maxStep;						// biggest believable change [C]
+	bool good;
+
+	good = (inputCard->ReadSensor(sensor, temp) == INPUT_RESULT_OK);
+	if (good)
+	{
+		h->lastTime = micros();
+	}
+
+	// If there's a previous reading, check the rate of change.
+	if (good && h->valid)
+	{
+		maxStep = maxRate * samplePeriod / 1000.0 + SENSOR_NOISE_ALLOWANCE;
+		good = (fabs(*temp - h->lastValue) <= maxStep);
+	}
+
+	if (good)
+	{
+		h->lastValue = *temp;
+		h->valid = true;
+		if (h->goodCount < 255)
+		{
+			h->goodCount++;
+		}
+
+		// Compare the readings after a fault with each other, but don't
+		// believe them until there are enough.
+		if (h->recovering)
+		{
+			if (h->goodCount >= SENSOR_RECOVERY_SAMPLES)
+			{
+				h->recovering = false;
+			}
+			else
+			{
+				good = false;
+			}
+		}
+	}
+	else
+	{
+		h->valid = false;
+		h->goodCount = 0;
+		h->recovering = true;
+		h->faultCount++;
+		faultSeen = true;
+		lastFaultTime = millis();
+	}
+
+	return good;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Read
+ *
+ *	Description:	Reads both sensors, and picks the process value.  Call
+ *					this once per sample period.  The sample's time is when
+ *					the sensor it came from was read, so the controller can
+ *					use the real time between samples:  anything that holds
+ *					up the main loop (LCD, serial port, EEPROM writes) moves
+ *					the reading, not just the schedule.
+ *
+ *	Parameters:		sample - the process value [C] (or NAN if no sensor can
+ *						be trusted), the result & the capture time
+ *
+ *	Return Value:	INPUT_RESULT_OK if the value can be used, else
+ *					INPUT_RESULT_FAIL
+ *
+ *****************************************************************************/
+
+inputResult_t SensorSupervisor::Read(inputSample_t *sample)
+{
+	inputSensor_t primary;				// sensor selected on the input card
+	inputSensor_t backup;				// the other one
+	double primaryTemp;					// readings [C]
+	double backupTemp;
+	bool primaryGood;					// whether to believe the readings
+	bool backupGood;
+
+	primary = inputCard->GetSensorType();
+	backup = (primary == INPUT_SENSOR_THERMOCOUPLE) ?
+		INPUT_SENSOR_THERMISTOR : INPUT_SENSOR_THERMOCOUPLE;
+
+	// If a different sensor was selected, start using it right away.
+	if (primary != primarySensor)
+	{
+		primarySensor = primary;
+		activeSensor = primary;
+		offsetValid = false;
+	}
+
+	primaryGood = Check(primary, &primaryTemp);
+	backupGood = Check(backup, &backupTemp);
+
+	// While both are good, track the difference between them so a handover
+	// doesn't bump the process value.
+	if (primaryGood && backupGood)
+	{
+		if (offsetValid)
+		{
+			offset += (primaryTemp - backupTemp - offset) / 8;
+		}
+		else
+		{
+			offset = primaryTemp - backupTemp;
+			offsetValid = true;
+		}
+	}
+
+	// If we're on the backup, only go back once the primary has proven
+	// itself.  If the backup fails meanwhile, take whatever we can get.
+	if (activeSensor != primary)
+	{
+		if ((health[primary].goodCount >= SENSOR_RECOVERY_SAMPLES) ||
+			(primaryGood && !backupGood) || !failover)
+		{
+			activeSensor = primary;
+		}
+	}
+	else if (!primaryGood && backupGood && failover)
+	{
+		activeSensor = backup;
+	}
+
+	// Hand back the process value.
+	if ((activeSensor == primary) && primaryGood)
+	{
+		sample->value = primaryTemp;
+		sample->status = INPUT_RESULT_OK;
+	}
+	else if ((activeSensor == backup) && backupGood)
+	{
+		sample->value = backupTemp + offset;
+		sample->status = INPUT_RESULT_OK;
+	}
+	else
+	{
+		sample->value = NAN;
+		sample->status = INPUT_RESULT_FAIL;
+		health[activeSensor].lastTime = micros();
+	}
+	sample->time = health[activeSensor].lastTime;
+
+	return sample->status;
+}
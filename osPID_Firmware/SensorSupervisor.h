@@ -0,0 +1,87 @@
+#ifndef SENSOR_SUPERVISOR_H
+#define SENSOR_SUPERVISOR_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "InputCard.h"
+
+// Number of good readings in a row before a sensor that failed is trusted
+// again (and a failed primary takes over from the backup).
+#define SENSOR_RECOVERY_SAMPLES	5
+
+// A change bigger than (maximum rate * sample period) plus this much is
+// implausible.  It keeps sensor noise from tripping the rate check.
+#define SENSOR_NOISE_ALLOWANCE	1.0		// [C]
+
+typedef struct							// health of one sensor
+{
+	double lastValue;					// last plausible reading [C]
+	unsigned long lastTime;				// micros() when it was read
+	bool valid;							// lastValue can be compared against
+	uint8_t goodCount;					// plausible readings in a row
+	bool recovering;					// failed, and not yet trusted again
+	uint16_t faultCount;				// faults since power-up
+} sensorHealth_t;
+
+class SensorSupervisor
+{
+public:
+	// Initialize the class.
+	SensorSupervisor(InputCard *card);
+
+	// Read both sensors and pick the process value, with the time it was
+	// read.
+	inputResult_t Read(inputSample_t *sample);
+
+	// Enable or disable switching to the other sensor on failure.
+	void SetFailover(bool enable);
+
+	// Find if switching to the other sensor is enabled.
+	bool GetFailover();
+
+	// Set the fastest believable rate of change [C per second].
+	void SetMaxRate(double degPerSec);
+
+	// Fetch the fastest believable rate of change [C per second].
+	double GetMaxRate();
+
+	// Set how often Read is called [milliseconds].
+	void SetSamplePeriod(unsigned long mSec);
+
+	// Find which sensor the process value is coming from.
+	inputSensor_t GetActiveSensor();
+
+	// Fetch a sensor's reading from the last Read, on the same scale as the
+	// primary sensor.  Returns false if the reading wasn't believable.
+	bool GetReading(inputSensor_t sensor, double *temp);
+
+	// Fetch a sensor's own reading from the last Read, without moving it to
+	// the primary sensor's scale (for sensors that measure different
+	// things).  Returns false if the reading wasn't believable.
+	bool GetRawReading(inputSensor_t sensor, double *temp);
+
+	// Fetch the number of faults seen on a sensor.
+	uint16_t GetFaultCount(inputSensor_t sensor);
+
+	// Fetch the time since the last fault on either sensor [milliseconds].
+	// Returns false if there hasn't been one.
+	bool GetTimeSinceFault(unsigned long *mSec);
+
+private:
+	InputCard *inputCard;				// card the sensors are on
+	bool failover;						// true to use the backup sensor
+	double maxRate;						// fastest believable rate [C/sec]
+	unsigned long samplePeriod;			// time between reads [milliseconds]
+	inputSensor_t primarySensor;		// sensor selected on the card
+	inputSensor_t activeSensor;			// sensor the PV comes from
+	double offset;						// primary minus backup reading [C]
+	bool offsetValid;					// offset has been measured
+	bool faultSeen;						// there's been a fault since power-up
+	unsigned long lastFaultTime;		// millis() at the last fault
+	sensorHealth_t health[2];			// indexed by inputSensor_t
+
+	// Read a sensor and update its health.
+	bool Check(inputSensor_t sensor, double *temp);
+};
+
+#endif
@@ -0,0 +1,204 @@
+/******************************************************************************
+ *
+ *	Filename:		SetpointRamp.cpp
+ *
+ *	Description:	Stands between the setpoint and the controller, and moves
+ *					a working setpoint toward it no faster than the ramp
+ *					rate, so a new setpoint doesn't hit the process (or the
+ *					ware in it) as a step.
+ *
+ *					With an acceleration set, the ramp rate itself builds up
+ *					and dies away gradually:  the working setpoint follows an
+ *					S-curve, with no sudden change of slope at either end of
+ *					the ramp.  It starts braking when the distance left is
+ *					what it needs to stop, so it arrives without
+ *					overshooting.
+ *
+ *					Update does the same few fixed-point operations every
+ *					call, so it takes constant time and no floating point.
+ *
+ *****************************************************************************/
+
+#include <stdint.h>
+#include "SetpointRamp.h"
+
+/******************************************************************************
+ *
+ *	Function:		SetpointRamp (Class Initializer)
+ *
+ *****************************************************************************/
+
+SetpointRamp::SetpointRamp()
+{
+	rate = 0;
+	acceleration = 0;
+	SetSamplePeriod(1000);
+	position = 0;
+	speed = 0;
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetRate
+ *
+ *	Description:	Sets the fastest the working setpoint may move.  If it's
+ *					moving faster when this is lowered, it slows down at the
+ *					acceleration limit.
+ *
+ *	Parameters:		rate - ramp rate [C/min, fixed point], or 0 for none
+ *
+ *	Return Value:	RAMP_RESULT_OK if it was set
+ *					RAMP_RESULT_INVALID if it's negative or over
+ *						RAMP_MAX_RATE
+ *
+ *****************************************************************************/
+
+rampResult_t SetpointRamp::SetRate(fixed_t rate)
+{
+	if ((rate < 0) || (rate > FIXED_FROM_INT(RAMP_MAX_RATE)))
+	{
+		return RAMP_RESULT_INVALID;
+	}
+
+	this->rate = rate;
+	return RAMP_RESULT_OK;
+}
+
+fixed_t SetpointRamp::GetRate()
+{
+	return rate;
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetAcceleration
+ *
+ *	Description:	Sets how fast the ramp rate may change.  The working
+ *					setpoint takes rate / acceleration minutes to get up to
+ *					full rate, and as long again to stop.
+ *
+ *	Parameters:		acceleration - [C/min^2, fixed point], or 0 for none
+ *
+ *	Return Value:	RAMP_RESULT_OK if it was set
+ *					RAMP_RESULT_INVALID if it's negative or over
+ *						RAMP_MAX_ACCELERATION
+ *
+ *****************************************************************************/
+
+rampResult_t SetpointRamp::SetAcceleration(fixed_t acceleration)
+{
+	if ((acceleration < 0) ||
+		(acceleration > FIXED_FROM_INT(RAMP_MAX_ACCELERATION)))
+	{
+		return RAMP_RESULT_INVALID;
+	}
+
+	this->acceleration = acceleration;
+	return RAMP_RESULT_OK;
+}
+
+fixed_t SetpointRamp::GetAcceleration()
+{
+	return acceleration;
+}
+
+void SetpointRamp::SetSamplePeriod(unsigned long period)
+{
+	tick = (uint32_t)(((uint64_t)period << 32) / 60000);
+}
+
+void SetpointRamp::Reset(fixed_t setpoint)
+{
+	position = setpoint;
+	speed = 0;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Update
+ *
+ *	Description:	Moves the working setpoint one sample toward the
+ *					setpoint.  Without an acceleration limit, it moves at the
+ *					ramp rate.  With one, its speed toward the setpoint goes
+ *					up (to the ramp rate) or down by one sample's worth of
+ *					acceleration:  down once the distance left, after this
+ *					sample's move, is no more than its braking distance
+ *					(speed^2 / 2 acceleration).  If the setpoint changes
+ *					behind it, it brakes, turns & comes back the same way.
+ *					It stops dead on the setpoint when one sample's move
+ *					would reach it.
+ *
+ *	Parameters:		setpoint - where to go [C, fixed point]
+ *
+ *	Return Value:	the working setpoint [C, fixed point]
+ *
+ *****************************************************************************/
+
+fixed_t SetpointRamp::Update(fixed_t setpoint)
+{
+	fixed_t distance;					// how far to go [C]
+	fixed_t toward;						// speed toward the setpoint [C/min]
+	fixed_t step;						// this sample's move [C]
+	fixed_t change;						// this sample's speed change [C/min]
+	bool down;							// true if the setpoint is below
+
+	if (rate == 0)
+	{
+		Reset(setpoint);
+		return position;
+	}
+
+	down = (setpoint < position);
+	distance = down ? (position - setpoint) : (setpoint - position);
+	toward = down ? -speed : speed;
+
+	if (acceleration == 0)
+	{
+		toward = rate;
+	}
+	else
+	{
+		change = PerSample(acceleration);
+		step = (toward > 0) ? PerSample(toward) : 0;
+		if ((toward > rate) || ((toward > 0) &&
+			((int64_t)toward * toward >=
+			2 * (int64_t)acceleration * (distance - step))))
+		{
+			toward -= change;
+		}
+		else
+		{
+			toward += change;
+			if (toward > rate)
+			{
+				toward = rate;
+			}
+		}
+	}
+
+	step = PerSample(toward);
+	if ((toward >= 0) && (step >= distance))
+	{
+		Reset(setpoint);
+		return position;
+	}
+
+	position += down ? -step : step;
+	speed = down ? -toward : toward;
+	return position;
+}
+
+fixed_t SetpointRamp::GetSetpoint()
+{
+	return position;
+}
+
+bool SetpointRamp::IsRamping()
+{
+	return speed != 0;
+}
+
+fixed_t SetpointRamp::PerSample(fixed_t perMinute)
+{
+	return (fixed_t)(((int64_t)perMinute * tick) >> 32);
+}
@@ -0,0 +1,69 @@
+#ifndef SETPOINT_RAMP_H
+#define SETPOINT_RAMP_H
+
+#include <stdint.h>
+#include "FixedPoint.h"
+
+// Limits on the settings.  They keep the braking sums in Update inside 64
+// bits.
+#define RAMP_MAX_RATE			1000	// [C/min]
+#define RAMP_MAX_ACCELERATION	10000	// [C/min^2]
+
+typedef enum							// status from functions
+{
+	RAMP_RESULT_OK,						// All is well!
+	RAMP_RESULT_FAIL,					// It's the hardware's fault.
+	RAMP_RESULT_INVALID,				// It's your fault.
+	RAMP_RESULT_NOT_IMPLEMENTED,		// It's my fault.
+} rampResult_t;
+
+class SetpointRamp
+{
+public:
+	// Initialize the class.  The ramp starts off:  the working setpoint
+	// follows the setpoint straight away.
+	SetpointRamp();
+
+	// Set the fastest the working setpoint may move [C/min, fixed point],
+	// or 0 for no ramp.
+	rampResult_t SetRate(fixed_t rate);
+
+	// Fetch the ramp rate [C/min, fixed point].
+	fixed_t GetRate();
+
+	// Set how fast the ramp rate may change [C/min^2, fixed point], or 0 to
+	// start & stop at full rate.
+	rampResult_t SetAcceleration(fixed_t acceleration);
+
+	// Fetch the acceleration [C/min^2, fixed point].
+	fixed_t GetAcceleration();
+
+	// Set the time between calls to Update [mSec].
+	void SetSamplePeriod(unsigned long period);
+
+	// Put the working setpoint here, standing still [C, fixed point].
+	void Reset(fixed_t setpoint);
+
+	// Move the working setpoint one sample toward the setpoint, and return
+	// it [C, fixed point].  Call once per sample.
+	fixed_t Update(fixed_t setpoint);
+
+	// Fetch the working setpoint [C, fixed point].
+	fixed_t GetSetpoint();
+
+	// True while the working setpoint is on its way.
+	bool IsRamping();
+
+private:
+	fixed_t rate;						// ramp rate limit [C/min]
+	fixed_t acceleration;				// ramp rate change limit [C/min^2]
+	uint32_t tick;						// sample period [minutes, 0.32
+										// fixed point]
+	fixed_t position;					// working setpoint [C]
+	fixed_t speed;						// its rate of change [C/min]
+
+	// Scale a per-minute amount to one sample's worth.
+	fixed_t PerSample(fixed_t perMinute);
+};
+
+#endif
@@ -0,0 +1,251 @@
+/******************************************************************************
+ *
+ *	Filename:		SmithPredictor.cpp
+ *
+ *	Description:	A Smith predictor lets the PID control a process with a
+ *					long dead time (transport delay) without detuning it.  It
+ *					runs a first-order model of the process alongside the real
+ *					thing.  The PID is fed the measured process value, plus
+ *					what the model says the process will do once the dead time
+ *					has passed, minus what the model says the process is doing
+ *					now:
+ *
+ *						feedback = PV + model(t) - model(t - deadTime)
+ *
+ *					If the model is right, the PID sees the process as if it
+ *					had no dead time, and can be tuned much tighter.  The model
+ *					runs in fixed point, and past model outputs are kept in a
+ *					ring buffer whose size is fixed at compile time.
+ *
+ *****************************************************************************/
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include <stdint.h>
+#include <math.h>
+#include "SmithPredictor.h"
+
+/******************************************************************************
+ *
+ *	Function:		SmithPredictor (Class Initializer)
+ *
+ *	Description:	Sets up the predictor with a model that has no dead time,
+ *					which makes it invisible to the PID until a real model is
+ *					loaded.
+ *
+ *****************************************************************************/
+
+SmithPredictor::SmithPredictor()
+{
+	modelGain = 1;						// default gain is 1 C per %
+	modelTau = 60;						// default time constant is 1 minute
+	modelDeadTime = 0;					// default is no dead time
+	samplePeriod = 1000;				// default sample period is 1 second
+
+	CalcCoeffs();
+	Reset(0);
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetModel
+ *
+ *	Description:	Sets the first-order-plus-dead-time model of the process.
+ *					These are normally found with a step test.  A dead time
+ *					longer than the delay line can hold (GetMaxDeadTime) is
+ *					refused, rather than compensated for only in part.
+ *
+ *	Parameters:		gain - change in PV per change in output [C per %]
+ *					timeConstant - time for PV to reach 63% of its final
+ *						value, not counting dead time [seconds]
+ *					deadTime - time before PV starts to respond [seconds]
+ *
+ *	Return Value:	SMITH_RESULT_OK if the model was set
+ *					SMITH_RESULT_INVALID if it makes no sense, or the dead
+ *						time is too long
+ *
+ *****************************************************************************/
+
+smithResult_t SmithPredictor::SetModel(double gain, double timeConstant,
+	double deadTime)
+{
+	// Start as a pessimist :(
+	smithResult_t result = SMITH_RESULT_INVALID;
+
+	// If the model makes sense, and its dead time fits in the delay line...
+	if ((gain != 0) && (timeConstant >= 0) && (deadTime >= 0) &&
+		(deadTime * 1000.0 / samplePeriod + 0.5 < SMITH_DELAY_LENGTH))
+	{
+		// Remember the model.
+		modelGain = gain;
+		modelTau = timeConstant;
+		modelDeadTime = deadTime;
+
+		// Update the coefficients used at run time.
+		CalcCoeffs();
+
+		// If we got here, we're ok :)
+		result = SMITH_RESULT_OK;
+	}
+
+	// Return the status.
+	return result;
+}
+
+double SmithPredictor::GetModelGain()
+{
+	return modelGain;
+}
+
+double SmithPredictor::GetModelTimeConstant()
+{
+	return modelTau;
+}
+
+double SmithPredictor::GetModelDeadTime()
+{
+	return modelDeadTime;
+}
+
+double SmithPredictor::GetMaxDeadTime()
+{
+	return (SMITH_DELAY_LENGTH - 1) * samplePeriod / 1000.0;
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetSamplePeriod
+ *
+ *	Description:	Sets the time between calls to Predict & Update.  The
+ *					model's coefficients depend on it.
+ *
+ *	Parameters:		mSec - sample period [milliseconds]
+ *
+ *****************************************************************************/
+
+void SmithPredictor::SetSamplePeriod(unsigned long mSec)
+{
+	if (mSec > 0)
+	{
+		samplePeriod = mSec;
+		CalcCoeffs();
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		CalcCoeffs
+ *
+ *	Description:	Converts the model to the fixed-point coefficients used by
+ *					Update.  This uses floating point, but only runs when the
+ *					model or sample period changes.
+ *
+ *****************************************************************************/
+
+void SmithPredictor::CalcCoeffs()
+{
+	double samples;						// dead time [samples]
+	double period;						// sample period [seconds]
+
+	period = samplePeriod / 1000.0;
+
+	// Each sample, the model moves this fraction of the way to its target.
+	if (modelTau > 0)
+	{
+		alpha = FixedFromDouble(1.0 - exp(-period / modelTau));
+	}
+	else
+	{
+		alpha = FIXED_ONE;
+	}
+
+	gain = FixedFromDouble(modelGain);
+
+	// Round the dead time to whole samples.  SetModel only takes dead times
+	// that fit, so this clip only matters if the sample period shrinks later.
+	samples = modelDeadTime / period + 0.5;
+	if (samples > (SMITH_DELAY_LENGTH - 1))
+	{
+		samples = SMITH_DELAY_LENGTH - 1;
+	}
+	delaySamples = (uint8_t)samples;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Reset
+ *
+ *	Description:	Puts the model at steady state, as if the output had been
+ *					held at the given value forever.  Call this whenever the
+ *					model changes or the predictor is switched on, so the PID
+ *					doesn't see a bump.
+ *
+ *	Parameters:		output - current controller output [%]
+ *
+ *****************************************************************************/
+
+void SmithPredictor::Reset(double output)
+{
+	uint8_t i;
+
+	modelOutput = FixedMul(gain, FixedFromDouble(output));
+
+	for (i = 0; i < SMITH_DELAY_LENGTH; i++)
+	{
+		delayLine[i] = modelOutput;
+	}
+
+	head = 0;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Predict
+ *
+ *	Description:	Corrects a process value for dead time.  The difference
+ *					between the model's current output and its output one dead
+ *					time ago is what the process is about to do, but hasn't
+ *					shown yet.
+ *
+ *	Parameters:		processValue - measured process value [C]
+ *
+ *	Return Value:	the process value the PID should see [C]
+ *
+ *****************************************************************************/
+
+double SmithPredictor::Predict(double processValue)
+{
+	fixed_t delayed;					// model output one dead time ago
+
+	// The newest entry is just behind the head.
+	delayed = delayLine[(uint8_t)(head - 1 - delaySamples) &
+		(SMITH_DELAY_LENGTH - 1)];
+
+	return processValue + FixedToDouble(modelOutput - delayed);
+}
+
+/******************************************************************************
+ *
+ *	Function:		Update
+ *
+ *	Description:	Runs the first-order model for one sample with the output
+ *					the PID just chose, and saves the result in the delay
+ *					line.
+ *
+ *	Parameters:		output - controller output [%]
+ *
+ *****************************************************************************/
+
+void SmithPredictor::Update(double output)
+{
+	fixed_t target;						// where the model is headed [C]
+
+	// First-order lag:  y += alpha * (K * u - y)
+	target = FixedMul(gain, FixedFromDouble(output));
+	modelOutput += FixedMul(alpha, target - modelOutput);
+
+	// Save the result in the delay line.
+	delayLine[head] = modelOutput;
+	head = (head + 1) & (SMITH_DELAY_LENGTH - 1);
+}
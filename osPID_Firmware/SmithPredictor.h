@@ -0,0 +1,79 @@
+#ifndef SMITH_PREDICTOR_H
+#define SMITH_PREDICTOR_H
+
+// Off the Arduino (in tools/smith_sim.cpp) there's no Arduino.h.
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include <stdint.h>
+#include "FixedPoint.h"
+
+// Length of the model's delay line [samples].  The longest dead time that can
+// be compensated is (SMITH_DELAY_LENGTH - 1) sample periods.  Each sample
+// costs 4 bytes of RAM.  Must be a power of 2.
+#define SMITH_DELAY_LENGTH	32
+
+#if (SMITH_DELAY_LENGTH & (SMITH_DELAY_LENGTH - 1)) != 0
+#error "SMITH_DELAY_LENGTH must be a power of 2"
+#endif
+
+typedef enum							// status from functions
+{
+	SMITH_RESULT_OK,					// All is well!
+	SMITH_RESULT_FAIL,					// It's the hardware's fault.
+	SMITH_RESULT_INVALID,				// It's your fault.
+	SMITH_RESULT_NOT_IMPLEMENTED,		// It's my fault.
+} smithResult_t;
+
+class SmithPredictor
+{
+public:
+	// Initialize the class.
+	SmithPredictor();
+
+	// Set the first-order-plus-dead-time process model.
+	smithResult_t SetModel(double gain, double timeConstant, double deadTime);
+
+	// Fetch the model's gain [C per % output].
+	double GetModelGain();
+
+	// Fetch the model's time constant [seconds].
+	double GetModelTimeConstant();
+
+	// Fetch the model's dead time [seconds].
+	double GetModelDeadTime();
+
+	// Fetch the longest dead time SetModel takes at this sample period
+	// [seconds].
+	double GetMaxDeadTime();
+
+	// Set how often Predict and Update are called [milliseconds].
+	void SetSamplePeriod(unsigned long mSec);
+
+	// Put the model at steady state for a given output.
+	void Reset(double output);
+
+	// Find the dead-time compensated process value to feed the PID.
+	double Predict(double processValue);
+
+	// Advance the model by one sample period.
+	void Update(double output);
+
+private:
+	double modelGain;					// process gain [C per % output]
+	double modelTau;					// process time constant [seconds]
+	double modelDeadTime;				// process dead time [seconds]
+	unsigned long samplePeriod;			// time between updates [milliseconds]
+
+	fixed_t gain;						// process gain (fixed point)
+	fixed_t alpha;						// model filter coefficient (fixed point)
+	uint8_t delaySamples;				// dead time [samples]
+	uint8_t head;						// next free slot in the delay line
+	fixed_t modelOutput;				// model output without dead time [C]
+	fixed_t delayLine[SMITH_DELAY_LENGTH];	// past model outputs [C]
+
+	// Recalculate the fixed-point coefficients from the model.
+	void CalcCoeffs();
+};
+
+#endif
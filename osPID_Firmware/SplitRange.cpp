@@ -0,0 +1,142 @@
+/******************************************************************************
+ *
+ *	Filename:		SplitRange.cpp
+ *
+ *	Description:	Splits one controller output between a heater and a
+ *					cooler (a fan or a compressor), so one PID can drive a
+ *					process both ways.  The controller's output runs from
+ *					-100% (full cooling) to +100% (full heat); around 0%
+ *					there's a deadband where neither runs, so the two don't
+ *					fight, or take turns, near the setpoint.
+ *
+ *					Past the deadband, each side's output rises in a
+ *					straight line to its gain (times 100%) at full
+ *					controller output.  A side that's stronger than the
+ *					other can have its gain cut, so the PID sees about the
+ *					same process gain either way.
+ *
+ *					Map does the same two multiplies & clamps every call,
+ *					so it takes constant time.
+ *
+ *****************************************************************************/
+
+#include <stdint.h>
+#include "SplitRange.h"
+
+/******************************************************************************
+ *
+ *	Function:		SplitRange (Class Initializer)
+ *
+ *****************************************************************************/
+
+SplitRange::SplitRange()
+{
+	halfDeadband = SPLIT_DEADBAND / 2;
+	heatGain = SPLIT_HEAT_GAIN;
+	coolGain = SPLIT_COOL_GAIN;
+	Scale();
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetDeadband
+ *
+ *	Description:	Sets the band of controller output, centered on 0%, in
+ *					which both sides are off.
+ *
+ *	Parameters:		deadband - width of the band [% of controller output]
+ *
+ *	Return Value:	SPLIT_RESULT_OK if it was set
+ *					SPLIT_RESULT_INVALID if it's negative or over
+ *						SPLIT_MAX_DEADBAND
+ *
+ *****************************************************************************/
+
+splitResult_t SplitRange::SetDeadband(double deadband)
+{
+	if (!((deadband >= 0) && (deadband <= SPLIT_MAX_DEADBAND)))
+	{
+		return SPLIT_RESULT_INVALID;
+	}
+
+	halfDeadband = deadband / 2;
+	Scale();
+	return SPLIT_RESULT_OK;
+}
+
+double SplitRange::GetDeadband()
+{
+	return halfDeadband * 2;
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetGains
+ *
+ *	Description:	Sets each side's gain.  At a gain of 1, a side goes from
+ *					0% at the edge of the deadband to 100% at full
+ *					controller output; at 0.5, it only gets to 50%; at 2, it
+ *					gets to 100% halfway there.
+ *
+ *	Parameters:		heatGain - heat side's gain
+ *					coolGain - cool side's gain
+ *
+ *	Return Value:	SPLIT_RESULT_OK if they were set
+ *					SPLIT_RESULT_INVALID if either is negative or over
+ *						SPLIT_MAX_GAIN
+ *
+ *****************************************************************************/
+
+splitResult_t SplitRange::SetGains(double heatGain, double coolGain)
+{
+	if (!((heatGain >= 0) && (heatGain <= SPLIT_MAX_GAIN) &&
+		(coolGain >= 0) && (coolGain <= SPLIT_MAX_GAIN)))
+	{
+		return SPLIT_RESULT_INVALID;
+	}
+
+	this->heatGain = heatGain;
+	this->coolGain = coolGain;
+	Scale();
+	return SPLIT_RESULT_OK;
+}
+
+double SplitRange::GetHeatGain()
+{
+	return heatGain;
+}
+
+double SplitRange::GetCoolGain()
+{
+	return coolGain;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Map
+ *
+ *	Description:	Splits a controller output into heat & cool outputs.
+ *					Above the deadband only the heat side runs, below it
+ *					only the cool side, and inside it neither.
+ *
+ *	Parameters:		output - controller output, -100 to 100 [%]
+ *					heat - heat side's output, 0 to 100 [%]
+ *					cool - cool side's output, 0 to 100 [%]
+ *
+ *****************************************************************************/
+
+void SplitRange::Map(double output, double *heat, double *cool)
+{
+	*heat = heatSlope * (output - halfDeadband);
+	*cool = coolSlope * (-output - halfDeadband);
+
+	*heat = (*heat < 0) ? 0 : ((*heat > 100) ? 100 : *heat);
+	*cool = (*cool < 0) ? 0 : ((*cool > 100) ? 100 : *cool);
+}
+
+// Each side covers what's left of the controller's range past the deadband.
+void SplitRange::Scale()
+{
+	heatSlope = heatGain * 100 / (100 - halfDeadband);
+	coolSlope = coolGain * 100 / (100 - halfDeadband);
+}
@@ -0,0 +1,59 @@
+#ifndef SPLIT_RANGE_H
+#define SPLIT_RANGE_H
+
+#include <stdint.h>
+
+// Defaults.  With no deadband and both gains at 1, +100% of controller
+// output is full heat and -100% is full cooling.
+#define SPLIT_DEADBAND		0.0			// [% of controller output]
+#define SPLIT_HEAT_GAIN		1.0
+#define SPLIT_COOL_GAIN		1.0
+
+// Limits on the settings.
+#define SPLIT_MAX_DEADBAND	50.0		// [% of controller output]
+#define SPLIT_MAX_GAIN		10.0
+
+typedef enum							// status from functions
+{
+	SPLIT_RESULT_OK,					// All is well!
+	SPLIT_RESULT_FAIL,					// It's the hardware's fault.
+	SPLIT_RESULT_INVALID,				// It's your fault.
+	SPLIT_RESULT_NOT_IMPLEMENTED,		// It's my fault.
+} splitResult_t;
+
+class SplitRange
+{
+public:
+	// Initialize the class.
+	SplitRange();
+
+	// Set the band around 0% of controller output where neither side runs
+	// [% of controller output].
+	splitResult_t SetDeadband(double deadband);
+
+	// Fetch the deadband [% of controller output].
+	double GetDeadband();
+
+	// Set each side's gain:  the share of its output it gets at full
+	// controller output.
+	splitResult_t SetGains(double heatGain, double coolGain);
+
+	// Fetch each side's gain.
+	double GetHeatGain();
+	double GetCoolGain();
+
+	// Split a controller output (-100 to 100%) into heat & cool outputs
+	// (each 0 to 100%).
+	void Map(double output, double *heat, double *cool);
+
+private:
+	double halfDeadband;				// half the deadband [%]
+	double heatGain;					// gains, as set
+	double coolGain;
+	double heatSlope;					// output % per controller % past
+	double coolSlope;					// the deadband
+
+	void Scale();						// Work out the slopes.
+};
+
+#endif
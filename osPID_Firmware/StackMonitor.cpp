@@ -0,0 +1,104 @@
+/******************************************************************************
+ *
+ *	Filename:		StackMonitor.cpp
+ *
+ *	Description:	Measures how much of the ATmega328P's 2 KB of RAM is left.
+ *					Before anything else runs at boot, every byte from the end
+ *					of the global variables (.data & .bss) to the top of RAM
+ *					is "painted" with STACK_CANARY.  The stack grows down
+ *					from the top of RAM and overwrites the paint as it goes,
+ *					so counting the untouched bytes from the bottom up gives
+ *					the stack's high-water mark.
+ *
+ *					The firmware doesn't use the heap (malloc), so the space
+ *					between the globals and the stack belongs to the stack
+ *					alone.
+ *
+ *****************************************************************************/
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "StackMonitor.h"
+
+// These are set up by the linker.
+extern uint8_t _end;					// end of the global variables
+extern uint8_t __stack;					// top of RAM
+
+// Set by malloc when the heap is used.
+extern char *__brkval;
+
+void StackPaint(void) __attribute__ ((naked, used, section (".init1")));
+
+/******************************************************************************
+ *
+ *	Function:		StackPaint
+ *
+ *	Description:	Fills free RAM with STACK_CANARY.  This lives in the .init1
+ *					section, so it runs before the C runtime has set up the
+ *					zero register or copied the globals in.  That's why it's
+ *					written in assembly:  compiled C code can't be trusted to
+ *					run yet.  It's never called; the linker places it in the
+ *					startup code.
+ *
+ *****************************************************************************/
+
+void StackPaint(void)
+{
+	__asm volatile (
+		"	ldi r30, lo8(_end)		\n"
+		"	ldi r31, hi8(_end)		\n"
+		"	ldi r24, lo8(0xC5)		\n"	// STACK_CANARY
+		"	ldi r25, hi8(__stack)	\n"
+		"	rjmp 2f					\n"
+		"1:	st Z+, r24				\n"
+		"2:	cpi r30, lo8(__stack)	\n"
+		"	cpc r31, r25			\n"
+		"	brlo 1b					\n"
+		"	breq 1b					\n"
+		::);
+}
+
+/******************************************************************************
+ *
+ *	Function:		StackFree
+ *
+ *	Description:	Finds how far apart the top of the heap and the stack
+ *					pointer are right now.
+ *
+ *	Return Value:	free RAM [bytes]
+ *
+ *****************************************************************************/
+
+uint16_t StackFree(void)
+{
+	uint8_t *heapEnd;					// first byte past the heap
+
+	heapEnd = (__brkval != 0) ? (uint8_t *)__brkval : &_end;
+
+	return (uint16_t)((uint8_t *)SP - heapEnd);
+}
+
+/******************************************************************************
+ *
+ *	Function:		StackUnused
+ *
+ *	Description:	Counts the painted bytes just above the globals.  The stack
+ *					has never reached them.
+ *
+ *	Return Value:	RAM the stack has never used [bytes]
+ *
+ *****************************************************************************/
+
+uint16_t StackUnused(void)
+{
+	const uint8_t *p = &_end;
+	uint16_t count = 0;
+
+	while ((*p == STACK_CANARY) && (p <= &__stack))
+	{
+		p++;
+		count++;
+	}
+
+	return count;
+}
@@ -0,0 +1,16 @@
+#ifndef STACK_MONITOR_H
+#define STACK_MONITOR_H
+
+#include <stdint.h>
+
+// Free RAM is filled with this value at boot.  Any byte that no longer holds
+// it has been used by the stack (or heap) at some point.
+#define STACK_CANARY	0xC5
+
+// Fetch the number of bytes between the heap and the stack right now.
+uint16_t StackFree(void);
+
+// Fetch the number of free bytes the stack has never touched since boot.
+uint16_t StackUnused(void);
+
+#endif
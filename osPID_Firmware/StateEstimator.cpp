@@ -0,0 +1,273 @@
+/******************************************************************************
+ *
+ *	Filename:		StateEstimator.cpp
+ *
+ *	Description:	A Kalman filter that fuses the thermocouple and the
+ *					thermistor into one estimate of the temperature and its
+ *					rate of change.  The process is modelled as a temperature
+ *					moving at a rate that wanders slowly:
+ *
+ *						temperature += rate * period
+ *						rate        += (random)
+ *
+ *					Each sample, Predict moves the state ahead one period, and
+ *					Correct blends in each sensor's reading, trusting it in
+ *					proportion to how noisy that sensor is.  Since the two
+ *					sensors are independent, they're folded in one at a time,
+ *					so nothing bigger than a 1x1 matrix is ever inverted.
+ *
+ *					The rate comes out of the filter already smoothed, so the
+ *					PID can use it for its derivative instead of differencing
+ *					a noisy process value.
+ *
+ *					Everything that runs each sample is fixed point.  The
+ *					state is 16.16; the covariance uses more fractional bits
+ *					(ESTIMATOR_VAR_SHIFT), since the process noise is tiny.
+ *					Predict costs 3 multiplies, and each Correct costs one
+ *					divide and 5 multiplies (all 32x32 -> 64 bits).
+ *					tools/estimator_replay.cpp measures this on a PC, and
+ *					reports how much noise it removes from a logged run.
+ *
+ *****************************************************************************/
+
+#include <stdint.h>
+#include <math.h>
+#include "StateEstimator.h"
+
+// 1.0 in the covariance's fixed-point format.
+#define VAR_ONE		((int32_t)1 << ESTIMATOR_VAR_SHIFT)
+
+// Smallest measurement noise allowed [C^2].  Keeps the reciprocal in Correct
+// from overflowing.
+#define MIN_NOISE	0.01
+
+// Convert a double to the covariance's fixed-point format.
+static inline int32_t VarFromDouble(double value)
+{
+	return (int32_t)(value * (double)VAR_ONE + 0.5);
+}
+
+// Multiply any fixed-point number by a number in the covariance's format.
+// The result has the first number's format.
+static inline int32_t VarMul(int32_t a, int32_t b)
+{
+	return (int32_t)(((int64_t)a * (int64_t)b) >> ESTIMATOR_VAR_SHIFT);
+}
+
+/******************************************************************************
+ *
+ *	Function:		StateEstimator (Class Initializer)
+ *
+ *****************************************************************************/
+
+StateEstimator::StateEstimator()
+{
+	samplePeriod = 1000;				// default sample period is 1 second
+	processNoise = ESTIMATOR_PROCESS_NOISE;
+	noise[ESTIMATOR_SENSOR_THERMOCOUPLE] =
+		VarFromDouble(ESTIMATOR_TC_VARIANCE);
+	noise[ESTIMATOR_SENSOR_THERMISTOR] =
+		VarFromDouble(ESTIMATOR_THERM_VARIANCE);
+
+	CalcProcessNoise();
+	Reset();
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetNoise
+ *
+ *	Description:	Sets how noisy a sensor is.  The noisier a sensor, the
+ *					less its readings move the estimate.
+ *
+ *	Parameters:		sensor - ESTIMATOR_SENSOR_THERMOCOUPLE or
+ *						ESTIMATOR_SENSOR_THERMISTOR
+ *					variance - the sensor's noise [C^2], at least 0.01 and
+ *						less than ESTIMATOR_MAX_VAR
+ *
+ *	Return Value:	enumerated error code
+ *
+ *****************************************************************************/
+
+estimatorResult_t StateEstimator::SetNoise(uint8_t sensor, double variance)
+{
+	// Start as a pessimist :(
+	estimatorResult_t result = ESTIMATOR_RESULT_INVALID;
+
+	// If the sensor exists and the variance makes sense...
+	if ((sensor < ESTIMATOR_SENSORS) && (variance >= MIN_NOISE) &&
+		(variance < ESTIMATOR_MAX_VAR))
+	{
+		noise[sensor] = VarFromDouble(variance);
+
+		// If we got here, we're ok :)
+		result = ESTIMATOR_RESULT_OK;
+	}
+
+	// Return the status.
+	return result;
+}
+
+double StateEstimator::GetNoise(uint8_t sensor)
+{
+	return (double)noise[sensor] / (double)VAR_ONE;
+}
+
+estimatorResult_t StateEstimator::SetProcessNoise(double density)
+{
+	// Start as a pessimist :(
+	estimatorResult_t result = ESTIMATOR_RESULT_INVALID;
+
+	if ((density > 0) && (density < ESTIMATOR_MAX_VAR))
+	{
+		processNoise = density;
+		CalcProcessNoise();
+
+		// If we got here, we're ok :)
+		result = ESTIMATOR_RESULT_OK;
+	}
+
+	// Return the status.
+	return result;
+}
+
+void StateEstimator::SetSamplePeriod(unsigned long mSec)
+{
+	if (mSec > 0)
+	{
+		samplePeriod = mSec;
+		CalcProcessNoise();
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		CalcProcessNoise
+ *
+ *	Description:	Works out how much uncertainty each period adds to the
+ *					state, for a rate that's pushed around by white noise.
+ *					This uses floating point, but only runs when the settings
+ *					change.
+ *
+ *****************************************************************************/
+
+void StateEstimator::CalcProcessNoise()
+{
+	double ts;							// sample period [seconds]
+
+	ts = samplePeriod / 1000.0;
+	period = FixedFromDouble(ts);
+
+	q00 = VarFromDouble(processNoise * ts * ts * ts / 3);
+	q01 = VarFromDouble(processNoise * ts * ts / 2);
+	q11 = VarFromDouble(processNoise * ts);
+}
+
+void StateEstimator::Reset()
+{
+	valid = false;
+	temperature = 0;
+	rate = 0;
+}
+
+bool StateEstimator::IsValid()
+{
+	return valid;
+}
+
+double StateEstimator::GetTemperature()
+{
+	return FixedToDouble(temperature);
+}
+
+double StateEstimator::GetRate()
+{
+	return FixedToDouble(rate);
+}
+
+/******************************************************************************
+ *
+ *	Function:		Predict
+ *
+ *	Description:	Moves the state ahead one sample period, and grows its
+ *					uncertainty to match.  If no sensor has corrected it for
+ *					so long that the uncertainty is about to overflow, the
+ *					estimator starts over.
+ *
+ *****************************************************************************/
+
+void StateEstimator::Predict()
+{
+	int32_t p01New;						// covariance after this period
+
+	if (!valid)
+	{
+		return;
+	}
+
+	temperature += FixedMul(period, rate);
+
+	// P = F * P * F' + Q, where F = [1 period; 0 1].
+	p01New = p01 + FixedMul(period, p11);
+	p00 += FixedMul(period, p01 + p01New) + q00;
+	p01 = p01New + q01;
+	p11 += q11;
+
+	if (p00 > VarFromDouble(ESTIMATOR_MAX_VAR))
+	{
+		Reset();
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		Correct
+ *
+ *	Description:	Blends a sensor's reading into the state.  The first
+ *					reading after a reset sets the temperature outright.
+ *
+ *	Parameters:		sensor - which sensor the reading came from
+ *					temp - the reading [C]
+ *
+ *****************************************************************************/
+
+void StateEstimator::Correct(uint8_t sensor, double temp)
+{
+	fixed_t innovation;					// reading minus estimate [C]
+	int32_t inverse;					// 1 / innovation variance [1/C^2]
+	int32_t k0;							// gain for temperature
+	int32_t k1;							// gain for rate [1/sec]
+
+	if (sensor >= ESTIMATOR_SENSORS)
+	{
+		return;
+	}
+
+	if (!valid)
+	{
+		temperature = FixedFromDouble(temp);
+		rate = 0;
+		p00 = noise[sensor];
+		p01 = 0;
+		p11 = VarFromDouble(ESTIMATOR_INITIAL_RATE_VAR);
+		valid = true;
+		return;
+	}
+
+	innovation = FixedFromDouble(temp) - temperature;
+
+	// K = P * H' / (H * P * H' + R), where H = [1 0].  The innovation
+	// variance is at least MIN_NOISE, so its reciprocal fits in 32 bits.
+	inverse = (int32_t)(((int64_t)1 << (2 * ESTIMATOR_VAR_SHIFT)) /
+		(p00 + noise[sensor]));
+	k0 = VarMul(p00, inverse);
+	k1 = VarMul(p01, inverse);
+
+	temperature += VarMul(innovation, k0);
+	rate += VarMul(innovation, k1);
+
+	// P = (I - K * H) * P.  p11 needs the old p01, so it goes first.
+	p11 -= VarMul(p01, k1);
+	p01 -= VarMul(p01, k0);
+	p00 -= VarMul(p00, k0);
+}
@@ -0,0 +1,103 @@
+#ifndef STATE_ESTIMATOR_H
+#define STATE_ESTIMATOR_H
+
+#include <stdint.h>
+#include "FixedPoint.h"
+
+// Sensors the estimator can fuse.  These match inputSensor_t in InputCard.h
+// (which isn't included here, so the estimator can be built on a PC by
+// tools/estimator_replay.cpp).
+#define ESTIMATOR_SENSOR_THERMOCOUPLE	0
+#define ESTIMATOR_SENSOR_THERMISTOR		1
+#define ESTIMATOR_SENSORS				2
+
+// Default measurement noise of each sensor, as a variance [C^2].  The
+// MAX31855 reads in 0.25 C steps; the thermistor is smoother.
+#define ESTIMATOR_TC_VARIANCE			0.06
+#define ESTIMATOR_THERM_VARIANCE		0.02
+
+// Default process noise:  how quickly the rate of change itself can wander,
+// as the spectral density of a random acceleration [(C/sec)^2 per second].
+#define ESTIMATOR_PROCESS_NOISE			0.0001
+
+// Uncertainty of the rate when the estimator starts [(C/sec)^2].
+#define ESTIMATOR_INITIAL_RATE_VAR		1.0
+
+// Variances are kept with this many fractional bits, so tiny process noise
+// terms don't round away.  Variances must stay below 2^(31 - this) C^2; if
+// the temperature's variance grows past ESTIMATOR_MAX_VAR (no measurements
+// for a long time), the estimator starts over.
+#define ESTIMATOR_VAR_SHIFT				24
+#define ESTIMATOR_MAX_VAR				64.0
+
+typedef enum							// status from functions
+{
+	ESTIMATOR_RESULT_OK,				// All is well!
+	ESTIMATOR_RESULT_FAIL,				// It's the hardware's fault.
+	ESTIMATOR_RESULT_INVALID,			// It's your fault.
+	ESTIMATOR_RESULT_NOT_IMPLEMENTED,	// It's my fault.
+} estimatorResult_t;
+
+class StateEstimator
+{
+public:
+	// Initialize the class.
+	StateEstimator();
+
+	// Set a sensor's measurement noise [C^2].
+	estimatorResult_t SetNoise(uint8_t sensor, double variance);
+
+	// Fetch a sensor's measurement noise [C^2].
+	double GetNoise(uint8_t sensor);
+
+	// Set how quickly the rate of change can wander [(C/sec)^2 per second].
+	estimatorResult_t SetProcessNoise(double density);
+
+	// Set how often Predict is called [milliseconds].
+	void SetSamplePeriod(unsigned long mSec);
+
+	// Forget the state.  The next measurement starts the estimator again.
+	void Reset();
+
+	// Advance the state by one sample period.  Call once per sample, before
+	// Correct.
+	void Predict();
+
+	// Correct the state with a sensor's reading [C].  Call once per sensor
+	// that has a good reading this sample.
+	void Correct(uint8_t sensor, double temp);
+
+	// Find whether the estimator has a state to report.
+	bool IsValid();
+
+	// Fetch the estimated temperature [C].
+	double GetTemperature();
+
+	// Fetch the estimated rate of change [C/sec].
+	double GetRate();
+
+private:
+	unsigned long samplePeriod;			// time between predictions [mSec]
+	double processNoise;				// random acceleration [(C/s)^2/s]
+	bool valid;							// state has been initialized
+
+	fixed_t period;						// sample period [seconds]
+	fixed_t temperature;				// state:  temperature [C]
+	fixed_t rate;						// state:  rate of change [C/sec]
+
+	// Covariance of the state, and noise, with ESTIMATOR_VAR_SHIFT
+	// fractional bits.  The covariance is symmetric, so only 3 of its 4
+	// entries are kept.
+	int32_t p00;						// temperature variance [C^2]
+	int32_t p01;						// covariance [C^2/sec]
+	int32_t p11;						// rate variance [(C/sec)^2]
+	int32_t q00;						// process noise per sample
+	int32_t q01;
+	int32_t q11;
+	int32_t noise[ESTIMATOR_SENSORS];	// measurement noise [C^2]
+
+	// Recalculate the process noise from the density & sample period.
+	void CalcProcessNoise();
+};
+
+#endif
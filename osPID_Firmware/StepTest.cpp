@@ -0,0 +1,257 @@
+/******************************************************************************
+ *
+ *	Filename:		StepTest.cpp
+ *
+ *	Description:	Finds a first-order-plus-dead-time model of the process by
+ *					stepping the output and watching how the process value
+ *					responds.  The model (gain, time constant & dead time) is
+ *					what the Smith predictor needs.
+ *
+ *					The fit uses Smith's two-point method:  once the process
+ *					has settled, find the times t28 and t63 at which the
+ *					response reached 28.3% and 63.2% of its final change.
+ *					Then:
+ *
+ *						gain = (final PV - starting PV) / output step
+ *						time constant = 1.5 * (t63 - t28)
+ *						dead time = t63 - time constant
+ *
+ *					The process must be steady before the test is started,
+ *					and the controller must be in manual mode while it runs.
+ *
+ *****************************************************************************/
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include <stdint.h>
+#include <math.h>
+#include "StepTest.h"
+
+/******************************************************************************
+ *
+ *	Function:		StepTest (Class Initializer)
+ *
+ *****************************************************************************/
+
+StepTest::StepTest()
+{
+	state = STEP_TEST_IDLE;
+	gain = 0;
+	tau = 0;
+	deadTime = 0;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Start
+ *
+ *	Description:	Steps the output and starts recording the response.  The
+ *					step is made upward unless that would exceed 100%.
+ *
+ *	Parameters:		processValue - current (steady) process value [C]
+ *					output - current (steady) output [%]
+ *					step - size of the output step [%]
+ *					noiseBand - PV changes smaller than this are noise [C]
+ *					lookbackSec - the process is settled when PV changes less
+ *						than noiseBand over this long [seconds]
+ *					samplePeriod - time between calls to Run [milliseconds]
+ *
+ *****************************************************************************/
+
+void StepTest::Start(double processValue, double output, double step,
+	double noiseBand, unsigned int lookbackSec, unsigned long samplePeriod)
+{
+	// Pick an output that stays within 0-100%.
+	testOutput = output + step;
+	if (testOutput > 100)
+	{
+		testOutput = output - step;
+	}
+	testOutput = (testOutput < 0) ? 0 :
+		((testOutput > 100) ? 100 : testOutput);
+	outputStep = testOutput - output;
+
+	startValue = processValue;
+	lookbackValue = processValue;
+	noise = noiseBand;
+	period = samplePeriod;
+	lookback = (uint16_t)(lookbackSec * 1000UL / samplePeriod);
+	if (lookback < 1)
+	{
+		lookback = 1;
+	}
+
+	sampleCount = 0;
+	samplesPerPoint = 1;
+	pointCount = 0;
+
+	// A step of nothing can't tell us anything.
+	state = (outputStep != 0) ? STEP_TEST_RUNNING : STEP_TEST_FAILED;
+}
+
+void StepTest::Cancel()
+{
+	state = STEP_TEST_IDLE;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Run
+ *
+ *	Description:	Records a point of the step response, and checks whether
+ *					the process has settled.  When it has, fits the model.
+ *
+ *	Parameters:		processValue - current process value [C]
+ *
+ *	Return Value:	state of the test
+ *
+ *****************************************************************************/
+
+stepTestState_t StepTest::Run(double processValue)
+{
+	uint8_t i;
+
+	// If we're not running, there's nothing to do.
+	if (state != STEP_TEST_RUNNING)
+	{
+		return state;
+	}
+
+	// If it's time to store a point...
+	if ((sampleCount % samplesPerPoint) == 0)
+	{
+		// If the buffer is full, throw away every other point.
+		if (pointCount == STEP_TEST_POINTS)
+		{
+			for (i = 0; i < STEP_TEST_POINTS / 2; i++)
+			{
+				response[i] = response[2 * i];
+			}
+			pointCount = STEP_TEST_POINTS / 2;
+			samplesPerPoint *= 2;
+		}
+
+		response[pointCount++] = FixedFromDouble(processValue - startValue);
+	}
+
+	// If it's time to check whether the process has settled...
+	if ((sampleCount > 0) && ((sampleCount % lookback) == 0))
+	{
+		// If it moved, and has stopped moving, the test is over.
+		if ((fabs(processValue - lookbackValue) <= noise) &&
+			(fabs(processValue - startValue) > noise))
+		{
+			state = Identify(processValue) ? STEP_TEST_DONE : STEP_TEST_FAILED;
+		}
+
+		lookbackValue = processValue;
+	}
+
+	// Give up if the process takes forever.
+	if (++sampleCount == 0xFFFF)
+	{
+		state = STEP_TEST_FAILED;
+	}
+
+	return state;
+}
+
+stepTestState_t StepTest::GetState()
+{
+	return state;
+}
+
+double StepTest::GetOutput()
+{
+	return testOutput;
+}
+
+double StepTest::GetGain()
+{
+	return gain;
+}
+
+double StepTest::GetTimeConstant()
+{
+	return tau;
+}
+
+double StepTest::GetDeadTime()
+{
+	return deadTime;
+}
+
+/******************************************************************************
+ *
+ *	Function:		CrossingTime
+ *
+ *	Description:	Finds when the recorded response first reached a level,
+ *					interpolating between stored points.
+ *
+ *	Parameters:		level - response to look for [C]; its sign must match
+ *						the sign of the response
+ *
+ *	Return Value:	time after the step [seconds]
+ *
+ *****************************************************************************/
+
+double StepTest::CrossingTime(fixed_t level)
+{
+	double pointTime;					// time between points [seconds]
+	double fraction;					// where between two points
+	uint8_t i;
+
+	pointTime = (double)samplesPerPoint * period / 1000.0;
+
+	for (i = 1; i < pointCount; i++)
+	{
+		// If this point reached the level...
+		if (((level > 0) && (response[i] >= level)) ||
+			((level < 0) && (response[i] <= level)))
+		{
+			// Interpolate between it and the point before it.
+			fraction = (double)(level - response[i - 1]) /
+				(double)(response[i] - response[i - 1]);
+			return ((i - 1) + fraction) * pointTime;
+		}
+	}
+
+	return (pointCount - 1) * pointTime;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Identify
+ *
+ *	Description:	Fits a first-order-plus-dead-time model to the recorded
+ *					response.  Runs once, so floating point is fine here.
+ *
+ *	Parameters:		finalValue - settled process value [C]
+ *
+ *	Return Value:	true if the model is usable
+ *
+ *****************************************************************************/
+
+bool StepTest::Identify(double finalValue)
+{
+	double change;						// total change in PV [C]
+	double t28;							// time to 28.3% of change [seconds]
+	double t63;							// time to 63.2% of change [seconds]
+
+	change = finalValue - startValue;
+
+	gain = change / outputStep;
+	t28 = CrossingTime(FixedFromDouble(0.283 * change));
+	t63 = CrossingTime(FixedFromDouble(0.632 * change));
+	tau = 1.5 * (t63 - t28);
+	deadTime = t63 - tau;
+
+	// Noise can make the dead time come out slightly negative.
+	if (deadTime < 0)
+	{
+		deadTime = 0;
+	}
+
+	return (tau > 0);
+}
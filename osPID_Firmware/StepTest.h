@@ -0,0 +1,79 @@
+#ifndef STEP_TEST_H
+#define STEP_TEST_H
+
+// Off the Arduino (in tools/smith_sim.cpp) there's no Arduino.h.
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include <stdint.h>
+#include "FixedPoint.h"
+
+// Number of points kept of the process's step response.  When the buffer
+// fills up, every other point is thrown away and points are taken half as
+// often, so a test of any length fits.  Each point costs 4 bytes of RAM.
+#define STEP_TEST_POINTS	32
+
+typedef enum							// state of the step test
+{
+	STEP_TEST_IDLE,						// not running
+	STEP_TEST_RUNNING,					// waiting for the process to settle
+	STEP_TEST_DONE,						// finished; model is available
+	STEP_TEST_FAILED,					// process never responded or settled
+} stepTestState_t;
+
+class StepTest
+{
+public:
+	// Initialize the class.
+	StepTest();
+
+	// Step the output and start watching the process.
+	void Start(double processValue, double output, double step,
+		double noiseBand, unsigned int lookbackSec, unsigned long samplePeriod);
+
+	// Stop the test.
+	void Cancel();
+
+	// Record a sample.  Call this once per sample period.
+	stepTestState_t Run(double processValue);
+
+	// Find what state the test is in.
+	stepTestState_t GetState();
+
+	// Fetch the output the test wants applied [%].
+	double GetOutput();
+
+	// Fetch the identified process gain [C per %].
+	double GetGain();
+
+	// Fetch the identified time constant [seconds].
+	double GetTimeConstant();
+
+	// Fetch the identified dead time [seconds].
+	double GetDeadTime();
+
+private:
+	stepTestState_t state;				// state of the test
+	double startValue;					// process value before the step [C]
+	double testOutput;					// output during the test [%]
+	double outputStep;					// size of the step [%]
+	double noise;						// PV change considered noise [C]
+	unsigned long period;				// sample period [milliseconds]
+	uint16_t lookback;					// samples between settle checks
+	uint16_t sampleCount;				// samples since the step
+	uint16_t samplesPerPoint;			// samples between stored points
+	uint8_t pointCount;					// number of stored points
+	double lookbackValue;				// process value at last settle check
+	double gain;						// identified gain [C per %]
+	double tau;							// identified time constant [seconds]
+	double deadTime;					// identified dead time [seconds]
+	fixed_t response[STEP_TEST_POINTS];	// PV minus startValue [C]
+
+	// Find when the response crossed a fraction of its final value.
+	double CrossingTime(fixed_t level);
+
+	// Fit a model to the recorded response.
+	bool Identify(double finalValue);
+};
+
+#endif
@@ -0,0 +1,176 @@
+/******************************************************************************
+ *
+ *	Filename:		Thermostat.cpp
+ *
+ *	Description:	An on/off controller with a differential (hysteresis)
+ *					and minimum on & off times.  For slow processes it's
+ *					gentler on a mechanical relay than time-proportioning
+ *					the PID's output:  the relay switches once each time the
+ *					process crosses the differential, not twice every output
+ *					window.
+ *
+ *					Update does the same few integer compares every call, so
+ *					it takes constant time and no floating point.
+ *
+ *****************************************************************************/
+
+#include <stdint.h>
+#include "Thermostat.h"
+
+/******************************************************************************
+ *
+ *	Function:		Thermostat (Class Initializer)
+ *
+ *****************************************************************************/
+
+Thermostat::Thermostat()
+{
+	halfDifferential = FixedFromDouble(THERMOSTAT_DIFFERENTIAL) / 2;
+	minOnTime = THERMOSTAT_MIN_ON_TIME;
+	minOffTime = THERMOSTAT_MIN_OFF_TIME;
+	reverse = false;
+	on = false;
+	lastSwitch = 0;
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetDifferential
+ *
+ *	Description:	Sets the gap between the process value that turns the
+ *					output on and the one that turns it off.  The gap is
+ *					centered on the setpoint.
+ *
+ *	Parameters:		differential - the gap [C, fixed point]
+ *
+ *	Return Value:	THERMOSTAT_RESULT_OK if it was set
+ *					THERMOSTAT_RESULT_INVALID if it's negative
+ *
+ *****************************************************************************/
+
+thermostatResult_t Thermostat::SetDifferential(fixed_t differential)
+{
+	if (differential < 0)
+	{
+		return THERMOSTAT_RESULT_INVALID;
+	}
+
+	halfDifferential = differential / 2;
+	return THERMOSTAT_RESULT_OK;
+}
+
+fixed_t Thermostat::GetDifferential()
+{
+	return halfDifferential * 2;
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetMinTimes
+ *
+ *	Description:	Sets how long the output must stay on once it turns on,
+ *					and off once it turns off.
+ *
+ *	Parameters:		onTime - minimum on time [mSec]
+ *					offTime - minimum off time [mSec]
+ *
+ *	Return Value:	THERMOSTAT_RESULT_OK if they were set
+ *					THERMOSTAT_RESULT_INVALID if either is longer than
+ *						THERMOSTAT_MAX_MIN_TIME
+ *
+ *****************************************************************************/
+
+thermostatResult_t Thermostat::SetMinTimes(unsigned long onTime,
+	unsigned long offTime)
+{
+	if ((onTime > THERMOSTAT_MAX_MIN_TIME) ||
+		(offTime > THERMOSTAT_MAX_MIN_TIME))
+	{
+		return THERMOSTAT_RESULT_INVALID;
+	}
+
+	minOnTime = onTime;
+	minOffTime = offTime;
+	return THERMOSTAT_RESULT_OK;
+}
+
+unsigned long Thermostat::GetMinOnTime()
+{
+	return minOnTime;
+}
+
+unsigned long Thermostat::GetMinOffTime()
+{
+	return minOffTime;
+}
+
+void Thermostat::SetReverse(bool reverse)
+{
+	this->reverse = reverse;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Reset
+ *
+ *	Description:	Starts over with the output in a known state.  The
+ *					minimum on or off time starts now, so the relay is
+ *					protected even if it just switched before the reset.
+ *
+ *	Parameters:		on - true if the output is on
+ *					now - the time [mSec]
+ *
+ *****************************************************************************/
+
+void Thermostat::Reset(bool on, unsigned long now)
+{
+	this->on = on;
+	lastSwitch = now;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Update
+ *
+ *	Description:	Decides whether the output should be on.  It turns on
+ *					when the process value is more than half the
+ *					differential on the cold side of the setpoint (the hot
+ *					side for reverse acting), and off when it's that far on
+ *					the other side, but never before the minimum time in its
+ *					current state is up.
+ *
+ *	Parameters:		processValue - process value [C, fixed point]
+ *					setpoint - setpoint [C, fixed point]
+ *					now - the time [mSec]
+ *
+ *	Return Value:	true if the output should be on
+ *
+ *****************************************************************************/
+
+bool Thermostat::Update(fixed_t processValue, fixed_t setpoint,
+	unsigned long now)
+{
+	fixed_t demand;						// how far on the "needs output" side
+										// of the setpoint the process is [C]
+
+	demand = reverse ? (processValue - setpoint) : (setpoint - processValue);
+
+	if (on)
+	{
+		if ((demand < -halfDifferential) && (now - lastSwitch >= minOnTime))
+		{
+			on = false;
+			lastSwitch = now;
+		}
+	}
+	else
+	{
+		if ((demand > halfDifferential) && (now - lastSwitch >= minOffTime))
+		{
+			on = true;
+			lastSwitch = now;
+		}
+	}
+
+	return on;
+}
@@ -0,0 +1,66 @@
+#ifndef THERMOSTAT_H
+#define THERMOSTAT_H
+
+#include <stdint.h>
+#include "FixedPoint.h"
+
+// Defaults.  The output turns on when the process value falls half the
+// differential below the setpoint, and off when it rises half the
+// differential above it (the other way around for reverse acting).  Once
+// switched, it stays put for at least the minimum on or off time, however the
+// process value moves, to protect the relay (or a compressor) from short
+// cycling.
+#define THERMOSTAT_DIFFERENTIAL		2.0		// [C]
+#define THERMOSTAT_MIN_ON_TIME		30000	// [mSec]
+#define THERMOSTAT_MIN_OFF_TIME		30000	// [mSec]
+
+// Longest minimum on or off time.  An hour is far beyond any relay's need.
+#define THERMOSTAT_MAX_MIN_TIME		3600000UL	// [mSec]
+
+typedef enum							// status from functions
+{
+	THERMOSTAT_RESULT_OK,				// All is well!
+	THERMOSTAT_RESULT_FAIL,				// It's the hardware's fault.
+	THERMOSTAT_RESULT_INVALID,			// It's your fault.
+	THERMOSTAT_RESULT_NOT_IMPLEMENTED,	// It's my fault.
+} thermostatResult_t;
+
+class Thermostat
+{
+public:
+	// Initialize the class.
+	Thermostat();
+
+	// Set the gap between switching on and switching off [C, fixed point].
+	thermostatResult_t SetDifferential(fixed_t differential);
+
+	// Fetch the differential [C, fixed point].
+	fixed_t GetDifferential();
+
+	// Set the minimum time to stay on, and to stay off [mSec].
+	thermostatResult_t SetMinTimes(unsigned long onTime,
+		unsigned long offTime);
+
+	// Fetch the minimum on & off times [mSec].
+	unsigned long GetMinOnTime();
+	unsigned long GetMinOffTime();
+
+	// Set direct (heating) or reverse (cooling) acting.
+	void SetReverse(bool reverse);
+
+	// Start over with the output on or off, as of now [mSec].
+	void Reset(bool on, unsigned long now);
+
+	// Decide whether the output should be on.  Call once per sample.
+	bool Update(fixed_t processValue, fixed_t setpoint, unsigned long now);
+
+private:
+	fixed_t halfDifferential;			// half the differential [C]
+	unsigned long minOnTime;			// minimum dwell times [mSec]
+	unsigned long minOffTime;
+	bool reverse;						// true for reverse acting
+	bool on;							// output's state
+	unsigned long lastSwitch;			// when the output last switched
+};
+
+#endif
@@ -0,0 +1,190 @@
+/******************************************************************************
+ *
+ *	Filename:		Trace.cpp
+ *
+ *	Description:	Keeps a record of the last few things the controller did
+ *					(samples, sensor reads, the controller, LCD & serial
+ *					updates, EEPROM writes, relay edges...) and the time of
+ *					each to within 4 microseconds, so the order of events
+ *					behind a timing glitch can be seen.  It's only built
+ *					when TRACE_ENABLED is set in Trace.h.
+ *
+ *					Records go into ring buffers in RAM, overwriting the
+ *					oldest.  The main loop and the interrupts each have a
+ *					ring of their own, so each ring has a single writer:  an
+ *					interrupt can't land in the middle of another write to
+ *					its ring, and no lock (or turning interrupts off) is
+ *					needed.  TraceDump merges the two by time.
+ *
+ *****************************************************************************/
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "Trace.h"
+
+#if TRACE_ENABLED
+
+static traceRecord_t mainRing[TRACE_SIZE];	// main loop's events
+static uint8_t mainHead;				// where the next one goes
+static uint8_t mainCount;				// records kept (up to TRACE_SIZE)
+
+static traceRecord_t isrRing[TRACE_ISR_SIZE];	// interrupts' events
+static volatile uint8_t isrHead;
+static volatile uint8_t isrCount;
+
+static volatile bool paused;			// true while dumping
+
+/******************************************************************************
+ *
+ *	Function:		TraceEvent
+ *
+ *	Description:	Records an event in the main loop's ring.  Don't call
+ *					this from an interrupt; use TraceIsr.
+ *
+ *	Parameters:		event - what happened (traceEvent_t)
+ *					phase - TRACE_PHASE_BEGIN, _END or _INSTANT
+ *					arg - depends on the event
+ *
+ *****************************************************************************/
+
+void TraceEvent(uint8_t event, char phase, uint16_t arg)
+{
+	traceRecord_t *record;
+
+	if (paused)
+	{
+		return;
+	}
+
+	record = &mainRing[mainHead];
+	record->time = micros();
+	record->event = event;
+	record->phase = phase;
+	record->arg = arg;
+
+	mainHead = (mainHead + 1) & (TRACE_SIZE - 1);
+	if (mainCount < TRACE_SIZE)
+	{
+		mainCount++;
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		TraceIsr
+ *
+ *	Description:	Records an instant event in the interrupts' ring.
+ *					Interrupts don't nest, so only one can be in here at a
+ *					time.
+ *
+ *	Parameters:		event - what happened (traceEvent_t)
+ *					arg - depends on the event
+ *
+ *****************************************************************************/
+
+void TraceIsr(uint8_t event, uint16_t arg)
+{
+	traceRecord_t *record;
+	uint8_t head = isrHead;
+
+	if (paused)
+	{
+		return;
+	}
+
+	record = &isrRing[head];
+	record->time = micros();
+	record->event = event;
+	record->phase = TRACE_PHASE_INSTANT;
+	record->arg = arg;
+
+	isrHead = (head + 1) & (TRACE_ISR_SIZE - 1);
+	if (isrCount < TRACE_ISR_SIZE)
+	{
+		isrCount++;
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		TraceDump
+ *
+ *	Description:	Sends the records out the serial port, merged into time
+ *					order, then forgets them.  Nothing is recorded while
+ *					this runs (it takes a while at 9600 baud, and would
+ *					fill the rings with its own serial traffic).  The dump
+ *					looks like this:
+ *
+ *						trace <count>
+ *						<time> <ring> <event> <phase> <arg>
+ *						...
+ *						trace end
+ *
+ *					time is micros(); ring is 0 for the main loop, 1 for
+ *					interrupts; event is a traceEvent_t number; phase is B,
+ *					E or i.
+ *
+ *****************************************************************************/
+
+void TraceDump(void)
+{
+	uint8_t mainLeft;					// records still to send
+	uint8_t isrLeft;
+	uint8_t mainNext;					// index of the next one
+	uint8_t isrNext;
+	traceRecord_t *record;
+	bool fromIsr;
+
+	paused = true;
+
+	mainLeft = mainCount;
+	isrLeft = isrCount;
+	mainNext = (mainHead - mainLeft) & (TRACE_SIZE - 1);
+	isrNext = (isrHead - isrLeft) & (TRACE_ISR_SIZE - 1);
+
+	Serial.print(F("trace "));
+	Serial.println(mainLeft + isrLeft);
+
+	while ((mainLeft > 0) || (isrLeft > 0))
+	{
+		// Take the earlier of the two oldest records.  The difference
+		// works across micros() wrapping around.
+		fromIsr = (mainLeft == 0) || ((isrLeft > 0) &&
+			((int32_t)(isrRing[isrNext].time - mainRing[mainNext].time) < 0));
+		if (fromIsr)
+		{
+			record = &isrRing[isrNext];
+			isrNext = (isrNext + 1) & (TRACE_ISR_SIZE - 1);
+			isrLeft--;
+		}
+		else
+		{
+			record = &mainRing[mainNext];
+			mainNext = (mainNext + 1) & (TRACE_SIZE - 1);
+			mainLeft--;
+		}
+
+		Serial.print(record->time);
+		Serial.print(fromIsr ? F(" 1 ") : F(" 0 "));
+		Serial.print(record->event);
+		Serial.print(' ');
+		Serial.print(record->phase);
+		Serial.print(' ');
+		Serial.println(record->arg);
+	}
+	Serial.println(F("trace end"));
+
+	mainCount = 0;
+	isrCount = 0;
+	paused = false;
+}
+
+#else
+
+// Tracing is off; the dump says so.
+void TraceDump(void)
+{
+	Serial.println(F("trace off"));
+}
+
+#endif
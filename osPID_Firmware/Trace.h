@@ -0,0 +1,73 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Set to 1 to record what the controller does, and when, for finding the
+// cause of timing glitches.  The serial `t` command dumps the record, and
+// tools/trace_to_json.py turns the dump into a trace for a viewer.  It
+// costs (TRACE_SIZE + TRACE_ISR_SIZE) x 8 bytes of RAM, and a few
+// microseconds per event.  At 0 the TRACE_ macros compile to nothing.
+#define TRACE_ENABLED	0
+
+// Records kept (powers of 2).  Interrupts have a ring of their own, so each
+// ring has only one writer, and neither needs a lock.
+#define TRACE_SIZE		32
+#define TRACE_ISR_SIZE	8
+
+// Phases, as the trace viewer spells them.
+#define TRACE_PHASE_BEGIN	'B'			// something started
+#define TRACE_PHASE_END		'E'			// it finished
+#define TRACE_PHASE_INSTANT	'i'			// something happened
+
+typedef enum							// what happened (tools/trace_to_json.py
+{										// reads these names from here)
+	TRACE_SAMPLE,						// a sample
+	TRACE_SENSOR,						// reading the input (arg:  sensor
+										// in use)
+	TRACE_CONTROL,						// the PID or on/off controller (arg:
+										// controller type)
+	TRACE_LCD,							// updating the LCD
+	TRACE_REPORT,						// sending the serial report
+	TRACE_EEPROM,						// writing an EEPROM byte (arg:
+										// address)
+	TRACE_RELAY,						// a relay switched (arg:  relay x 2 +
+										// new state)
+	TRACE_COMMAND,						// a serial command (arg:  its letter)
+	TRACE_MODBUS,						// handling a Modbus request (arg:
+										// function, then response length)
+	TRACE_ADC,							// an ADC conversion finished
+										// (interrupt; arg:  reading)
+} traceEvent_t;
+
+typedef struct							// one event:  8 bytes
+{
+	uint32_t time;						// micros() when it happened
+	uint8_t event;						// traceEvent_t
+	char phase;							// TRACE_PHASE_...
+	uint16_t arg;						// depends on the event
+} traceRecord_t;
+
+// Record an event.  Call this from the main loop only.
+void TraceEvent(uint8_t event, char phase, uint16_t arg);
+
+// Record an event.  Call this from interrupts only.
+void TraceIsr(uint8_t event, uint16_t arg);
+
+// Send the record out the serial port, oldest first, and start over.
+void TraceDump(void);
+
+#if TRACE_ENABLED
+#define TRACE_BEGIN(event, arg)		TraceEvent((event), TRACE_PHASE_BEGIN, (arg))
+#define TRACE_END(event, arg)		TraceEvent((event), TRACE_PHASE_END, (arg))
+#define TRACE_INSTANT(event, arg)	\
+	TraceEvent((event), TRACE_PHASE_INSTANT, (arg))
+#define TRACE_ISR(event, arg)		TraceIsr((event), (arg))
+#else
+#define TRACE_BEGIN(event, arg)
+#define TRACE_END(event, arg)
+#define TRACE_INSTANT(event, arg)
+#define TRACE_ISR(event, arg)
+#endif
+
+#endif
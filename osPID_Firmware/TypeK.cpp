@@ -0,0 +1,188 @@
+/******************************************************************************
+ *
+ *	Filename:		TypeK.cpp
+ *
+ *	Description:	Linearizes type-K thermocouple readings from a MAX31855.
+ *					The chip reports the hot-junction temperature assuming the
+ *					thermocouple's output is a straight 41.276 uV/C, which is
+ *					off by several degrees above 600 C.  Instead, this takes
+ *					the chip's two raw readings and:
+ *
+ *					1.	Recovers the thermocouple's voltage from the chip's
+ *						hot-junction & cold-junction readings.
+ *					2.	Adds the voltage a type-K thermocouple would make at
+ *						the cold-junction temperature (cold-junction
+ *						compensation).
+ *					3.	Looks up the temperature for the total voltage.
+ *
+ *					Both lookups use piecewise-linear tables in flash, built
+ *					from the NIST ITS-90 type-K polynomials by
+ *					tools/typek_table.py, which also builds this file on a
+ *					PC and reports how closely TypeKLinearize matches:
+ *					within 0.07 C from -100 C to 1372 C, rising to about 2 C
+ *					at -200 C.  Everything is integer math, so it's
+ *					cheap enough to run every sample.
+ *
+ *****************************************************************************/
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include <stdint.h>
+#include "TypeK.h"
+
+// The tables live in flash.  Off the AVR (in tools/typek_table.py) flash is
+// just memory.
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#ifndef pgm_read_word
+#define pgm_read_word(p)	(*(const uint16_t *)(p))
+#endif
+#endif
+
+// Hot-junction table:  temperature [1/16 C] every 512 uV from -6144 uV.
+#define HOT_MIN_UV		-6144L			// voltage of the first entry [uV]
+#define HOT_SHIFT		9				// log2 of the step [uV]
+#define HOT_COUNT		121				// number of entries
+
+// Cold-junction table:  voltage [uV] every 16 C from -64 C.
+#define COLD_MIN		(-64 * 16)		// temperature of the first entry [1/16 C]
+#define COLD_SHIFT		8				// log2 of the step [1/16 C]
+#define COLD_COUNT		13				// number of entries
+
+// The MAX31855's gain, 41.276 uV/C, in uV per 1/16 C, times 4096.
+#define MAX31855_GAIN	10567L
+
+// Generated by tools/typek_table.py.  Do not edit by hand.
+const int16_t typeKTempTable[121] PROGMEM =
+{
+	 -3500,  -2951,  -2545,  -2201,  -1896,  -1616,  -1355,  -1107,
+	  -871,   -644,   -424,   -210,      0,    206,    409,    610,
+	   810,   1008,   1205,   1402,   1600,   1798,   1998,   2200,
+	  2402,   2606,   2811,   3016,   3221,   3426,   3630,   3832,
+	  4034,   4235,   4434,   4633,   4831,   5028,   5225,   5421,
+	  5616,   5812,   6006,   6201,   6395,   6589,   6782,   6975,
+	  7168,   7361,   7554,   7746,   7938,   8130,   8323,   8515,
+	  8707,   8899,   9091,   9284,   9476,   9669,   9862,  10055,
+	 10248,  10442,  10636,  10831,  11026,  11221,  11417,  11613,
+	 11810,  12007,  12205,  12403,  12602,  12802,  13002,  13203,
+	 13404,  13606,  13808,  14012,  14216,  14420,  14625,  14831,
+	 15038,  15245,  15453,  15661,  15871,  16081,  16291,  16503,
+	 16715,  16929,  17143,  17358,  17573,  17790,  18008,  18227,
+	 18447,  18668,  18890,  19113,  19338,  19564,  19791,  20020,
+	 20250,  20482,  20715,  20950,  21186,  21424,  21663,  21904,
+	 22146,
+};
+
+const int16_t typeKVoltTable[13] PROGMEM =
+{
+	 -2382,  -1818,  -1231,   -624,      0,    637,   1285,   1941,
+	  2602,   3267,   3931,   4591,   5247,
+};
+
+/******************************************************************************
+ *
+ *	Function:		TypeKVoltage
+ *
+ *	Description:	Finds the type-K voltage at a cold-junction temperature,
+ *					by interpolating in the cold-junction table.
+ *
+ *	Parameters:		junction - temperature [1/16 C]
+ *
+ *	Return Value:	voltage [uV]
+ *
+ *****************************************************************************/
+
+int16_t TypeKVoltage(int16_t junction)
+{
+	int16_t x;							// position in the table
+	uint8_t i;							// table entry below x
+	int16_t a;							// table entries either side of x
+	int16_t b;
+
+	x = junction - COLD_MIN;
+	if (x < 0)
+	{
+		x = 0;
+	}
+	else if (x > ((COLD_COUNT - 1) << COLD_SHIFT) - 1)
+	{
+		x = ((COLD_COUNT - 1) << COLD_SHIFT) - 1;
+	}
+
+	i = x >> COLD_SHIFT;
+	a = pgm_read_word(&typeKVoltTable[i]);
+	b = pgm_read_word(&typeKVoltTable[i + 1]);
+
+	return a + (int16_t)(((int32_t)(b - a) *
+		(x & ((1 << COLD_SHIFT) - 1))) >> COLD_SHIFT);
+}
+
+/******************************************************************************
+ *
+ *	Function:		TypeKTemperature
+ *
+ *	Description:	Finds the temperature for a type-K voltage, by
+ *					interpolating in the hot-junction table.
+ *
+ *	Parameters:		microvolts - compensated thermocouple voltage [uV]
+ *
+ *	Return Value:	temperature [1/16 C]
+ *
+ *****************************************************************************/
+
+int16_t TypeKTemperature(int32_t microvolts)
+{
+	int32_t x;							// position in the table
+	uint8_t i;							// table entry below x
+	int16_t a;							// table entries either side of x
+	int16_t b;
+
+	x = microvolts - HOT_MIN_UV;
+	if (x < 0)
+	{
+		x = 0;
+	}
+	else if (x > ((int32_t)(HOT_COUNT - 1) << HOT_SHIFT) - 1)
+	{
+		x = ((int32_t)(HOT_COUNT - 1) << HOT_SHIFT) - 1;
+	}
+
+	i = x >> HOT_SHIFT;
+	a = pgm_read_word(&typeKTempTable[i]);
+	b = pgm_read_word(&typeKTempTable[i + 1]);
+
+	return a + (int16_t)(((int32_t)(b - a) *
+		(int16_t)(x & ((1 << HOT_SHIFT) - 1))) >> HOT_SHIFT);
+}
+
+/******************************************************************************
+ *
+ *	Function:		TypeKLinearize
+ *
+ *	Description:	Converts the MAX31855's raw readings to a temperature.
+ *
+ *	Parameters:		thermocouple - hot-junction reading [1/4 C]
+ *					junction - cold-junction reading [1/16 C]
+ *
+ *	Return Value:	temperature [1/16 C]
+ *
+ *****************************************************************************/
+
+int16_t TypeKLinearize(int16_t thermocouple, int16_t junction)
+{
+	int32_t microvolts;					// thermocouple voltage [uV]
+
+	// The chip reports junction + voltage / gain.  Undo that.
+	microvolts = ((int32_t)thermocouple * 4 - junction) * MAX31855_GAIN;
+	microvolts >>= 12;
+
+	// Add the voltage the cold junction is hiding.
+	microvolts += TypeKVoltage(junction);
+
+	return TypeKTemperature(microvolts);
+}
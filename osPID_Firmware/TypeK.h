@@ -0,0 +1,22 @@
+#ifndef TYPE_K_H
+#define TYPE_K_H
+
+#include <stdint.h>
+
+// Convert raw MAX31855 readings to a linearized type-K temperature.
+//	thermocouple - hot-junction reading [1/4 C] (the chip's 14-bit field)
+//	junction - cold-junction reading [1/16 C] (the chip's 12-bit field)
+// Returns the temperature [1/16 C].
+int16_t TypeKLinearize(int16_t thermocouple, int16_t junction);
+
+// Find the type-K voltage at a cold-junction temperature.
+//	junction - temperature [1/16 C], -64 C to +128 C
+// Returns the voltage [microvolts].
+int16_t TypeKVoltage(int16_t junction);
+
+// Find the temperature for a type-K voltage.
+//	microvolts - voltage, including cold-junction compensation
+// Returns the temperature [1/16 C].
+int16_t TypeKTemperature(int32_t microvolts);
+
+#endif
@@ -0,0 +1,415 @@
+/******************************************************************************
+ *
+ *	Filename:		ZoneEngine.cpp
+ *
+ *	Description:	Runs several independent control loops at once, one per
+ *					zone:  each has its own process value, setpoint, PID
+ *					tunings & output window, and its own output.  The
+ *					sketch gives each zone its sensor's reading and passes
+ *					each output on to its relay.
+ *
+ *					The zones' state is kept as one array per field rather
+ *					than one structure per zone, and every zone's PID is
+ *					worked out in one pass of a single loop, in fixed point
+ *					(the AVR has no floating-point hardware).  The gains are
+ *					scaled for the sample period when they're set, so each
+ *					zone costs three multiplies per sample.  The tunings are
+ *					kept as they were set, and the gains always worked out
+ *					from them, so rounding doesn't build up as the period or
+ *					direction changes.  The sketch times Compute, so the
+ *					cost per zone can be checked on the real hardware;
+ *					tools/zone_bench.cpp checks & times it on a PC.
+ *
+ *					Each zone is a plain PID:  the integral is clamped to
+ *					the output range (no windup), the derivative is taken on
+ *					the process value (no kick on a setpoint change), and
+ *					switching to automatic starts from the output as it is.
+ *					A zone whose sensor can't be trusted turns its output
+ *					off, and starts again from there when the sensor comes
+ *					back.
+ *
+ *****************************************************************************/
+
+#include <stdint.h>
+#include "ZoneEngine.h"
+
+#define ZONE_OUTPUT_MAX		FIXED_FROM_INT(100)	// [%]
+
+/******************************************************************************
+ *
+ *	Function:		ZoneEngine (Class Initializer)
+ *
+ *****************************************************************************/
+
+ZoneEngine::ZoneEngine()
+{
+	uint8_t zone;
+
+	reverse = 0;
+	valid = 0;
+	automatic = false;
+	period = ZONE_PERIOD;
+	for (zone = 0; zone < ZONE_COUNT; zone++)
+	{
+		setpoint[zone] = FIXED_FROM_INT(ZONE_SETPOINT);
+		input[zone] = 0;
+		lastInput[zone] = 0;
+		output[zone] = 0;
+		integral[zone] = 0;
+		window[zone] = ZONE_WINDOW;
+		dispKp[zone] = ZONE_KP;
+		dispKi[zone] = ZONE_KI;
+		dispKd[zone] = ZONE_KD;
+		Scale(zone);
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetTunings
+ *
+ *	Description:	Sets a zone's PID tunings, the way PID_v1 takes them.
+ *
+ *	Parameters:		zone - 0 to ZONE_COUNT - 1
+ *					kp - proportional gain [%/C]
+ *					ki - integral gain [%/(C sec)]
+ *					kd - derivative gain [% sec/C]
+ *
+ *	Return Value:	ZONE_RESULT_OK if they were set
+ *					ZONE_RESULT_INVALID if there's no such zone, or a gain
+ *						is negative or over ZONE_MAX_GAIN
+ *
+ *****************************************************************************/
+
+zoneResult_t ZoneEngine::SetTunings(uint8_t zone, double kp, double ki,
+	double kd)
+{
+	if ((zone >= ZONE_COUNT) ||
+		!((kp >= 0) && (kp <= ZONE_MAX_GAIN) && (ki >= 0) &&
+		(ki <= ZONE_MAX_GAIN) && (kd >= 0) && (kd <= ZONE_MAX_GAIN)))
+	{
+		return ZONE_RESULT_INVALID;
+	}
+
+	dispKp[zone] = kp;
+	dispKi[zone] = ki;
+	dispKd[zone] = kd;
+	Scale(zone);
+	return ZONE_RESULT_OK;
+}
+
+double ZoneEngine::GetKp(uint8_t zone)
+{
+	return dispKp[zone];
+}
+
+double ZoneEngine::GetKi(uint8_t zone)
+{
+	return dispKi[zone];
+}
+
+double ZoneEngine::GetKd(uint8_t zone)
+{
+	return dispKd[zone];
+}
+
+zoneResult_t ZoneEngine::SetReverse(uint8_t zone, bool reverse)
+{
+	if (zone >= ZONE_COUNT)
+	{
+		return ZONE_RESULT_INVALID;
+	}
+
+	if (reverse)
+	{
+		this->reverse |= 1 << zone;
+	}
+	else
+	{
+		this->reverse &= ~(1 << zone);
+	}
+	Scale(zone);
+	return ZONE_RESULT_OK;
+}
+
+bool ZoneEngine::GetReverse(uint8_t zone)
+{
+	return (reverse & (1 << zone)) != 0;
+}
+
+zoneResult_t ZoneEngine::SetSetpoint(uint8_t zone, fixed_t setpoint)
+{
+	if ((zone >= ZONE_COUNT) ||
+		(setpoint < ZONE_MIN_SETPOINT * FIXED_ONE) ||
+		(setpoint > ZONE_MAX_SETPOINT * FIXED_ONE))
+	{
+		return ZONE_RESULT_INVALID;
+	}
+
+	this->setpoint[zone] = setpoint;
+	return ZONE_RESULT_OK;
+}
+
+fixed_t ZoneEngine::GetSetpoint(uint8_t zone)
+{
+	return setpoint[zone];
+}
+
+zoneResult_t ZoneEngine::SetWindow(uint8_t zone, unsigned long window)
+{
+	if ((zone >= ZONE_COUNT) || (window < ZONE_MIN_WINDOW) ||
+		(window > ZONE_MAX_WINDOW))
+	{
+		return ZONE_RESULT_INVALID;
+	}
+
+	this->window[zone] = window;
+	return ZONE_RESULT_OK;
+}
+
+unsigned long ZoneEngine::GetWindow(uint8_t zone)
+{
+	return window[zone];
+}
+
+/******************************************************************************
+ *
+ *	Function:		GetRecord
+ *
+ *	Description:	Fills in a zone's settings, as saved in EEPROM.
+ *
+ *	Parameters:		zone - 0 to ZONE_COUNT - 1
+ *					record - the settings
+ *
+ *****************************************************************************/
+
+void ZoneEngine::GetRecord(uint8_t zone, zoneRecord_t *record)
+{
+	record->setpoint = FixedToDouble(setpoint[zone]);
+	record->kp = GetKp(zone);
+	record->ki = GetKi(zone);
+	record->kd = GetKd(zone);
+	record->window = window[zone] / 100;
+	record->flags = GetReverse(zone) ? ZONE_REVERSE : 0;
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetRecord
+ *
+ *	Description:	Takes a zone's settings, as saved in EEPROM.  Settings
+ *					that are out of range are left as they were.
+ *
+ *	Parameters:		zone - 0 to ZONE_COUNT - 1
+ *					record - the settings
+ *
+ *	Return Value:	ZONE_RESULT_OK if they were all taken
+ *					ZONE_RESULT_INVALID if there's no such zone, or some
+ *						were out of range
+ *
+ *****************************************************************************/
+
+zoneResult_t ZoneEngine::SetRecord(uint8_t zone, const zoneRecord_t *record)
+{
+	zoneResult_t result = ZONE_RESULT_OK;
+
+	if (zone >= ZONE_COUNT)
+	{
+		return ZONE_RESULT_INVALID;
+	}
+
+	SetReverse(zone, (record->flags & ZONE_REVERSE) != 0);
+	if (SetTunings(zone, record->kp, record->ki, record->kd) !=
+		ZONE_RESULT_OK)
+	{
+		result = ZONE_RESULT_INVALID;
+	}
+	if (SetWindow(zone, record->window * 100UL) != ZONE_RESULT_OK)
+	{
+		result = ZONE_RESULT_INVALID;
+	}
+	if (!((record->setpoint >= ZONE_MIN_SETPOINT) &&
+		(record->setpoint <= ZONE_MAX_SETPOINT)) ||
+		(SetSetpoint(zone, FixedFromDouble(record->setpoint)) !=
+		ZONE_RESULT_OK))
+	{
+		result = ZONE_RESULT_INVALID;
+	}
+	return result;
+}
+
+// Rescale every zone's tunings for the new period (at least
+// ZONE_MIN_PERIOD).
+void ZoneEngine::SetSamplePeriod(unsigned long period)
+{
+	uint8_t zone;
+
+	if (period < ZONE_MIN_PERIOD)
+	{
+		return;
+	}
+
+	this->period = period;
+	for (zone = 0; zone < ZONE_COUNT; zone++)
+	{
+		Scale(zone);
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetAutomatic
+ *
+ *	Description:	Starts or stops the zones' controllers.  On the way into
+ *					automatic, each zone starts from its output as it is
+ *					(see Initialize), so the outputs don't jump.
+ *
+ *	Parameters:		automatic - true to run the controllers
+ *
+ *****************************************************************************/
+
+void ZoneEngine::SetAutomatic(bool automatic)
+{
+	uint8_t zone;
+
+	if (automatic && !this->automatic)
+	{
+		for (zone = 0; zone < ZONE_COUNT; zone++)
+		{
+			Initialize(zone);
+		}
+	}
+	this->automatic = automatic;
+}
+
+// A zone whose sensor comes back starts again from its output (off).
+void ZoneEngine::SetInput(uint8_t zone, fixed_t value, bool valid)
+{
+	uint8_t bit = 1 << zone;
+
+	input[zone] = value;
+	if (valid && !(this->valid & bit))
+	{
+		Initialize(zone);
+	}
+	if (valid)
+	{
+		this->valid |= bit;
+	}
+	else
+	{
+		this->valid &= ~bit;
+	}
+}
+
+fixed_t ZoneEngine::GetInput(uint8_t zone)
+{
+	return input[zone];
+}
+
+bool ZoneEngine::IsValid(uint8_t zone)
+{
+	return (valid & (1 << zone)) != 0;
+}
+
+void ZoneEngine::SetOutput(uint8_t zone, fixed_t output)
+{
+	if (output < 0)
+	{
+		output = 0;
+	}
+	else if (output > ZONE_OUTPUT_MAX)
+	{
+		output = ZONE_OUTPUT_MAX;
+	}
+	this->output[zone] = output;
+}
+
+fixed_t ZoneEngine::GetOutput(uint8_t zone)
+{
+	return output[zone];
+}
+
+/******************************************************************************
+ *
+ *	Function:		Compute
+ *
+ *	Description:	Works out every zone's output, in one pass.  The terms
+ *					are summed in 64 bits and clamped, so large gains &
+ *					errors can't overflow.  In manual, the outputs stay
+ *					where they are, and only the derivative's memory moves.
+ *
+ *****************************************************************************/
+
+void ZoneEngine::Compute()
+{
+	uint8_t zone;
+	uint8_t bit = 1;					// zone's bit in valid
+	fixed_t error;						// setpoint - process value [C]
+	int64_t sum;						// [%, fixed point]
+
+	for (zone = 0; zone < ZONE_COUNT; zone++, bit <<= 1)
+	{
+		if (!(valid & bit))
+		{
+			output[zone] = 0;
+			continue;
+		}
+		if (!automatic)
+		{
+			lastInput[zone] = input[zone];
+			continue;
+		}
+
+		error = setpoint[zone] - input[zone];
+
+		sum = integral[zone] +
+			(((int64_t)kiStep[zone] * error) >> FIXED_SHIFT);
+		sum = (sum < 0) ? 0 : ((sum > ZONE_OUTPUT_MAX) ?
+			ZONE_OUTPUT_MAX : sum);
+		integral[zone] = (fixed_t)sum;
+
+		sum += (((int64_t)kp[zone] * error) -
+			((int64_t)kdStep[zone] * (input[zone] - lastInput[zone]))) >>
+			FIXED_SHIFT;
+		output[zone] = (fixed_t)((sum < 0) ? 0 : ((sum > ZONE_OUTPUT_MAX) ?
+			ZONE_OUTPUT_MAX : sum));
+		lastInput[zone] = input[zone];
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		Initialize
+ *
+ *	Description:	Starts a zone's controller from its output as it is, the
+ *					way PID::Initialize does:  the integral term takes what
+ *					the proportional term doesn't give, so the first output
+ *					is the same, and the derivative starts from this
+ *					sample.  The integral is kept within the output range,
+ *					so a large error still moves the output right away.
+ *
+ *	Parameters:		zone - 0 to ZONE_COUNT - 1
+ *
+ *****************************************************************************/
+
+void ZoneEngine::Initialize(uint8_t zone)
+{
+	int64_t sum = output[zone] - (((int64_t)kp[zone] *
+		(setpoint[zone] - input[zone])) >> FIXED_SHIFT);	// [%]
+
+	integral[zone] = (fixed_t)((sum < 0) ? 0 : ((sum > ZONE_OUTPUT_MAX) ?
+		ZONE_OUTPUT_MAX : sum));
+	lastInput[zone] = input[zone];
+}
+
+// Gains go negative for reverse acting; the integral gain is per sample,
+// and the derivative gain per sample's change.
+void ZoneEngine::Scale(uint8_t zone)
+{
+	double sign = GetReverse(zone) ? -1 : 1;
+
+	kp[zone] = FixedFromDouble(sign * dispKp[zone]);
+	kiStep[zone] = FixedFromDouble(sign * dispKi[zone] * period / 1000);
+	kdStep[zone] = FixedFromDouble(sign * dispKd[zone] * 1000 / period);
+}
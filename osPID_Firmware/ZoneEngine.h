@@ -0,0 +1,149 @@
+#ifndef ZONE_ENGINE_H
+#define ZONE_ENGINE_H
+
+#include <stdint.h>
+#include "FixedPoint.h"
+
+// Number of zones.  The osPID has two sensors & two relays, so two zones;
+// each one more costs 48 bytes of RAM and a zoneRecord_t of EEPROM.  It can
+// be set on the command line (tools/zone_bench.cpp times up to 8).
+#ifndef ZONE_COUNT
+#define ZONE_COUNT			2
+#endif
+
+#if ZONE_COUNT > 8
+#error "ZONE_COUNT can't be over 8 (one bit per zone in a uint8_t)"
+#endif
+
+// Defaults for each zone
+#define ZONE_SETPOINT		50			// [C]
+#define ZONE_KP				2			// tunings
+#define ZONE_KI				0.5
+#define ZONE_KD				2
+#define ZONE_WINDOW			10000		// output window [mSec]
+#define ZONE_PERIOD			1000		// time between Computes [mSec]
+
+// Limits on the settings.  Tunings are kept in 16.16 fixed point, scaled
+// for the sample period, so they have to stay well inside its range.
+#define ZONE_MAX_GAIN		1000
+#define ZONE_MIN_PERIOD		100			// [mSec]
+#define ZONE_MIN_SETPOINT	-200		// [C]
+#define ZONE_MAX_SETPOINT	1500		// [C]
+#define ZONE_MIN_WINDOW		500			// [mSec]
+#define ZONE_MAX_WINDOW		600000		// [mSec]
+
+// Flags in a zoneRecord_t
+#define ZONE_REVERSE		0x01		// reverse acting (cooling)
+
+typedef enum							// status from functions
+{
+	ZONE_RESULT_OK,						// All is well!
+	ZONE_RESULT_FAIL,					// It's the hardware's fault.
+	ZONE_RESULT_INVALID,				// It's your fault.
+	ZONE_RESULT_NOT_IMPLEMENTED,		// It's my fault.
+} zoneResult_t;
+
+typedef struct __attribute__((packed))	// a zone's settings, as saved
+{
+	float setpoint;						// [C]
+	float kp;							// tunings
+	float ki;
+	float kd;
+	uint16_t window;					// output window [0.1 sec]
+	uint8_t flags;						// ZONE_REVERSE
+} zoneRecord_t;
+
+class ZoneEngine
+{
+public:
+	// Initialize the class, with every zone at the defaults, in manual.
+	ZoneEngine();
+
+	// Set a zone's tunings:  proportional gain [%/C], integral gain
+	// [%/(C sec)] & derivative gain [% sec/C].
+	zoneResult_t SetTunings(uint8_t zone, double kp, double ki, double kd);
+
+	// Fetch a zone's tunings.
+	double GetKp(uint8_t zone);
+	double GetKi(uint8_t zone);
+	double GetKd(uint8_t zone);
+
+	// Make a zone reverse acting (its output cools), or direct acting.
+	zoneResult_t SetReverse(uint8_t zone, bool reverse);
+
+	// Find if a zone is reverse acting.
+	bool GetReverse(uint8_t zone);
+
+	// Set a zone's setpoint [C, fixed point].
+	zoneResult_t SetSetpoint(uint8_t zone, fixed_t setpoint);
+
+	// Fetch a zone's setpoint [C, fixed point].
+	fixed_t GetSetpoint(uint8_t zone);
+
+	// Set a zone's output window [mSec].  The engine only keeps it; the
+	// output card does the switching.
+	zoneResult_t SetWindow(uint8_t zone, unsigned long window);
+
+	// Fetch a zone's output window [mSec].
+	unsigned long GetWindow(uint8_t zone);
+
+	// Fetch, or fill in, a zone's settings as saved.
+	void GetRecord(uint8_t zone, zoneRecord_t *record);
+	zoneResult_t SetRecord(uint8_t zone, const zoneRecord_t *record);
+
+	// Set the time between calls to Compute [mSec].
+	void SetSamplePeriod(unsigned long period);
+
+	// Run the zones' controllers (true), or leave their outputs where they
+	// are (false).  Switching to automatic is bumpless.
+	void SetAutomatic(bool automatic);
+
+	// Give a zone its new process value [C, fixed point], or tell it its
+	// sensor can't be trusted (valid false).
+	void SetInput(uint8_t zone, fixed_t value, bool valid);
+
+	// Fetch a zone's process value [C, fixed point].
+	fixed_t GetInput(uint8_t zone);
+
+	// Find if a zone's process value can be trusted.
+	bool IsValid(uint8_t zone);
+
+	// Set a zone's output in manual [%, fixed point].
+	void SetOutput(uint8_t zone, fixed_t output);
+
+	// Fetch a zone's output [%, fixed point].
+	fixed_t GetOutput(uint8_t zone);
+
+	// Run every zone's controller once.  Call once per sample period,
+	// after giving every zone its input.
+	void Compute();
+
+private:
+	// Per-zone state, one array per field, so Compute walks each array in
+	// order and no zone's state has to be gathered up from a structure.
+	fixed_t setpoint[ZONE_COUNT];		// [C]
+	fixed_t input[ZONE_COUNT];			// process value [C]
+	fixed_t lastInput[ZONE_COUNT];		// last sample's [C]
+	fixed_t output[ZONE_COUNT];			// [%]
+	fixed_t integral[ZONE_COUNT];		// integral term [%]
+	fixed_t kp[ZONE_COUNT];				// gains, signed for the direction
+	fixed_t kiStep[ZONE_COUNT];			// and scaled for the sample
+	fixed_t kdStep[ZONE_COUNT];			// period
+	double dispKp[ZONE_COUNT];			// tunings as they were set, which
+	double dispKi[ZONE_COUNT];			// the gains are worked out from
+	double dispKd[ZONE_COUNT];
+	uint32_t window[ZONE_COUNT];		// output window [mSec]
+	uint8_t reverse;					// bit n set if zone n is reverse
+	uint8_t valid;						// bit n set if zone n's input is
+										// good
+	bool automatic;						// true while computing
+	unsigned long period;				// time between Computes [mSec]
+
+	// Work out a zone's gains from its tunings, signed & scaled.
+	void Scale(uint8_t zone);
+
+	// Start a zone's controller from its output as it is.
+	void Initialize(uint8_t zone);
+};
+
+#endif
@@ -12,12 +12,31 @@
 // Libraries
 #include <LiquidCrystal.h>
 #include <EEPROM.h>
+#include <avr/wdt.h>
 #include "AnalogButton_local.h"
 #include "EEPROMAnything.h"
 #include "InputCard.h"
 #include "OutputCard.h"
-#include "PID_v1.h"
+#include "PID_v1_local.h"
 #include "PID_AutoTune_v0.h"
+#include "SmithPredictor.h"
+#include "StepTest.h"
+#include "SensorSupervisor.h"
+#include "SafetySupervisor.h"
+#include "StackMonitor.h"
+#include "StateEstimator.h"
+#include "PowerSave.h"
+#include "ModbusSlave.h"
+#include "AdaptiveSampler.h"
+#include "Thermostat.h"
+#include "NumberFormat.h"
+#include "Recipe.h"
+#include "SetpointRamp.h"
+#include "SplitRange.h"
+#include "ConfigBlob.h"
+#include "RunStats.h"
+#include "ZoneEngine.h"
+#include "Trace.h"
 
 #define PROJECT			" osPID"		// project name
 #define FVN				" alpha"		// firmware version
@@ -40,21 +59,206 @@ const byte pinKeys		= A3;			// analog buttons pin
 const byte pinTherm		= A6;			// thermistor pin
 
 // Button hardware settings
-const byte key0Level = 0;				// ADC level for button 0
-const byte key1Level = 253;				// ADC level for button 1
-const byte key2Level = 454;				// ADC level for button 2
-const byte key3Level = 657;				// ADC level for button 3
+const int key0Level = 0;				// ADC level for button 0
+const int key1Level = 253;				// ADC level for button 1
+const int key2Level = 454;				// ADC level for button 2
+const int key3Level = 657;				// ADC level for button 3
 
 // Other settings
 const int baudRate = 9600;				// USB serial port baud rate
 const byte lcdRows = 2;					// LCD's number of lines
 const byte lcdColumns = 8;				// LCD's number of characters per line
+const unsigned long basePeriod = 1000;	// time between PID updates when
+										// not adapting [mSec]
+const unsigned long reportPeriod = 1000;	// time between reports [mSec]
+const unsigned long buttonPeriod = 20;	// time between button checks [mSec]
+const unsigned int alarmTone = 2000;	// buzzer frequency for alarms [Hz]
+const unsigned long sensorStartup = 200;	// time before the first sample:
+										// twice the MAX31855's first
+										// conversion after power-up [mSec]
+const unsigned long checkpointPeriod = 60000;	// time between run
+										// checkpoints [mSec]
+const unsigned long minSummaryRun = 60000;	// shortest run whose
+										// statistics are saved [mSec]
+const double defaultTolerance = 1;		// tolerance band, either side of
+										// the setpoint [C]
+
+// Default tunings (the PID keeps the working copies)
+const double defaultKp = 2;				// proportional gain
+const double defaultKi = 0.5;			// integral gain
+const double defaultKd = 2;				// derivative gain
+
+// Cascade control settings.  The default tunings suit the jacketed vessel
+// in tools/cascade_sim.cpp; tune them for the real one.
+const byte cascadeRatio = 4;			// samples per run of the outer loop
+const double cascadeMinInner = 0;		// inner setpoint limits [C]
+const double cascadeMaxInner = 250;
+const double defaultOuterKp = 5;		// outer loop (product) tunings
+const double defaultOuterKi = 0.002;
+const double defaultOuterKd = 0;
+const double defaultInnerKp = 4;		// inner loop (heater) tunings
+const double defaultInnerKi = 0.1;
+const double defaultInnerKd = 0;
+
+// Controller types
+#define CTRL_TYPE_PID		0			// plain PID
+#define CTRL_TYPE_SMITH		1			// PID with Smith predictor
+#define CTRL_TYPE_ONOFF		2			// on/off with hysteresis
+#define CTRL_TYPE_CASCADE	3			// PID on the thermocouple sets the
+										// setpoint of a PID on the thermistor
+#define CTRL_TYPE_ZONES		4			// independent zones, each with its
+										// own sensor & relay (see RunZones)
+
+// Serial port protocols
+#define PROTOCOL_TEXT		0			// text commands & reports
+#define PROTOCOL_MODBUS		1			// Modbus RTU slave
+
+// Control variables
+double setpoint = 50;					// setpoint [C]
+double workingSetpoint = 50;			// setpoint the controller works to,
+										// on its way to setpoint [C]
+bool rampFromPV = true;					// true to start the working setpoint
+										// from the PV at the next sample
+double processValue = 0;				// measured process value [C]
+double feedbackValue = 0;				// process value seen by the PID [C]
+double outputValue = 0;					// controller output [%]:  0 to 100,
+										// or -100 (full cooling) to 100
+										// (full heat) in split range
+byte ctrlDirection = DIRECT;			// direct or reverse acting
+byte modeIndex = MANUAL;				// manual or automatic
+byte ctrlType = CTRL_TYPE_PID;			// PID, Smith predictor or on/off
+bool splitOutput = false;				// true for split-range heat & cool
+										// output (see SplitActive)
+unsigned long coolMinOff = 0;			// cool side's minimum off time
+										// [mSec] (see SetOutputSides)
+byte useEstimator = false;				// true to control on the fused PV
+double rateValue = 0;					// estimated PV rate of change [C/sec]
+
+// Cascade control variables
+double innerValue = 0;					// inner loop's process value (the
+										// thermistor) [C]
+double innerSetpoint = 0;				// inner loop's setpoint, from the
+										// outer loop [C]
+byte cascadeCount = 0;					// samples until the outer loop runs
+
+// Zone control variables.  Zone n + 1 reads zoneSensor[n], and drives the
+// output relay (zone 1) or the other one (zone 2).
+const inputSensor_t zoneSensor[ZONE_COUNT] =
+	{ INPUT_SENSOR_THERMOCOUPLE, INPUT_SENSOR_THERMISTOR };
+unsigned int zoneCost = 0;				// time to compute, per zone, last
+										// sample [uSec]
+unsigned int zoneCostMax = 0;			// the most it's been since boot
+
+// Sensor failure variables
+bool inputFailed = false;				// true when no sensor can be trusted
+double safeOutput = 0;					// output when inputs fail [%]
+double faultOutput;						// output when inputs failed [%]
+
+// Step test variables
+double aTuneStep = 20;					// output step [%]
+double aTuneNoise = 1;					// PV noise band [C]
+double aTuneLookBack = 10;				// settling time to check [seconds]
+
+// Serial port variables
+byte serialProtocol = PROTOCOL_TEXT;	// what the serial port speaks
+sleepStats_t sleepStats;				// where the time went, last sample
+
+// Relay wear variables
+typedef struct							// relay operation counts, as saved
+{
+	unsigned long count[2];				// operations of each relay
+	uint16_t check;						// RelayWearCheck of the counts
+} relayWear_t;
+
+byte wearSlot = 0;						// EEPROM slot last saved to
+unsigned long wearSaved = 0;			// total operations when last saved
+unsigned long bootCount[2];				// operations of each relay at boot
+
+// Run checkpoint variables
+typedef struct							// run state, as saved
+{
+	uint16_t sequence;					// goes up by one per checkpoint
+	byte mode;							// modeIndex
+	byte recipe;						// activeRecipe
+	float output;						// outputValue [%]
+	unsigned long elapsed;				// time into the run [seconds]
+	uint16_t check;						// RecordCheck of the above
+} checkpoint_t;
+
+bool running = false;					// true while in automatic mode
+unsigned long runStart;					// time the run started [mSec]
+unsigned long lastCheckpoint;			// time of the last checkpoint [mSec]
+byte checkpointSlot = 0;				// EEPROM slot last saved to
+uint16_t checkpointSequence = 0;		// sequence of the last checkpoint
+unsigned long resumed = 0;				// time into the run it resumed at
+										// after a reset [seconds], or 0
+
+// Run statistics variables
+fixed_t statsTolerance = FixedFromDouble(defaultTolerance);	// tolerance
+										// band, either side of the
+										// setpoint [C]
+unsigned long lifeStart = 0;			// time the lifetime statistics
+										// started [mSec]
+byte summarySlot = 0;					// EEPROM slot last saved to
+uint16_t summarySequence = 0;			// sequence of the last summary
+
+// Boot timing variables
+unsigned long bootSettings;				// time to load settings [uSec]
+unsigned long bootOutput = 0;			// time from reset to the first
+										// control output [mSec]
+
+// Recipe variables
+byte activeRecipe = 0;					// recipe last loaded (1 to
+										// RECIPE_COUNT), or 0 for none
+byte pendingRecipe = 0;					// recipe to load at the next sample
+byte recipesStored = 0;					// bit n set if recipe n + 1 is saved
+char recipeName[RECIPE_NAME_SIZE];		// active recipe's name
+
+// Serial command buffer
+char serialBuffer[24];					// command being received
+byte serialIndex = 0;					// number of characters received
+
+// Configuration import variables
+bool configImporting = false;			// true while a blob is coming in
+unsigned int configReceived;			// bytes of it received
+unsigned long configLastByte;			// when the last one came [mSec]
+
+// Sample timing variables
+unsigned long samplePeriod = basePeriod;	// time between PID updates [mSec]
+byte adaptiveSampling = true;			// true to adapt samplePeriod
+unsigned long lastSample;				// time of the last sample [mSec]
+unsigned long lastReport;				// time of the last report [mSec]
+unsigned long lastButton;				// time the buttons were checked [mSec]
 
 // Objects
 LiquidCrystal lcd(pinLCDrs, pinLCDen, pinLCDd4, pinLCDd5, pinLCDd6, pinLCDd7);
 AnalogButton button(pinKeys, key0Level, key1Level, key2Level, key3Level);
 InputCard input(pinTherm, pinCS, pinMISO, pinCLK);
 OutputCard output(pinRelay1, pinRelay2);
+PID myPID(&feedbackValue, &outputValue, &workingSetpoint,
+	defaultKp, defaultKi, defaultKd, DIRECT);
+PID outerPID(&processValue, &innerSetpoint, &workingSetpoint,
+	defaultOuterKp, defaultOuterKi, defaultOuterKd, DIRECT);
+PID innerPID(&innerValue, &outputValue, &innerSetpoint,
+	defaultInnerKp, defaultInnerKi, defaultInnerKd, DIRECT);
+SmithPredictor smith;
+StepTest stepTest;
+SensorSupervisor supervisor(&input);
+SafetySupervisor safety;
+StateEstimator estimator;
+ModbusSlave modbus;
+AdaptiveSampler sampler;
+Thermostat thermostat;
+SetpointRamp ramp;
+SplitRange splitRange;
+RunStats runStats;						// this run's statistics
+RunStats lifeStats;						// statistics since boot (or `z`)
+ZoneEngine zones;
+SafetySupervisor zoneSafety[ZONE_COUNT];	// runaway checks on each zone
+										// (safety holds the alarm)
+uint8_t ConfigRead(uint16_t address);	// (ConfigBlob's EEPROM access)
+void ConfigWrite(uint16_t address, uint8_t data);
+ConfigBlob config(ConfigRead, ConfigWrite);
 
 /******************************************************************************
  *
@@ -67,33 +271,102 @@ OutputCard output(pinRelay1, pinRelay2);
 
 void setup(void)
 {
-	// Initialize UART.
+	byte resetCause;					// why the processor was reset
+	byte alarm;							// alarm latched before the reset
+	unsigned long start;				// micros() before loading settings
+
+	// Stop the watchdog in case it reset us, or it'll do it again.
+	resetCause = MCUSR;
+	MCUSR = 0;
+	wdt_disable();
+
+	// Initialize UART.  It doesn't wait for anything.
 	Serial.begin(baudRate);
 
-	// Initialize LCD (8 chars wide, 2 chars tall).
-	lcd.begin(lcdColumns, lcdRows);
+	// Load settings from EEPROM, and pick up a run the power cut short.
+	start = micros();
+	MemoryInit();
+	bootSettings = micros() - start;
+
+	// Set up the process model.
+	smith.SetSamplePeriod(basePeriod);
+	smith.Reset(outputValue);
+
+	// Set up sensor checking & the setpoint ramp.
+	supervisor.SetSamplePeriod(samplePeriod);
+	estimator.SetSamplePeriod(samplePeriod);
+	ramp.SetSamplePeriod(samplePeriod);
+
+	// Set up PID library.  In automatic mode, it starts from the output
+	// it had at the last checkpoint.
+	myPID.SetSampleTime(samplePeriod);
+	myPID.SetOutputLimits(OutputMin(), 100);
+	myPID.SetControllerDirection(ctrlDirection);
+	myPID.SetMode(modeIndex);
+
+	// Set up cascade control.  The outer loop runs every cascadeRatio
+	// samples, which are always basePeriod apart in cascade.
+	outerPID.SetSampleTime(basePeriod * cascadeRatio);
+	outerPID.SetOutputLimits(cascadeMinInner, cascadeMaxInner);
+	innerPID.SetSampleTime(basePeriod);
+	innerPID.SetOutputLimits(OutputMin(), 100);
+
+	// Set up on/off control.  The minimum off time starts now, in case
+	// the relay was on just before the reset.
+	thermostat.SetReverse(ctrlDirection == REVERSE);
+	thermostat.Reset(false, millis());
+
+	// Set up zone control.  Zones always run at basePeriod, and zone 1
+	// starts from the output it had at the last checkpoint.
+	zones.SetSamplePeriod(basePeriod);
+	zones.SetOutput(0, FixedFromDouble(outputValue));
+	SetOutputSides();
+
+	// A runaway alarm stays latched through a reset.
+	safety.SetReverse(ctrlDirection == REVERSE);
+	EEPROM_readAnything(SAFETY_ALARM_ADDR, alarm);
+	if (alarm != SAFETY_ALARM_NONE)
+	{
+		safety.SetAlarm((safetyAlarm_t)alarm);
+		Alarm();
+	}
 
-	// Display firmware version.
+	// Put the output back to work before the slow parts.
+	DriveOutput();
+
+	// Start talking.
+	StartProtocol();
+	if (serialProtocol == PROTOCOL_TEXT)
+	{
+		if (resetCause & (1 << WDRF))
+		{
+			Serial.println(F("watchdog reset"));
+		}
+		if (resumed != 0)
+		{
+			Serial.print(F("resumed "));
+			Serial.println(resumed);
+		}
+	}
+
+	// Initialize LCD (8 chars wide, 2 chars tall), and display the firmware
+	// version.  It stays up until the first report.
+	lcd.begin(lcdColumns, lcdRows);
 	lcd.setCursor(0, 0);
 	lcd.print(F(PROJECT));
 	lcd.setCursor(0, 1);
 	lcd.print(F(FVN));
-	
-	// Wait 1 second.
-	delay(1000);
-	
-	// Set up the display for temperature.
-	lcd.setCursor(0, 0);
-	lcd.print("temp  ");
-	lcd.setCursor(0, 1);
-	lcd.print("      C");
-	
-	// Set up PID library.
-//	myPID.SetSampleTime(1000);
-//	myPID.SetOutputLimits(0, 100);
-//	myPID.SetTunings(kp, ki, kd);
-//	myPID.SetControllerDirection(ctrlDirection);
-//	myPID.SetMode(modeIndex);
+
+	// The first sample is taken as soon as the sensors can give one.
+	while (millis() < sensorStartup)
+	{
+		output.Service();
+		SleepIdle();
+	}
+	safety.Begin();
+
+	lastSample = millis() - samplePeriod;
+	lastReport = lastSample - reportPeriod;
 }
 
 /******************************************************************************
@@ -107,25 +380,3081 @@ void setup(void)
 
 void loop()
 {
-	double temperature;
-	
-	// Read the temperature from the input card.
-	temperature = input.ReadFromCard();
+	// Let the watchdog know we're still going.
+	safety.CheckIn(SAFETY_TASK_LOOP);
+	safety.Service();
 
-	// Report the temperature to the user.
-	Serial.print(temperature);
-	Serial.println(" C");
+	// Handle commands from the serial port.
+	if (serialProtocol == PROTOCOL_MODBUS)
+	{
+		modbus.Poll();
+	}
+	else
+	{
+		ProcessSerial();
+	}
 
-	// Display the temperature.
-	lcd.setCursor(0, 1);
-	lcd.print(temperature);
-	
-	// Set output.
-//	output.SetRelayState(0, HIGH);
-//	output.SetRelayState(1, HIGH);
-	output.SetOutput(50.0);
+	// If it's time, sample the input and run the controller.
+	if (millis() - lastSample >= samplePeriod)
+	{
+		SleepCheckLatency(lastSample + samplePeriod);
+		lastSample += samplePeriod;
+		TRACE_BEGIN(TRACE_SAMPLE, 0);
+		Sample();
+		TRACE_END(TRACE_SAMPLE, 0);
+		if (bootOutput == 0)
+		{
+			bootOutput = millis();
+		}
+	}
+
+	// Check the buttons.  OK steps to the next recipe.
+	if (millis() - lastButton >= buttonPeriod)
+	{
+		lastButton = millis();
+		if (button.Get() == BUTTON_OK)
+		{
+			NextRecipe();
+		}
+	}
+
+	// Pass on the output, and switch the relays if one of their edges is
+	// due.  Both cost next to nothing when there's nothing to do, so relay
+	// edges land within a timer tick of when they should.
+	DriveOutput();
+	MemoryBackupRelayWear();
+
+	// Nothing else can happen until an interrupt, so sleep until one comes.
+	// The timer tick wakes us in time for the relay's next edge.
+	SleepIdle();
+}
+
+/******************************************************************************
+ *
+ *	Function:		Sample
+ *
+ *	Description:	Reads the input, runs the controller & reports the
+ *					results.  Runs once per sample period.
+ *
+ *****************************************************************************/
+
+void Sample(void)
+{
+	inputResult_t result;				// how the input read went
+	inputSample_t sample;				// the reading, & when it was taken
+
+	safety.CheckIn(SAFETY_TASK_SAMPLE);
+
+	// Load a recipe between samples, so all of it takes effect at once.
+	if (pendingRecipe != 0)
+	{
+		ApplyRecipe(pendingRecipe);
+		pendingRecipe = 0;
+	}
+
+	// Read the temperature from the input card.  If no sensor can be
+	// trusted, hold the output in its safe state until one can.  The PID
+	// works from when the reading was taken, not when it was due.
+	TRACE_BEGIN(TRACE_SENSOR, supervisor.GetActiveSensor());
+	result = supervisor.Read(&sample);
+	processValue = sample.value;
+	TRACE_END(TRACE_SENSOR, supervisor.GetActiveSensor());
+
+	// Each zone reads its own sensor and copes with its own failures, so
+	// one zone's fault doesn't stop the other.  Only zone 1 is counted in
+	// the statistics.
+	if (ctrlType == CTRL_TYPE_ZONES)
+	{
+		RunZones();
+		CheckSafety();
+		CheckpointRun();
+		if (zones.IsValid(0))
+		{
+			UpdateStats();
+		}
+		AdaptSamplePeriod();
+		Report();
+		return;
+	}
+
+	// Cascade control needs both sensors, each on its own scale:  the
+	// thermocouple in the product, and the thermistor on the heater.
+	if ((result == INPUT_RESULT_OK) && (ctrlType == CTRL_TYPE_CASCADE) &&
+		!(supervisor.GetRawReading(INPUT_SENSOR_THERMOCOUPLE, &processValue) &&
+		supervisor.GetRawReading(INPUT_SENSOR_THERMISTOR, &innerValue)))
+	{
+		result = INPUT_RESULT_FAIL;
+	}
+
+	if (result != INPUT_RESULT_OK)
+	{
+		if (!inputFailed)
+		{
+			inputFailed = true;
+			faultOutput = outputValue;
+			stepTest.Cancel();
+			myPID.SetMode(MANUAL);
+			outerPID.SetMode(MANUAL);
+			innerPID.SetMode(MANUAL);
+		}
+
+		estimator.Reset();
+		rateValue = 0;
+		rampFromPV = true;
+		output.SetError(NAN);
+		outputValue = safeOutput;
+		smith.Update(outputValue);
+		CheckSafety();
+		AdaptSamplePeriod();
+		Report();
+		return;
+	}
+
+	// Fuse both sensors, and use the result if we're asked to.
+	Estimate();
+
+	// Move the working setpoint toward the setpoint.  Outside automatic
+	// mode (and after a reset or an input failure) it waits at the process
+	// value, so control starts with a ramp from where the process is.
+	if ((modeIndex != AUTOMATIC) || rampFromPV)
+	{
+		ramp.Reset(FixedFromDouble(processValue));
+		rampFromPV = false;
+	}
+	workingSetpoint = FixedToDouble(ramp.Update(FixedFromDouble(setpoint)));
+	output.SetError(workingSetpoint - processValue);
+
+	// If a step test is running, feed it the new value.
+	if (stepTest.GetState() == STEP_TEST_RUNNING)
+	{
+		if (stepTest.Run(processValue) != STEP_TEST_RUNNING)
+		{
+			FinishStepTest();
+		}
+	}
+
+	// Correct the process value for dead time if we're asked to.
+	if (ctrlType == CTRL_TYPE_SMITH)
+	{
+		feedbackValue = smith.Predict(processValue);
+	}
+	else
+	{
+		feedbackValue = processValue;
+	}
+
+	// If the input just came back, pick up where we left off.  In automatic
+	// the PID starts from the safe output, so there's no bump.
+	if (inputFailed)
+	{
+		inputFailed = false;
+		if (modeIndex == MANUAL)
+		{
+			outputValue = faultOutput;
+		}
+		myPID.SetMode(modeIndex);
+		thermostat.Reset(outputValue > 0, lastSample);
+	}
+
+	// Run the controller, then let the model see what it decided.  Through
+	// the Smith predictor, the PID has to difference its own input.  In
+	// on/off & cascade modes the PID sits idle; SetCtrlType restarts it.
+	TRACE_BEGIN(TRACE_CONTROL, ctrlType);
+	if (ctrlType == CTRL_TYPE_ONOFF)
+	{
+		if (modeIndex == AUTOMATIC)
+		{
+			outputValue = thermostat.Update(FixedFromDouble(feedbackValue),
+				ramp.GetSetpoint(), lastSample) ? 100 : 0;
+		}
+	}
+	else if (ctrlType == CTRL_TYPE_CASCADE)
+	{
+		RunCascade(sample.time);
+	}
+	else
+	{
+		myPID.SetRateInput((useEstimator && (ctrlType == CTRL_TYPE_PID)) ?
+			&rateValue : NULL);
+		myPID.Compute(sample.time);
+	}
+	TRACE_END(TRACE_CONTROL, ctrlType);
+	smith.Update(outputValue);
+
+	CheckSafety();
+	CheckpointRun();
+	UpdateStats();
+	AdaptSamplePeriod();
+	Report();
+}
+
+/******************************************************************************
+ *
+ *	Function:		CheckpointRun
+ *
+ *	Description:	Keeps track of the run:  the time since automatic mode
+ *					started (or a recipe was loaded), and saves it with the
+ *					output every checkpointPeriod, so a run cut short by a
+ *					power failure resumes where it left off.  A run's first
+ *					checkpoint is saved as it starts.  None are saved while
+ *					the inputs have failed, since the output isn't the
+ *					controller's then.  The run's statistics start afresh
+ *					with it.
+ *
+ *****************************************************************************/
+
+void CheckpointRun(void)
+{
+	if (modeIndex != AUTOMATIC)
+	{
+		EndRun();
+		return;
+	}
+
+	if (!running)
+	{
+		running = true;
+		runStart = lastSample;
+		lastCheckpoint = lastSample - checkpointPeriod;
+		runStats.Reset();
+	}
+
+	if (lastSample - lastCheckpoint >= checkpointPeriod)
+	{
+		lastCheckpoint = lastSample;
+		MemoryBackupCheckpoint();
+	}
+}
+
+// End the run, and save its statistics if it was long enough to count.
+void EndRun(void)
+{
+	if (running && !runStats.IsEmpty() &&
+		(lastSample - runStart >= minSummaryRun))
+	{
+		MemoryBackupRunSummary();
+	}
+	running = false;
+}
+
+/******************************************************************************
+ *
+ *	Function:		UpdateStats
+ *
+ *	Description:	Adds the sample to the lifetime statistics, and to the
+ *					run's while there is one.  Each sample counts for the
+ *					sample period it ends, so the statistics are averages
+ *					over time however the period adapts.  Samples taken
+ *					while the inputs have failed aren't counted.
+ *
+ *****************************************************************************/
+
+void UpdateStats(void)
+{
+	fixed_t value = FixedFromDouble(processValue);
+	fixed_t error = value - FixedFromDouble(setpoint);
+	fixed_t out = FixedFromDouble(outputValue);
+	bool inTolerance = (error >= -statsTolerance) &&
+		(error <= statsTolerance);
+
+	lifeStats.Add(value, out, inTolerance, samplePeriod);
+	if (running)
+	{
+		runStats.Add(value, out, inTolerance, samplePeriod);
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		DriveOutput
+ *
+ *	Description:	Passes the controller output to the output card, and
+ *					switches the relays if it's time.  In split range, the
+ *					output is split between the heat side (the output relay)
+ *					and the cool side (the other relay) first; the split is
+ *					a couple of multiplies, so it's done every pass.  In
+ *					zone control, each relay takes its own zone's output.
+ *
+ *****************************************************************************/
+
+void DriveOutput(void)
+{
+	double heat;						// heat side's output [%]
+	double cool;						// cool side's output [%]
+
+	if (ctrlType == CTRL_TYPE_ZONES)
+	{
+		output.SetOutput(FixedToDouble(zones.GetOutput(0)));
+		output.SetCoolOutput(FixedToDouble(zones.GetOutput(1)));
+	}
+	else if (SplitActive())
+	{
+		splitRange.Map(outputValue, &heat, &cool);
+		output.SetOutput(heat);
+		output.SetCoolOutput(cool);
+	}
+	else
+	{
+		output.SetOutput(outputValue);
+	}
+	output.Service();
+}
+
+// True if the output is split between heating & cooling.  The choice is
+// kept through zone control, which uses the other relay for zone 2.
+bool SplitActive(void)
+{
+	return splitOutput && (ctrlType != CTRL_TYPE_ZONES);
+}
+
+// The lowest controller output:  full cooling in split range.
+double OutputMin(void)
+{
+	return SplitActive() ? -100 : 0;
+}
+
+// Give the other relay to split range or to zone 2, and each relay its
+// zone's window in zone control.  Zone 2 runs a heater, so it doesn't get
+// the cool side's minimum off time, which keeps a compressor from short
+// cycling.
+void SetOutputSides(void)
+{
+	bool zoned = (ctrlType == CTRL_TYPE_ZONES);
+
+	output.SetSplit(splitOutput || zoned);
+	output.SetSideWindow(false, zoned ? zones.GetWindow(0) : 0);
+	output.SetSideWindow(true, zoned ? zones.GetWindow(1) : 0);
+	output.SetMinOffTime(true, zoned ? 0 : coolMinOff);
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetSplit
+ *
+ *	Description:	Turns split-range output on or off, and saves the
+ *					choice.  The PIDs' output ranges follow:  -100 to 100%
+ *					in split range, 0 to 100% without.  Turning it off
+ *					brings a cooling output (and the output used when the
+ *					inputs fail) back to 0%.
+ *
+ *	Parameters:		split - true for split-range heat & cool output
+ *
+ *****************************************************************************/
+
+void SetSplit(bool split)
+{
+	splitOutput = split;
+	SetOutputSides();
+	myPID.SetOutputLimits(OutputMin(), 100);
+	innerPID.SetOutputLimits(OutputMin(), 100);
+	outputValue = constrain(outputValue, OutputMin(), 100);
+	safeOutput = constrain(safeOutput, OutputMin(), 100);
+	EEPROM_writeAnything(SPLIT_ADDR, (byte)split);
+	MemoryBackupDash();
+	MemoryBackupInput();
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetSplitSide
+ *
+ *	Description:	Sets (or reports) one side's split-range gain and its
+ *					relay's minimum off time, from the text after an h or c
+ *					command:  "<gain> <min off time [sec]>".  The minimum
+ *					off time keeps a compressor from being restarted too
+ *					soon after it stops.
+ *
+ *	Parameters:		cool - false for the heat side, true for the cool side
+ *					text - the gain & minimum off time, or nothing to
+ *						report them
+ *
+ *****************************************************************************/
+
+void SetSplitSide(bool cool, char *text)
+{
+	double gain;						// new gain
+	double offTime;						// new minimum off time [sec]
+	char number[FORMAT_SIZE];			// a setting, as text
+
+	if (*text == '\0')
+	{
+		Serial.print(F("side "));
+		Serial.print(FormatDouble(number, cool ? splitRange.GetCoolGain() :
+			splitRange.GetHeatGain(), 2, 0));
+		Serial.print(' ');
+		Serial.println((cool ? coolMinOff : output.GetMinOffTime(false)) /
+			1000);
+		return;
+	}
+
+	gain = strtod(text, &text);
+	offTime = strtod(text, &text);
+	if ((offTime < 0) || (splitRange.SetGains(
+		cool ? splitRange.GetHeatGain() : gain,
+		cool ? gain : splitRange.GetCoolGain()) != SPLIT_RESULT_OK))
+	{
+		return;
+	}
+
+	if (cool)
+	{
+		coolMinOff = (unsigned long)(offTime * 1000);
+		SetOutputSides();
+	}
+	else
+	{
+		output.SetMinOffTime(false, (unsigned long)(offTime * 1000));
+	}
+	MemoryBackupSplit();
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetCtrlType
+ *
+ *	Description:	Switches between the plain PID, the PID with Smith
+ *					predictor, on/off control, cascade control and zone
+ *					control, and saves the choice.  The PID sits idle during
+ *					on/off, cascade & zone control, so it's restarted from
+ *					the current output (without a bump), and on/off control
+ *					starts from the relay's current state.  The cascade
+ *					loops are stopped, so RunCascade starts them afresh.
+ *					Zone 1 takes over the output as it is; zone 2 takes the
+ *					other relay from split range until zone control ends.
+ *
+ *	Parameters:		type - CTRL_TYPE_PID, CTRL_TYPE_SMITH, CTRL_TYPE_ONOFF,
+ *						CTRL_TYPE_CASCADE or CTRL_TYPE_ZONES
+ *
+ *****************************************************************************/
+
+void SetCtrlType(byte type)
+{
+	byte zone;
+
+	ctrlType = type;
+	smith.Reset(outputValue);
+	thermostat.Reset(outputValue > 0, millis());
+	outerPID.SetMode(MANUAL);
+	innerPID.SetMode(MANUAL);
+	if ((ctrlType == CTRL_TYPE_CASCADE) || (ctrlType == CTRL_TYPE_ZONES))
+	{
+		// The loops' gains are set for basePeriod.
+		sampler.SetPeriod(basePeriod);
+		SetSamplePeriod(basePeriod);
+	}
+	if (ctrlType == CTRL_TYPE_ZONES)
+	{
+		// The zones look after their own sensors, and step tests don't
+		// run on them.  Their runaway checks start afresh.
+		stepTest.Cancel();
+		for (zone = 0; zone < ZONE_COUNT; zone++)
+		{
+			zoneSafety[zone].ClearAlarm();
+		}
+		inputFailed = false;
+		outputValue = constrain(outputValue, 0, 100);
+		zones.SetAutomatic(false);
+		zones.SetOutput(0, FixedFromDouble(outputValue));
+	}
+	SetOutputSides();
+	myPID.SetOutputLimits(OutputMin(), 100);
+	innerPID.SetOutputLimits(OutputMin(), 100);
+	if (!inputFailed)
+	{
+		myPID.SetMode(MANUAL);
+		myPID.SetMode(modeIndex);
+	}
+	EEPROM_writeAnything(CTRL_TYPE_ADDR, ctrlType);
+}
+
+/******************************************************************************
+ *
+ *	Function:		RunCascade
+ *
+ *	Description:	Runs cascade control:  the outer loop compares the
+ *					product's temperature (the thermocouple) with the
+ *					setpoint and picks a temperature for the heater; the
+ *					inner loop drives the output to hold the heater (the
+ *					thermistor) there.  A disturbance at the heater, such as
+ *					a drop in supply voltage, is corrected by the inner loop
+ *					before the product feels it.
+ *
+ *					The inner loop runs every sample and the outer loop
+ *					every cascadeRatio samples, counted, not timed, so the
+ *					two stay in step whatever else the main loop is doing.
+ *					On its samples the outer loop runs first, so the inner
+ *					loop always works on a fresh setpoint.  Until the loops
+ *					are running, the inner setpoint follows the heater, so
+ *					they start without a bump.
+ *
+ *	Parameters:		time - when the sensors were read [microseconds]
+ *
+ *****************************************************************************/
+
+void RunCascade(unsigned long time)
+{
+	if ((modeIndex != AUTOMATIC) || (outerPID.GetMode() != AUTOMATIC))
+	{
+		innerSetpoint = constrain(innerValue, cascadeMinInner,
+			cascadeMaxInner);
+		cascadeCount = 0;
+	}
+
+	// The heater gets hotter as the output goes up (or colder, reverse
+	// acting), and the product follows the heater either way.
+	innerPID.SetControllerDirection(ctrlDirection);
+	outerPID.SetMode(modeIndex);
+	innerPID.SetMode(modeIndex);
+
+	if (cascadeCount == 0)
+	{
+		outerPID.Compute(time);
+	}
+	cascadeCount = (cascadeCount + 1) % cascadeRatio;
+	innerPID.Compute(time);
+}
+
+/******************************************************************************
+ *
+ *	Function:		RunZones
+ *
+ *	Description:	Runs zone control:  gives each zone its sensor's
+ *					reading, and works out every zone's output in one pass
+ *					of the zone engine.  Zone 1 works to the setpoint (with
+ *					no ramp) and stands in for the process value & output,
+ *					so the display, reports & run statistics follow it
+ *					(CheckSafety checks every zone).  In manual, O sets zone
+ *					1's output; zone 2's stays where it was.
+ *
+ *					The pass is timed, so the cost of each zone can be
+ *					checked (g reports it).
+ *
+ *****************************************************************************/
+
+void RunZones(void)
+{
+	double reading;						// a zone's reading [C]
+	bool valid;							// true if it can be trusted
+	unsigned long start;				// when Compute started [uSec]
+	byte zone;
+
+	workingSetpoint = setpoint;
+	rampFromPV = true;
+	zones.SetSetpoint(0, FixedFromDouble(setpoint));
+
+	for (zone = 0; zone < ZONE_COUNT; zone++)
+	{
+		valid = supervisor.GetRawReading(zoneSensor[zone], &reading);
+		zones.SetInput(zone, valid ? FixedFromDouble(reading) : 0, valid);
+	}
+
+	zones.SetAutomatic(modeIndex == AUTOMATIC);
+	if (modeIndex != AUTOMATIC)
+	{
+		zones.SetOutput(0, FixedFromDouble(outputValue));
+	}
+
+	TRACE_BEGIN(TRACE_CONTROL, ctrlType);
+	start = micros();
+	zones.Compute();
+	zoneCost = (micros() - start) / ZONE_COUNT;
+	TRACE_END(TRACE_CONTROL, ctrlType);
+	if (zoneCost > zoneCostMax)
+	{
+		zoneCostMax = zoneCost;
+	}
+
+	processValue = zones.IsValid(0) ? FixedToDouble(zones.GetInput(0)) : NAN;
+	outputValue = FixedToDouble(zones.GetOutput(0));
+	output.SetError(zones.IsValid(0) ? setpoint - processValue : NAN);
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetZone
+ *
+ *	Description:	Sets (or reports) a zone's settings, from the text after
+ *					a g, k or l command:  the zone number (1 to ZONE_COUNT),
+ *					then for g the setpoint [C], for k the tunings "<kp>
+ *					<ki> <kd>", and for l the output window [sec] and
+ *					whether the zone is reverse acting (0 or 1).  With only
+ *					the zone number, the zone is reported; with nothing,
+ *					every zone is, and the time each took to compute.
+ *					Zone 1's setpoint is the setpoint, so S sets it too.
+ *
+ *	Parameters:		command - g, k or l
+ *					text - the zone & its settings
+ *
+ *****************************************************************************/
+
+void SetZone(char command, char *text)
+{
+	byte zone;							// zone, from 0
+	double kp;							// new tunings
+	double ki;
+	double kd;
+	double value;						// new setpoint or window
+	char *end;							// end of the zone number
+
+	if (*text == '\0')
+	{
+		for (zone = 0; zone < ZONE_COUNT; zone++)
+		{
+			ReportZone(zone);
+		}
+		Serial.print(F("cost "));
+		Serial.print(zoneCost);
+		Serial.print(' ');
+		Serial.println(zoneCostMax);
+		return;
+	}
+
+	zone = (byte)(strtol(text, &end, 10) - 1);
+	if ((end == text) || (zone >= ZONE_COUNT))
+	{
+		return;
+	}
+	text = end;
+	while (*text == ' ')
+	{
+		text++;
+	}
+	if (*text == '\0')
+	{
+		ReportZone(zone);
+		return;
+	}
+
+	switch (command)
+	{
+	case 'g':
+		value = atof(text);
+		if (zones.SetSetpoint(zone, FixedFromDouble(value)) !=
+			ZONE_RESULT_OK)
+		{
+			return;
+		}
+		if (zone == 0)
+		{
+			setpoint = value;
+			MemoryBackupDash();
+		}
+		break;
+
+	case 'k':
+		kp = strtod(text, &text);
+		ki = strtod(text, &text);
+		kd = strtod(text, &text);
+		if (zones.SetTunings(zone, kp, ki, kd) != ZONE_RESULT_OK)
+		{
+			return;
+		}
+		break;
+
+	case 'l':
+		value = strtod(text, &text);
+		if (zones.SetWindow(zone, (unsigned long)(value * 1000)) !=
+			ZONE_RESULT_OK)
+		{
+			return;
+		}
+		zones.SetReverse(zone, atoi(text) != 0);
+		SetOutputSides();
+		break;
+	}
+	MemoryBackupZones();
+}
+
+// Report a zone:  its process value (nan if its sensor failed), setpoint,
+// output, tunings, window [sec] & direction.
+void ReportZone(byte zone)
+{
+	char number[FORMAT_SIZE];			// a setting, as text
+
+	Serial.print(F("zone "));
+	Serial.print(zone + 1);
+	Serial.print(F(" pv "));
+	Serial.print(FormatDouble(number, zones.IsValid(zone) ?
+		FixedToDouble(zones.GetInput(zone)) : NAN, 2, 0));
+	Serial.print(F(" sp "));
+	Serial.print(FormatDouble(number,
+		FixedToDouble(zones.GetSetpoint(zone)), 2, 0));
+	Serial.print(F(" out "));
+	Serial.print(FormatDouble(number,
+		FixedToDouble(zones.GetOutput(zone)), 2, 0));
+	Serial.print(F(" tunings "));
+	Serial.print(FormatDouble(number, zones.GetKp(zone), 3, 0));
+	Serial.print(' ');
+	Serial.print(FormatDouble(number, zones.GetKi(zone), 4, 0));
+	Serial.print(' ');
+	Serial.print(FormatDouble(number, zones.GetKd(zone), 3, 0));
+	Serial.print(F(" window "));
+	Serial.print(FormatDouble(number, zones.GetWindow(zone) / 1000.0, 1,
+		0));
+	Serial.print(F(" reverse "));
+	Serial.println(zones.GetReverse(zone));
+}
+
+/******************************************************************************
+ *
+ *	Function:		AdaptSamplePeriod
+ *
+ *	Description:	Picks the time until the next sample.  The Smith
+ *					predictor's delay line and the step test count samples,
+ *					so they need the base period, and so does a failed
+ *					input (nothing to adapt to).
+ *
+ *****************************************************************************/
+
+void AdaptSamplePeriod(void)
+{
+	if (adaptiveSampling && (ctrlType == CTRL_TYPE_PID) && !inputFailed &&
+		(stepTest.GetState() != STEP_TEST_RUNNING))
+	{
+		SetSamplePeriod(sampler.Update(workingSetpoint - processValue, rateValue));
+	}
+	else
+	{
+		sampler.SetPeriod(basePeriod);
+		SetSamplePeriod(basePeriod);
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetSamplePeriod
+ *
+ *	Description:	Changes the time until the next sample (and the ones
+ *					after), and rescales everything that depends on it.  The
+ *					PID's integral & derivative gains are per sample, so they
+ *					must change with it.  The new period starts from the
+ *					sample that just ran, so the next derivative spans
+ *					exactly the new period.
+ *
+ *	Parameters:		period - sample period [mSec]
+ *
+ *****************************************************************************/
+
+void SetSamplePeriod(unsigned long period)
+{
+	if (period == samplePeriod)
+	{
+		return;
+	}
+
+	samplePeriod = period;
+	myPID.SetSampleTime(period);
+	supervisor.SetSamplePeriod(period);
+	estimator.SetSamplePeriod(period);
+	ramp.SetSamplePeriod(period);
+}
+
+/******************************************************************************
+ *
+ *	Function:		Estimate
+ *
+ *	Description:	Runs the Kalman filter on whichever sensors read well
+ *					this sample.  If the estimator is in use, its temperature
+ *					replaces the process value, and its rate feeds the PID's
+ *					derivative.
+ *
+ *****************************************************************************/
+
+void Estimate(void)
+{
+	double reading;						// one sensor's reading [C]
+
+	estimator.Predict();
+	if (supervisor.GetReading(INPUT_SENSOR_THERMOCOUPLE, &reading))
+	{
+		estimator.Correct(ESTIMATOR_SENSOR_THERMOCOUPLE, reading);
+	}
+	if (supervisor.GetReading(INPUT_SENSOR_THERMISTOR, &reading))
+	{
+		estimator.Correct(ESTIMATOR_SENSOR_THERMISTOR, reading);
+	}
+
+	rateValue = estimator.GetRate();
+
+	// In cascade the sensors measure different things, so don't blend them.
+	if (useEstimator && estimator.IsValid() && (ctrlType != CTRL_TYPE_CASCADE))
+	{
+		processValue = estimator.GetTemperature();
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		CheckSafety
+ *
+ *	Description:	Checks for thermal runaway, and raises the alarm the
+ *					first time it's found.  In zone control, each zone's
+ *					heater is checked on its own, and a runaway in any zone
+ *					shuts off both relays.
+ *
+ *****************************************************************************/
+
+void CheckSafety(void)
+{
+	double heat = outputValue;			// heat side's output [%]
+	double cool;						// cool side's output [%]
+	safetyAlarm_t alarm;				// a zone's alarm
+	byte zone;
+
+	if (ctrlType == CTRL_TYPE_ZONES)
+	{
+		for (zone = 0; zone < ZONE_COUNT; zone++)
+		{
+			zoneSafety[zone].SetReverse(zones.GetReverse(zone));
+			alarm = zoneSafety[zone].Check(zones.IsValid(zone) ?
+				FixedToDouble(zones.GetInput(zone)) : NAN,
+				FixedToDouble(zones.GetOutput(zone)), millis());
+			if ((alarm != SAFETY_ALARM_NONE) &&
+				(safety.GetAlarm() == SAFETY_ALARM_NONE))
+			{
+				safety.SetAlarm(alarm);
+			}
+		}
+		if ((safety.GetAlarm() != SAFETY_ALARM_NONE) && !output.IsShutdown())
+		{
+			EEPROM.write(SAFETY_ALARM_ADDR, safety.GetAlarm());
+			Alarm();
+		}
+		return;
+	}
+
+	// In split range, it's the heat side that can run away.
+	if (SplitActive())
+	{
+		splitRange.Map(outputValue, &heat, &cool);
+	}
+
+	if ((safety.Check(processValue, heat, millis()) !=
+		SAFETY_ALARM_NONE) && !output.IsShutdown())
+	{
+		EEPROM.write(SAFETY_ALARM_ADDR, safety.GetAlarm());
+		Alarm();
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		Alarm
+ *
+ *	Description:	Turns off both relays (and keeps them off) and sounds the
+ *					buzzer.  Only the X serial command undoes this.
+ *
+ *****************************************************************************/
+
+void Alarm(void)
+{
+	output.Shutdown();
+	tone(pinBuzzer, alarmTone);
+
+	if (serialProtocol == PROTOCOL_TEXT)
+	{
+		Serial.print(F("alarm "));
+		Serial.println(safety.GetAlarm());
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		ClearAlarm
+ *
+ *	Description:	Clears a runaway alarm, silences the buzzer, and lets the
+ *					relays turn on again.
+ *
+ *****************************************************************************/
+
+void ClearAlarm(void)
+{
+	byte zone;
 
-	// Wait a second.
-	delay(1000);
+	safety.ClearAlarm();
+	for (zone = 0; zone < ZONE_COUNT; zone++)
+	{
+		zoneSafety[zone].ClearAlarm();
+	}
+	EEPROM.write(SAFETY_ALARM_ADDR, SAFETY_ALARM_NONE);
+	noTone(pinBuzzer);
+	output.Restart();
 }
 
+/******************************************************************************
+ *
+ *	Function:		Report
+ *
+ *	Description:	Shows the temperature (and the name of the recipe last
+ *					loaded) on the LCD, and (unless the
+ *					serial port is speaking Modbus) sends the controller's
+ *					status out the serial port.  However fast the samples
+ *					come, this only happens once per reportPeriod, so the
+ *					serial port can keep up.  The serial line is a list of
+ *					names and values:
+ *
+ *					pv		process value [C]
+ *					sp		setpoint [C]
+ *					out		output [%]
+ *					sensor	sensor in use (0 = thermocouple, 1 = thermistor)
+ *					faults	faults seen on the thermocouple & thermistor
+ *					since	time since the last fault [seconds], or none
+ *					tc, th	thermocouple & thermistor readings (Error if not
+ *							believable), on the primary sensor's scale [C]
+ *					rate	estimated rate of change of PV [C/sec]
+ *					sleep	time the CPU spent asleep since the last report
+ *							[%]
+ *					late	worst wake-up latency since the last report:
+ *							time from when a sample was due to when it
+ *							started [microseconds]
+ *					period	sample period [milliseconds]
+ *					alarm	runaway alarm (0 = none, 1 = PV not rising at
+ *							full output, 2 = PV rising with no output)
+ *					run		time into the run (in automatic mode) [seconds]
+ *					wsp		working setpoint, on its way to sp [C]
+ *					inner	(cascade only) the inner loop's process value
+ *							& setpoint [C]
+ *					split	(split range only) the heat & cool sides'
+ *							outputs [%]
+ *
+ *****************************************************************************/
+
+void Report(void)
+{
+	double reading;						// one sensor's reading [C]
+	double heat;						// split-range outputs [%]
+	double cool;
+	unsigned long faultAge;				// time since a sensor fault [mSec]
+	char number[FORMAT_SIZE];			// a number, as text
+	byte i;
+
+	// lastSample is when this sample was due, so reports stay on schedule.
+	if (lastSample - lastReport < reportPeriod)
+	{
+		return;
+	}
+	lastReport = lastSample;
+
+	SleepGetStats(&sleepStats);
+
+	// Display the temperature.
+	TRACE_BEGIN(TRACE_LCD, 0);
+	lcd.setCursor(0, 0);
+	if (safety.GetAlarm() != SAFETY_ALARM_NONE)
+	{
+		lcd.print(F("ALARM "));
+	}
+	else if (activeRecipe != 0)
+	{
+		lcd.print(recipeName);
+		for (i = strlen(recipeName); i < RECIPE_NAME_SIZE - 1; i++)
+		{
+			lcd.print(' ');
+		}
+	}
+	else
+	{
+		lcd.print(F("temp  "));
+	}
+	lcd.setCursor(0, 1);
+	if (inputFailed || isnan(processValue))
+	{
+		lcd.print(F(" Error "));
+	}
+	else
+	{
+		// Fixed width, so a shorter number covers a longer one, and the
+		// C (gone after an error) is put back.
+		lcd.print(FormatDouble(number, processValue, 1, lcdColumns - 2));
+		lcd.print('C');
+	}
+	TRACE_END(TRACE_LCD, 0);
+
+	// (A host sending a blob is waiting for acknowledgements, not reports.)
+	if ((serialProtocol != PROTOCOL_TEXT) || configImporting)
+	{
+		return;
+	}
+
+	TRACE_BEGIN(TRACE_REPORT, 0);
+
+	Serial.print(F("pv "));
+	Serial.print(FormatDouble(number, processValue, 2, 0));
+	Serial.print(F(" sp "));
+	Serial.print(FormatDouble(number, setpoint, 2, 0));
+	Serial.print(F(" out "));
+	Serial.print(FormatDouble(number, outputValue, 2, 0));
+	Serial.print(F(" sensor "));
+	Serial.print(supervisor.GetActiveSensor());
+	Serial.print(F(" faults "));
+	Serial.print(supervisor.GetFaultCount(INPUT_SENSOR_THERMOCOUPLE));
+	Serial.print(' ');
+	Serial.print(supervisor.GetFaultCount(INPUT_SENSOR_THERMISTOR));
+	Serial.print(F(" since "));
+	if (supervisor.GetTimeSinceFault(&faultAge))
+	{
+		Serial.print(faultAge / 1000);
+	}
+	else
+	{
+		Serial.print(F("none"));
+	}
+	Serial.print(F(" tc "));
+	Serial.print(FormatDouble(number,
+		supervisor.GetReading(INPUT_SENSOR_THERMOCOUPLE, &reading) ?
+		reading : NAN, 2, 0));
+	Serial.print(F(" th "));
+	Serial.print(FormatDouble(number,
+		supervisor.GetReading(INPUT_SENSOR_THERMISTOR, &reading) ?
+		reading : NAN, 2, 0));
+	Serial.print(F(" rate "));
+	Serial.print(FormatDouble(number, rateValue, 3, 0));
+	Serial.print(F(" sleep "));
+	Serial.print(FormatDouble(number,
+		sleepStats.asleep * 100.0 / sleepStats.elapsed, 1, 0));
+	Serial.print(F(" late "));
+	Serial.print(sleepStats.maxLatency);
+	Serial.print(F(" period "));
+	Serial.print(samplePeriod);
+	Serial.print(F(" alarm "));
+	Serial.print(safety.GetAlarm());
+	Serial.print(F(" run "));
+	Serial.print(running ? (millis() - runStart) / 1000 : 0);
+	Serial.print(F(" wsp "));
+	Serial.print(FormatDouble(number, workingSetpoint, 2, 0));
+	if (ctrlType == CTRL_TYPE_CASCADE)
+	{
+		Serial.print(F(" inner "));
+		Serial.print(FormatDouble(number, innerValue, 2, 0));
+		Serial.print(' ');
+		Serial.print(FormatDouble(number, innerSetpoint, 2, 0));
+	}
+	if (ctrlType == CTRL_TYPE_ZONES)
+	{
+		Serial.print(F(" zone2 "));
+		Serial.print(FormatDouble(number, zones.IsValid(1) ?
+			FixedToDouble(zones.GetInput(1)) : NAN, 2, 0));
+		Serial.print(' ');
+		Serial.print(FormatDouble(number,
+			FixedToDouble(zones.GetSetpoint(1)), 2, 0));
+		Serial.print(' ');
+		Serial.print(FormatDouble(number,
+			FixedToDouble(zones.GetOutput(1)), 2, 0));
+	}
+	if (SplitActive())
+	{
+		splitRange.Map(outputValue, &heat, &cool);
+		Serial.print(F(" split "));
+		Serial.print(FormatDouble(number, heat, 2, 0));
+		Serial.print(' ');
+		Serial.print(FormatDouble(number, cool, 2, 0));
+	}
+	Serial.println();
+	TRACE_END(TRACE_REPORT, 0);
+}
+
+/******************************************************************************
+ *
+ *	Function:		StartStepTest
+ *
+ *	Description:	Puts the controller in manual and steps the output to
+ *					identify the process model.  The process should be steady
+ *					before this is called.
+ *
+ *****************************************************************************/
+
+void StartStepTest(void)
+{
+	modeIndex = MANUAL;
+	myPID.SetMode(modeIndex);
+
+	// The test counts samples, so go back to the base period.
+	sampler.SetPeriod(basePeriod);
+	SetSamplePeriod(basePeriod);
+
+	stepTest.Start(processValue, outputValue, aTuneStep, aTuneNoise,
+		(unsigned int)aTuneLookBack, basePeriod);
+	outputValue = stepTest.GetOutput();
+}
+
+/******************************************************************************
+ *
+ *	Function:		FinishStepTest
+ *
+ *	Description:	Stores the model found by the step test, or reports that
+ *					the test failed, or found a dead time longer than the
+ *					Smith predictor can compensate for (the model isn't
+ *					stored then).  The output is left where the test put it
+ *					so the process isn't bumped again.
+ *
+ *****************************************************************************/
+
+void FinishStepTest(void)
+{
+	char number[FORMAT_SIZE];			// a number, as text
+
+	if ((stepTest.GetState() == STEP_TEST_DONE) &&
+		(smith.SetModel(stepTest.GetGain(), stepTest.GetTimeConstant(),
+			stepTest.GetDeadTime()) == SMITH_RESULT_OK))
+	{
+		smith.Reset(outputValue);
+		MemoryBackupModel();
+
+		if (serialProtocol == PROTOCOL_TEXT)
+		{
+			Serial.print(F("model "));
+			Serial.print(FormatDouble(number, smith.GetModelGain(), 2, 0));
+			Serial.print(' ');
+			Serial.print(FormatDouble(number, smith.GetModelTimeConstant(), 2,
+				0));
+			Serial.print(' ');
+			Serial.println(FormatDouble(number, smith.GetModelDeadTime(), 2,
+				0));
+		}
+	}
+	else if (serialProtocol == PROTOCOL_TEXT)
+	{
+		if ((stepTest.GetState() == STEP_TEST_DONE) &&
+			(stepTest.GetDeadTime() > smith.GetMaxDeadTime()))
+		{
+			Serial.println(F("dead time too long"));
+		}
+		else
+		{
+			Serial.println(F("step test failed"));
+		}
+	}
+
+	stepTest.Cancel();
+}
+
+/******************************************************************************
+ *
+ *	Function:		Calibrate
+ *
+ *	Description:	Calibrates the thermistor against a reference
+ *					thermometer.  Hold the thermistor at a steady, known
+ *					temperature and record a point; repeat at temperatures
+ *					spread across the range of interest, then fit.  The fit
+ *					replaces the Beta model until B is sent.
+ *
+ *	Parameters:		fit - true to fit the recorded points, false to record
+ *						a new one
+ *					refTemp - reference temperature for a new point [C]
+ *
+ *****************************************************************************/
+
+void Calibrate(bool fit, double refTemp)
+{
+	double shA;							// Steinhart-Hart coefficients
+	double shB;
+	double shC;
+	char number[FORMAT_SIZE];			// a coefficient, as text
+
+	if (!fit)
+	{
+		if (input.AddCalibrationPoint(refTemp) == INPUT_RESULT_OK)
+		{
+			Serial.print(F("cal point "));
+			Serial.println(input.GetCalibrationCount());
+		}
+		else
+		{
+			Serial.println(F("cal point failed"));
+		}
+		return;
+	}
+
+	if (input.Calibrate() != INPUT_RESULT_OK)
+	{
+		Serial.println(F("cal failed"));
+		return;
+	}
+
+	MemoryBackupInput();
+	input.GetSteinhartCoeffs(&shA, &shB, &shC);
+	Serial.print(F("cal "));
+	Serial.print(FormatDouble(number, shA * 1e3, 6, 0));
+	Serial.print(F("e-3 "));
+	Serial.print(FormatDouble(number, shB * 1e4, 6, 0));
+	Serial.print(F("e-4 "));
+	Serial.print(FormatDouble(number, shC * 1e7, 6, 0));
+	Serial.println(F("e-7"));
+}
+
+/******************************************************************************
+ *
+ *	Function:		ReportRelayWear
+ *
+ *	Description:	Sends each relay's operation count out the serial port,
+ *					with the share of its rated life (RELAY_RATED_OPS) that's
+ *					left, and how many hours that will last at the rate it's
+ *					switched since boot:
+ *
+ *						relay<n> ops <count> left <%> hours <hours>
+ *
+ *					Hours are "-" if the relay hasn't switched since boot.
+ *
+ *****************************************************************************/
+
+void ReportRelayWear(void)
+{
+	byte relay;
+	unsigned long ops;					// operations so far
+	unsigned long left;					// operations left
+	unsigned long recent;				// operations since boot
+	char number[FORMAT_SIZE];			// hours, as text
+
+	for (relay = 0; relay < 2; relay++)
+	{
+		ops = output.GetSwitchCount(relay);
+		left = (ops < RELAY_RATED_OPS) ? (RELAY_RATED_OPS - ops) : 0;
+		recent = ops - bootCount[relay];
+
+		Serial.print(F("relay"));
+		Serial.print(relay + 1);
+		Serial.print(F(" ops "));
+		Serial.print(ops);
+		Serial.print(F(" left "));
+		Serial.print(left / (RELAY_RATED_OPS / 100));
+		Serial.print(F(" hours "));
+		if (recent == 0)
+		{
+			Serial.println('-');
+		}
+		else
+		{
+			Serial.println(FormatDouble(number,
+				(double)left * (millis() / 3600000.0) / recent, 0, 0));
+		}
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		ReportStats
+ *
+ *	Description:	Sends the process statistics out the serial port:  the
+ *					tolerance band, the current run's (if there is one),
+ *					the lifetime's (since boot, or since `z`), and the saved
+ *					summaries of the last runs, newest first:
+ *
+ *						tol <C>
+ *						run time <sec> recipe <n> min <C> max <C> mean <C>
+ *							sd <C> in <%> out <%>
+ *						life time ...
+ *						last<n> time ...
+ *
+ *					"in" is the share of the time the process value was
+ *					within the tolerance band of the setpoint, and "out" the
+ *					mean output.
+ *
+ *****************************************************************************/
+
+void ReportStats(void)
+{
+	runSummary_t summary;
+	char number[FORMAT_SIZE];			// tolerance, as text
+	byte slot;
+	byte n = 0;							// summaries sent
+	byte i;
+
+	Serial.print(F("tol "));
+	Serial.println(FormatFixed(number, statsTolerance, 2, 0));
+
+	if (running)
+	{
+		runStats.Summarize(&summary);
+		summary.recipe = activeRecipe;
+		summary.duration = (lastSample - runStart) / 1000;
+		Serial.print(F("run"));
+		PrintSummary(&summary);
+	}
+
+	lifeStats.Summarize(&summary);
+	summary.recipe = activeRecipe;
+	summary.duration = (lastSample - lifeStart) / 1000;
+	Serial.print(F("life"));
+	PrintSummary(&summary);
+
+	for (i = 0; i < RUN_SUMMARY_SLOTS; i++)
+	{
+		slot = (summarySlot + RUN_SUMMARY_SLOTS - i) % RUN_SUMMARY_SLOTS;
+		if (MemoryReadRunSummary(slot, &summary))
+		{
+			Serial.print(F("last"));
+			Serial.print(++n);
+			PrintSummary(&summary);
+		}
+	}
+}
+
+// Send the rest of a line of statistics.
+void PrintSummary(const runSummary_t *summary)
+{
+	char number[FORMAT_SIZE];			// a statistic, as text
+
+	Serial.print(F(" time "));
+	Serial.print(summary->duration);
+	Serial.print(F(" recipe "));
+	Serial.print(summary->recipe);
+	Serial.print(F(" min "));
+	Serial.print(FormatFixed(number, summary->min, 2, 0));
+	Serial.print(F(" max "));
+	Serial.print(FormatFixed(number, summary->max, 2, 0));
+	Serial.print(F(" mean "));
+	Serial.print(FormatFixed(number, summary->mean, 2, 0));
+	Serial.print(F(" sd "));
+	Serial.print(FormatFixed(number, summary->stdDev, 3, 0));
+	Serial.print(F(" in "));
+	Serial.print(FormatFixed(number, summary->inTolerance, 1, 0));
+	Serial.print(F(" out "));
+	Serial.println(FormatFixed(number, summary->output, 1, 0));
+}
+
+/******************************************************************************
+ *
+ *	Function:		RequestRecipe
+ *
+ *	Description:	Asks for a stored recipe to be loaded.  It's loaded at
+ *					the start of the next sample, all at once, so the
+ *					controller never runs with half of one recipe and half
+ *					of another.
+ *
+ *	Parameters:		number - recipe to load (1 to RECIPE_COUNT)
+ *
+ *	Return Value:	true if the recipe is stored
+ *
+ *****************************************************************************/
+
+bool RequestRecipe(byte number)
+{
+	if ((number < 1) || (number > RECIPE_COUNT) ||
+		!(recipesStored & (1 << (number - 1))))
+	{
+		return false;
+	}
+
+	pendingRecipe = number;
+	return true;
+}
+
+/******************************************************************************
+ *
+ *	Function:		NextRecipe
+ *
+ *	Description:	Asks for the next stored recipe after the current one (or
+ *					the one waiting to be loaded), going back to the first
+ *					after the last.  This is what the OK button does.
+ *
+ *****************************************************************************/
+
+void NextRecipe(void)
+{
+	byte number;
+	byte i;
+
+	number = (pendingRecipe != 0) ? pendingRecipe : activeRecipe;
+	for (i = 0; i < RECIPE_COUNT; i++)
+	{
+		number = (number % RECIPE_COUNT) + 1;
+		if (RequestRecipe(number))
+		{
+			return;
+		}
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		ApplyRecipe
+ *
+ *	Description:	Loads a recipe:  setpoint, tunings, direction, sensor and
+ *					output window.  Only that recipe's record is read.  In
+ *					automatic, the PID is restarted from the current output,
+ *					so the new settings take over without a bump.  Call this
+ *					between samples.
+ *
+ *	Parameters:		number - recipe to load (1 to RECIPE_COUNT)
+ *
+ *****************************************************************************/
+
+void ApplyRecipe(byte number)
+{
+	recipe_t recipe;
+
+	if (!MemoryReadRecipe(number, &recipe))
+	{
+		return;
+	}
+
+	setpoint = recipe.setpoint / 10.0;
+	myPID.SetTunings(recipe.kp, recipe.ki, recipe.kd);
+	ctrlDirection = (recipe.flags & RECIPE_REVERSE) ? REVERSE : DIRECT;
+	myPID.SetControllerDirection(ctrlDirection);
+	thermostat.SetReverse(ctrlDirection == REVERSE);
+	safety.SetReverse(ctrlDirection == REVERSE);
+	input.SetSensorType((recipe.flags & RECIPE_THERMISTOR) ?
+		INPUT_SENSOR_THERMISTOR : INPUT_SENSOR_THERMOCOUPLE);
+	output.SetOutputWindow(recipe.window / 10.0);
+	if (!inputFailed)
+	{
+		myPID.SetMode(MANUAL);
+		myPID.SetMode(modeIndex);
+	}
+
+	EndRun();
+	activeRecipe = number;
+	strcpy(recipeName, recipe.name);
+
+	MemoryBackupTunings();
+	MemoryBackupDash();
+	MemoryBackupInput();
+	EEPROM_writeAnything(OUTPUT_WINDOW_ADDR, output.GetOutputWindow());
+	EEPROM_writeAnything(RECIPE_ACTIVE_ADDR, activeRecipe);
+
+	if (serialProtocol == PROTOCOL_TEXT)
+	{
+		Serial.print(F("recipe "));
+		Serial.print(number);
+		Serial.print(' ');
+		Serial.println(recipeName);
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		SaveRecipe
+ *
+ *	Description:	Saves the setpoint, tunings, direction, sensor and output
+ *					window as a recipe.
+ *
+ *	Parameters:		number - recipe to save (1 to RECIPE_COUNT)
+ *					name - its name (see RecipeSetName), or NULL
+ *
+ *****************************************************************************/
+
+void SaveRecipe(byte number, const char *name)
+{
+	recipe_t recipe;
+	double scaled;						// setpoint [0.1 C]
+	unsigned long window;				// output window [0.1 sec]
+
+	if ((number < 1) || (number > RECIPE_COUNT))
+	{
+		Serial.println(F("no recipe"));
+		return;
+	}
+
+	RecipeSetName(&recipe, name, number);
+	scaled = setpoint * 10;
+	recipe.setpoint = (int16_t)constrain(scaled + ((scaled < 0) ? -0.5 : 0.5),
+		-32767, 32767);
+	recipe.kp = myPID.GetKp();
+	recipe.ki = myPID.GetKi();
+	recipe.kd = myPID.GetKd();
+	recipe.flags = ((ctrlDirection == REVERSE) ? RECIPE_REVERSE : 0) |
+		((input.GetSensorType() == INPUT_SENSOR_THERMISTOR) ?
+		RECIPE_THERMISTOR : 0);
+	window = output.GetOutputWindow() / 100;
+	recipe.window = (window > 65535UL) ? 65535U : (uint16_t)window;
+
+	MemoryWriteRecipe(number, &recipe);
+	Serial.print(F("saved recipe "));
+	Serial.println(number);
+}
+
+/******************************************************************************
+ *
+ *	Function:		ListRecipes
+ *
+ *	Description:	Sends the stored recipes out the serial port, one per
+ *					line, with a * on the one last loaded:
+ *
+ *						recipe <n> <name> sp <C> kp <kp> ki <ki> kd <kd>
+ *							dir <0|1> sensor <0|1> window <sec>
+ *
+ *****************************************************************************/
+
+void ListRecipes(void)
+{
+	recipe_t recipe;
+	char number[FORMAT_SIZE];			// a number, as text
+	byte n;
+
+	for (n = 1; n <= RECIPE_COUNT; n++)
+	{
+		if (!(recipesStored & (1 << (n - 1))) ||
+			!MemoryReadRecipe(n, &recipe))
+		{
+			continue;
+		}
+
+		Serial.print(F("recipe "));
+		Serial.print(n);
+		Serial.print((n == activeRecipe) ? '*' : ' ');
+		Serial.print(recipe.name);
+		Serial.print(F(" sp "));
+		Serial.print(FormatScaled(number, recipe.setpoint, 1, 0));
+		Serial.print(F(" kp "));
+		Serial.print(FormatDouble(number, recipe.kp, 2, 0));
+		Serial.print(F(" ki "));
+		Serial.print(FormatDouble(number, recipe.ki, 2, 0));
+		Serial.print(F(" kd "));
+		Serial.print(FormatDouble(number, recipe.kd, 2, 0));
+		Serial.print(F(" dir "));
+		Serial.print(recipe.flags & RECIPE_REVERSE);
+		Serial.print(F(" sensor "));
+		Serial.print((recipe.flags & RECIPE_THERMISTOR) ? 1 : 0);
+		Serial.print(F(" window "));
+		Serial.println(FormatScaled(number, recipe.window, 1, 0));
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetCascadeTunings
+ *
+ *	Description:	Sets one of the cascade loops' tunings from a serial
+ *					command, and saves them.  With no numbers, it reports
+ *					them instead:
+ *
+ *						tunings <kp> <ki> <kd>
+ *
+ *	Parameters:		pid - outerPID or innerPID
+ *					text - the command after its letter:  Kp, Ki & Kd,
+ *						separated by spaces
+ *
+ *****************************************************************************/
+
+void SetCascadeTunings(PID *pid, char *text)
+{
+	double kp;							// new tunings
+	double ki;
+	double kd;
+	char number[FORMAT_SIZE];			// a tuning, as text
+
+	if (*text == '\0')
+	{
+		Serial.print(F("tunings "));
+		Serial.print(FormatDouble(number, pid->GetKp(), 3, 0));
+		Serial.print(' ');
+		Serial.print(FormatDouble(number, pid->GetKi(), 4, 0));
+		Serial.print(' ');
+		Serial.println(FormatDouble(number, pid->GetKd(), 3, 0));
+		return;
+	}
+
+	kp = strtod(text, &text);
+	ki = strtod(text, &text);
+	kd = strtod(text, &text);
+	pid->SetTunings(kp, ki, kd);
+	MemoryBackupCascade();
+}
+
+/******************************************************************************
+ *
+ *	Function:		ProcessSerial
+ *
+ *	Description:	Collects characters from the serial port, and carries out
+ *					a command when a whole line has arrived.  Commands are a
+ *					letter, optionally followed by a number:
+ *
+ *					S<value>	set the setpoint [C]
+ *					A<0|1>		set manual (0) or automatic (1) mode
+ *					O<value>	set the output in manual mode [%]
+ *								(-100 to 100 in split range)
+ *					C<0|1|2|3|4>
+ *								use a plain PID (0), Smith predictor (1),
+ *								on/off control (2), cascade control (3) or
+ *								zone control (4)
+ *					o<kp> <ki> <kd>
+ *								set the cascade's outer loop tunings
+ *					i<kp> <ki> <kd>
+ *								set the cascade's inner loop tunings
+ *					o, i		report a cascade loop's tunings
+ *					g<n> <value>
+ *								set zone n's setpoint [C] (zone 1's is the
+ *								setpoint)
+ *					k<n> <kp> <ki> <kd>
+ *								set zone n's tunings
+ *					l<n> <window> <0|1>
+ *								set zone n's output window [sec], and make
+ *								it direct (0) or reverse (1) acting
+ *					g<n>, k<n>, l<n>
+ *								report zone n
+ *					g			report every zone, and the time each took
+ *								to compute, last sample & at most [uSec]
+ *					T			start (or cancel) a step test
+ *					F<0|1>		disable (0) or enable (1) sensor failover
+ *					Z<value>	set the output used when inputs fail [%]
+ *					x<0|1>		drive only the output relay (0), or split
+ *								the output (-100 to 100%) between heat on
+ *								the output relay & cooling on the other
+ *								one (1)
+ *					d<value>	set the split-range deadband [% of output]
+ *					h<gain> <min off>
+ *								set the heat side's split-range gain &
+ *								its relay's minimum off time [sec]
+ *					c<gain> <min off>
+ *								the same for the cool side
+ *					h, c		report a side's gain & minimum off time
+ *					R<value>	set the fastest believable PV change [C/sec]
+ *					r<value>	set the setpoint ramp rate [C/min] (0 for
+ *								none)
+ *					s<value>	set the setpoint ramp's acceleration
+ *								[C/min^2] (0 for none; otherwise the ramp
+ *								is an S-curve)
+ *					D<value>	set the on/off differential [C]
+ *					E<value>	set the on/off minimum on time [sec]
+ *					L<value>	set the on/off minimum off time [sec]
+ *					X			clear a runaway alarm
+ *					M			report free RAM, the stack's high-water mark,
+ *								the time from reset to the first control
+ *								output [mSec] & the time to load settings
+ *								[uSec]
+ *					e			export the settings as a configuration
+ *								blob (see ConfigExport)
+ *					w			import a configuration blob (see
+ *								ConfigImportStart)
+ *					N			report each relay's operations & the life it
+ *								has left
+ *					a			report the process statistics (see
+ *								ReportStats)
+ *					b<value>	set the statistics' tolerance band, either
+ *								side of the setpoint [C]
+ *					z			start the lifetime statistics afresh
+ *					U<0|1>		switch the output relay plainly (0), or
+ *								through the switching optimizer (1)
+ *					H<value>	record a thermistor calibration point at the
+ *								given reference temperature [C]
+ *					H			fit & save Steinhart-Hart coefficients to
+ *								the calibration points (3 to 5 of them)
+ *					B			forget calibration & go back to the Beta
+ *								model
+ *					K<0|1>		control on the selected sensor (0) or on
+ *								both sensors fused by a Kalman filter (1)
+ *					V<value>	set the thermocouple's noise variance [C^2]
+ *					W<value>	set the thermistor's noise variance [C^2]
+ *					Q<0|1>		use a fixed (0) or adaptive (1) sample period
+ *					P<value>	set the setpoint weight on the proportional
+ *								term, beta (0 to 1; below 1 cuts overshoot
+ *								after a setpoint step)
+ *					G<value>	set the setpoint weight on the derivative
+ *								term, gamma (0 to 1; 0 avoids derivative
+ *								kick)
+ *					f<value>	set the derivative filter's time constant
+ *								[sec] (0 for none)
+ *					I<n> <name>	save the setpoint, tunings, direction,
+ *								sensor & output window as recipe n (1 to
+ *								RECIPE_COUNT), named name (up to 6
+ *								characters)
+ *					J<n>		load recipe n at the next sample
+ *					J			list the recipes
+ *					t			dump the event trace (if TRACE_ENABLED is
+ *								set in Trace.h)
+ *					Y<address>	switch the serial port to Modbus RTU, as
+ *								slave 1 to 247 (see ModbusRegisters)
+ *
+ *****************************************************************************/
+
+void ProcessSerial(void)
+{
+	char c;								// character received
+	double value;						// number following the command
+
+	// Go back to commands once a blob stops coming:  give up on one that
+	// was still expected, or stop discarding the rest of a bad one.
+	if (configImporting && (millis() - configLastByte >= CONFIG_TIMEOUT))
+	{
+		if (config.GetState() == CONFIG_STATE_RUNNING)
+		{
+			ConfigImportEnd(CONFIG_STATE_RUNNING);
+		}
+		configImporting = false;
+	}
+
+	while (Serial.available() > 0)
+	{
+		c = Serial.read();
+
+		// A configuration blob is binary, not lines.
+		if (configImporting)
+		{
+			ConfigImportByte(c);
+			continue;
+		}
+
+		// Collect characters until the end of the line.
+		if ((c != '\n') && (c != '\r'))
+		{
+			if (serialIndex < sizeof(serialBuffer) - 1)
+			{
+				serialBuffer[serialIndex++] = c;
+			}
+			continue;
+		}
+
+		// Ignore empty lines.
+		if (serialIndex == 0)
+		{
+			continue;
+		}
+
+		serialBuffer[serialIndex] = '\0';
+		serialIndex = 0;
+		value = atof(&serialBuffer[1]);
+		TRACE_INSTANT(TRACE_COMMAND, serialBuffer[0]);
+
+		switch (serialBuffer[0])
+		{
+		case 't':
+			TraceDump();
+			break;
+
+		case 'o':
+			SetCascadeTunings(&outerPID, &serialBuffer[1]);
+			break;
+
+		case 'i':
+			SetCascadeTunings(&innerPID, &serialBuffer[1]);
+			break;
+
+		case 'g':
+		case 'k':
+		case 'l':
+			SetZone(serialBuffer[0], &serialBuffer[1]);
+			break;
+
+		case 'S':
+			setpoint = value;
+			MemoryBackupDash();
+			break;
+
+		case 'A':
+			modeIndex = (value != 0) ? AUTOMATIC : MANUAL;
+			myPID.SetMode(modeIndex);
+			MemoryBackupDash();
+			break;
+
+		case 'O':
+			if (modeIndex == MANUAL)
+			{
+				outputValue = constrain(value, OutputMin(), 100);
+				MemoryBackupDash();
+			}
+			break;
+
+		case 'x':
+			SetSplit(value != 0);
+			break;
+
+		case 'd':
+			if (splitRange.SetDeadband(value) == SPLIT_RESULT_OK)
+			{
+				MemoryBackupSplit();
+			}
+			break;
+
+		case 'h':
+			SetSplitSide(false, &serialBuffer[1]);
+			break;
+
+		case 'c':
+			SetSplitSide(true, &serialBuffer[1]);
+			break;
+
+		case 'C':
+			if ((value >= 0) && (value <= CTRL_TYPE_ZONES))
+			{
+				SetCtrlType((byte)value);
+			}
+			break;
+
+		case 'r':
+			if (ramp.SetRate(FixedFromDouble(value)) == RAMP_RESULT_OK)
+			{
+				MemoryBackupRamp();
+			}
+			break;
+
+		case 's':
+			if (ramp.SetAcceleration(FixedFromDouble(value)) ==
+				RAMP_RESULT_OK)
+			{
+				MemoryBackupRamp();
+			}
+			break;
+
+		case 'D':
+			if (thermostat.SetDifferential(FixedFromDouble(value)) ==
+				THERMOSTAT_RESULT_OK)
+			{
+				MemoryBackupThermostat();
+			}
+			break;
+
+		// Check the range before converting:  a negative or huge time
+		// doesn't fit in an unsigned long.
+		case 'E':
+			if ((value >= 0) && (value <= THERMOSTAT_MAX_MIN_TIME / 1000) &&
+				(thermostat.SetMinTimes((unsigned long)(value * 1000),
+					thermostat.GetMinOffTime()) == THERMOSTAT_RESULT_OK))
+			{
+				MemoryBackupThermostat();
+			}
+			break;
+
+		case 'L':
+			if ((value >= 0) && (value <= THERMOSTAT_MAX_MIN_TIME / 1000) &&
+				(thermostat.SetMinTimes(thermostat.GetMinOnTime(),
+					(unsigned long)(value * 1000)) == THERMOSTAT_RESULT_OK))
+			{
+				MemoryBackupThermostat();
+			}
+			break;
+
+		case 'F':
+			supervisor.SetFailover(value != 0);
+			MemoryBackupInput();
+			break;
+
+		case 'Z':
+			safeOutput = constrain(value, OutputMin(), 100);
+			MemoryBackupInput();
+			break;
+
+		case 'R':
+			supervisor.SetMaxRate(value);
+			MemoryBackupInput();
+			break;
+
+		case 'X':
+			ClearAlarm();
+			break;
+
+		case 'M':
+			Serial.print(F("mem free "));
+			Serial.print(StackFree());
+			Serial.print(F(" unused "));
+			Serial.print(StackUnused());
+			Serial.print(F(" boot "));
+			Serial.print(bootOutput);
+			Serial.print(F(" settings "));
+			Serial.println(bootSettings);
+			break;
+
+		case 'e':
+			ConfigExport();
+			break;
+
+		case 'w':
+			ConfigImportStart();
+			break;
+
+		case 'N':
+			ReportRelayWear();
+			break;
+
+		case 'a':
+			ReportStats();
+			break;
+
+		case 'b':
+			if (value >= 0)
+			{
+				statsTolerance = FixedFromDouble(value);
+				MemoryBackupStats();
+			}
+			break;
+
+		case 'z':
+			lifeStats.Reset();
+			lifeStart = millis();
+			break;
+
+		case 'U':
+			output.SetOptimize(value != 0);
+			EEPROM_writeAnything(OUTPUT_OPTIMIZE_ADDR,
+				(byte)output.GetOptimize());
+			break;
+
+		case 'H':
+			Calibrate(serialBuffer[1] == '\0', value);
+			break;
+
+		case 'B':
+			input.ClearCalibration();
+			input.SetThermistorCoeffs(input.GetThermistorRefRes(),
+				input.GetThermistorRefTemp(), input.GetThermistorBeta(),
+				input.GetThermistorDiv());
+			MemoryBackupInput();
+			Serial.println(F("cal beta"));
+			break;
+
+		case 'K':
+			useEstimator = (value != 0);
+			MemoryBackupEstimator();
+			break;
+
+		case 'V':
+			estimator.SetNoise(ESTIMATOR_SENSOR_THERMOCOUPLE, value);
+			MemoryBackupEstimator();
+			break;
+
+		case 'W':
+			estimator.SetNoise(ESTIMATOR_SENSOR_THERMISTOR, value);
+			MemoryBackupEstimator();
+			break;
+
+		case 'Q':
+			adaptiveSampling = (value != 0);
+			EEPROM_writeAnything(ADAPTIVE_ADDR, adaptiveSampling);
+			break;
+
+		case 'P':
+			myPID.SetWeights(value, myPID.GetGamma());
+			MemoryBackupTunings();
+			break;
+
+		case 'G':
+			myPID.SetWeights(myPID.GetBeta(), value);
+			MemoryBackupTunings();
+			break;
+
+		case 'f':
+			myPID.SetDerivativeFilter(value);
+			MemoryBackupTunings();
+			break;
+
+		case 'I':
+			SaveRecipe((byte)value, strchr(serialBuffer, ' '));
+			break;
+
+		case 'J':
+			if (serialBuffer[1] == '\0')
+			{
+				ListRecipes();
+			}
+			else if (!RequestRecipe((byte)value))
+			{
+				Serial.println(F("no recipe"));
+			}
+			break;
+
+		case 'Y':
+			if (modbus.SetAddress((byte)value))
+			{
+				SetProtocol(PROTOCOL_MODBUS);
+			}
+			break;
+
+		case 'T':
+			if (stepTest.GetState() == STEP_TEST_RUNNING)
+			{
+				stepTest.Cancel();
+			}
+			else
+			{
+				StartStepTest();
+			}
+			break;
+		}
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		ConfigExport
+ *
+ *	Description:	Sends the settings (see ConfigBlob.cpp) as one binary
+ *					blob:  a line "config <size>", then size bytes of blob,
+ *					then a line end.  The relay is kept switching between
+ *					bytes; the blob takes about half a second at 9600 baud.
+ *
+ *****************************************************************************/
+
+void ConfigExport(void)
+{
+	uint8_t data;						// a byte of the blob
+
+	Serial.print(F("config "));
+	Serial.println(ConfigBlob::GetSize());
+	config.Start();
+	while (config.Export(&data))
+	{
+		Serial.write(data);
+		output.Service();
+	}
+	Serial.println();
+}
+
+/******************************************************************************
+ *
+ *	Function:		ConfigImportStart
+ *
+ *	Description:	Gets ready to take a blob made by ConfigExport (or
+ *					tools/config_tool.cpp), and says "ready".  From then on
+ *					the serial port takes bytes of the blob rather than
+ *					commands, and reports stop.  The sender has to wait for
+ *					a "+" after every CONFIG_CHUNK bytes, since writing to
+ *					EEPROM is slower than the serial line.
+ *
+ *					Until the blob is in and checked, EEPROM is marked as
+ *					not holding good settings, so if the power fails part
+ *					way, the controller starts up on the defaults rather
+ *					than on half of each.
+ *
+ *****************************************************************************/
+
+void ConfigImportStart(void)
+{
+	EEPROM.write(RESET_ADDR, EEPROM_RESET);
+	config.Start();
+	configImporting = true;
+	configReceived = 0;
+	configLastByte = millis();
+	Serial.println(F("ready"));
+}
+
+// Take a byte of the blob being imported.  Line ends left from the w
+// command are skipped, and so is the rest of a blob that's gone bad, so
+// none of it is taken for commands.
+void ConfigImportByte(byte data)
+{
+	configState_t state;				// how the import is going
+
+	if ((configReceived == 0) && ((data == '\n') || (data == '\r')))
+	{
+		return;
+	}
+
+	configLastByte = millis();
+	configReceived++;
+	if (config.GetState() != CONFIG_STATE_RUNNING)
+	{
+		return;
+	}
+
+	state = config.Import(data);
+	if (state != CONFIG_STATE_RUNNING)
+	{
+		ConfigImportEnd(state);
+	}
+	else if (configReceived % CONFIG_CHUNK == 0)
+	{
+		Serial.write('+');
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		ConfigImportEnd
+ *
+ *	Description:	Finishes an import, and reports how it went:
+ *
+ *					config ok <writes>	the blob was good, and <writes>
+ *										EEPROM bytes changed
+ *					config header		it wasn't made for this firmware's
+ *										settings layout
+ *					config check		it was damaged on the way
+ *					config timeout		it stopped coming
+ *
+ *					With a good blob, the controller restarts (through the
+ *					watchdog) on the new settings.  A runaway alarm stays
+ *					latched, whatever the blob says.  Otherwise the settings
+ *					in use are saved again, over whatever part of the blob
+ *					got written; recipes the blob reached may be lost.  The
+ *					serial port goes back to commands once the line has been
+ *					quiet for CONFIG_TIMEOUT.
+ *
+ *	Parameters:		state - how the import ended (CONFIG_STATE_RUNNING if
+ *						it timed out)
+ *
+ *****************************************************************************/
+
+void ConfigImportEnd(configState_t state)
+{
+	Serial.print(F("config "));
+
+	if (state == CONFIG_STATE_DONE)
+	{
+		EEPROM.write(SAFETY_ALARM_ADDR, safety.GetAlarm());
+		EEPROM.write(RESET_ADDR, EEPROM_NO_RESET);
+		Serial.print(F("ok "));
+		Serial.println(config.GetWrites());
+		Serial.flush();
+		wdt_enable(WDTO_15MS);
+		for (;;)
+		{
+		}
+	}
+
+	if (state == CONFIG_STATE_BAD_HEADER)
+	{
+		Serial.println(F("header"));
+	}
+	else if (state == CONFIG_STATE_BAD_CHECK)
+	{
+		Serial.println(F("check"));
+	}
+	else
+	{
+		Serial.println(F("timeout"));
+	}
+
+	MemoryBackupAll();
+	MemoryInitRecipes();
+	EEPROM.write(RESET_ADDR, EEPROM_NO_RESET);
+}
+
+uint8_t ConfigRead(uint16_t address)
+{
+	return EEPROM.read(address);
+}
+
+void ConfigWrite(uint16_t address, uint8_t data)
+{
+	TRACE_BEGIN(TRACE_EEPROM, address);
+	EEPROM.write(address, data);
+	TRACE_END(TRACE_EEPROM, address);
+}
+
+/******************************************************************************
+ *
+ *	Function:		ModbusRegisters
+ *
+ *	Description:	Modbus register map.  Registers are signed 16-bit
+ *					numbers, scaled where noted; they can be read as holding
+ *					or input registers.  A process value that can't be read
+ *					is sent as -32768.
+ *
+ *					0	PV [0.1 C]							read-only
+ *					1	setpoint [0.1 C]
+ *					2	output [0.1 %]						manual mode only
+ *						(negative is cooling, in split range)
+ *					3	mode (0 = manual, 1 = automatic)
+ *					4	Kp [0.01]
+ *					5	Ki [0.01]
+ *					6	Kd [0.01]
+ *					7	direction (0 = direct, 1 = reverse)
+ *					8	controller type (0 = PID, 1 = Smith predictor,
+ *						2 = on/off, 3 = cascade, 4 = zones)
+ *					9	runaway alarm						write 0 to clear
+ *					10	sensor in use (0 = thermocouple)	read-only
+ *					11	protocol (1 = Modbus)				write 0 to go back
+ *															to text commands
+ *					12	time asleep during the last sample [0.1 %]
+ *															read-only
+ *					13	worst wake-up latency during the last sample
+ *						[microseconds]						read-only
+ *					14	sample period [mSec]				read-only
+ *					15	recipe last loaded (0 = none)		write 1 to
+ *															RECIPE_COUNT to
+ *															load a recipe
+ *					16	working setpoint [0.1 C]			read-only
+ *
+ *****************************************************************************/
+
+// Scale a value into a register, clamping it to fit.
+uint16_t ToRegister(double value, double scale)
+{
+	value *= scale;
+	if (isnan(value) || (value < -32767))
+	{
+		value = -32768;
+	}
+	else if (value > 32767)
+	{
+		value = 32767;
+	}
+
+	return (uint16_t)(int16_t)(value + ((value < 0) ? -0.5 : 0.5));
+}
+
+// Scale a register back into a value.
+double FromRegister(uint16_t value, double scale)
+{
+	return (int16_t)value / scale;
+}
+
+uint16_t RegReadPV(void)
+{
+	return ToRegister(inputFailed ? NAN : processValue, 10);
+}
+
+uint16_t RegReadSetpoint(void)
+{
+	return ToRegister(setpoint, 10);
+}
+
+bool RegWriteSetpoint(uint16_t value)
+{
+	setpoint = FromRegister(value, 10);
+	MemoryBackupDash();
+	return true;
+}
+
+uint16_t RegReadOutput(void)
+{
+	return ToRegister(outputValue, 10);
+}
+
+bool RegWriteOutput(uint16_t value)
+{
+	if (modeIndex != MANUAL)
+	{
+		return false;
+	}
+
+	outputValue = constrain(FromRegister(value, 10), OutputMin(), 100);
+	MemoryBackupDash();
+	return true;
+}
+
+uint16_t RegReadMode(void)
+{
+	return modeIndex;
+}
+
+bool RegWriteMode(uint16_t value)
+{
+	if (value > AUTOMATIC)
+	{
+		return false;
+	}
+
+	modeIndex = value;
+	myPID.SetMode(modeIndex);
+	MemoryBackupDash();
+	return true;
+}
+
+uint16_t RegReadKp(void)
+{
+	return ToRegister(myPID.GetKp(), 100);
+}
+
+bool RegWriteKp(uint16_t value)
+{
+	if ((int16_t)value < 0)
+	{
+		return false;
+	}
+
+	myPID.SetTunings(FromRegister(value, 100), myPID.GetKi(), myPID.GetKd());
+	MemoryBackupTunings();
+	return true;
+}
+
+uint16_t RegReadKi(void)
+{
+	return ToRegister(myPID.GetKi(), 100);
+}
+
+bool RegWriteKi(uint16_t value)
+{
+	if ((int16_t)value < 0)
+	{
+		return false;
+	}
+
+	myPID.SetTunings(myPID.GetKp(), FromRegister(value, 100), myPID.GetKd());
+	MemoryBackupTunings();
+	return true;
+}
+
+uint16_t RegReadKd(void)
+{
+	return ToRegister(myPID.GetKd(), 100);
+}
+
+bool RegWriteKd(uint16_t value)
+{
+	if ((int16_t)value < 0)
+	{
+		return false;
+	}
+
+	myPID.SetTunings(myPID.GetKp(), myPID.GetKi(), FromRegister(value, 100));
+	MemoryBackupTunings();
+	return true;
+}
+
+uint16_t RegReadDirection(void)
+{
+	return ctrlDirection;
+}
+
+bool RegWriteDirection(uint16_t value)
+{
+	if (value > REVERSE)
+	{
+		return false;
+	}
+
+	ctrlDirection = value;
+	myPID.SetControllerDirection(ctrlDirection);
+	thermostat.SetReverse(ctrlDirection == REVERSE);
+	safety.SetReverse(ctrlDirection == REVERSE);
+	MemoryBackupTunings();
+	return true;
+}
+
+uint16_t RegReadCtrlType(void)
+{
+	return ctrlType;
+}
+
+bool RegWriteCtrlType(uint16_t value)
+{
+	if (value > CTRL_TYPE_ZONES)
+	{
+		return false;
+	}
+
+	SetCtrlType(value);
+	return true;
+}
+
+uint16_t RegReadAlarm(void)
+{
+	return safety.GetAlarm();
+}
+
+bool RegWriteAlarm(uint16_t value)
+{
+	if (value != SAFETY_ALARM_NONE)
+	{
+		return false;
+	}
+
+	ClearAlarm();
+	return true;
+}
+
+uint16_t RegReadSensor(void)
+{
+	return supervisor.GetActiveSensor();
+}
+
+uint16_t RegReadProtocol(void)
+{
+	return serialProtocol;
+}
+
+bool RegWriteProtocol(uint16_t value)
+{
+	if (value != PROTOCOL_TEXT)
+	{
+		return value == PROTOCOL_MODBUS;
+	}
+
+	// The response to this write still goes out as Modbus.
+	SetProtocol(PROTOCOL_TEXT);
+	return true;
+}
+
+uint16_t RegReadSleep(void)
+{
+	return ToRegister(sleepStats.asleep * 100.0 / sleepStats.elapsed, 10);
+}
+
+uint16_t RegReadLatency(void)
+{
+	return sleepStats.maxLatency;
+}
+
+uint16_t RegReadPeriod(void)
+{
+	return samplePeriod;
+}
+
+uint16_t RegReadRecipe(void)
+{
+	return activeRecipe;
+}
+
+bool RegWriteRecipe(uint16_t value)
+{
+	return (value <= RECIPE_COUNT) && RequestRecipe(value);
+}
+
+uint16_t RegReadWorkingSetpoint(void)
+{
+	return ToRegister(workingSetpoint, 10);
+}
+
+const modbusRegister_t modbusRegisters[] PROGMEM =
+{
+	{ RegReadPV,		NULL },
+	{ RegReadSetpoint,	RegWriteSetpoint },
+	{ RegReadOutput,	RegWriteOutput },
+	{ RegReadMode,		RegWriteMode },
+	{ RegReadKp,		RegWriteKp },
+	{ RegReadKi,		RegWriteKi },
+	{ RegReadKd,		RegWriteKd },
+	{ RegReadDirection,	RegWriteDirection },
+	{ RegReadCtrlType,	RegWriteCtrlType },
+	{ RegReadAlarm,		RegWriteAlarm },
+	{ RegReadSensor,	NULL },
+	{ RegReadProtocol,	RegWriteProtocol },
+	{ RegReadSleep,		NULL },
+	{ RegReadLatency,	NULL },
+	{ RegReadPeriod,	NULL },
+	{ RegReadRecipe,	RegWriteRecipe },
+	{ RegReadWorkingSetpoint,	NULL },
+};
+
+/******************************************************************************
+ *
+ *	Function:		StartProtocol
+ *
+ *	Description:	Hands Modbus its register map, and starts it if that's
+ *					what the serial port was last set to speak.
+ *
+ *****************************************************************************/
+
+void StartProtocol(void)
+{
+	modbus.SetRegisters(modbusRegisters,
+		sizeof(modbusRegisters) / sizeof(modbusRegisters[0]));
+
+	if (serialProtocol == PROTOCOL_MODBUS)
+	{
+		modbus.Begin(baudRate);
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		SetProtocol
+ *
+ *	Description:	Switches the serial port between text commands and
+ *					Modbus, and remembers the choice.
+ *
+ *	Parameters:		protocol - PROTOCOL_TEXT or PROTOCOL_MODBUS
+ *
+ *****************************************************************************/
+
+void SetProtocol(byte protocol)
+{
+	if (protocol == PROTOCOL_MODBUS)
+	{
+		modbus.Begin(baudRate);
+	}
+	else
+	{
+		modbus.End();
+		serialIndex = 0;
+	}
+
+	serialProtocol = protocol;
+	EEPROM_writeAnything(PROTOCOL_ADDR, serialProtocol);
+	EEPROM_writeAnything(MODBUS_ID_ADDR, modbus.GetAddress());
+}
+
+/******************************************************************************
+ *
+ *	Function:		MemoryInit
+ *
+ *	Description:	Loads settings from EEPROM, and the run checkpoint.  If
+ *					EEPROM has never been written (or was wiped by a firmware
+ *					update), stores the defaults instead.
+ *
+ *****************************************************************************/
+
+void MemoryInit(void)
+{
+	double kp;							// tuning parameters
+	double ki;
+	double kd;
+	double beta;						// setpoint weights
+	double gamma;
+	double filterTime;					// derivative filter [sec]
+	double rampRate;					// setpoint ramp settings
+	double rampAccel;
+	unsigned long window;				// output window [mSec]
+	byte optimize;						// output optimizer on
+	byte split;							// split-range settings
+	double deadband;
+	double heatGain;
+	double coolGain;
+	unsigned long heatOff;
+	unsigned long coolOff;
+	double differential;				// on/off settings
+	unsigned long minOn;
+	unsigned long minOff;
+	byte failover;						// sensor failure settings
+	double maxRate;
+	double gain;						// process model parameters
+	double tau;
+	double deadTime;
+	byte sensorType;					// input card settings
+	byte thermModel;
+	double thermRes;
+	double thermBeta;
+	double thermRefTemp;
+	double thermDiv;
+	double shA;							// Steinhart-Hart coefficients
+	double shB;
+	double shC;
+	double tcNoise;						// sensor noise variances
+	double thNoise;
+	double tolerance;					// statistics' tolerance band
+	zoneRecord_t zone;					// a zone's settings
+	byte address;						// Modbus slave address
+	byte i;
+
+	// Relay operation counts survive a change of settings layout.
+	MemoryInitRelayWear();
+
+	// If EEPROM doesn't hold our settings, write the defaults.
+	if (EEPROM.read(RESET_ADDR) != EEPROM_NO_RESET)
+	{
+		MemoryBackupAll();
+		MemoryClearRecipes();
+		EEPROM.write(SAFETY_ALARM_ADDR, SAFETY_ALARM_NONE);
+		EEPROM.write(RESET_ADDR, EEPROM_NO_RESET);
+		MemoryInitCheckpoint();
+		MemoryInitRunSummaries();
+		return;
+	}
+
+	EEPROM_readAnything(DIR_ADDR, ctrlDirection);
+	EEPROM_readAnything(KP_ADDR, kp);
+	EEPROM_readAnything(KI_ADDR, ki);
+	EEPROM_readAnything(KD_ADDR, kd);
+	myPID.SetTunings(kp, ki, kd);
+	EEPROM_readAnything(PID_BETA_ADDR, beta);
+	EEPROM_readAnything(PID_GAMMA_ADDR, gamma);
+	myPID.SetWeights(beta, gamma);
+	EEPROM_readAnything(PID_DFILTER_ADDR, filterTime);
+	myPID.SetDerivativeFilter(filterTime);
+
+	EEPROM_readAnything(CASC_OUTER_KP_ADDR, kp);
+	EEPROM_readAnything(CASC_OUTER_KI_ADDR, ki);
+	EEPROM_readAnything(CASC_OUTER_KD_ADDR, kd);
+	outerPID.SetTunings(kp, ki, kd);
+	EEPROM_readAnything(CASC_INNER_KP_ADDR, kp);
+	EEPROM_readAnything(CASC_INNER_KI_ADDR, ki);
+	EEPROM_readAnything(CASC_INNER_KD_ADDR, kd);
+	innerPID.SetTunings(kp, ki, kd);
+
+	EEPROM_readAnything(RAMP_RATE_ADDR, rampRate);
+	EEPROM_readAnything(RAMP_ACCEL_ADDR, rampAccel);
+	ramp.SetRate(FixedFromDouble(rampRate));
+	ramp.SetAcceleration(FixedFromDouble(rampAccel));
+
+	EEPROM_readAnything(MODE_ADDR, modeIndex);
+	EEPROM_readAnything(SP_ADDR, setpoint);
+	EEPROM_readAnything(OUTPUT_ADDR, outputValue);
+
+	EEPROM_readAnything(TUNE_STEP_ADDR, aTuneStep);
+	EEPROM_readAnything(TUNE_NOISE_ADDR, aTuneNoise);
+	EEPROM_readAnything(TUNE_LOOKBACK_ADDR, aTuneLookBack);
+
+	EEPROM_readAnything(INPUT_TYPE_ADDR, sensorType);
+	EEPROM_readAnything(INPUT_REFRES_ADDR, thermRes);
+	EEPROM_readAnything(INPUT_BETA_ADDR, thermBeta);
+	EEPROM_readAnything(INPUT_REFTEMP_ADDR, thermRefTemp);
+	EEPROM_readAnything(INPUT_DIV_ADDR, thermDiv);
+	EEPROM_readAnything(INPUT_MODEL_ADDR, thermModel);
+	input.SetSensorType((inputSensor_t)sensorType);
+	input.SetThermistorCoeffs(thermRes, thermRefTemp, thermBeta, thermDiv);
+	if (thermModel == INPUT_THERM_STEINHART)
+	{
+		EEPROM_readAnything(INPUT_SH_A_ADDR, shA);
+		EEPROM_readAnything(INPUT_SH_B_ADDR, shB);
+		EEPROM_readAnything(INPUT_SH_C_ADDR, shC);
+		input.SetSteinhartCoeffs(shA, shB, shC);
+	}
+
+	EEPROM_readAnything(INPUT_FAILOVER_ADDR, failover);
+	EEPROM_readAnything(INPUT_SAFE_OUT_ADDR, safeOutput);
+	EEPROM_readAnything(INPUT_MAX_RATE_ADDR, maxRate);
+	supervisor.SetFailover(failover);
+	supervisor.SetMaxRate(maxRate);
+
+	EEPROM_readAnything(CTRL_TYPE_ADDR, ctrlType);
+	EEPROM_readAnything(MODEL_GAIN_ADDR, gain);
+	EEPROM_readAnything(MODEL_TAU_ADDR, tau);
+	EEPROM_readAnything(MODEL_DEADTIME_ADDR, deadTime);
+	smith.SetModel(gain, tau, deadTime);
+
+	EEPROM_readAnything(ESTIMATOR_ADDR, useEstimator);
+	EEPROM_readAnything(EST_TC_NOISE_ADDR, tcNoise);
+	EEPROM_readAnything(EST_TH_NOISE_ADDR, thNoise);
+	estimator.SetNoise(ESTIMATOR_SENSOR_THERMOCOUPLE, tcNoise);
+	estimator.SetNoise(ESTIMATOR_SENSOR_THERMISTOR, thNoise);
+
+	EEPROM_readAnything(ADAPTIVE_ADDR, adaptiveSampling);
+
+	EEPROM_readAnything(ONOFF_DIFF_ADDR, differential);
+	EEPROM_readAnything(ONOFF_MIN_ON_ADDR, minOn);
+	EEPROM_readAnything(ONOFF_MIN_OFF_ADDR, minOff);
+	thermostat.SetDifferential(FixedFromDouble(differential));
+	thermostat.SetMinTimes(minOn, minOff);
+
+	EEPROM_readAnything(OUTPUT_WINDOW_ADDR, window);
+	EEPROM_readAnything(OUTPUT_OPTIMIZE_ADDR, optimize);
+	output.SetOutputWindow(window / 1000.0);
+	output.SetOptimize(optimize);
+
+	EEPROM_readAnything(SPLIT_ADDR, split);
+	EEPROM_readAnything(SPLIT_DEADBAND_ADDR, deadband);
+	EEPROM_readAnything(SPLIT_HEAT_GAIN_ADDR, heatGain);
+	EEPROM_readAnything(SPLIT_COOL_GAIN_ADDR, coolGain);
+	EEPROM_readAnything(SPLIT_HEAT_OFF_ADDR, heatOff);
+	EEPROM_readAnything(SPLIT_COOL_OFF_ADDR, coolOff);
+	splitOutput = split;
+	splitRange.SetDeadband(deadband);
+	splitRange.SetGains(heatGain, coolGain);
+	output.SetMinOffTime(false, heatOff);
+	coolMinOff = coolOff;
+
+	EEPROM_readAnything(STATS_TOLERANCE_ADDR, tolerance);
+	statsTolerance = FixedFromDouble(tolerance);
+
+	for (i = 0; i < ZONE_COUNT; i++)
+	{
+		EEPROM_readAnything(ZONE_ADDR + i * sizeof(zoneRecord_t), zone);
+		zones.SetRecord(i, &zone);
+	}
+
+	MemoryInitRecipes();
+
+	EEPROM_readAnything(PROTOCOL_ADDR, serialProtocol);
+	EEPROM_readAnything(MODBUS_ID_ADDR, address);
+	if (!modbus.SetAddress(address))
+	{
+		serialProtocol = PROTOCOL_TEXT;
+	}
+
+	MemoryInitCheckpoint();
+	MemoryInitRunSummaries();
+}
+
+// Save every setting (but the recipes) from what's in use.
+void MemoryBackupAll(void)
+{
+	MemoryBackupTunings();
+	MemoryBackupDash();
+	MemoryBackupModel();
+	EEPROM_writeAnything(CTRL_TYPE_ADDR, ctrlType);
+	EEPROM_writeAnything(TUNE_STEP_ADDR, aTuneStep);
+	EEPROM_writeAnything(TUNE_NOISE_ADDR, aTuneNoise);
+	EEPROM_writeAnything(TUNE_LOOKBACK_ADDR, aTuneLookBack);
+	MemoryBackupInput();
+	MemoryBackupEstimator();
+	MemoryBackupThermostat();
+	MemoryBackupCascade();
+	MemoryBackupRamp();
+	EEPROM_writeAnything(SPLIT_ADDR, (byte)splitOutput);
+	MemoryBackupSplit();
+	EEPROM_writeAnything(OUTPUT_WINDOW_ADDR, output.GetOutputWindow());
+	EEPROM_writeAnything(OUTPUT_OPTIMIZE_ADDR, (byte)output.GetOptimize());
+	EEPROM_writeAnything(RECIPE_ACTIVE_ADDR, activeRecipe);
+	EEPROM_writeAnything(PROTOCOL_ADDR, serialProtocol);
+	EEPROM_writeAnything(MODBUS_ID_ADDR, modbus.GetAddress());
+	EEPROM_writeAnything(ADAPTIVE_ADDR, adaptiveSampling);
+	MemoryBackupStats();
+	MemoryBackupZones();
+}
+
+void MemoryBackupTunings(void)
+{
+	EEPROM_writeAnything(DIR_ADDR, ctrlDirection);
+	EEPROM_writeAnything(KP_ADDR, myPID.GetKp());
+	EEPROM_writeAnything(KI_ADDR, myPID.GetKi());
+	EEPROM_writeAnything(KD_ADDR, myPID.GetKd());
+	EEPROM_writeAnything(PID_BETA_ADDR, myPID.GetBeta());
+	EEPROM_writeAnything(PID_GAMMA_ADDR, myPID.GetGamma());
+	EEPROM_writeAnything(PID_DFILTER_ADDR, myPID.GetDerivativeFilter());
+}
+
+void MemoryBackupDash(void)
+{
+	EEPROM_writeAnything(MODE_ADDR, modeIndex);
+	EEPROM_writeAnything(SP_ADDR, setpoint);
+	EEPROM_writeAnything(OUTPUT_ADDR, outputValue);
+}
+
+void MemoryBackupInput(void)
+{
+	double shA;							// Steinhart-Hart coefficients
+	double shB;
+	double shC;
+
+	input.GetSteinhartCoeffs(&shA, &shB, &shC);
+	EEPROM_writeAnything(INPUT_TYPE_ADDR, (byte)input.GetSensorType());
+	EEPROM_writeAnything(INPUT_REFRES_ADDR, input.GetThermistorRefRes());
+	EEPROM_writeAnything(INPUT_BETA_ADDR, input.GetThermistorBeta());
+	EEPROM_writeAnything(INPUT_REFTEMP_ADDR, input.GetThermistorRefTemp());
+	EEPROM_writeAnything(INPUT_DIV_ADDR, input.GetThermistorDiv());
+	EEPROM_writeAnything(INPUT_MODEL_ADDR, (byte)input.GetThermistorModel());
+	EEPROM_writeAnything(INPUT_SH_A_ADDR, shA);
+	EEPROM_writeAnything(INPUT_SH_B_ADDR, shB);
+	EEPROM_writeAnything(INPUT_SH_C_ADDR, shC);
+	EEPROM_writeAnything(INPUT_FAILOVER_ADDR, (byte)supervisor.GetFailover());
+	EEPROM_writeAnything(INPUT_SAFE_OUT_ADDR, safeOutput);
+	EEPROM_writeAnything(INPUT_MAX_RATE_ADDR, supervisor.GetMaxRate());
+}
+
+void MemoryBackupModel(void)
+{
+	EEPROM_writeAnything(MODEL_GAIN_ADDR, smith.GetModelGain());
+	EEPROM_writeAnything(MODEL_TAU_ADDR, smith.GetModelTimeConstant());
+	EEPROM_writeAnything(MODEL_DEADTIME_ADDR, smith.GetModelDeadTime());
+}
+
+void MemoryBackupEstimator(void)
+{
+	EEPROM_writeAnything(ESTIMATOR_ADDR, useEstimator);
+	EEPROM_writeAnything(EST_TC_NOISE_ADDR,
+		estimator.GetNoise(ESTIMATOR_SENSOR_THERMOCOUPLE));
+	EEPROM_writeAnything(EST_TH_NOISE_ADDR,
+		estimator.GetNoise(ESTIMATOR_SENSOR_THERMISTOR));
+}
+
+/******************************************************************************
+ *
+ *	Function:		MemoryInitRelayWear
+ *
+ *	Description:	Restores the relays' operation counts.  They're saved
+ *					to RELAY_WEAR_SLOTS slots in turn, so no EEPROM cell is
+ *					written more than one time in RELAY_WEAR_SLOTS.  The
+ *					counts only go up, so the newest good slot is the one
+ *					with the highest total.  A slot that's blank, or was
+ *					only half written when the power went, fails its check.
+ *
+ *****************************************************************************/
+
+void MemoryInitRelayWear(void)
+{
+	relayWear_t wear;					// one slot
+	byte slot;
+	byte relay;
+	unsigned long best = 0;				// highest total found
+
+	for (slot = 0; slot < RELAY_WEAR_SLOTS; slot++)
+	{
+		EEPROM_readAnything(RELAY_WEAR_ADDR + slot * sizeof(relayWear_t),
+			wear);
+		if ((wear.check == RelayWearCheck(wear.count[0], wear.count[1])) &&
+			(wear.count[0] + wear.count[1] >= best))
+		{
+			best = wear.count[0] + wear.count[1];
+			wearSlot = slot;
+			output.SetSwitchCount(0, wear.count[0]);
+			output.SetSwitchCount(1, wear.count[1]);
+		}
+	}
+
+	wearSaved = best;
+	for (relay = 0; relay < 2; relay++)
+	{
+		bootCount[relay] = output.GetSwitchCount(relay);
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		MemoryBackupRelayWear
+ *
+ *	Description:	Saves the relays' operation counts to the next slot, once
+ *					they've gone up by RELAY_WEAR_SAVE_OPS since the last
+ *					save.  Call this from the main loop.  A power cut loses
+ *					fewer than RELAY_WEAR_SAVE_OPS operations.
+ *
+ *****************************************************************************/
+
+void MemoryBackupRelayWear(void)
+{
+	relayWear_t wear;					// counts to save
+	unsigned long total;				// operations of both relays
+
+	wear.count[0] = output.GetSwitchCount(0);
+	wear.count[1] = output.GetSwitchCount(1);
+	total = wear.count[0] + wear.count[1];
+	if (total - wearSaved < RELAY_WEAR_SAVE_OPS)
+	{
+		return;
+	}
+
+	wear.check = RelayWearCheck(wear.count[0], wear.count[1]);
+	wearSlot = (wearSlot + 1) % RELAY_WEAR_SLOTS;
+	EEPROM_writeAnything(RELAY_WEAR_ADDR + wearSlot * sizeof(relayWear_t),
+		wear);
+	wearSaved = total;
+}
+
+// A check value for a slot.  Blank EEPROM (all 0xFF) doesn't pass.
+uint16_t RelayWearCheck(unsigned long count1, unsigned long count2)
+{
+	return (uint16_t)(count1 ^ (count1 >> 16) ^ count2 ^ (count2 >> 16) ^
+		0x5AA5);
+}
+
+void MemoryBackupThermostat(void)
+{
+	EEPROM_writeAnything(ONOFF_DIFF_ADDR,
+		FixedToDouble(thermostat.GetDifferential()));
+	EEPROM_writeAnything(ONOFF_MIN_ON_ADDR, thermostat.GetMinOnTime());
+	EEPROM_writeAnything(ONOFF_MIN_OFF_ADDR, thermostat.GetMinOffTime());
+}
+
+/******************************************************************************
+ *
+ *	Function:		MemoryInitRecipes
+ *
+ *	Description:	Notes which recipes are stored, and restores the name of
+ *					the one last loaded.  This is the only time every recipe
+ *					is read; after this, loading one reads only its record.
+ *
+ *****************************************************************************/
+
+void MemoryInitRecipes(void)
+{
+	recipe_t recipe;
+	byte n;
+
+	recipesStored = 0;
+	for (n = 1; n <= RECIPE_COUNT; n++)
+	{
+		if (MemoryReadRecipe(n, &recipe))
+		{
+			recipesStored |= 1 << (n - 1);
+		}
+	}
+
+	EEPROM_readAnything(RECIPE_ACTIVE_ADDR, activeRecipe);
+	if ((activeRecipe < 1) || (activeRecipe > RECIPE_COUNT) ||
+		!MemoryReadRecipe(activeRecipe, &recipe))
+	{
+		activeRecipe = 0;
+		return;
+	}
+	strcpy(recipeName, recipe.name);
+}
+
+/******************************************************************************
+ *
+ *	Function:		MemoryClearRecipes
+ *
+ *	Description:	Forgets every recipe, by spoiling each one's check.  That
+ *					writes one byte per recipe, instead of the whole thing.
+ *
+ *****************************************************************************/
+
+void MemoryClearRecipes(void)
+{
+	recipe_t recipe;
+	byte n;
+
+	for (n = 1; n <= RECIPE_COUNT; n++)
+	{
+		EEPROM_readAnything(RECIPE_ADDR + (n - 1) * sizeof(recipe_t), recipe);
+		if (recipe.check == RecipeCheck(&recipe))
+		{
+			EEPROM.write(RECIPE_ADDR + n * sizeof(recipe_t) - 1,
+				recipe.check + 1);
+		}
+	}
+	recipesStored = 0;
+}
+
+// Read a recipe.  Returns false if it's blank or damaged.
+bool MemoryReadRecipe(byte number, recipe_t *recipe)
+{
+	EEPROM_readAnything(RECIPE_ADDR + (number - 1) * sizeof(recipe_t),
+		*recipe);
+	recipe->name[RECIPE_NAME_SIZE - 1] = '\0';
+	return recipe->check == RecipeCheck(recipe);
+}
+
+void MemoryWriteRecipe(byte number, recipe_t *recipe)
+{
+	recipe->check = RecipeCheck(recipe);
+	EEPROM_writeAnything(RECIPE_ADDR + (number - 1) * sizeof(recipe_t),
+		*recipe);
+	recipesStored |= 1 << (number - 1);
+}
+
+void MemoryBackupRamp(void)
+{
+	EEPROM_writeAnything(RAMP_RATE_ADDR, FixedToDouble(ramp.GetRate()));
+	EEPROM_writeAnything(RAMP_ACCEL_ADDR,
+		FixedToDouble(ramp.GetAcceleration()));
+}
+
+void MemoryBackupSplit(void)
+{
+	EEPROM_writeAnything(SPLIT_DEADBAND_ADDR, splitRange.GetDeadband());
+	EEPROM_writeAnything(SPLIT_HEAT_GAIN_ADDR, splitRange.GetHeatGain());
+	EEPROM_writeAnything(SPLIT_COOL_GAIN_ADDR, splitRange.GetCoolGain());
+	EEPROM_writeAnything(SPLIT_HEAT_OFF_ADDR, output.GetMinOffTime(false));
+	EEPROM_writeAnything(SPLIT_COOL_OFF_ADDR, coolMinOff);
+}
+
+void MemoryBackupCascade(void)
+{
+	EEPROM_writeAnything(CASC_OUTER_KP_ADDR, outerPID.GetKp());
+	EEPROM_writeAnything(CASC_OUTER_KI_ADDR, outerPID.GetKi());
+	EEPROM_writeAnything(CASC_OUTER_KD_ADDR, outerPID.GetKd());
+	EEPROM_writeAnything(CASC_INNER_KP_ADDR, innerPID.GetKp());
+	EEPROM_writeAnything(CASC_INNER_KI_ADDR, innerPID.GetKi());
+	EEPROM_writeAnything(CASC_INNER_KD_ADDR, innerPID.GetKd());
+}
+
+/******************************************************************************
+ *
+ *	Function:		MemoryInitCheckpoint
+ *
+ *	Description:	Finds the newest run checkpoint, and if the run it
+ *					belongs to was still going when the power went, picks it
+ *					up:  the output (which the PID starts from) and the time
+ *					into the run.  Checkpoints are saved to CHECKPOINT_SLOTS
+ *					slots in turn, like the relay wear counts.  The newest
+ *					good slot is the one with the highest sequence number,
+ *					allowing for it wrapping around.
+ *
+ *****************************************************************************/
+
+void MemoryInitCheckpoint(void)
+{
+	checkpoint_t checkpoint;			// one slot
+	checkpoint_t newest;				// newest good slot
+	byte slot;
+	bool found = false;
+
+	for (slot = 0; slot < CHECKPOINT_SLOTS; slot++)
+	{
+		EEPROM_readAnything(CHECKPOINT_ADDR + slot * sizeof(checkpoint_t),
+			checkpoint);
+		if ((checkpoint.check == RecordCheck((const byte *)&checkpoint,
+			sizeof(checkpoint))) &&
+			(!found || ((int16_t)(checkpoint.sequence - newest.sequence) > 0)))
+		{
+			newest = checkpoint;
+			checkpointSlot = slot;
+			found = true;
+		}
+	}
+	if (!found)
+	{
+		return;
+	}
+	checkpointSequence = newest.sequence;
+
+	// Only resume the run that was saved:  still automatic, same recipe.
+	if ((newest.mode != AUTOMATIC) || (modeIndex != AUTOMATIC) ||
+		(newest.recipe != activeRecipe))
+	{
+		return;
+	}
+	outputValue = newest.output;
+	resumed = newest.elapsed;
+	running = true;
+	runStart = millis() - resumed * 1000;
+	lastCheckpoint = millis();
+}
+
+void MemoryBackupCheckpoint(void)
+{
+	checkpoint_t checkpoint;			// run state to save
+
+	checkpoint.sequence = ++checkpointSequence;
+	checkpoint.mode = modeIndex;
+	checkpoint.recipe = activeRecipe;
+	checkpoint.output = outputValue;
+	checkpoint.elapsed = (lastSample - runStart) / 1000;
+	checkpoint.check = RecordCheck((const byte *)&checkpoint,
+		sizeof(checkpoint));
+	checkpointSlot = (checkpointSlot + 1) % CHECKPOINT_SLOTS;
+	EEPROM_writeAnything(CHECKPOINT_ADDR + checkpointSlot *
+		sizeof(checkpoint_t), checkpoint);
+}
+
+/******************************************************************************
+ *
+ *	Function:		MemoryInitRunSummaries
+ *
+ *	Description:	Finds the newest saved run summary, so the next one goes
+ *					in the slot after it.  Summaries are saved like the run
+ *					checkpoints, to RUN_SUMMARY_SLOTS slots in turn.
+ *
+ *****************************************************************************/
+
+void MemoryInitRunSummaries(void)
+{
+	runSummary_t summary;				// one slot
+	byte slot;
+	bool found = false;
+
+	for (slot = 0; slot < RUN_SUMMARY_SLOTS; slot++)
+	{
+		if (MemoryReadRunSummary(slot, &summary) &&
+			(!found || ((int16_t)(summary.sequence - summarySequence) > 0)))
+		{
+			summarySequence = summary.sequence;
+			summarySlot = slot;
+			found = true;
+		}
+	}
+}
+
+// Save the run's statistics to the next slot.
+void MemoryBackupRunSummary(void)
+{
+	runSummary_t summary;				// run statistics to save
+
+	runStats.Summarize(&summary);
+	summary.sequence = ++summarySequence;
+	summary.recipe = activeRecipe;
+	summary.duration = (lastSample - runStart) / 1000;
+	summary.check = RecordCheck((const byte *)&summary, sizeof(summary));
+	summarySlot = (summarySlot + 1) % RUN_SUMMARY_SLOTS;
+	EEPROM_writeAnything(RUN_SUMMARY_ADDR + summarySlot *
+		sizeof(runSummary_t), summary);
+}
+
+// Read a run summary.  Returns false if it's blank or damaged.
+bool MemoryReadRunSummary(byte slot, runSummary_t *summary)
+{
+	EEPROM_readAnything(RUN_SUMMARY_ADDR + slot * sizeof(runSummary_t),
+		*summary);
+	return summary->check == RecordCheck((const byte *)summary,
+		sizeof(runSummary_t));
+}
+
+void MemoryBackupStats(void)
+{
+	EEPROM_writeAnything(STATS_TOLERANCE_ADDR, FixedToDouble(statsTolerance));
+}
+
+void MemoryBackupZones(void)
+{
+	zoneRecord_t zone;					// a zone's settings
+	byte i;
+
+	for (i = 0; i < ZONE_COUNT; i++)
+	{
+		zones.GetRecord(i, &zone);
+		EEPROM_writeAnything(ZONE_ADDR + i * sizeof(zoneRecord_t), zone);
+	}
+}
+
+// A check value for a saved record of size bytes (everything before its
+// check, which is last).  Blank EEPROM (all 0xFF) doesn't pass.
+uint16_t RecordCheck(const byte *data, byte size)
+{
+	uint16_t sum = 0x5AA5;
+	byte i;
+
+	for (i = 0; i < size - sizeof(uint16_t); i++)
+	{
+		sum = sum * 31 + data[i];
+	}
+	return sum;
+}
@@ -0,0 +1,168 @@
+/******************************************************************************
+ *
+ *	Filename:		adaptive_sim.cpp
+ *
+ *	Description:	Simulates an oven (first order plus dead time) under the
+ *					firmware's PID, and compares a fixed sample period with
+ *					the AdaptiveSampler:  how many times the PID runs (the
+ *					CPU cost) against the integral of the absolute error
+ *					(the control quality).
+ *
+ *					The oven starts cold at AMBIENT, the setpoint steps to
+ *					SETPOINT, and at LOAD_TIME a load knocks LOAD_DROP off
+ *					the temperature it would settle at.  The PV is read with
+ *					NOISE (peak to peak) of uniform noise, and its rate of
+ *					change is filtered over RATE_TIME, as the estimator
+ *					would.  The PID sees a new period as soon as the sampler
+ *					picks it, as through SetSamplePeriod in the sketch.
+ *
+ *					For each mode it prints the PID runs, the IAE [C sec]
+ *					and the overshoot of the setpoint step [C].
+ *
+ *	Build:			g++ -O2 -I osPID_Firmware -o adaptive_sim \
+ *						tools/adaptive_sim.cpp osPID_Firmware/PID_v1.cpp \
+ *						osPID_Firmware/AdaptiveSampler.cpp
+ *
+ *	Usage:			adaptive_sim
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "PID_v1_local.h"
+#include "AdaptiveSampler.h"
+
+// Oven model
+#define GAIN			2.0				// [C/%]
+#define TAU				120.0			// time constant [seconds]
+#define DEAD_TIME		500				// [ticks] (5 seconds)
+#define AMBIENT			25.0			// [C]
+#define LOAD_DROP		15.0			// [C]
+
+// Sensor
+#define NOISE			0.1				// [C peak to peak]
+#define RATE_TIME		5.0				// rate filter [seconds]
+
+// Tunings
+#define KP				4.0
+#define KI				0.04
+#define KD				10.0
+
+#define SETPOINT		100.0			// [C]
+#define BASE_PERIOD		1000			// basePeriod [mSec]
+#define FAST_PERIOD		100				// SAMPLER_FAST_PERIOD [mSec]
+#define LOAD_TIME		1500000UL		// [mSec]
+#define RUN_TIME		3000000UL		// [mSec]
+#define TICK			10				// simulation step [mSec]
+
+typedef enum							// how the period is picked
+{
+	MODE_FAST,							// fixed at FAST_PERIOD
+	MODE_BASE,							// fixed at BASE_PERIOD
+	MODE_ADAPTIVE,						// by the AdaptiveSampler
+} sampling_t;
+
+typedef struct							// how a run went
+{
+	long samples;						// times the PID ran
+	double iae;							// integral of |error| [C sec]
+	double overshoot;					// of the setpoint step [C]
+} result_t;
+
+// Run the oven for RUN_TIME under one mode.
+static void Run(sampling_t mode, result_t *result)
+{
+	static double delay[DEAD_TIME];		// output on its way to the oven [%]
+	double processValue = AMBIENT;		// as the PID sees it [C]
+	double output = 0;					// [%]
+	double setpoint = SETPOINT;			// [C]
+	PID pid(&processValue, &output, &setpoint, KP, KI, KD, DIRECT);
+	AdaptiveSampler sampler;
+	unsigned long period;				// sample period [mSec]
+	unsigned long next = 0;				// when the next sample is due [mSec]
+	unsigned long t;					// [mSec]
+	double rise = 0;					// oven above ambient [C]
+	double temperature;					// oven [C]
+	double load;						// load's drop [C]
+	double delayed;						// output reaching the oven [%]
+	double reading;						// sensor reading [C]
+	double lastReading = AMBIENT;		// last sample's [C]
+	double rate = 0;					// filtered rate of change [C/sec]
+	double dt;							// sample period [seconds]
+	double peak = 0;					// before the load [C]
+	unsigned long p;					// period the sampler picked [mSec]
+	int i;
+
+	period = (mode == MODE_FAST) ? FAST_PERIOD : BASE_PERIOD;
+	pid.SetSampleTime(period);
+	pid.SetOutputLimits(0, 100);
+	pid.SetMode(AUTOMATIC);
+	sampler.SetPeriod(BASE_PERIOD);
+	for (i = 0; i < DEAD_TIME; i++)
+	{
+		delay[i] = 0;
+	}
+	srand(1);
+
+	result->samples = 0;
+	result->iae = 0;
+	for (t = 0; t < RUN_TIME; t += TICK)
+	{
+		load = (t > LOAD_TIME) ? -LOAD_DROP : 0;
+		delayed = delay[(t / TICK) % DEAD_TIME];
+		delay[(t / TICK) % DEAD_TIME] = output;
+		rise += (1 - exp(-(TICK / 1000.0) / TAU)) *
+			(GAIN * delayed + load - rise);
+		temperature = AMBIENT + rise;
+
+		if (t >= next)
+		{
+			reading = temperature +
+				((rand() % 1000) / 1000.0 - 0.5) * NOISE;
+			dt = period / 1000.0;
+			rate += dt / (dt + RATE_TIME) *
+				((reading - lastReading) / dt - rate);
+			lastReading = reading;
+			processValue = reading;
+			pid.Compute();
+			result->samples++;
+			if (mode == MODE_ADAPTIVE)
+			{
+				p = sampler.Update(setpoint - processValue, rate);
+				if (p != period)
+				{
+					period = p;
+					pid.SetSampleTime(p);
+				}
+			}
+			next += period;
+		}
+
+		result->iae += fabs(setpoint - temperature) * (TICK / 1000.0);
+		if ((t < LOAD_TIME) && (temperature > peak))
+		{
+			peak = temperature;
+		}
+	}
+	result->overshoot = peak - SETPOINT;
+}
+
+int main(void)
+{
+	static const char *names[] =
+	{
+		"fixed 100 ms", "fixed 1000 ms", "adaptive",
+	};
+	result_t result;
+	int mode;
+
+	printf("%-14s %8s %10s %10s\n", "", "samples", "IAE C*s", "over C");
+	for (mode = MODE_FAST; mode <= MODE_ADAPTIVE; mode++)
+	{
+		Run((sampling_t)mode, &result);
+		printf("%-14s %8ld %10.0f %10.2f\n", names[mode], result.samples,
+			result.iae, result.overshoot);
+	}
+	return 0;
+}
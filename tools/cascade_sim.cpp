@@ -0,0 +1,295 @@
+/******************************************************************************
+ *
+ *	Filename:		cascade_sim.cpp
+ *
+ *	Description:	Simulates a jacketed vessel (a heater heats a jacket,
+ *					which heats the product), and compares a single PID on
+ *					the product's temperature with the firmware's cascade
+ *					control:  an outer PID on the product (the thermocouple)
+ *					sets the jacket temperature, and an inner PID on the
+ *					jacket (the thermistor) drives the heater.  The outer
+ *					loop runs every RATIO samples, as in RunCascade.
+ *
+ *					The vessel starts settled at the setpoint.  After
+ *					DISTURB_TIME one of two things happens:
+ *
+ *					-	heater sag:  the heater's power drops to
+ *						SAG_POWER of normal (a low supply voltage)
+ *					-	product load:  the product suddenly cools by
+ *						LOAD_STEP (cold product added)
+ *
+ *					For each it reports, from the disturbance on:  the
+ *					integral of the product's absolute error [C sec], the
+ *					peak error [C], the time until the error stays within
+ *					RECOVER_BAND [seconds], and how much the output moved
+ *					[% per hour], which shows how hard each controller works
+ *					the relay.
+ *
+ *					The tunings are the best found by a grid search over
+ *					both disturbances, with output movement held under 3000
+ *					% per hour; the cascade ones are the firmware's defaults.
+ *					The sensors are lagged, noisy and quantized like the
+ *					real ones, and the heater is driven through a relay
+ *					window.
+ *
+ *	Build:			g++ -O2 -I osPID_Firmware -o cascade_sim \
+ *						tools/cascade_sim.cpp osPID_Firmware/PID_v1.cpp
+ *
+ *	Usage:			cascade_sim [ratio]
+ *
+ *					ratio is the number of samples per run of the outer
+ *					loop (default 4, as in the firmware).
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "PID_v1_local.h"
+
+// Vessel model
+#define JACKET_CAP		4000.0			// jacket heat capacity [J/C]
+#define PRODUCT_CAP		40000.0			// product heat capacity [J/C]
+#define JACKET_PRODUCT	50.0			// jacket to product [W/C]
+#define JACKET_AMBIENT	2.0				// jacket to ambient [W/C]
+#define PRODUCT_AMBIENT	5.0				// product to ambient [W/C]
+#define HEATER_POWER	1500.0			// [W]
+#define AMBIENT			20.0			// [C]
+
+// Sensors
+#define TC_LAG			30.0			// thermocouple (in a well) [seconds]
+#define TC_STEP			0.25			// MAX31855 resolution [C]
+#define TC_NOISE		0.1				// [C RMS]
+#define THERM_LAG		5.0				// thermistor (on the jacket) [seconds]
+#define THERM_STEP		0.1				// [C]
+#define THERM_NOISE		0.05			// [C RMS]
+
+// Tunings
+#define SINGLE_KP		8.0
+#define SINGLE_KI		(SINGLE_KP / 565)
+#define OUTER_KP		5.0				// defaultOuterKp etc.
+#define OUTER_KI		0.002
+#define INNER_KP		4.0
+#define INNER_KI		0.1
+
+#define SETPOINT		60.0			// [C]
+#define RATIO			4				// cascadeRatio
+#define MAX_INNER		250.0			// cascadeMaxInner [C]
+#define SAMPLE_TIME		1000			// [mSec]
+#define WINDOW			10.0			// output window [seconds]
+#define TICK			0.1				// simulation step [seconds]
+#define RUN_TIME		(3 * 3600)		// [seconds]
+#define DISTURB_TIME	600				// [seconds]
+#define SAG_POWER		0.7				// heater power after a sag
+#define LOAD_STEP		5.0				// product cooling [C]
+#define RECOVER_BAND	0.5				// [C]
+
+enum { SAG, LOAD };						// disturbances
+
+typedef struct							// the vessel, and what's measured
+{
+	double jacket;						// [C]
+	double product;						// [C]
+	double tc;							// thermocouple, before noise [C]
+	double therm;						// thermistor, before noise [C]
+	double power;						// heater power [fraction of normal]
+} vessel_t;
+
+typedef struct							// how a run went
+{
+	double iae;							// [C sec]
+	double peak;						// [C]
+	double recover;						// [seconds]
+	double moves;						// [% per hour]
+} result_t;
+
+static unsigned long seed;				// noise generator state
+
+// Gaussian noise (near enough), of unit RMS.
+static double Noise(void)
+{
+	double sum = 0;
+	int i;
+
+	for (i = 0; i < 12; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		sum += ((seed >> 16) & 0x7FFF) / 32768.0;
+	}
+	return sum - 6;
+}
+
+static double Quantize(double value, double step)
+{
+	return floor(value / step + 0.5) * step;
+}
+
+// Settle the vessel at the setpoint, and return the output that holds it.
+static double Settle(vessel_t *v)
+{
+	v->product = SETPOINT;
+	v->jacket = SETPOINT + PRODUCT_AMBIENT * (SETPOINT - AMBIENT) /
+		JACKET_PRODUCT;
+	v->tc = v->product;
+	v->therm = v->jacket;
+	v->power = 1;
+	seed = 1;
+	return 100 * (JACKET_PRODUCT * (v->jacket - v->product) +
+		JACKET_AMBIENT * (v->jacket - AMBIENT)) / HEATER_POWER;
+}
+
+// Run the vessel for one second at "output" [%], starting at time t.
+static void Step(vessel_t *v, double output, int t)
+{
+	double time;
+	double heat;						// heater power [W]
+	double flow;						// jacket to product [W]
+
+	for (time = t; time < t + 1 - TICK / 2; time += TICK)
+	{
+		heat = (fmod(time, WINDOW) < output / 100 * WINDOW) ?
+			HEATER_POWER * v->power : 0;
+		flow = JACKET_PRODUCT * (v->jacket - v->product);
+		v->jacket += TICK * (heat - flow -
+			JACKET_AMBIENT * (v->jacket - AMBIENT)) / JACKET_CAP;
+		v->product += TICK * (flow -
+			PRODUCT_AMBIENT * (v->product - AMBIENT)) / PRODUCT_CAP;
+		v->tc += TICK * (v->product - v->tc) / TC_LAG;
+		v->therm += TICK * (v->jacket - v->therm) / THERM_LAG;
+	}
+}
+
+static void Disturb(vessel_t *v, int disturbance, int t)
+{
+	if (t == DISTURB_TIME)
+	{
+		if (disturbance == SAG)
+		{
+			v->power = SAG_POWER;
+		}
+		else
+		{
+			v->product -= LOAD_STEP;
+		}
+	}
+}
+
+static void Measure(result_t *r, vessel_t *v, int t, double output,
+	double *lastOutput)
+{
+	double error = fabs(v->product - SETPOINT);
+
+	if (t >= DISTURB_TIME)
+	{
+		r->iae += error;
+		if (error > r->peak)
+		{
+			r->peak = error;
+		}
+		if (error > RECOVER_BAND)
+		{
+			r->recover = t + 1 - DISTURB_TIME;
+		}
+		r->moves += fabs(output - *lastOutput);
+	}
+	*lastOutput = output;
+}
+
+static result_t Single(int disturbance)
+{
+	vessel_t v;
+	result_t r = { 0, 0, 0, 0 };
+	double output = Settle(&v);
+	double lastOutput = output;
+	double input = SETPOINT;
+	double setpoint = SETPOINT;
+	int t;
+	PID pid(&input, &output, &setpoint, SINGLE_KP, SINGLE_KI, 0, DIRECT);
+
+	pid.SetSampleTime(SAMPLE_TIME);
+	pid.SetOutputLimits(0, 100);
+	pid.SetMode(AUTOMATIC);
+
+	for (t = 0; t < RUN_TIME; t++)
+	{
+		Disturb(&v, disturbance, t);
+		input = Quantize(v.tc + TC_NOISE * Noise(), TC_STEP);
+		pid.Compute();
+		Step(&v, output, t);
+		Measure(&r, &v, t, output, &lastOutput);
+	}
+	r.moves /= RUN_TIME / 3600;
+	return r;
+}
+
+static result_t Cascade(int disturbance, int ratio)
+{
+	vessel_t v;
+	result_t r = { 0, 0, 0, 0 };
+	double output = Settle(&v);
+	double lastOutput = output;
+	double input = SETPOINT;
+	double innerInput = v.jacket;
+	double innerSetpoint = v.jacket;
+	double setpoint = SETPOINT;
+	int t;
+	PID outer(&input, &innerSetpoint, &setpoint, OUTER_KP, OUTER_KI, 0,
+		DIRECT);
+	PID inner(&innerInput, &output, &innerSetpoint, INNER_KP, INNER_KI, 0,
+		DIRECT);
+
+	outer.SetSampleTime(SAMPLE_TIME * ratio);
+	outer.SetOutputLimits(0, MAX_INNER);
+	outer.SetMode(AUTOMATIC);
+	inner.SetSampleTime(SAMPLE_TIME);
+	inner.SetOutputLimits(0, 100);
+	inner.SetMode(AUTOMATIC);
+
+	for (t = 0; t < RUN_TIME; t++)
+	{
+		Disturb(&v, disturbance, t);
+		input = Quantize(v.tc + TC_NOISE * Noise(), TC_STEP);
+		innerInput = Quantize(v.therm + THERM_NOISE * Noise(), THERM_STEP);
+		if (t % ratio == 0)
+		{
+			outer.Compute();
+		}
+		inner.Compute();
+		Step(&v, output, t);
+		Measure(&r, &v, t, output, &lastOutput);
+	}
+	r.moves /= RUN_TIME / 3600;
+	return r;
+}
+
+static void Print(const char *name, result_t r)
+{
+	printf("  %-10s %8.0f %8.2f %8.0f %8.0f\n", name, r.iae, r.peak,
+		r.recover, r.moves);
+}
+
+int main(int argc, char **argv)
+{
+	int ratio = RATIO;
+
+	if (argc > 1)
+	{
+		ratio = atoi(argv[1]);
+		if (ratio < 1)
+		{
+			ratio = 1;
+		}
+	}
+
+	printf("outer loop every %d samples\n", ratio);
+	printf("               IAE     peak  recover    moves\n");
+	printf("             [C s]      [C]      [s]   [%%/h]\n");
+	printf("heater sag to %.0f%%\n", SAG_POWER * 100);
+	Print("single", Single(SAG));
+	Print("cascade", Cascade(SAG, ratio));
+	printf("product load of %.0f C\n", LOAD_STEP);
+	Print("single", Single(LOAD));
+	Print("cascade", Cascade(LOAD, ratio));
+
+	return 0;
+}
@@ -0,0 +1,601 @@
+/******************************************************************************
+ *
+ *	Filename:		config_tool.cpp
+ *
+ *	Description:	Provisions osPID units from configuration blobs (see
+ *					ConfigBlob.cpp):  pulls a unit's settings into a file,
+ *					shows a file's settings by name, compares two files,
+ *					edits settings in a file, and pushes a file to a unit.
+ *					A file is the blob exactly as the firmware sends it, CRC
+ *					and all, and is checked every time it's read.
+ *
+ *					A typical fleet setup:  set up one unit by hand, pull
+ *					its settings, then for each of the others, set its
+ *					Modbus address in a copy and push it.  A push takes a
+ *					second or two (more when most of EEPROM changes, as
+ *					each byte written takes 3.3 mSec); the unit then
+ *					restarts on the new settings.
+ *
+ *					Settings are named after what they set; times are in
+ *					mSec, as in EEPROM.  Runs on Linux, on a little-endian
+ *					PC (as the AVR is).
+ *
+ *	Build:			g++ -O2 -I osPID_Firmware -o config_tool \
+ *						tools/config_tool.cpp osPID_Firmware/ConfigBlob.cpp \
+ *						osPID_Firmware/ModbusRtu.cpp \
+ *						osPID_Firmware/Recipe.cpp
+ *
+ *	Usage:			config_tool pull <port> <file>
+ *					config_tool push <port> <file>
+ *					config_tool show <file>
+ *					config_tool diff <file> <file>
+ *					config_tool set <file> <name>=<value> ...
+ *
+ *					port is the unit's serial port, e.g. /dev/ttyUSB0.
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <poll.h>
+#include <time.h>
+#include "EEPROMLayout.h"
+#include "ConfigBlob.h"
+#include "Recipe.h"
+#include "ZoneEngine.h"
+
+#define EEPROM_SIZE		1024			// ATmega328P [bytes]
+#define BOOT_TIMEOUT	10000			// wait for the first report [mSec]
+#define REPLY_TIMEOUT	5000			// wait for any other reply [mSec]
+
+typedef struct							// a setting, by name
+{
+	const char *name;
+	uint16_t address;
+	char type;							// 'b' byte, 'f' float (an AVR
+										// double), 'h' uint16_t, 'u'
+										// unsigned long
+} field_t;
+
+// A zone's settings (see zoneRecord_t; the window is in 0.1 sec).
+#define ZONE_FIELD_ADDR(n, member) \
+	(ZONE_ADDR + (n) * sizeof(zoneRecord_t) + offsetof(zoneRecord_t, member))
+#define ZONE_FIELDS(zone, n) \
+	{ zone "sp", ZONE_FIELD_ADDR(n, setpoint), 'f' }, \
+	{ zone "kp", ZONE_FIELD_ADDR(n, kp), 'f' }, \
+	{ zone "ki", ZONE_FIELD_ADDR(n, ki), 'f' }, \
+	{ zone "kd", ZONE_FIELD_ADDR(n, kd), 'f' }, \
+	{ zone "window", ZONE_FIELD_ADDR(n, window), 'h' }, \
+	{ zone "flags", ZONE_FIELD_ADDR(n, flags), 'b' }
+
+static const field_t fields[] =
+{
+	{ "dir",			DIR_ADDR,				'b' },
+	{ "kp",				KP_ADDR,				'f' },
+	{ "ki",				KI_ADDR,				'f' },
+	{ "kd",				KD_ADDR,				'f' },
+	{ "beta",			PID_BETA_ADDR,			'f' },
+	{ "gamma",			PID_GAMMA_ADDR,			'f' },
+	{ "dfilter",		PID_DFILTER_ADDR,		'f' },
+	{ "mode",			MODE_ADDR,				'b' },
+	{ "sp",				SP_ADDR,				'f' },
+	{ "out",			OUTPUT_ADDR,			'f' },
+	{ "tune_step",		TUNE_STEP_ADDR,			'f' },
+	{ "tune_noise",		TUNE_NOISE_ADDR,		'f' },
+	{ "tune_lookback",	TUNE_LOOKBACK_ADDR,		'f' },
+	{ "sensor",			INPUT_TYPE_ADDR,		'b' },
+	{ "therm_res",		INPUT_REFRES_ADDR,		'f' },
+	{ "therm_beta",		INPUT_BETA_ADDR,		'f' },
+	{ "therm_ref_temp",	INPUT_REFTEMP_ADDR,		'f' },
+	{ "therm_div",		INPUT_DIV_ADDR,			'f' },
+	{ "therm_model",	INPUT_MODEL_ADDR,		'b' },
+	{ "sh_a",			INPUT_SH_A_ADDR,		'f' },
+	{ "sh_b",			INPUT_SH_B_ADDR,		'f' },
+	{ "sh_c",			INPUT_SH_C_ADDR,		'f' },
+	{ "failover",		INPUT_FAILOVER_ADDR,	'b' },
+	{ "safe_out",		INPUT_SAFE_OUT_ADDR,	'f' },
+	{ "max_rate",		INPUT_MAX_RATE_ADDR,	'f' },
+	{ "ctrl_type",		CTRL_TYPE_ADDR,			'b' },
+	{ "model_gain",		MODEL_GAIN_ADDR,		'f' },
+	{ "model_tau",		MODEL_TAU_ADDR,			'f' },
+	{ "model_dead_time",	MODEL_DEADTIME_ADDR,	'f' },
+	{ "estimator",		ESTIMATOR_ADDR,			'b' },
+	{ "tc_noise",		EST_TC_NOISE_ADDR,		'f' },
+	{ "th_noise",		EST_TH_NOISE_ADDR,		'f' },
+	{ "protocol",		PROTOCOL_ADDR,			'b' },
+	{ "modbus_id",		MODBUS_ID_ADDR,			'b' },
+	{ "adaptive",		ADAPTIVE_ADDR,			'b' },
+	{ "onoff_diff",		ONOFF_DIFF_ADDR,		'f' },
+	{ "onoff_min_on",	ONOFF_MIN_ON_ADDR,		'u' },
+	{ "onoff_min_off",	ONOFF_MIN_OFF_ADDR,		'u' },
+	{ "recipe_active",	RECIPE_ACTIVE_ADDR,		'b' },
+	{ "outer_kp",		CASC_OUTER_KP_ADDR,		'f' },
+	{ "outer_ki",		CASC_OUTER_KI_ADDR,		'f' },
+	{ "outer_kd",		CASC_OUTER_KD_ADDR,		'f' },
+	{ "inner_kp",		CASC_INNER_KP_ADDR,		'f' },
+	{ "inner_ki",		CASC_INNER_KI_ADDR,		'f' },
+	{ "inner_kd",		CASC_INNER_KD_ADDR,		'f' },
+	{ "ramp_rate",		RAMP_RATE_ADDR,			'f' },
+	{ "ramp_accel",		RAMP_ACCEL_ADDR,		'f' },
+	{ "output_relay",	OUTPUT_RELAY_ADDR,		'b' },
+	{ "window",			OUTPUT_WINDOW_ADDR,		'u' },
+	{ "optimize",		OUTPUT_OPTIMIZE_ADDR,	'b' },
+	{ "split",			SPLIT_ADDR,				'b' },
+	{ "deadband",		SPLIT_DEADBAND_ADDR,	'f' },
+	{ "heat_gain",		SPLIT_HEAT_GAIN_ADDR,	'f' },
+	{ "cool_gain",		SPLIT_COOL_GAIN_ADDR,	'f' },
+	{ "heat_min_off",	SPLIT_HEAT_OFF_ADDR,	'u' },
+	{ "cool_min_off",	SPLIT_COOL_OFF_ADDR,	'u' },
+	{ "tolerance",		STATS_TOLERANCE_ADDR,	'f' },
+	ZONE_FIELDS("zone1_", 0),
+	ZONE_FIELDS("zone2_", 1),
+};
+
+#define FIELDS	(sizeof(fields) / sizeof(fields[0]))
+
+static uint8_t *image;					// EEPROM the blob is read into or
+										// made from
+
+static uint8_t ImageRead(uint16_t address)
+{
+	return image[address];
+}
+
+static void ImageWrite(uint16_t address, uint8_t data)
+{
+	image[address] = data;
+}
+
+static void Fail(const char *message, const char *what)
+{
+	fprintf(stderr, "config_tool: %s%s%s\n", message, what ? ": " : "",
+		what ? what : "");
+	exit(1);
+}
+
+// Unpack a blob into an EEPROM image, checking it.
+static void Unpack(const uint8_t *blob, uint16_t size, uint8_t *eeprom,
+	const char *name)
+{
+	ConfigBlob config(ImageRead, ImageWrite);
+	configState_t state = CONFIG_STATE_RUNNING;
+	uint16_t i;
+
+	if (size != ConfigBlob::GetSize())
+	{
+		Fail("wrong size (not for this firmware?)", name);
+	}
+
+	image = eeprom;
+	memset(eeprom, 0xFF, EEPROM_SIZE);
+	config.Start();
+	for (i = 0; (i < size) && (state == CONFIG_STATE_RUNNING); i++)
+	{
+		state = config.Import(blob[i]);
+	}
+	if (state == CONFIG_STATE_BAD_HEADER)
+	{
+		Fail("not a blob for this firmware's settings layout", name);
+	}
+	if (state != CONFIG_STATE_DONE)
+	{
+		Fail("damaged (CRC doesn't match)", name);
+	}
+}
+
+// Pack an EEPROM image into a blob, and return its size.
+static uint16_t Pack(uint8_t *eeprom, uint8_t *blob)
+{
+	ConfigBlob config(ImageRead, ImageWrite);
+	uint16_t size = 0;
+
+	image = eeprom;
+	config.Start();
+	while (config.Export(&blob[size]))
+	{
+		size++;
+	}
+	return size;
+}
+
+static void Load(const char *file, uint8_t *eeprom)
+{
+	uint8_t blob[EEPROM_SIZE + CONFIG_HEADER_SIZE + CONFIG_CHECK_SIZE];
+	FILE *f = fopen(file, "rb");
+	size_t size;
+
+	if (f == NULL)
+	{
+		Fail("can't read", file);
+	}
+	size = fread(blob, 1, sizeof(blob), f);
+	fclose(f);
+	Unpack(blob, (uint16_t)size, eeprom, file);
+}
+
+static void Save(const char *file, uint8_t *eeprom)
+{
+	uint8_t blob[EEPROM_SIZE + CONFIG_HEADER_SIZE + CONFIG_CHECK_SIZE];
+	uint16_t size = Pack(eeprom, blob);
+	FILE *f = fopen(file, "wb");
+
+	if ((f == NULL) || (fwrite(blob, 1, size, f) != size) || fclose(f))
+	{
+		Fail("can't write", file);
+	}
+}
+
+// A setting's value, as text.
+static void Format(const field_t *field, const uint8_t *eeprom, char *text)
+{
+	float f;
+	uint16_t h;
+	uint32_t u;
+
+	switch (field->type)
+	{
+	case 'b':
+		sprintf(text, "%u", eeprom[field->address]);
+		break;
+	case 'h':
+		memcpy(&h, &eeprom[field->address], sizeof(h));
+		sprintf(text, "%u", h);
+		break;
+	case 'f':
+		memcpy(&f, &eeprom[field->address], sizeof(f));
+		sprintf(text, "%.7g", f);
+		break;
+	default:
+		memcpy(&u, &eeprom[field->address], sizeof(u));
+		sprintf(text, "%lu", (unsigned long)u);
+		break;
+	}
+}
+
+// A recipe, as text, or an empty string if there isn't one.
+static void FormatRecipe(uint8_t n, const uint8_t *eeprom, char *text)
+{
+	recipe_t recipe;
+
+	memcpy(&recipe, &eeprom[RECIPE_ADDR + n * sizeof(recipe_t)],
+		sizeof(recipe));
+	text[0] = '\0';
+	if (recipe.check == RecipeCheck(&recipe))
+	{
+		recipe.name[RECIPE_NAME_SIZE - 1] = '\0';
+		sprintf(text, "%s sp %.1f kp %g ki %g kd %g flags %u window %.1f",
+			recipe.name, recipe.setpoint / 10.0, recipe.kp, recipe.ki,
+			recipe.kd, recipe.flags, recipe.window / 10.0);
+	}
+}
+
+static void Show(const char *file)
+{
+	uint8_t eeprom[EEPROM_SIZE];
+	char text[80];
+	unsigned i;
+
+	Load(file, eeprom);
+	for (i = 0; i < FIELDS; i++)
+	{
+		Format(&fields[i], eeprom, text);
+		printf("%s=%s\n", fields[i].name, text);
+	}
+	for (i = 0; i < RECIPE_COUNT; i++)
+	{
+		FormatRecipe(i, eeprom, text);
+		if (text[0] != '\0')
+		{
+			printf("recipe%u: %s\n", i + 1, text);
+		}
+	}
+}
+
+// List the settings that differ.  Exits with 1 if any do, like diff.
+static int Diff(const char *fileA, const char *fileB)
+{
+	uint8_t a[EEPROM_SIZE];
+	uint8_t b[EEPROM_SIZE];
+	char textA[80];
+	char textB[80];
+	int differ = 0;
+	unsigned i;
+
+	Load(fileA, a);
+	Load(fileB, b);
+	for (i = 0; i < FIELDS; i++)
+	{
+		Format(&fields[i], a, textA);
+		Format(&fields[i], b, textB);
+		if (strcmp(textA, textB) != 0)
+		{
+			printf("%s: %s -> %s\n", fields[i].name, textA, textB);
+			differ = 1;
+		}
+	}
+	for (i = 0; i < RECIPE_COUNT; i++)
+	{
+		FormatRecipe(i, a, textA);
+		FormatRecipe(i, b, textB);
+		if (strcmp(textA, textB) != 0)
+		{
+			printf("recipe%u: %s -> %s\n", i + 1,
+				textA[0] ? textA : "(none)", textB[0] ? textB : "(none)");
+			differ = 1;
+		}
+	}
+	return differ;
+}
+
+static void Set(const char *file, int count, char **settings)
+{
+	uint8_t eeprom[EEPROM_SIZE];
+	char *value;
+	char *end;
+	float f;
+	uint32_t u;
+	unsigned i;
+	int n;
+
+	Load(file, eeprom);
+	for (n = 0; n < count; n++)
+	{
+		value = strchr(settings[n], '=');
+		if (value == NULL)
+		{
+			Fail("expected <name>=<value>", settings[n]);
+		}
+		*value++ = '\0';
+		for (i = 0; (i < FIELDS) && strcmp(fields[i].name, settings[n]); i++)
+		{
+		}
+		if (i == FIELDS)
+		{
+			Fail("no such setting", settings[n]);
+		}
+
+		if (fields[i].type == 'f')
+		{
+			f = strtof(value, &end);
+			memcpy(&eeprom[fields[i].address], &f, sizeof(f));
+		}
+		else
+		{
+			u = strtoul(value, &end, 0);
+			if ((fields[i].type == 'b') && (u > 255))
+			{
+				Fail("too big for a byte", settings[n]);
+			}
+			if ((fields[i].type == 'h') && (u > 65535))
+			{
+				Fail("too big for 16 bits", settings[n]);
+			}
+			memcpy(&eeprom[fields[i].address], &u,
+				(fields[i].type == 'b') ? 1 :
+				((fields[i].type == 'h') ? 2 : sizeof(u)));
+		}
+		if ((*value == '\0') || (*end != '\0'))
+		{
+			Fail("not a number", value);
+		}
+	}
+	Save(file, eeprom);
+}
+
+// Milliseconds since some time.
+static long Now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000L + t.tv_nsec / 1000000;
+}
+
+// Fetch a byte from the unit, or -1 if none comes by the deadline.
+static int Receive(int fd, long deadline)
+{
+	struct pollfd p = { fd, POLLIN, 0 };
+	uint8_t c;
+	long wait = deadline - Now();
+
+	if ((wait < 0) || (poll(&p, 1, wait) <= 0) || (read(fd, &c, 1) != 1))
+	{
+		return -1;
+	}
+	return c;
+}
+
+// Fetch a line from the unit (without its end), or fail.
+static void ReceiveLine(int fd, char *line, size_t size, long deadline)
+{
+	size_t n = 0;
+	int c;
+
+	for (;;)
+	{
+		c = Receive(fd, deadline);
+		if (c < 0)
+		{
+			Fail("no reply from the unit", NULL);
+		}
+		if (c == '\n')
+		{
+			break;
+		}
+		if ((c != '\r') && (n < size - 1))
+		{
+			line[n++] = c;
+		}
+	}
+	line[n] = '\0';
+}
+
+// Skip lines (reports) until one starts with "start".
+static void Expect(int fd, const char *start, char *line, size_t size,
+	long timeout)
+{
+	long deadline = Now() + timeout;
+
+	do
+	{
+		ReceiveLine(fd, line, size, deadline);
+	} while (strncmp(line, start, strlen(start)) != 0);
+}
+
+static void Send(int fd, const void *data, size_t length)
+{
+	if (write(fd, data, length) != (ssize_t)length)
+	{
+		Fail("can't write to the unit", NULL);
+	}
+}
+
+// Open the unit's serial port at 9600 baud, and wait until it's running
+// (opening the port resets most Arduinos).
+static int Open(const char *port)
+{
+	struct termios tio;
+	char line[160];
+	int fd = open(port, O_RDWR | O_NOCTTY);
+
+	if ((fd < 0) || (tcgetattr(fd, &tio) != 0))
+	{
+		Fail("can't open", port);
+	}
+	cfmakeraw(&tio);
+	cfsetispeed(&tio, B9600);
+	cfsetospeed(&tio, B9600);
+	tio.c_cflag |= CLOCAL | CREAD;
+	if (tcsetattr(fd, TCSANOW, &tio) != 0)
+	{
+		Fail("can't set up", port);
+	}
+
+	Expect(fd, "pv ", line, sizeof(line), BOOT_TIMEOUT);
+	return fd;
+}
+
+static void Pull(const char *port, const char *file)
+{
+	uint8_t blob[EEPROM_SIZE + CONFIG_HEADER_SIZE + CONFIG_CHECK_SIZE];
+	uint8_t eeprom[EEPROM_SIZE];
+	char line[160];
+	long deadline;
+	unsigned long size;
+	unsigned long i;
+	int fd = Open(port);
+	int c;
+
+	Send(fd, "e\n", 2);
+	Expect(fd, "config ", line, sizeof(line), REPLY_TIMEOUT);
+	size = strtoul(line + 7, NULL, 10);
+	if (size > sizeof(blob))
+	{
+		Fail("blob too big", line);
+	}
+
+	deadline = Now() + REPLY_TIMEOUT;
+	for (i = 0; i < size; i++)
+	{
+		c = Receive(fd, deadline);
+		if (c < 0)
+		{
+			Fail("blob cut short", NULL);
+		}
+		blob[i] = c;
+	}
+	close(fd);
+
+	Unpack(blob, (uint16_t)size, eeprom, port);
+	Save(file, eeprom);
+	printf("pulled %lu bytes\n", size);
+}
+
+static void Push(const char *port, const char *file)
+{
+	uint8_t blob[EEPROM_SIZE + CONFIG_HEADER_SIZE + CONFIG_CHECK_SIZE];
+	uint8_t eeprom[EEPROM_SIZE];
+	char line[160];
+	uint16_t size;
+	uint16_t sent;
+	uint16_t chunk;
+	long start;
+	int fd;
+	int c;
+
+	Load(file, eeprom);
+	size = Pack(eeprom, blob);
+	fd = Open(port);
+	start = Now();
+
+	Send(fd, "w\n", 2);
+	Expect(fd, "ready", line, sizeof(line), REPLY_TIMEOUT);
+
+	// Each full chunk is acknowledged with a '+' once it's in EEPROM.
+	for (sent = 0; sent < size; sent += chunk)
+	{
+		chunk = (size - sent < CONFIG_CHUNK) ? size - sent : CONFIG_CHUNK;
+		Send(fd, &blob[sent], chunk);
+		if (chunk == CONFIG_CHUNK)
+		{
+			do
+			{
+				c = Receive(fd, Now() + REPLY_TIMEOUT);
+			} while ((c >= 0) && (c != '+') && (c != 'c'));
+			if (c != '+')
+			{
+				// "config ..." came early:  the unit gave up on it.
+				break;
+			}
+		}
+	}
+
+	Expect(fd, "config", line, sizeof(line), REPLY_TIMEOUT);
+	close(fd);
+	if (strncmp(line, "config ok", 9) != 0)
+	{
+		Fail("the unit refused it", line);
+	}
+	printf("pushed %u bytes in %.1f sec, %s EEPROM bytes changed\n", size,
+		(Now() - start) / 1000.0, line + 10);
+}
+
+int main(int argc, char **argv)
+{
+	if ((argc == 4) && !strcmp(argv[1], "pull"))
+	{
+		Pull(argv[2], argv[3]);
+	}
+	else if ((argc == 4) && !strcmp(argv[1], "push"))
+	{
+		Push(argv[2], argv[3]);
+	}
+	else if ((argc == 3) && !strcmp(argv[1], "show"))
+	{
+		Show(argv[2]);
+	}
+	else if ((argc == 4) && !strcmp(argv[1], "diff"))
+	{
+		return Diff(argv[2], argv[3]);
+	}
+	else if ((argc >= 4) && !strcmp(argv[1], "set"))
+	{
+		Set(argv[2], argc - 3, &argv[3]);
+	}
+	else
+	{
+		fprintf(stderr, "usage:  config_tool pull <port> <file>\n"
+			"        config_tool push <port> <file>\n"
+			"        config_tool show <file>\n"
+			"        config_tool diff <file> <file>\n"
+			"        config_tool set <file> <name>=<value> ...\n");
+		return 2;
+	}
+	return 0;
+}
@@ -0,0 +1,285 @@
+/******************************************************************************
+ *
+ *	Filename:		estimator_replay.cpp
+ *
+ *	Description:	Runs the firmware's Kalman filter (StateEstimator.cpp) on
+ *					a PC, against a logged run or a simulated one, and
+ *					reports:
+ *
+ *					-	how much noise it removes from the process value and
+ *						from its rate of change, compared with using the
+ *						selected sensor alone and differencing it
+ *					-	how long each sample's update takes
+ *
+ *					Noise is measured as the RMS difference between a signal
+ *					and a centered moving average of itself, so slow changes
+ *					in the process don't count as noise.
+ *
+ *					A log is what the controller prints on its serial port,
+ *					one line per sample.  The tc, th & sensor fields are used;
+ *					everything else is ignored.
+ *
+ *	Build:			g++ -O2 -I osPID_Firmware -o estimator_replay \
+ *						tools/estimator_replay.cpp \
+ *						osPID_Firmware/StateEstimator.cpp
+ *
+ *	Usage:			estimator_replay [options] [log]
+ *
+ *					-p <mSec>	sample period (default 1000)
+ *					-v <C^2>	thermocouple noise variance
+ *					-w <C^2>	thermistor noise variance
+ *					-q <value>	process noise [(C/sec)^2 per second]
+ *					-s			replay a simulated run instead of a log
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+#include "StateEstimator.h"
+
+#define WINDOW		15					// moving average length [samples]
+#define TIMING_RUNS	200					// times the trace is replayed for timing
+
+typedef struct							// one logged sample
+{
+	double tc;							// thermocouple reading [C], or NAN
+	double th;							// thermistor reading [C], or NAN
+	int sensor;							// sensor selected (0 = thermocouple)
+} sample_t;
+
+/******************************************************************************
+ *
+ *	Function:		Field
+ *
+ *	Description:	Finds a named value in a log line.  The name must not
+ *					be the first thing on the line.
+ *
+ *	Return Value:	the value, or NAN if it isn't there
+ *
+ *****************************************************************************/
+
+static double Field(const char *line, const char *name)
+{
+	char key[16];
+	const char *p;
+
+	snprintf(key, sizeof(key), " %s ", name);
+	p = strstr(line, key);
+	if (p == NULL)
+	{
+		return NAN;
+	}
+
+	return strtod(p + strlen(key), NULL);
+}
+
+static void Load(FILE *f, std::vector<sample_t> *trace)
+{
+	char line[256];
+	sample_t s;
+
+	while (fgets(line, sizeof(line), f) != NULL)
+	{
+		s.tc = Field(line, "tc");
+		s.th = Field(line, "th");
+		s.sensor = (int)Field(line, "sensor");
+		if (!isnan(s.tc) || !isnan(s.th))
+		{
+			trace->push_back(s);
+		}
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		Simulate
+ *
+ *	Description:	Makes up a run:  a first-order process heated in steps,
+ *					read by a thermocouple (0.25 C steps, 0.15 C noise) and a
+ *					thermistor (0.05 C noise).  Logged readings already have
+ *					the offset between the sensors removed, so none is added.
+ *
+ *****************************************************************************/
+
+static double Gauss()
+{
+	double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+	double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+	return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static void Simulate(double period, std::vector<sample_t> *trace)
+{
+	double temp = 25;					// process temperature [C]
+	double target;						// where it's headed [C]
+	sample_t s;
+	int i;
+
+	srand(1);
+	for (i = 0; i < 3600; i++)
+	{
+		target = ((i / 600) % 2) ? 150 : 60;
+		temp += (target - temp) * (1 - exp(-period / 300));
+		s.tc = floor((temp + 0.15 * Gauss()) * 4 + 0.5) / 4;
+		s.th = temp + 0.05 * Gauss();
+		s.sensor = 0;
+		trace->push_back(s);
+	}
+}
+
+static double Noise(const std::vector<double> &x)
+{
+	double sum = 0;
+	double avg;
+	size_t n = 0;
+	size_t i;
+	size_t j;
+
+	for (i = WINDOW / 2; i + WINDOW / 2 < x.size(); i++)
+	{
+		avg = 0;
+		for (j = i - WINDOW / 2; j <= i + WINDOW / 2; j++)
+		{
+			avg += x[j];
+		}
+		avg /= WINDOW;
+		sum += (x[i] - avg) * (x[i] - avg);
+		n++;
+	}
+
+	return (n > 0) ? sqrt(sum / n) : NAN;
+}
+
+static void Run(StateEstimator *est, const sample_t &s)
+{
+	est->Predict();
+	if (!isnan(s.tc))
+	{
+		est->Correct(ESTIMATOR_SENSOR_THERMOCOUPLE, s.tc);
+	}
+	if (!isnan(s.th))
+	{
+		est->Correct(ESTIMATOR_SENSOR_THERMISTOR, s.th);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<sample_t> trace;
+	std::vector<double> rawTemp;		// selected sensor [C]
+	std::vector<double> rawRate;		// its difference [C/sec]
+	std::vector<double> estTemp;		// estimator's outputs
+	std::vector<double> estRate;
+	StateEstimator est;
+	unsigned long mSec = 1000;
+	bool simulate = false;
+	double raw;
+	double last = NAN;
+	double period;
+	clock_t start;
+	double nSec;
+	FILE *f;
+	size_t i;
+	int r;
+	int opt;
+
+	for (opt = 1; (opt < argc) && (argv[opt][0] == '-'); opt++)
+	{
+		if (strcmp(argv[opt], "-s") == 0)
+		{
+			simulate = true;
+			continue;
+		}
+		if (opt + 1 >= argc)
+		{
+			fprintf(stderr, "%s needs a value\n", argv[opt]);
+			return 1;
+		}
+		switch (argv[opt][1])
+		{
+		case 'p':
+			mSec = strtoul(argv[++opt], NULL, 10);
+			break;
+		case 'v':
+			est.SetNoise(ESTIMATOR_SENSOR_THERMOCOUPLE, atof(argv[++opt]));
+			break;
+		case 'w':
+			est.SetNoise(ESTIMATOR_SENSOR_THERMISTOR, atof(argv[++opt]));
+			break;
+		case 'q':
+			est.SetProcessNoise(atof(argv[++opt]));
+			break;
+		default:
+			fprintf(stderr, "unknown option %s\n", argv[opt]);
+			return 1;
+		}
+	}
+
+	period = mSec / 1000.0;
+	est.SetSamplePeriod(mSec);
+
+	if (simulate)
+	{
+		Simulate(period, &trace);
+	}
+	else
+	{
+		f = (opt < argc) ? fopen(argv[opt], "r") : stdin;
+		if (f == NULL)
+		{
+			perror(argv[opt]);
+			return 1;
+		}
+		Load(f, &trace);
+	}
+
+	if (trace.size() < 2 * WINDOW)
+	{
+		fprintf(stderr, "need at least %d samples\n", 2 * WINDOW);
+		return 1;
+	}
+
+	// Replay the trace once for the noise figures.
+	for (i = 0; i < trace.size(); i++)
+	{
+		Run(&est, trace[i]);
+
+		raw = (trace[i].sensor == 1) ? trace[i].th : trace[i].tc;
+		if (isnan(raw) || !est.IsValid())
+		{
+			continue;
+		}
+		rawTemp.push_back(raw);
+		rawRate.push_back(isnan(last) ? 0 : (raw - last) / period);
+		estTemp.push_back(est.GetTemperature());
+		estRate.push_back(est.GetRate());
+		last = raw;
+	}
+
+	// And many more times for the timing.
+	start = clock();
+	for (r = 0; r < TIMING_RUNS; r++)
+	{
+		est.Reset();
+		for (i = 0; i < trace.size(); i++)
+		{
+			Run(&est, trace[i]);
+		}
+	}
+	nSec = (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 /
+		((double)TIMING_RUNS * trace.size());
+
+	printf("samples        %u\n", (unsigned)trace.size());
+	printf("PV noise       raw %.4f C   estimate %.4f C   (%.1fx less)\n",
+		Noise(rawTemp), Noise(estTemp), Noise(rawTemp) / Noise(estTemp));
+	printf("rate noise     raw %.4f C/s estimate %.4f C/s (%.1fx less)\n",
+		Noise(rawRate), Noise(estRate), Noise(rawRate) / Noise(estRate));
+	printf("update time    %.0f nSec per sample on this PC\n", nSec);
+
+	return 0;
+}
@@ -0,0 +1,309 @@
+/******************************************************************************
+ *
+ *	Filename:		format_bench.cpp
+ *
+ *	Description:	Builds the firmware's number formatter (NumberFormat.cpp)
+ *					on a PC, checks it against printf for a few hundred
+ *					thousand random numbers, widths & decimal counts (and
+ *					for NaN & numbers too big to show), then times it
+ *					against the way Arduino's Print::print(double) works:
+ *					rounding by repeated division, then peeling off one
+ *					digit at a time with floating-point math.
+ *
+ *					A PC has floating-point hardware & a divide
+ *					instruction, so it flatters print(double), which comes
+ *					out well ahead there.  On the AVR, every float operation
+ *					and every 32-bit division is a library call of hundreds
+ *					of cycles, so the bench also counts those.
+ *
+ *	Build:			g++ -O2 -I osPID_Firmware -o format_bench \
+ *						tools/format_bench.cpp osPID_Firmware/NumberFormat.cpp
+ *
+ *	Usage:			format_bench
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "NumberFormat.h"
+
+#define CHECKS		300000				// random numbers checked
+#define RUNS		2000000				// numbers formatted for timing
+
+static unsigned long failures;
+
+// What print(double) costs in the AVR's software floating point & 32-bit
+// division, which are library calls of hundreds of cycles each.
+static unsigned long floatOps;
+static unsigned long divisions;
+
+static void Fail(const char *what, const char *got, const char *want)
+{
+	if (failures++ < 10)
+	{
+		printf("%s:  got \"%s\", want \"%s\"\n", what, got, want);
+	}
+}
+
+/******************************************************************************
+ *
+ *	Function:		Expected
+ *
+ *	Description:	Formats a scaled integer with printf, as FormatScaled
+ *					should.
+ *
+ *****************************************************************************/
+
+static char *Expected(char *buffer, long scaled, int decimals, int width)
+{
+	char digits[64];
+	long p = 1;
+	int i;
+
+	if (decimals == 0)
+	{
+		sprintf(buffer, "%*ld", width, scaled);
+		return buffer;
+	}
+	for (i = 0; i < decimals; i++)
+	{
+		p *= 10;
+	}
+	sprintf(digits, "%s%ld.%0*ld", (scaled < 0) ? "-" : "",
+		labs(scaled) / p, decimals, labs(scaled) % p);
+	sprintf(buffer, "%*s", width, digits);
+	return buffer;
+}
+
+/******************************************************************************
+ *
+ *	Function:		PrintFloat
+ *
+ *	Description:	Formats a number the way Print::print(double) does, into
+ *					a buffer instead of the serial port.
+ *
+ *****************************************************************************/
+
+static char *PrintFloat(char *buffer, double number, unsigned char digits)
+{
+	char *p = buffer;
+	double rounding = 0.5;
+	unsigned long whole;
+	double remainder;
+	char reversed[12];
+	int n = 0;
+	unsigned char i;
+
+	if (isnan(number))
+	{
+		strcpy(buffer, "nan");
+		return buffer;
+	}
+	if (number < 0.0)
+	{
+		*p++ = '-';
+		number = -number;
+	}
+
+	for (i = 0; i < digits; ++i)
+	{
+		rounding /= 10.0;
+		floatOps++;
+	}
+	number += rounding;
+	floatOps += 4;						// add, compare, 2 conversions
+
+	whole = (unsigned long)number;
+	remainder = number - (double)whole;
+	do
+	{
+		reversed[n++] = '0' + whole % 10;
+		whole /= 10;
+		divisions++;
+	} while (whole > 0);
+	while (n > 0)
+	{
+		*p++ = reversed[--n];
+	}
+
+	if (digits > 0)
+	{
+		*p++ = '.';
+	}
+	while (digits-- > 0)
+	{
+		remainder *= 10.0;
+		int toPrint = (int)remainder;
+		*p++ = '0' + toPrint;
+		remainder -= toPrint;
+		floatOps += 4;					// multiply, subtract, 2 conversions
+		divisions++;					// print(int) divides, even for 1 digit
+	}
+	*p = '\0';
+
+	return buffer;
+}
+
+int main(void)
+{
+	char got[FORMAT_SIZE];
+	char want[64];
+	unsigned long n;
+	int decimals;
+	int width;
+	long scaled;
+	fixed_t fixed;
+	clock_t start;
+	double seconds;
+	volatile char sink = 0;
+	static double values[1024];
+
+	srand(1);
+
+	// Scaled integers must match printf exactly.
+	for (n = 0; n < CHECKS; n++)
+	{
+		scaled = (long)(((unsigned long)rand() << 16) ^ rand()) %
+			(1L << (rand() % 31 + 1));
+		if (rand() & 1)
+		{
+			scaled = -scaled;
+		}
+		decimals = rand() % 6;
+		width = rand() % 12;
+		FormatScaled(got, scaled, decimals, width);
+		Expected(want, scaled, decimals, width);
+		if (strcmp(got, want) != 0)
+		{
+			Fail("FormatScaled", got, want);
+		}
+	}
+
+	// Fixed point is rounded to the nearest last digit, halves away from
+	// zero.  Work out the answer exactly, in 64 bits.
+	for (n = 0; n < CHECKS; n++)
+	{
+		long long magnitude;
+		long p = 1;
+
+		fixed = (fixed_t)(((unsigned long)rand() << 16) ^ rand());
+		decimals = rand() % (FORMAT_FIXED_DECIMALS + 1);
+		width = rand() % 12;
+		for (int i = 0; i < decimals; i++)
+		{
+			p *= 10;
+		}
+		magnitude = llabs((long long)fixed);
+		scaled = (long)((magnitude * p * 2 + 65536) / 131072);
+		FormatFixed(got, fixed, decimals, width);
+		Expected(want, (fixed < 0) ? -scaled : scaled, decimals, width);
+		if (strcmp(got, want) != 0)
+		{
+			Fail("FormatFixed", got, want);
+		}
+	}
+
+	// Doubles should match printf, except within a hair of a half, where
+	// the one multiply's rounding error can tip it either way.  Numbers
+	// that don't fit in 32 bits once scaled are errors.
+	for (n = 0; n < CHECKS; n++)
+	{
+		double value;
+		double p = 1;
+		char *minus;
+
+		decimals = rand() % 4;
+		width = rand() % 12;
+		for (int i = 0; i < decimals; i++)
+		{
+			p *= 10;
+		}
+		value = (rand() - RAND_MAX / 2) / (double)(1 << (rand() % 20));
+		if (fabs(fabs(value * p - trunc(value * p)) - 0.5) < 1e-6)
+		{
+			continue;
+		}
+		FormatDouble(got, value, decimals, width);
+		if (fabs(value * p) >= 2147483647.0)
+		{
+			// Too big for the scaled integer.
+			snprintf(want, sizeof(want), "%*s", width, "Error");
+		}
+		else
+		{
+			snprintf(want, sizeof(want), "%*.*f", width, decimals, value);
+		}
+		minus = strchr(want, '-');
+		if ((minus != NULL) && (strspn(minus + 1, "0.") == strlen(minus + 1)))
+		{
+			// printf keeps the sign of a negative number that rounds to
+			// zero; the formatter doesn't.
+			*minus = ' ';
+			if (strlen(want) > (size_t)width)
+			{
+				memmove(want, want + 1, strlen(want));
+			}
+		}
+		if (strcmp(got, want) != 0)
+		{
+			Fail("FormatDouble", got, want);
+		}
+	}
+
+	// Doubles that can't be shown.
+	if (strcmp(FormatDouble(got, NAN, 2, 7), "  Error") != 0)
+	{
+		Fail("FormatDouble(NAN)", got, "  Error");
+	}
+	if (strcmp(FormatDouble(got, 3e9, 0, 0), "Error") != 0)
+	{
+		Fail("FormatDouble(3e9)", got, "Error");
+	}
+	if (strcmp(FormatDouble(got, -1234.567, 2, 9), " -1234.57") != 0)
+	{
+		Fail("FormatDouble(-1234.567)", got, " -1234.57");
+	}
+
+	// Time both on temperatures like the controller prints.
+	for (n = 0; n < 1024; n++)
+	{
+		values[n] = (rand() % 400000) / 1000.0 - 50;
+	}
+
+	start = clock();
+	for (n = 0; n < RUNS; n++)
+	{
+		PrintFloat(got, values[n & 1023], 2);
+		sink ^= got[1];
+	}
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("print(double)  %6.1f ns per number, %.1f float operations & "
+		"%.1f divisions\n", seconds * 1e9 / RUNS, (double)floatOps / RUNS,
+		(double)divisions / RUNS);
+
+	start = clock();
+	for (n = 0; n < RUNS; n++)
+	{
+		FormatDouble(got, values[n & 1023], 2, 0);
+		sink ^= got[1];
+	}
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("FormatDouble   %6.1f ns per number, 5 float operations & "
+		"no divisions\n", seconds * 1e9 / RUNS);
+
+	start = clock();
+	for (n = 0; n < RUNS; n++)
+	{
+		FormatFixed(got, (fixed_t)(values[n & 1023] * 65536), 2, 0);
+		sink ^= got[1];
+	}
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("FormatFixed    %6.1f ns per number (conversion included)\n",
+		seconds * 1e9 / RUNS);
+
+	printf("failures       %lu\n", failures);
+	return (failures == 0) ? 0 : 1;
+}
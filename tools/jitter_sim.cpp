@@ -0,0 +1,185 @@
+/******************************************************************************
+ *
+ *	Filename:		jitter_sim.cpp
+ *
+ *	Description:	Shows what loop jitter does to the firmware PID's
+ *					derivative term (PID_v1.cpp), and what the derivative
+ *					filter does about sensor noise.
+ *
+ *					Samples are due every SAMPLE_TIME, but the reading is
+ *					taken late by however long the main loop was held up:  a
+ *					few milliseconds most of the time, and now & then much
+ *					longer (an LCD update, a report going out, an EEPROM
+ *					write at 3.3 mSec a byte).  The process is a steady ramp,
+ *					so the true derivative term is a constant, and anything
+ *					else is noise.  The PID runs with only a derivative term
+ *					(Kp & Ki zero), so its output is the derivative term.
+ *
+ *					For each amount of jitter, it reports the derivative
+ *					term's RMS error [% output] when Compute assumes a fixed
+ *					sample time, and when it's given each reading's capture
+ *					time.  Then, with the sensor quantized & noisy like the
+ *					MAX31855, it reports the RMS error for a few derivative
+ *					filter time constants.  The filter pays for its
+ *					smoothing with lag:  the derivative term follows a change
+ *					in the ramp rate one time constant late.
+ *
+ *	Build:			g++ -O2 -I osPID_Firmware -o jitter_sim \
+ *						tools/jitter_sim.cpp osPID_Firmware/PID_v1.cpp
+ *
+ *	Usage:			jitter_sim
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "PID_v1_local.h"
+
+#define SAMPLE_TIME		1000			// [mSec]
+#define KD				120.0			// derivative gain [% per C/sec]
+#define RATE			2.0				// ramp rate [C/min]
+#define START			25.0			// [C]
+#define SAMPLES			20000			// samples per run
+#define STALL_CHANCE	0.05			// chance a sample waits on a stall
+#define STALL_TIME		150.0			// longest stall [mSec]
+#define SENSOR_STEP		0.25			// MAX31855 resolution [C]
+#define SENSOR_NOISE	0.1				// [C RMS]
+
+static unsigned long seed;				// random number generator state
+
+// Uniform random number from 0 to 1.
+static double Random(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 16) & 0x7FFF) / 32768.0;
+}
+
+// Gaussian noise (near enough), of unit RMS.
+static double Noise(void)
+{
+	double sum = 0;
+	int i;
+
+	for (i = 0; i < 12; i++)
+	{
+		sum += Random();
+	}
+	return sum - 6;
+}
+
+// How late a reading is [mSec]:  up to "jitter" on a normal pass, and up to
+// STALL_TIME more when something holds up the loop.
+static double Delay(double jitter)
+{
+	double delay = jitter * Random();
+
+	if (Random() < STALL_CHANCE)
+	{
+		delay += STALL_TIME * Random();
+	}
+	return delay;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Run
+ *
+ *	Description:	Runs the derivative-only PID along a ramp, and measures
+ *					the derivative term's error.  Halfway through, the ramp
+ *					rate doubles; the samples just after are left out of the
+ *					measurement while the filter catches up.
+ *
+ *	Parameters:		jitter - normal lateness of a reading [mSec]
+ *					timed - true to give Compute the capture times
+ *					noisy - true to quantize the reading & add noise
+ *					filter - derivative filter [seconds]
+ *
+ *	Return Value:	RMS error of the derivative term [% output]
+ *
+ *****************************************************************************/
+
+static double Run(double jitter, bool timed, bool noisy, double filter)
+{
+	double input = START;
+	double output = 0;
+	double setpoint = START;
+	double t;							// capture time [seconds]
+	double pv;							// true temperature [C]
+	double truth;						// true derivative term [%]
+	double error;
+	double sum = 0;
+	int count = 0;
+	int k;
+	PID pid(&input, &output, &setpoint, 0, 0, KD, DIRECT);
+
+	seed = 1;
+	pid.SetSampleTime(SAMPLE_TIME);
+	pid.SetOutputLimits(-1e6, 1e6);
+	pid.SetDerivativeFilter(filter);
+	pid.SetMode(AUTOMATIC);
+
+	for (k = 1; k <= SAMPLES; k++)
+	{
+		t = (k * (double)SAMPLE_TIME + Delay(jitter)) / 1000.0;
+		pv = START + RATE / 60 * t;
+		truth = -KD * RATE / 60;
+		if (k > SAMPLES / 2)
+		{
+			// The ramp rate doubles halfway.
+			pv += RATE / 60 * (t - SAMPLES / 2 * SAMPLE_TIME / 1000.0);
+			truth *= 2;
+		}
+		input = noisy ?
+			floor((pv + SENSOR_NOISE * Noise()) / SENSOR_STEP + 0.5) *
+			SENSOR_STEP : pv;
+
+		if (timed)
+		{
+			pid.Compute((unsigned long)(t * 1e6));
+		}
+		else
+		{
+			pid.Compute();
+		}
+
+		// Skip the start, and the step in the rate.
+		if ((k > 100) && ((k < SAMPLES / 2) || (k > SAMPLES / 2 + 100)))
+		{
+			error = output - truth;
+			sum += error * error;
+			count++;
+		}
+	}
+	return sqrt(sum / count);
+}
+
+int main(void)
+{
+	static const double jitters[] = { 0, 5, 20, 50 };
+	static const double filters[] = { 0, 2, 5, 10, 20 };
+	unsigned i;
+
+	printf("derivative term %.1f %% (Kd %.0f, ramp %.1f C/min), "
+		"stalls up to %.0f mSec on %.0f%% of samples\n\n",
+		-KD * RATE / 60, KD, RATE, STALL_TIME, STALL_CHANCE * 100);
+
+	printf("jitter [mSec]   RMS D error [%%]\n");
+	printf("                fixed dt   measured dt\n");
+	for (i = 0; i < sizeof(jitters) / sizeof(jitters[0]); i++)
+	{
+		printf("%8.0f       %9.3f   %11.3f\n", jitters[i],
+			Run(jitters[i], false, false, 0),
+			Run(jitters[i], true, false, 0));
+	}
+
+	printf("\nquantized & noisy sensor, measured dt\n");
+	printf("filter [sec]    RMS D error [%%]\n");
+	for (i = 0; i < sizeof(filters) / sizeof(filters[0]); i++)
+	{
+		printf("%8.0f       %12.3f\n", filters[i],
+			Run(0, true, true, filters[i]));
+	}
+
+	return 0;
+}
@@ -0,0 +1,71 @@
+#!/bin/sh
+###############################################################################
+#
+#	Filename:		memory_report.sh
+#
+#	Description:	Reports how much flash & RAM the firmware uses, and
+#					what each module contributes.  Flash holds .text & .data
+#					(initial values); RAM holds .data & .bss.  Whatever RAM is
+#					left over is shared by the stack and any buffers added
+#					later.
+#
+#					The totals come from the linked .elf, so they're what
+#					goes on the chip.  The per-module rows come from the
+#					object files the Arduino build leaves behind, and are
+#					only a breakdown:  they're sized before linking, so they
+#					count code the linker throws out (unused functions, most
+#					of the core) and not the startup code & vector table it
+#					adds, and don't add up to the totals.
+#
+#	Usage:			tools/memory_report.sh <build directory>
+#
+#					The Arduino IDE prints the build directory when verbose
+#					compile output is turned on.  With arduino-cli, use
+#					"arduino-cli compile --build-path <dir>".  To run this
+#					after every build, see the README.
+#
+###############################################################################
+
+FLASH_SIZE=32256			# ATmega328P flash, less the 512-byte bootloader
+RAM_SIZE=2048				# ATmega328P SRAM
+SIZE=${AVR_SIZE:-avr-size}
+
+if [ $# -ne 1 ] || [ ! -d "$1" ]; then
+	echo "usage: $0 <build directory>" >&2
+	exit 1
+fi
+
+# The linked sketch, for the totals.
+ELF=$(find "$1" -maxdepth 1 -name '*.elf' | head -n 1)
+if [ -z "$ELF" ]; then
+	echo "no .elf in $1 (has the sketch been linked?)" >&2
+	exit 1
+fi
+
+# The sketch's own modules, then the Arduino core & libraries.
+OBJECTS=$(find "$1" -name '*.o' | sort)
+if [ -z "$OBJECTS" ]; then
+	echo "no object files in $1" >&2
+	exit 1
+fi
+
+TOTALS=$($SIZE --format=berkeley "$ELF" | awk 'NR == 2 { print $1, $2, $3 }')
+
+$SIZE --format=berkeley $OBJECTS | awk -v flash=$FLASH_SIZE -v ram=$RAM_SIZE \
+	-v totals="$TOTALS" '
+NR == 1 {
+	printf "%-32s %7s %7s %7s\n", "module (before linking)", ".text", ".data", ".bss"
+	next
+}
+{
+	name = $6
+	sub(/.*\//, "", name)
+	printf "%-32s %7d %7d %7d\n", name, $1, $2, $3
+}
+END {
+	split(totals, size, " ")
+	text = size[1]; data = size[2]; bss = size[3]
+	printf "%-32s %7d %7d %7d\n", "linked", text, data, bss
+	printf "\nflash: %d of %d bytes (%d free)\n", text + data, flash, flash - text - data
+	printf "RAM:   %d of %d bytes (%d left for the stack)\n", data + bss, ram, ram - data - bss
+}'
@@ -0,0 +1,315 @@
+/******************************************************************************
+ *
+ *	Filename:		modbus_hammer.cpp
+ *
+ *	Description:	Builds the firmware's Modbus RTU protocol code
+ *					(ModbusRtu.cpp) on a PC, and hammers it with requests from
+ *					a stand-in master:  good reads & writes, reads & writes
+ *					out of range, read-only writes, unknown functions,
+ *					damaged frames, and frames for other slaves.  Every
+ *					response is checked against what a Modbus slave should
+ *					send, and against a copy of the registers kept by the
+ *					master.  At the end it reports any mismatches and the
+ *					number of requests handled per second.
+ *
+ *					This times the protocol code only.  On the controller,
+ *					the serial line is far slower:  at 9600 baud a typical
+ *					read takes about 20 mSec on the wire.
+ *
+ *	Build:			g++ -O2 -I osPID_Firmware -o modbus_hammer \
+ *						tools/modbus_hammer.cpp osPID_Firmware/ModbusRtu.cpp
+ *
+ *	Usage:			modbus_hammer [requests]
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ModbusRtu.h"
+
+#define SLAVE			17				// address of the slave under test
+#define REGISTERS		14				// registers in the table
+#define READ_ONLY		0				// register 0 can't be written
+#define REFUSED			0x8000			// value the registers won't accept
+
+static uint16_t slaveRegs[REGISTERS];	// the slave's registers
+static uint16_t masterRegs[REGISTERS];	// what the master thinks they hold
+
+// Register N reads & writes slaveRegs[N].  Templates keep the table in the
+// same form as the firmware's:  one plain function per register.
+template <int N> static uint16_t Read(void)
+{
+	return slaveRegs[N];
+}
+
+template <int N> static bool Write(uint16_t value)
+{
+	if (value == REFUSED)
+	{
+		return false;
+	}
+	slaveRegs[N] = value;
+	return true;
+}
+
+static const modbusRegister_t table[REGISTERS] PROGMEM =
+{
+	{ Read<0>, NULL },     { Read<1>, Write<1> },   { Read<2>, Write<2> },
+	{ Read<3>, Write<3> }, { Read<4>, Write<4> },   { Read<5>, Write<5> },
+	{ Read<6>, Write<6> }, { Read<7>, Write<7> },   { Read<8>, Write<8> },
+	{ Read<9>, Write<9> }, { Read<10>, Write<10> }, { Read<11>, Write<11> },
+	{ Read<12>, Write<12> }, { Read<13>, Write<13> },
+};
+
+static unsigned long failures;			// responses that were wrong
+
+static void Fail(const char *what, unsigned long request)
+{
+	if (failures++ < 10)
+	{
+		printf("request %lu:  %s\n", request, what);
+	}
+}
+
+static void Put16(uint8_t *p, uint16_t value)
+{
+	p[0] = (uint8_t)(value >> 8);
+	p[1] = (uint8_t)value;
+}
+
+static uint16_t Get16(const uint8_t *p)
+{
+	return ((uint16_t)p[0] << 8) | p[1];
+}
+
+static uint8_t AddCrc(uint8_t *frame, uint8_t length)
+{
+	uint16_t crc = ModbusCrc(frame, length);
+
+	frame[length++] = (uint8_t)crc;
+	frame[length++] = (uint8_t)(crc >> 8);
+	return length;
+}
+
+/******************************************************************************
+ *
+ *	Function:		Hammer
+ *
+ *	Description:	Sends one random request, and checks the response.
+ *
+ *	Parameters:		slave - the slave under test
+ *					n - request number (for error messages)
+ *
+ *****************************************************************************/
+
+static void Hammer(ModbusRtu *slave, unsigned long n)
+{
+	uint8_t frame[MODBUS_FRAME_SIZE];
+	uint8_t length;						// request, then response length
+	uint8_t expect;						// expected exception, or 0
+	uint8_t function;
+	uint16_t start;
+	uint16_t count;
+	uint16_t values[MODBUS_MAX_REGISTERS];
+	uint16_t i;
+	int kind = rand() % 10;
+	bool broadcast = false;
+
+	frame[0] = SLAVE;
+	start = rand() % (REGISTERS + 2);
+	count = 1 + rand() % 6;
+	expect = 0;
+
+	// Pick a request, and work out what the answer should be.
+	if (kind < 4)
+	{
+		function = (kind & 1) ? MODBUS_READ_INPUT : MODBUS_READ_HOLDING;
+		Put16(&frame[2], start);
+		Put16(&frame[4], count);
+		length = 6;
+		if (start + count > REGISTERS)
+		{
+			expect = MODBUS_ILLEGAL_ADDRESS;
+		}
+	}
+	else if (kind < 6)
+	{
+		function = MODBUS_WRITE_SINGLE;
+		count = 1;
+		values[0] = (rand() % 20 == 0) ? REFUSED : (uint16_t)rand();
+		Put16(&frame[2], start);
+		Put16(&frame[4], values[0]);
+		length = 6;
+	}
+	else if (kind < 8)
+	{
+		function = MODBUS_WRITE_MULTIPLE;
+		Put16(&frame[2], start);
+		Put16(&frame[4], count);
+		frame[6] = (uint8_t)(2 * count);
+		for (i = 0; i < count; i++)
+		{
+			values[i] = (rand() % 50 == 0) ? REFUSED : (uint16_t)rand();
+			Put16(&frame[7 + 2 * i], values[i]);
+		}
+		length = 7 + 2 * count;
+		broadcast = (rand() % 10 == 0);
+	}
+	else
+	{
+		function = 0x2B;				// not supported
+		Put16(&frame[2], start);
+		Put16(&frame[4], count);
+		length = 6;
+		expect = MODBUS_ILLEGAL_FUNCTION;
+	}
+	frame[1] = function;
+
+	if ((function == MODBUS_WRITE_SINGLE) ||
+		(function == MODBUS_WRITE_MULTIPLE))
+	{
+		if (start + count > REGISTERS)
+		{
+			expect = MODBUS_ILLEGAL_ADDRESS;
+		}
+		else if (start <= READ_ONLY)
+		{
+			expect = MODBUS_ILLEGAL_ADDRESS;
+		}
+		else
+		{
+			// Writes before a refused value stick.
+			for (i = 0; i < count; i++)
+			{
+				if (values[i] == REFUSED)
+				{
+					expect = MODBUS_ILLEGAL_VALUE;
+					break;
+				}
+				masterRegs[start + i] = values[i];
+			}
+		}
+	}
+
+	if (broadcast)
+	{
+		frame[0] = MODBUS_BROADCAST;
+	}
+	length = AddCrc(frame, length);
+
+	// Now and then, damage the frame or send it to someone else.  Either
+	// way, there should be no answer, and nothing should change.
+	if (rand() % 20 == 0)
+	{
+		if (rand() & 1)
+		{
+			frame[rand() % length] ^= (uint8_t)(1 + rand() % 255);
+		}
+		else
+		{
+			frame[0] = SLAVE + 1;
+		}
+		memcpy(masterRegs, slaveRegs, sizeof(masterRegs));
+		if (slave->Process(frame, length) != 0)
+		{
+			Fail("answered a damaged or misaddressed frame", n);
+		}
+		memcpy(masterRegs, slaveRegs, sizeof(masterRegs));
+		return;
+	}
+
+	length = slave->Process(frame, length);
+
+	// Check the response.
+	if (broadcast)
+	{
+		if (length != 0)
+		{
+			Fail("answered a broadcast", n);
+		}
+		return;
+	}
+	if ((length < 5) || (ModbusCrc(frame, length - 2) !=
+		(uint16_t)(frame[length - 2] | (frame[length - 1] << 8))))
+	{
+		Fail("bad response CRC", n);
+		return;
+	}
+	if (frame[0] != SLAVE)
+	{
+		Fail("wrong address in response", n);
+	}
+	if (expect != 0)
+	{
+		if ((frame[1] != (function | 0x80)) || (frame[2] != expect) ||
+			(length != 5))
+		{
+			Fail("wrong exception", n);
+		}
+		return;
+	}
+	if (frame[1] != function)
+	{
+		Fail("unexpected exception", n);
+		return;
+	}
+	if ((function == MODBUS_READ_HOLDING) || (function == MODBUS_READ_INPUT))
+	{
+		if ((length != 5 + 2 * count) || (frame[2] != 2 * count))
+		{
+			Fail("wrong read length", n);
+			return;
+		}
+		for (i = 0; i < count; i++)
+		{
+			if (Get16(&frame[3 + 2 * i]) != masterRegs[start + i])
+			{
+				Fail("read back the wrong value", n);
+			}
+		}
+	}
+	else if ((length != 8) || (Get16(&frame[2]) != start))
+	{
+		Fail("wrong write response", n);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	ModbusRtu slave;
+	unsigned long requests = 1000000;
+	unsigned long n;
+	clock_t start;
+	double seconds;
+
+	if (argc > 1)
+	{
+		requests = strtoul(argv[1], NULL, 10);
+	}
+
+	slave.SetAddress(SLAVE);
+	slave.SetRegisters(table, REGISTERS);
+	srand(1);
+
+	start = clock();
+	for (n = 0; n < requests; n++)
+	{
+		Hammer(&slave, n);
+	}
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	// The slave's registers should match the master's idea of them.
+	if (memcmp(slaveRegs, masterRegs, sizeof(slaveRegs)) != 0)
+	{
+		Fail("registers don't match", n);
+	}
+
+	printf("requests       %lu\n", requests);
+	printf("failures       %lu\n", failures);
+	printf("rate           %.0f requests/sec on this PC\n",
+		requests / seconds);
+
+	return (failures == 0) ? 0 : 1;
+}
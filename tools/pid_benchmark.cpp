@@ -0,0 +1,277 @@
+/******************************************************************************
+ *
+ *	Filename:		pid_benchmark.cpp
+ *
+ *	Description:	Builds the firmware's PID (PID_v1.cpp) on a PC, runs it
+ *					against a simulated oven, and compares it with the
+ *					original library's algorithm (clamped integral, integral
+ *					loaded with the manual output, no setpoint weights).
+ *					For each run it reports:
+ *
+ *					-	overshoot past the setpoint [C]
+ *					-	settling time:  until the process value stays within
+ *						SETTLE_BAND of the setpoint [seconds]
+ *					-	the change in output at the first sample [%], which
+ *						shows derivative kick & transfer bumps
+ *					-	the biggest change in output from one sample to the
+ *						next [%]
+ *
+ *					The oven is a first-order lag with dead time, driven by
+ *					a 0-100% heater.  The runs are:
+ *
+ *					-	cold start to a high setpoint, which saturates the
+ *						heater for a long time (integral windup)
+ *					-	a small setpoint step that doesn't saturate
+ *					-	switching from manual to automatic with the process
+ *						off the setpoint (transfer bump)
+ *
+ *	Build:			g++ -O2 -I osPID_Firmware -o pid_benchmark \
+ *						tools/pid_benchmark.cpp osPID_Firmware/PID_v1.cpp
+ *
+ *	Usage:			pid_benchmark [beta]
+ *
+ *					beta is the setpoint weight to compare (default 0.7).
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "PID_v1_local.h"
+
+// Oven model
+#define GAIN		3.0					// [C per %]
+#define TIME_CONST	200.0				// [seconds]
+#define DEAD_TIME	10					// [seconds]
+#define AMBIENT		25.0				// [C]
+
+// Tuning (SIMC rules for the model above, tuned tight for load rejection,
+// plus some derivative)
+#define KP			3.33
+#define KI			(KP / 80)
+#define KD			(KP * DEAD_TIME / 2)
+
+#define SAMPLE_TIME	1000				// [mSec]
+#define SETTLE_BAND	1.0					// [C]
+#define RUN_TIME	3000				// length of each run [seconds]
+
+// The original library's algorithm, as it was before anti-windup, bumpless
+// transfer & setpoint weights.
+class OriginalPid
+{
+public:
+	OriginalPid(double *input, double *output, double *setpoint)
+	{
+		myInput = input;
+		myOutput = output;
+		mySetpoint = setpoint;
+		kp = KP;
+		ki = KI * SAMPLE_TIME / 1000.0;
+		kd = KD / (SAMPLE_TIME / 1000.0);
+	}
+
+	void Initialize()
+	{
+		ITerm = Clamp(*myOutput);
+		lastInput = *myInput;
+	}
+
+	void Compute()
+	{
+		double error = *mySetpoint - *myInput;
+
+		ITerm = Clamp(ITerm + ki * error);
+		*myOutput = Clamp(kp * error + ITerm - kd * (*myInput - lastInput));
+		lastInput = *myInput;
+	}
+
+private:
+	static double Clamp(double x)
+	{
+		return (x > 100) ? 100 : (x < 0) ? 0 : x;
+	}
+
+	double *myInput;
+	double *myOutput;
+	double *mySetpoint;
+	double kp;
+	double ki;
+	double kd;
+	double ITerm;
+	double lastInput;
+};
+
+// A simulated oven.
+class Oven
+{
+public:
+	Oven(double temperature, double heat)
+	{
+		int i;
+
+		for (i = 0; i < DEAD_TIME; i++)
+		{
+			delayed[i] = heat;
+		}
+		next = 0;
+		pv = temperature;
+	}
+
+	// Run the oven for one second with the heater at "heat" [%].
+	double Step(double heat)
+	{
+		double applied = delayed[next];
+
+		delayed[next] = heat;
+		next = (next + 1) % DEAD_TIME;
+		pv += (AMBIENT + GAIN * applied - pv) * (1 - exp(-1.0 / TIME_CONST));
+		return pv;
+	}
+
+private:
+	double delayed[DEAD_TIME];			// heater settings on their way
+	int next;							// oldest entry in delayed
+	double pv;							// oven temperature [C]
+};
+
+typedef struct							// how a run went
+{
+	double overshoot;					// [C]
+	int settle;							// [seconds], or -1 if it never did
+	double bump;						// output change at first sample [%]
+	double maxJump;						// biggest output change [%]
+} result_t;
+
+/******************************************************************************
+ *
+ *	Function:		Run
+ *
+ *	Description:	Runs one test:  lets the oven settle, then switches to
+ *					automatic (if it isn't already) with the setpoint at
+ *					"setpoint".
+ *
+ *	Parameters:		beta, gamma - setpoint weights (firmware PID only)
+ *					original - true to use the original algorithm
+ *					start - setpoint the oven settles at before the test
+ *						(in automatic), or NAN to settle in manual
+ *					manual - output while settling in manual [%]
+ *					setpoint - setpoint for the test [C]
+ *
+ *****************************************************************************/
+
+static result_t Run(double beta, double gamma, bool original, double start,
+	double manual, double setpoint)
+{
+	double pv;
+	double out;
+	double sp;
+	double lastOut;
+	double initial;						// process value at the start
+	result_t result;
+	PID pid(&pv, &out, &sp, KP, KI, KD, DIRECT);
+	OriginalPid orig(&pv, &out, &sp);
+	int t;
+
+	pid.SetSampleTime(SAMPLE_TIME);
+	pid.SetOutputLimits(0, 100);
+	pid.SetTunings(KP, KI, KD);
+	pid.SetWeights(beta, gamma);
+
+	// Settle, in manual or at the starting setpoint.
+	out = isnan(start) ? manual : (start - AMBIENT) / GAIN;
+	pv = AMBIENT + GAIN * out;
+	sp = isnan(start) ? pv : start;
+	if (!isnan(start))
+	{
+		pid.SetMode(AUTOMATIC);
+		orig.Initialize();
+	}
+	Oven oven(pv, out);
+
+	// Go to the new setpoint, in automatic.
+	initial = pv;
+	sp = setpoint;
+	pid.SetMode(AUTOMATIC);
+	if (isnan(start))
+	{
+		orig.Initialize();
+	}
+
+	result.overshoot = 0;
+	result.settle = -1;
+	result.maxJump = 0;
+	lastOut = out;
+	for (t = 0; t < RUN_TIME; t++)
+	{
+		if (original)
+		{
+			orig.Compute();
+		}
+		else
+		{
+			pid.Compute();
+		}
+		if (t == 0)
+		{
+			result.bump = fabs(out - lastOut);
+		}
+		if (fabs(out - lastOut) > result.maxJump)
+		{
+			result.maxJump = fabs(out - lastOut);
+		}
+		lastOut = out;
+
+		pv = oven.Step(out);
+		if ((setpoint - initial) * (pv - setpoint) > 0)
+		{
+			if (fabs(pv - setpoint) > result.overshoot)
+			{
+				result.overshoot = fabs(pv - setpoint);
+			}
+		}
+		if (fabs(pv - setpoint) > SETTLE_BAND)
+		{
+			result.settle = -1;
+		}
+		else if (result.settle < 0)
+		{
+			result.settle = t;
+		}
+	}
+
+	return result;
+}
+
+static void Print(const char *name, result_t r)
+{
+	printf("  %-20s overshoot %5.2f C  settle %4d s  "
+		"first step %6.2f %%  max step %6.2f %%\n",
+		name, r.overshoot, r.settle, r.bump, r.maxJump);
+}
+
+int main(int argc, char **argv)
+{
+	double beta = 0.7;
+
+	if (argc > 1)
+	{
+		beta = atof(argv[1]);
+	}
+
+	printf("cold start, 25 -> 250 C (heater saturated)\n");
+	Print("original", Run(1, 0, true, NAN, 0, 250));
+	Print("anti-windup", Run(1, 0, false, NAN, 0, 250));
+	Print("anti-windup + beta", Run(beta, 0, false, NAN, 0, 250));
+
+	printf("setpoint step, 150 -> 160 C\n");
+	Print("original", Run(1, 0, true, 150, 0, 160));
+	Print("beta 1, gamma 1", Run(1, 1, false, 150, 0, 160));
+	Print("beta 1, gamma 0", Run(1, 0, false, 150, 0, 160));
+	Print("beta, gamma 0", Run(beta, 0, false, 150, 0, 160));
+
+	printf("manual 40%% (145 C) -> automatic at 150 C\n");
+	Print("original", Run(1, 0, true, NAN, 40, 150));
+	Print("bumpless", Run(1, 0, false, NAN, 40, 150));
+
+	return 0;
+}
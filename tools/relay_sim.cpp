@@ -0,0 +1,275 @@
+/******************************************************************************
+ *
+ *	Filename:		relay_sim.cpp
+ *
+ *	Description:	Simulates an oven held at its setpoint through a relay,
+ *					and counts how often the relay switches, for each way the
+ *					firmware can drive it:
+ *
+ *					-	PID with time-proportioning (OutputCard's window)
+ *					-	the same, through the switching optimizer
+ *						(RelayOptimizer.cpp), a step at a time:  merging
+ *						on-times across windows, then also rounding &
+ *						skipping short pulses, then also stretching the
+ *						window near the setpoint
+ *					-	on/off control (Thermostat.cpp), at a few
+ *						differentials & minimum on/off times
+ *					-	on/off control again, with the sensor right at the
+ *						heater (NEAR_DEAD_TIME) and a narrow differential.
+ *						On the oven above, the dead time alone keeps the
+ *						relay on or off for longer than 30 seconds, so a
+ *						30 second minimum never comes into play; here the
+ *						relay would switch every few seconds, and the
+ *						minimum is what holds it back
+ *
+ *					For each it reports relay operations per hour, the
+ *					estimated relay life at RELAY_RATING operations, and how
+ *					well the temperature is held (RMS error and the peak to
+ *					peak swing), measured once the oven has settled.  The
+ *					controllers & the optimizer are the firmware's own code;
+ *					the relay
+ *					window is simulated the way OutputCard schedules it.
+ *
+ *					The oven is a first-order lag with dead time; halfway
+ *					through the run its heat loss steps up, as if a door were
+ *					opened.  The controllers read it in 0.25 C steps, like
+ *					the MAX31855.
+ *
+ *	Build:			g++ -O2 -I osPID_Firmware -o relay_sim \
+ *						tools/relay_sim.cpp osPID_Firmware/PID_v1.cpp \
+ *						osPID_Firmware/Thermostat.cpp \
+ *						osPID_Firmware/RelayOptimizer.cpp
+ *
+ *	Usage:			relay_sim
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <math.h>
+#include "PID_v1_local.h"
+#include "Thermostat.h"
+#include "RelayOptimizer.h"
+
+// Oven model
+#define GAIN		3.0					// [C per %]
+#define TIME_CONST	1800.0				// [seconds]
+#define DEAD_TIME	20					// [seconds]
+#define AMBIENT		25.0				// [C]
+#define LOAD		-60.0				// heat loss step halfway through [C]
+#define NEAR_DEAD_TIME	2				// sensor at the heater [seconds]
+#define NEAR_DIFFERENTIAL	0.5			// [C]
+
+#define SETPOINT	150.0				// [C]
+#define RUN_TIME	(8 * 3600)			// length of a run [seconds]
+#define SETTLE_TIME	1800				// not measured before this [seconds]
+#define TICK		100					// simulation step [mSec]
+#define SAMPLE_TIME	1000				// controller sample period [mSec]
+#define WINDOW		10000				// output window [mSec]
+#define RELAY_RATING	100000.0		// relay life [operations]
+
+// PID tuning (the firmware's defaults are for a different process)
+#define KP			15
+#define KI			(KP / 160)
+#define KD			(KP * DEAD_TIME / 2)
+
+typedef struct							// how a run went
+{
+	unsigned long switches;				// relay operations (on or off)
+	double rms;							// RMS error [C]
+	double swing;						// peak to peak PV [C]
+} result_t;
+
+/******************************************************************************
+ *
+ *	Function:		Run
+ *
+ *	Description:	Runs the oven for RUN_TIME with one controller.
+ *
+ *	Parameters:		thermostat - on/off controller, or NULL to run the PID
+ *						with time-proportioning
+ *					optimizer - plans the PID's windows, or NULL to switch
+ *						the plain way
+ *					deadTime - the oven's dead time (up to DEAD_TIME)
+ *						[seconds]
+ *
+ *****************************************************************************/
+
+static result_t Run(Thermostat *thermostat, RelayOptimizer *optimizer,
+	unsigned int deadTime)
+{
+	double temp = SETPOINT;				// oven temperature [C]; it starts
+										// at the setpoint, steady
+	double pv = SETPOINT;				// what the controller reads [C]
+	double out = (SETPOINT - AMBIENT) / GAIN;
+	double sp = SETPOINT;
+	double heat[DEAD_TIME * 1000 / TICK];	// relay states on their way
+	unsigned int slots = deadTime * 1000 / TICK;
+	unsigned int next = 0;
+	unsigned long now;
+	unsigned long windowStart = 0;		// start of this window [mSec]
+	unsigned long windowLength = WINDOW;	// length of this window [mSec]
+	unsigned long onTime = 0;			// relay on-time this window [mSec]
+	bool onFirst = true;				// on-time starts the window
+	relayPlan_t plan;
+	bool relay = false;
+	bool on;
+	double sum = 0;
+	unsigned long count = 0;
+	double low = 1e9;
+	double high = -1e9;
+	double load;
+	result_t result;
+	PID pid(&pv, &out, &sp, KP, KI, KD, DIRECT);
+	unsigned int i;
+
+	for (i = 0; i < slots; i++)
+	{
+		heat[i] = out;
+	}
+	pid.SetSampleTime(SAMPLE_TIME);
+	pid.SetOutputLimits(0, 100);
+	pid.SetTunings(KP, KI, KD);
+	pid.SetMode(AUTOMATIC);
+	if (thermostat != NULL)
+	{
+		thermostat->Reset(false, 0);
+	}
+	if (optimizer != NULL)
+	{
+		optimizer->Reset();
+	}
+
+	result.switches = 0;
+	for (now = 0; now < RUN_TIME * 1000UL; now += TICK)
+	{
+		// Run the controller once per sample.  The reading is rounded to
+		// the MAX31855's 0.25 C steps.
+		if (now % SAMPLE_TIME == 0)
+		{
+			pv = floor(temp * 4 + 0.5) / 4;
+			if (thermostat != NULL)
+			{
+				out = thermostat->Update(FixedFromDouble(pv),
+					FixedFromDouble(sp), now) ? 100 : 0;
+			}
+			else
+			{
+				pid.Compute();
+			}
+			if (optimizer == NULL)
+			{
+				onTime = (unsigned long)(out * WINDOW / 100.0);
+			}
+		}
+
+		// Start a new window, planned by the optimizer if there is one.
+		if (now - windowStart >= windowLength)
+		{
+			windowStart = now;
+			if (optimizer != NULL)
+			{
+				optimizer->Plan(WINDOW, out, sp - pv, &plan);
+				windowLength = plan.window;
+				onTime = plan.onTime;
+				onFirst = plan.onFirst;
+			}
+		}
+
+		// The relay is on for onTime at the start or end of the window.
+		if (onFirst)
+		{
+			on = (now - windowStart) < onTime;
+		}
+		else
+		{
+			on = (now - windowStart) >= windowLength - onTime;
+		}
+		if (on != relay)
+		{
+			relay = on;
+			result.switches++;
+		}
+
+		// Heat the oven.
+		load = (now >= RUN_TIME * 500UL) ? LOAD : 0;
+		temp += (AMBIENT + load + GAIN * heat[next] - temp) *
+			(1 - exp(-TICK / 1000.0 / TIME_CONST));
+		heat[next] = relay ? 100 : 0;
+		next = (next + 1) % slots;
+
+		if (now >= SETTLE_TIME * 1000UL)
+		{
+			sum += (temp - sp) * (temp - sp);
+			count++;
+			if (temp < low)
+			{
+				low = temp;
+			}
+			if (temp > high)
+			{
+				high = temp;
+			}
+		}
+	}
+
+	result.rms = sqrt(sum / count);
+	result.swing = high - low;
+	return result;
+}
+
+static void Print(const char *name, result_t r)
+{
+	double perHour = r.switches * 3600.0 / RUN_TIME;
+
+	printf("  %-28s %7.1f ops/hour  life %8.0f hours  "
+		"RMS %5.2f C  swing %5.2f C\n", name, perHour,
+		RELAY_RATING / perHour, r.rms, r.swing);
+}
+
+int main(void)
+{
+	Thermostat thermostat;
+	RelayOptimizer optimizer;
+	static const double differentials[] = { 1, 2, 4 };
+	static const unsigned long dwells[] = { 0, 30, 120 };
+	char name[40];
+	unsigned int d;
+	unsigned int w;
+
+	printf("oven at %.0f C for %d hours\n", SETPOINT, RUN_TIME / 3600);
+	Print("PID, 10 s window", Run(NULL, NULL, DEAD_TIME));
+
+	optimizer.SetDutyStep(0);
+	optimizer.SetMinPulse(0);
+	optimizer.SetStretch(0, 1);
+	Print("  + merged", Run(NULL, &optimizer, DEAD_TIME));
+	optimizer.SetDutyStep(RELAY_DUTY_STEP);
+	optimizer.SetMinPulse(RELAY_MIN_PULSE);
+	Print("  + rounded & skipped", Run(NULL, &optimizer, DEAD_TIME));
+	optimizer.SetStretch(RELAY_QUIET_BAND, RELAY_STRETCH);
+	Print("  + stretched", Run(NULL, &optimizer, DEAD_TIME));
+
+	for (d = 0; d < sizeof(differentials) / sizeof(differentials[0]); d++)
+	{
+		for (w = 0; w < sizeof(dwells) / sizeof(dwells[0]); w++)
+		{
+			thermostat.SetDifferential(FixedFromDouble(differentials[d]));
+			thermostat.SetMinTimes(dwells[w] * 1000, dwells[w] * 1000);
+			snprintf(name, sizeof(name), "on/off, %.0f C, %lu s min",
+				differentials[d], dwells[w]);
+			Print(name, Run(&thermostat, NULL, DEAD_TIME));
+		}
+	}
+
+	printf("sensor at the heater (%d s dead time)\n", NEAR_DEAD_TIME);
+	for (w = 0; w < sizeof(dwells) / sizeof(dwells[0]); w++)
+	{
+		thermostat.SetDifferential(FixedFromDouble(NEAR_DIFFERENTIAL));
+		thermostat.SetMinTimes(dwells[w] * 1000, dwells[w] * 1000);
+		snprintf(name, sizeof(name), "on/off, %.1f C, %lu s min",
+			NEAR_DIFFERENTIAL, dwells[w]);
+		Print(name, Run(&thermostat, NULL, NEAR_DEAD_TIME));
+	}
+
+	return 0;
+}
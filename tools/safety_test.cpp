@@ -0,0 +1,247 @@
+/******************************************************************************
+ *
+ *	Filename:		safety_test.cpp
+ *
+ *	Description:	Builds the firmware's thermal-runaway checks
+ *					(SafetySupervisor.cpp) on a PC, and runs them against a
+ *					simulated oven:  a heater (time constant TAU_HEATER)
+ *					warming the product the sensor is in (TAU_PRODUCT), one
+ *					sample a second, with the default limits.  The cases are:
+ *
+ *					-	sensor loose:  the output goes to 100%, but the
+ *						sensor has fallen out and reads the room.  NO_RISE
+ *						must trip SAFETY_FULL_ON_TIME after the output went
+ *						full on, and not a sample sooner.
+ *					-	relay welded:  the output is 0%, but the heater is
+ *						stuck on.  RISE_WHEN_OFF must trip at the first
+ *						sample the product has risen SAFETY_MAX_RISE since
+ *						SAFETY_OFF_HOLD_TIME, and not a sample sooner.
+ *					-	healthy:  the oven warms up at 100% for HEAT_TIME,
+ *						then coasts at 0% for an hour (the product keeps
+ *						rising for a while after the heater goes off).
+ *						Nothing may trip.
+ *					-	healthy cooler:  the same, reverse acting, with the
+ *						output cooling the product.  Nothing may trip.
+ *
+ *					A tripped alarm must stay latched until ClearAlarm.  It
+ *					reports any case that went wrong, and the trip times.
+ *
+ *	Build:			g++ -O2 -I osPID_Firmware -o safety_test \
+ *						tools/safety_test.cpp \
+ *						osPID_Firmware/SafetySupervisor.cpp
+ *
+ *	Usage:			safety_test
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include "SafetySupervisor.h"
+
+// Oven model
+#define AMBIENT			25.0			// [C]
+#define GAIN			2.0				// heater's rise at steady state [C/%]
+#define TAU_HEATER		300.0			// [seconds]
+#define TAU_PRODUCT		600.0			// [seconds]
+
+#define HEAT_TIME		1200			// healthy warm-up [seconds]
+#define RUN_TIME		3600			// of the other phases [seconds]
+
+typedef enum							// what's wrong with the oven
+{
+	FAULT_NONE,
+	FAULT_SENSOR_LOOSE,					// sensor reads AMBIENT
+	FAULT_RELAY_WELDED,					// heater is on, whatever the output
+} fault_t;
+
+typedef struct							// the oven
+{
+	double heater;						// [C]
+	double product;						// [C]
+	double sign;						// 1 for a heater, -1 for a cooler
+	fault_t fault;
+} oven_t;
+
+static unsigned long failures;			// checks that went wrong
+
+static void Fail(const char *test, const char *what, long t)
+{
+	failures++;
+	printf("%-16s %s at %ld s\n", test, what, t);
+}
+
+static void Start(oven_t *oven, double sign, fault_t fault)
+{
+	oven->heater = AMBIENT;
+	oven->product = AMBIENT;
+	oven->sign = sign;
+	oven->fault = fault;
+}
+
+// Run the oven for a second with the given output, and read the sensor.
+static double Step(oven_t *oven, double output)
+{
+	if (oven->fault == FAULT_RELAY_WELDED)
+	{
+		output = 100;
+	}
+	oven->heater += (AMBIENT + oven->sign * GAIN * output - oven->heater) /
+		TAU_HEATER;
+	oven->product += (oven->heater - oven->product) / TAU_PRODUCT;
+	return (oven->fault == FAULT_SENSOR_LOOSE) ? AMBIENT : oven->product;
+}
+
+// Run the oven at an output until the alarm trips or time runs out.
+// Returns the time it tripped [seconds], or -1.
+static long Run(SafetySupervisor *safety, oven_t *oven, double output,
+	long seconds, long *t)
+{
+	long end = *t + seconds;
+	double reading;						// [C]
+
+	for (; *t < end; (*t)++)
+	{
+		reading = Step(oven, output);
+		if (safety->Check(reading, output, *t * 1000UL) != SAFETY_ALARM_NONE)
+		{
+			return (*t)++;
+		}
+	}
+	return -1;
+}
+
+static void SensorLoose(void)
+{
+	SafetySupervisor safety;
+	oven_t oven;
+	long t = 0;							// [seconds]
+	long trip;							// [seconds]
+
+	Start(&oven, 1, FAULT_SENSOR_LOOSE);
+	trip = Run(&safety, &oven, 100, RUN_TIME, &t);
+	printf("sensor loose     NO_RISE at %ld s\n", trip);
+	if (trip != SAFETY_FULL_ON_TIME)
+	{
+		Fail("sensor loose", "tripped off time", trip);
+	}
+	if (safety.GetAlarm() != SAFETY_ALARM_NO_RISE)
+	{
+		Fail("sensor loose", "wrong alarm", trip);
+	}
+
+	// Putting the sensor back doesn't clear it.
+	oven.fault = FAULT_NONE;
+	Run(&safety, &oven, 100, RUN_TIME, &t);
+	if (safety.GetAlarm() != SAFETY_ALARM_NO_RISE)
+	{
+		Fail("sensor loose", "alarm didn't stay latched", t);
+	}
+	safety.ClearAlarm();
+	if (safety.GetAlarm() != SAFETY_ALARM_NONE)
+	{
+		Fail("sensor loose", "alarm didn't clear", t);
+	}
+}
+
+static void RelayWelded(void)
+{
+	SafetySupervisor safety;
+	oven_t oven;
+	long t = 0;							// [seconds]
+	long trip;							// [seconds]
+	long expected = -1;					// when it should trip [seconds]
+	double held = 0;					// product after the hold [C]
+	oven_t model;						// a copy, to find expected
+
+	// Work out when the product first rises SAFETY_MAX_RISE past where it
+	// was at the end of the hold.  The product only rises, so that's also
+	// its lowest point.
+	Start(&model, 1, FAULT_RELAY_WELDED);
+	for (t = 0; (t < RUN_TIME) && (expected < 0); t++)
+	{
+		double reading = Step(&model, 0);
+
+		if (t == SAFETY_OFF_HOLD_TIME)
+		{
+			held = reading;
+		}
+		else if ((t > SAFETY_OFF_HOLD_TIME) &&
+			(reading - held >= SAFETY_MAX_RISE))
+		{
+			expected = t;
+		}
+	}
+
+	t = 0;
+	Start(&oven, 1, FAULT_RELAY_WELDED);
+	trip = Run(&safety, &oven, 0, RUN_TIME, &t);
+	printf("relay welded     RISE_WHEN_OFF at %ld s (expected %ld s)\n",
+		trip, expected);
+	if ((trip != expected) || (trip < 0))
+	{
+		Fail("relay welded", "tripped off time", trip);
+	}
+	if (safety.GetAlarm() != SAFETY_ALARM_RISE_WHEN_OFF)
+	{
+		Fail("relay welded", "wrong alarm", trip);
+	}
+
+	// Unsticking the relay doesn't clear it.
+	oven.fault = FAULT_NONE;
+	Run(&safety, &oven, 0, RUN_TIME, &t);
+	if (safety.GetAlarm() != SAFETY_ALARM_RISE_WHEN_OFF)
+	{
+		Fail("relay welded", "alarm didn't stay latched", t);
+	}
+}
+
+static void Healthy(const char *test, bool reverse)
+{
+	SafetySupervisor safety;
+	oven_t oven;
+	oven_t coast;						// a copy, to measure the coast
+	long t = 0;							// [seconds]
+	long trip;							// [seconds]
+	double start;						// product when the output went off
+										// [C]
+	double overshoot = 0;				// of the coast past start [C]
+	int i;
+
+	safety.SetReverse(reverse);
+	Start(&oven, reverse ? -1 : 1, FAULT_NONE);
+	trip = Run(&safety, &oven, 100, HEAT_TIME, &t);
+	if (trip >= 0)
+	{
+		Fail(test, "tripped at full output", trip);
+	}
+
+	// See how far the product coasts once the output goes off.
+	coast = oven;
+	start = oven.product;
+	for (i = 0; i < SAFETY_OFF_HOLD_TIME; i++)
+	{
+		double moved = (Step(&coast, 0) - start) * coast.sign;
+
+		if (moved > overshoot)
+		{
+			overshoot = moved;
+		}
+	}
+
+	trip = Run(&safety, &oven, 0, RUN_TIME, &t);
+	if (trip >= 0)
+	{
+		Fail(test, "tripped while coasting", trip);
+	}
+	printf("%-16s no alarm (coasted %.1f C)\n", test, overshoot);
+}
+
+int main(void)
+{
+	SensorLoose();
+	RelayWelded();
+	Healthy("healthy", false);
+	Healthy("healthy cooler", true);
+
+	printf("failures         %lu\n", failures);
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,272 @@
+/******************************************************************************
+ *
+ *	Filename:		smith_sim.cpp
+ *
+ *	Description:	Simulates a process with a long dead time (first order
+ *					plus dead time), identifies it with the firmware's step
+ *					test, and compares the firmware's Smith predictor mode
+ *					with a plain PID on it.
+ *
+ *					The process starts settled with the output at START_OUT.
+ *					The step test steps the output by TEST_STEP and fits the
+ *					model to the response.  Then each controller takes a
+ *					setpoint step of SP_STEP, and at LOAD_TIME a load that
+ *					takes LOAD_OUT off the output's effect.  The controllers
+ *					are:
+ *
+ *					-	PID, detuned:  tuned for the dead time (SIMC, with
+ *						the closed-loop time constant equal to the dead
+ *						time), as a plain PID must be
+ *					-	PID, fast:  the Smith predictor's tunings on the
+ *						plain PID, to show why it has to be detuned
+ *					-	Smith:  tuned as if the dead time weren't there
+ *						(SIMC, closed-loop time constant FAST_TAU), on the
+ *						identified model
+ *					-	Smith, off model:  the same, but the process's dead
+ *						time is MISMATCH times the one identified
+ *
+ *					For each it reports the time to 90% of the setpoint
+ *					step [seconds], the overshoot [C], the integral of the
+ *					absolute error [C sec] after the step and after the
+ *					load, and the number of times the error changed sign
+ *					by more than the noise after the step (oscillation).
+ *
+ *	Build:			g++ -O2 -I osPID_Firmware -o smith_sim \
+ *						tools/smith_sim.cpp osPID_Firmware/PID_v1.cpp \
+ *						osPID_Firmware/SmithPredictor.cpp \
+ *						osPID_Firmware/StepTest.cpp
+ *
+ *	Usage:			smith_sim
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "PID_v1_local.h"
+#include "SmithPredictor.h"
+#include "StepTest.h"
+
+// Process model
+#define GAIN			2.0				// [C/%]
+#define TAU				60.0			// time constant [seconds]
+#define DEAD_TIME		15				// [seconds]
+#define AMBIENT			20.0			// [C]
+#define NOISE			0.1				// [C peak to peak]
+#define MISMATCH		1.2				// dead time off the model
+
+// Step test (the firmware's defaults, but for the lookback)
+#define START_OUT		10.0			// [%]
+#define TEST_STEP		20.0			// aTuneStep [%]
+#define TEST_NOISE		1.0				// aTuneNoise [C]
+#define TEST_LOOKBACK	30				// [seconds]
+
+// Closed-loop tests
+#define SP_STEP			10.0			// [C]
+#define LOAD_OUT		5.0				// [%]
+#define LOAD_TIME		600				// [seconds]
+#define RUN_TIME		1200			// [seconds]
+#define FAST_TAU		10.0			// Smith's closed-loop time constant
+										// [seconds]
+#define PERIOD			1000			// basePeriod [mSec]
+#define MAX_DELAY		64				// longest dead time [samples]
+
+typedef struct							// the process
+{
+	double rise;						// above ambient [C]
+	double delay[MAX_DELAY];			// outputs on their way [%]
+	int deadTime;						// [samples]
+	int head;							// next slot in delay
+} process_t;
+
+typedef struct							// how a run went
+{
+	int t90;							// time to 90% of the step [seconds]
+	double overshoot;					// [C]
+	double stepIae;						// [C sec]
+	double loadIae;
+	int crossings;						// sign changes of the error
+} result_t;
+
+// Put the process at steady state for an output.
+static void Settle(process_t *process, double output, int deadTime)
+{
+	int i;
+
+	process->rise = GAIN * output;
+	for (i = 0; i < MAX_DELAY; i++)
+	{
+		process->delay[i] = output;
+	}
+	process->deadTime = deadTime;
+	process->head = 0;
+}
+
+// Run the process for a sample with the given output, and read it.
+static double Step(process_t *process, double output)
+{
+	double delayed;						// output reaching the process [%]
+
+	delayed = process->delay[(process->head + MAX_DELAY - process->deadTime) %
+		MAX_DELAY];
+	process->delay[process->head] = output;
+	process->head = (process->head + 1) % MAX_DELAY;
+	process->rise += (1 - exp(-(PERIOD / 1000.0) / TAU)) *
+		(GAIN * delayed - process->rise);
+	return AMBIENT + process->rise + ((rand() % 1000) / 1000.0 - 0.5) * NOISE;
+}
+
+// Run the firmware's step test.  Returns false if it didn't finish.
+static bool Identify(double *gain, double *tau, double *deadTime)
+{
+	process_t process;
+	StepTest test;
+	double reading;						// [C]
+	int i;
+
+	Settle(&process, START_OUT, DEAD_TIME);
+	reading = Step(&process, START_OUT);
+	test.Start(reading, START_OUT, TEST_STEP, TEST_NOISE, TEST_LOOKBACK,
+		PERIOD);
+	for (i = 0; (i < 10000) && (test.GetState() == STEP_TEST_RUNNING); i++)
+	{
+		reading = Step(&process, test.GetOutput());
+		test.Run(reading);
+	}
+	if (test.GetState() != STEP_TEST_DONE)
+	{
+		return false;
+	}
+
+	*gain = test.GetGain();
+	*tau = test.GetTimeConstant();
+	*deadTime = test.GetDeadTime();
+	return true;
+}
+
+// Take a setpoint step and a load under one controller.
+static void Run(double kp, double ki, bool useSmith, double deadTime,
+	const SmithPredictor *model, result_t *result)
+{
+	process_t process;
+	SmithPredictor smith = *model;
+	double processValue;				// [C]
+	double feedback;					// what the PID sees [C]
+	double output = START_OUT;			// [%]
+	double setpoint;					// [C]
+	PID pid(&feedback, &output, &setpoint, kp, ki, 0, DIRECT);
+	double start;						// process value before the step [C]
+	double error;						// setpoint - process value [C]
+	double lastError = 0;				// the last one outside the noise [C]
+	double load;						// [%]
+	int t;								// [seconds]
+
+	srand(1);
+	Settle(&process, START_OUT, (int)(deadTime + 0.5));
+	start = AMBIENT + GAIN * START_OUT;
+	setpoint = start;
+	processValue = start;
+	feedback = start;
+	smith.Reset(output);
+	pid.SetSampleTime(PERIOD);
+	pid.SetOutputLimits(0, 100);
+	pid.SetMode(AUTOMATIC);
+
+	// Step the setpoint after going to automatic, or the bumpless switch
+	// takes the step up into the integral term.
+	setpoint = start + SP_STEP;
+
+	result->t90 = -1;
+	result->overshoot = 0;
+	result->stepIae = 0;
+	result->loadIae = 0;
+	result->crossings = 0;
+	for (t = 0; t < RUN_TIME; t++)
+	{
+		feedback = useSmith ? smith.Predict(processValue) : processValue;
+		pid.Compute();
+		smith.Update(output);
+
+		load = (t >= LOAD_TIME) ? LOAD_OUT : 0;
+		processValue = Step(&process, output - load);
+
+		error = setpoint - processValue;
+		if (t < LOAD_TIME)
+		{
+			result->stepIae += fabs(error);
+			if ((result->t90 < 0) &&
+				(processValue - start >= 0.9 * SP_STEP))
+			{
+				result->t90 = t + 1;
+			}
+			if (-error > result->overshoot)
+			{
+				result->overshoot = -error;
+			}
+		}
+		else
+		{
+			result->loadIae += fabs(error);
+		}
+		if (fabs(error) > NOISE)
+		{
+			if (error * lastError < 0)
+			{
+				result->crossings++;
+			}
+			lastError = error;
+		}
+	}
+}
+
+static void Print(const char *name, const result_t *result)
+{
+	printf("%-18s %5d %8.2f %9.0f %9.0f %9d\n", name, result->t90,
+		result->overshoot, result->stepIae, result->loadIae,
+		result->crossings);
+}
+
+int main(void)
+{
+	double gain;						// identified model
+	double tau;
+	double deadTime;
+	double slowKp;						// tunings
+	double slowKi;
+	double fastKp;
+	double fastKi;
+	SmithPredictor model;
+	result_t result;
+
+	srand(1);
+	if (!Identify(&gain, &tau, &deadTime))
+	{
+		printf("step test failed\n");
+		return 1;
+	}
+	printf("process:     gain %.2f C/%%  tau %.1f s  dead time %d s\n",
+		GAIN, TAU, DEAD_TIME);
+	printf("step test:   gain %.2f C/%%  tau %.1f s  dead time %.1f s\n\n",
+		gain, tau, deadTime);
+
+	model.SetSamplePeriod(PERIOD);
+	model.SetModel(gain, tau, deadTime);
+
+	// SIMC:  Kc = tau / (K (tauC + theta)), Ti = tau.
+	slowKp = tau / (gain * 2 * deadTime);
+	slowKi = slowKp / tau;
+	fastKp = tau / (gain * FAST_TAU);
+	fastKi = fastKp / tau;
+
+	printf("%-18s %5s %8s %9s %9s %9s\n", "", "t90 s", "over C",
+		"step IAE", "load IAE", "crossings");
+	Run(slowKp, slowKi, false, DEAD_TIME, &model, &result);
+	Print("PID, detuned", &result);
+	Run(fastKp, fastKi, false, DEAD_TIME, &model, &result);
+	Print("PID, fast", &result);
+	Run(fastKp, fastKi, true, DEAD_TIME, &model, &result);
+	Print("Smith", &result);
+	Run(fastKp, fastKi, true, DEAD_TIME * MISMATCH, &model, &result);
+	Print("Smith, off model", &result);
+	return 0;
+}
@@ -0,0 +1,255 @@
+/******************************************************************************
+ *
+ *	Filename:		split_sim.cpp
+ *
+ *	Description:	Simulates an environmental chamber with a heater on one
+ *					relay and a compressor on the other, run by the
+ *					firmware's PID (PID_v1.cpp) through its split-range map
+ *					(SplitRange.cpp).  The relays are driven by the
+ *					firmware's own output card driver (OutputCard.cpp),
+ *					built against a stub Arduino core (tools/stub), through
+ *					SetOutput, SetCoolOutput & Service, a millisecond at a
+ *					time; the relays' states are read back from the pins.
+ *
+ *					The setpoint steps above ambient, well below it, and
+ *					then to just above it, where the chamber needs a little
+ *					heat or a little cooling depending on the noise.  For
+ *					each deadband & compressor minimum off time it reports:
+ *					the integral of absolute error [C sec] once each step
+ *					has had SETTLE_TIME to get there, the compressor's
+ *					starts per hour, its shortest off time [seconds], how
+ *					often the output changed over between heating and
+ *					cooling, and the time both relays were on together.
+ *					It fails if the compressor was ever off for less than
+ *					its minimum off time, or the relays were ever on
+ *					together.
+ *
+ *	Build:			g++ -O2 -I tools/stub -I osPID_Firmware -o split_sim \
+ *						tools/split_sim.cpp osPID_Firmware/PID_v1.cpp \
+ *						osPID_Firmware/SplitRange.cpp \
+ *						osPID_Firmware/OutputCard.cpp \
+ *						osPID_Firmware/RelayOptimizer.cpp
+ *
+ *	Usage:			split_sim
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "PID_v1_local.h"
+#include "SplitRange.h"
+#include "OutputCard.h"
+
+// Chamber model
+#define AIR_CAP			20000.0			// chamber heat capacity [J/C]
+#define AIR_AMBIENT		10.0			// chamber to ambient [W/C]
+#define HEATER_POWER	800.0			// [W]
+#define COOLER_POWER	1600.0			// compressor's cooling [W]
+#define AMBIENT			22.0			// [C]
+#define SENSOR_STEP		0.1				// thermistor resolution [C]
+#define SENSOR_NOISE	0.05			// [C RMS]
+
+// Controller
+#define KP				20.0
+#define KI				0.2
+#define KD				0.0
+#define SAMPLE_TIME		1000			// [mSec]
+#define WINDOW			10.0			// output window [seconds]
+#define HEAT_GAIN		1.0				// split-range gains:  the compressor
+#define COOL_GAIN		0.5				// is twice the heater
+
+#define HEAT_PIN		6				// relay pins, as on the osPID
+#define COOL_PIN		5
+
+#define TICK			1				// simulation step [mSec]
+#define STEP_TIME		3600			// time at each setpoint [seconds]
+#define SETTLE_TIME		1200			// time to get to it [seconds]
+
+static const double setpoints[] = { 40, 10, 23 };	// [C]
+#define STEPS	(sizeof(setpoints) / sizeof(setpoints[0]))
+
+typedef struct							// one relay, as seen at its pin
+{
+	uint8_t pin;
+	bool on;
+	unsigned long offSince;				// when it last turned off [mSec]
+	int starts;							// times it turned on
+	unsigned long shortestOff;			// shortest off time [mSec]
+} relay_t;
+
+typedef struct							// how a run went
+{
+	double iae;							// [C sec]
+	double startsPerHour;				// compressor's
+	double shortestOff;					// compressor's [seconds]
+	int changeovers;					// heating to cooling & back
+	double bothOn;						// [seconds]
+} result_t;
+
+unsigned long stubMillis;				// the stub Arduino core's time
+bool stubPin[STUB_PINS];				// & its pins
+
+static unsigned long seed;				// noise generator state
+static unsigned long failures;			// checks that went wrong
+
+// Gaussian noise (near enough), of unit RMS.
+static double Noise(void)
+{
+	double sum = 0;
+	int i;
+
+	for (i = 0; i < 12; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		sum += ((seed >> 16) & 0x7FFF) / 32768.0;
+	}
+	return sum - 6;
+}
+
+static void Fail(double deadband, double minOff, const char *what)
+{
+	failures++;
+	printf("deadband %.0f%%, min off %.0f s:  %s\n", deadband, minOff, what);
+}
+
+// Note any change in a relay's state since the last tick.
+static void Watch(relay_t *r, unsigned long now)
+{
+	bool on = stubPin[r->pin];
+
+	if (on == r->on)
+	{
+		return;
+	}
+	if (on)
+	{
+		if (now - r->offSince < r->shortestOff)
+		{
+			r->shortestOff = now - r->offSince;
+		}
+		r->starts++;
+	}
+	else
+	{
+		r->offSince = now;
+	}
+	r->on = on;
+}
+
+static result_t Run(double deadband, double minOff)
+{
+	result_t r = { 0, 0, 0, 0, 0 };
+	relay_t heater = { HEAT_PIN, false, 0, 0, ULONG_MAX };
+	relay_t cooler = { COOL_PIN, false, 0, 0, ULONG_MAX };
+	double temp = AMBIENT;				// chamber [C]
+	double input = AMBIENT;
+	double output = 0;
+	double setpoint = setpoints[0];
+	double heat;						// split-range outputs [%]
+	double cool;
+	int side = 0;						// last side that ran (1 heat, -1 cool)
+	int t;								// [seconds]
+	int ms;								// into the second [mSec]
+	PID pid(&input, &output, &setpoint, KP, KI, KD, DIRECT);
+	SplitRange split;
+
+	// The card starts at reset, with its relays off.
+	stubMillis = 0;
+	memset(stubPin, 0, sizeof(stubPin));
+	OutputCard card(HEAT_PIN, COOL_PIN);
+
+	seed = 1;
+	split.SetDeadband(deadband);
+	split.SetGains(HEAT_GAIN, COOL_GAIN);
+	pid.SetSampleTime(SAMPLE_TIME);
+	pid.SetOutputLimits(-100, 100);
+	pid.SetMode(AUTOMATIC);
+	card.SetOutputWindow(WINDOW);
+	card.SetMinOffTime(true, (unsigned long)(minOff * 1000));
+	card.SetSplit(true);
+
+	for (t = 0; t < (int)STEPS * STEP_TIME; t++)
+	{
+		stubMillis = t * 1000UL;
+		setpoint = setpoints[t / STEP_TIME];
+		input = floor((temp + SENSOR_NOISE * Noise()) / SENSOR_STEP + 0.5) *
+			SENSOR_STEP;
+		pid.Compute();
+		split.Map(output, &heat, &cool);
+		card.SetOutput(heat);
+		card.SetCoolOutput(cool);
+
+		if ((heat > 0) && (side != 1))
+		{
+			r.changeovers += (side != 0);
+			side = 1;
+		}
+		else if ((cool > 0) && (side != -1))
+		{
+			r.changeovers += (side != 0);
+			side = -1;
+		}
+
+		for (ms = 0; ms < 1000; ms += TICK)
+		{
+			stubMillis = t * 1000UL + ms;
+			card.Service();
+			Watch(&heater, stubMillis);
+			Watch(&cooler, stubMillis);
+			temp += TICK / 1000.0 * ((heater.on ? HEATER_POWER : 0) -
+				(cooler.on ? COOLER_POWER : 0) -
+				AIR_AMBIENT * (temp - AMBIENT)) / AIR_CAP;
+			if (heater.on && cooler.on)
+			{
+				r.bothOn += TICK / 1000.0;
+			}
+		}
+
+		if (t % STEP_TIME >= SETTLE_TIME)
+		{
+			r.iae += fabs(temp - setpoint);
+		}
+	}
+
+	if (cooler.shortestOff < minOff * 1000)
+	{
+		Fail(deadband, minOff, "compressor off for less than its minimum");
+	}
+	if (r.bothOn > 0)
+	{
+		Fail(deadband, minOff, "both relays on together");
+	}
+	r.startsPerHour = cooler.starts / (STEPS * STEP_TIME / 3600.0);
+	r.shortestOff = cooler.shortestOff / 1000.0;
+	return r;
+}
+
+int main(void)
+{
+	static const double deadbands[] = { 0, 4, 10 };
+	static const double minOffs[] = { 0, 180 };
+	result_t r;
+	unsigned i;
+	unsigned j;
+
+	printf("setpoints %.0f, %.0f & %.0f C, ambient %.0f C\n", setpoints[0],
+		setpoints[1], setpoints[2], AMBIENT);
+	printf("deadband  min off      IAE   starts  shortest  change-   both\n");
+	printf("     [%%]      [s]    [C s]     [/h]   off [s]    overs  on [s]\n");
+	for (i = 0; i < sizeof(deadbands) / sizeof(deadbands[0]); i++)
+	{
+		for (j = 0; j < sizeof(minOffs) / sizeof(minOffs[0]); j++)
+		{
+			r = Run(deadbands[i], minOffs[j]);
+			printf("%8.0f %8.0f %8.0f %8.1f %9.3f %8d %7.1f\n", deadbands[i],
+				minOffs[j], r.iae, r.startsPerHour, r.shortestOff,
+				r.changeovers, r.bothOn);
+		}
+	}
+
+	printf("failures %lu\n", failures);
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,55 @@
+/******************************************************************************
+ *
+ *	Filename:		Arduino.h
+ *
+ *	Description:	Just enough of the Arduino core to build the firmware's
+ *					drivers (OutputCard.cpp) into a PC simulation.  The tool
+ *					defines stubMillis & stubPin, sets the time by hand, and
+ *					reads the pins back to see what the driver did.
+ *
+ *	Build:			add -I tools/stub (before -I osPID_Firmware) to the
+ *					tool's build line
+ *
+ *****************************************************************************/
+
+#ifndef ARDUINO_STUB_H
+#define ARDUINO_STUB_H
+
+#include <stdint.h>
+
+#define PROGMEM
+
+#define LOW			0
+#define HIGH		1
+#define INPUT		0
+#define OUTPUT		1
+
+#define STUB_PINS	20					// digital pins on the ATmega328P
+
+typedef uint8_t byte;
+
+extern unsigned long stubMillis;		// the time [mSec]
+extern bool stubPin[STUB_PINS];			// each pin's output state
+
+inline unsigned long millis(void)
+{
+	return stubMillis;
+}
+
+inline void pinMode(uint8_t pin, uint8_t mode)
+{
+	(void)pin;
+	(void)mode;
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t value)
+{
+	stubPin[pin] = (value == HIGH);
+}
+
+inline int digitalRead(uint8_t pin)
+{
+	return stubPin[pin] ? HIGH : LOW;
+}
+
+#endif
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+###############################################################################
+#
+#	Filename:		trace_to_json.py
+#
+#	Description:	Turns event-trace dumps from the controller (the serial
+#					`t` command, with TRACE_ENABLED set in Trace.h) into the
+#					Chrome trace-event JSON format, which chrome://tracing
+#					and ui.perfetto.dev open.  Samples, sensor reads, the
+#					controller, LCD & serial updates, EEPROM writes and
+#					Modbus requests show as spans; relay edges, serial
+#					commands and ADC interrupts as instants.  The main loop
+#					and the interrupts are separate tracks, and each dump in
+#					the log is a process of its own.
+#
+#					Event names are read from the traceEvent_t list in
+#					Trace.h, so they always match the firmware.
+#
+#					The rings only hold the last few events, so the oldest
+#					span may have lost its start:  ends without a start are
+#					dropped, and starts without an end are closed at the
+#					dump's last event.
+#
+#	Usage:			tools/trace_to_json.py <serial log> [Trace.h] > trace.json
+#
+#					Anything in the log that isn't part of a dump (the
+#					controller's reports, say) is skipped.
+#
+###############################################################################
+
+import json
+import os
+import re
+import sys
+
+TRACKS = ["main loop", "interrupts"]
+
+def event_names(header):
+	"""Lists traceEvent_t's names in order, without the TRACE_ prefix."""
+	text = open(header).read()
+	body = re.search(r"typedef enum[^{]*\{(.*?)\}\s*traceEvent_t", text, re.S)
+	if body is None:
+		sys.exit("%s: no traceEvent_t" % header)
+	body = re.sub(r"//[^\n]*", "", body.group(1))
+	return [name.strip()[len("TRACE_"):].lower()
+		for name in body.split(",") if name.strip()]
+
+def read_dumps(log):
+	"""Yields each dump in the log as a list of (time, ring, event, phase,
+	arg)."""
+	dump = None
+	for line in log:
+		fields = line.split()
+		if len(fields) == 2 and fields[0] == "trace":
+			if fields[1] == "end":
+				if dump is not None:
+					yield dump
+				dump = None
+			else:
+				dump = []
+		elif dump is not None and len(fields) == 5:
+			try:
+				dump.append((int(fields[0]), int(fields[1]), int(fields[2]),
+					fields[3], int(fields[4])))
+			except ValueError:
+				dump = None				# garbled; skip this dump
+
+def convert(dump, pid, names):
+	"""Turns one dump into trace events."""
+	events = []
+	open_spans = {}						# (ring, event) -> depth
+	base = dump[0][0] if dump else 0
+	wraps = 0
+	last = base
+	now = 0
+
+	for time, ring, event, phase, arg in dump:
+		# micros() wraps around every 71.6 minutes.
+		if time < last and last - time > 1 << 31:
+			wraps += 1
+		last = time
+		now = time + (wraps << 32) - base
+
+		name = names[event] if event < len(names) else "event%d" % event
+		key = (ring, event)
+		if phase == "E":
+			if open_spans.get(key, 0) == 0:
+				continue				# started before the dump
+			open_spans[key] -= 1
+		elif phase == "B":
+			open_spans[key] = open_spans.get(key, 0) + 1
+
+		record = {"name": name, "ph": phase, "ts": now, "pid": pid,
+			"tid": ring, "args": {"arg": arg}}
+		if name == "relay":
+			record["args"] = {"relay": arg // 2 + 1, "on": arg % 2}
+		elif name == "command":
+			record["args"] = {"command": chr(arg)}
+		if phase == "i":
+			record["s"] = "t"
+		events.append(record)
+
+	for (ring, event), depth in open_spans.items():
+		for i in range(depth):
+			events.append({"name": names[event], "ph": "E", "ts": now,
+				"pid": pid, "tid": ring})
+
+	# Name the tracks.
+	events.append({"name": "process_name", "ph": "M", "pid": pid,
+		"args": {"name": "dump %d" % pid}})
+	for tid, track in enumerate(TRACKS):
+		events.append({"name": "thread_name", "ph": "M", "pid": pid,
+			"tid": tid, "args": {"name": track}})
+	return events
+
+def main():
+	if len(sys.argv) not in (2, 3):
+		sys.exit("usage: %s <serial log> [Trace.h] > trace.json" % sys.argv[0])
+
+	header = sys.argv[2] if len(sys.argv) == 3 else os.path.join(
+		os.path.dirname(os.path.abspath(__file__)), "..", "osPID_Firmware",
+		"Trace.h")
+	names = event_names(header)
+
+	events = []
+	with open(sys.argv[1], errors="replace") as log:
+		for pid, dump in enumerate(read_dumps(log), 1):
+			events += convert(dump, pid, names)
+
+	json.dump({"traceEvents": events, "displayTimeUnit": "ms"}, sys.stdout,
+		indent=1)
+	sys.stdout.write("\n")
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+###############################################################################
+#
+#	Filename:		typek_table.py
+#
+#	Description:	Generates the type-K thermocouple tables in TypeK.cpp from
+#					the NIST ITS-90 polynomials, and checks how closely the
+#					firmware's fixed-point interpolation matches them.
+#
+#					Two tables are built:
+#
+#					1.	Temperature at evenly spaced thermocouple voltages, for
+#						finding the hot-junction temperature.
+#					2.	Voltage at evenly spaced temperatures over the MAX31855's
+#						operating range, for cold-junction compensation.
+#
+#					The check builds the firmware's own TypeK.cpp on the PC
+#					(with $CXX, or g++) and feeds TypeKLinearize what a
+#					MAX31855 would report, in its 1/4 C & 1/16 C steps, for
+#					temperatures over the thermocouple's whole range and cold
+#					junctions over the chip's.  Its output is compared with
+#					the temperature the NIST polynomials give, and with this
+#					script's model of the firmware, which must match it
+#					exactly.  Exits with 1 if it doesn't.
+#
+#	Usage:			tools/typek_table.py			(print tables & errors)
+#					tools/typek_table.py --check	(errors only)
+#
+###############################################################################
+
+import ctypes
+import math
+import os
+import subprocess
+import sys
+import tempfile
+
+# NIST ITS-90 type K, temperature [C] -> voltage [mV].
+FWD_NEG = [0.0, 0.394501280250e-01, 0.236223735980e-04, -0.328589067840e-06,
+	-0.499048287770e-08, -0.675090591730e-10, -0.574103274280e-12,
+	-0.310888728940e-14, -0.104516093650e-16, -0.198892668780e-19,
+	-0.163226974860e-22]
+FWD_POS = [-0.176004136860e-01, 0.389212049750e-01, 0.185587700320e-04,
+	-0.994575928740e-07, 0.318409457190e-09, -0.560728448890e-12,
+	0.560750590590e-15, -0.320207200030e-18, 0.971511471520e-22,
+	-0.121047212750e-25]
+FWD_EXP = (0.118597600000e+00, -0.118343200000e-03, 0.126968600000e+03)
+
+# NIST ITS-90 type K, voltage [mV] -> temperature [C].
+INV = [
+	(-5.891, 0.0, [0.0, 2.5173462e+01, -1.1662878e+00, -1.0833638e+00,
+		-8.9773540e-01, -3.7342377e-01, -8.6632643e-02, -1.0450598e-02,
+		-5.1920577e-04]),
+	(0.0, 20.644, [0.0, 2.508355e+01, 7.860106e-02, -2.503131e-01,
+		8.315270e-02, -1.228034e-02, 9.804036e-04, -4.413030e-05,
+		1.057734e-06, -1.052755e-08]),
+	(20.644, 54.886, [-1.318058e+02, 4.830222e+01, -1.646031e+00,
+		5.464731e-02, -9.650715e-04, 8.802193e-06, -3.110810e-08]),
+]
+
+# These must match TypeK.cpp.
+HOT_MIN_UV = -6144		# first entry of the hot-junction table [uV]
+HOT_SHIFT = 9			# log2 of the voltage step [uV]
+HOT_COUNT = 121			# entries in the hot-junction table
+COLD_MIN_C = -64		# first entry of the cold-junction table [C]
+COLD_SHIFT = 8			# log2 of the temperature step [1/16 C]
+COLD_COUNT = 13			# entries in the cold-junction table
+MAX31855_UV_PER_C = 41.276	# the chip's linear approximation [uV/C]
+MAX31855_GAIN = 10567		# the same, in uV per 1/16 C, times 4096
+
+def poly(c, x):
+	return sum(k * x ** i for i, k in enumerate(c))
+
+def volts(t):
+	"""NIST voltage [uV] at temperature t [C]."""
+	if t < 0:
+		return 1000 * poly(FWD_NEG, t)
+	a0, a1, a2 = FWD_EXP
+	return 1000 * (poly(FWD_POS, t) + a0 * math.exp(a1 * (t - a2) ** 2))
+
+def temp(uv):
+	"""Exact inverse of volts() [C], by bisection."""
+	lo, hi = -270.0, 1400.0
+	for _ in range(60):
+		mid = (lo + hi) / 2
+		if volts(mid) < uv:
+			lo = mid
+		else:
+			hi = mid
+	return (lo + hi) / 2
+
+def temp_nist(uv):
+	"""NIST inverse polynomial [C], or None outside its range."""
+	mv = uv / 1000
+	for lo, hi, c in INV:
+		if lo <= mv <= hi:
+			return poly(c, mv)
+	return None
+
+HOT = [int(round(16 * temp(HOT_MIN_UV + (i << HOT_SHIFT))))
+	for i in range(HOT_COUNT)]
+COLD = [int(round(volts(COLD_MIN_C + i * (1 << COLD_SHIFT) / 16)))
+	for i in range(COLD_COUNT)]
+
+def asr(x, n):
+	"""Arithmetic shift right, as avr-gcc does it."""
+	return x >> n
+
+def fw_cold_uv(cj16):
+	"""Firmware's cold-junction voltage [uV] from 1/16 C."""
+	x = cj16 - COLD_MIN_C * 16
+	x = max(0, min(x, ((COLD_COUNT - 1) << COLD_SHIFT) - 1))
+	i = asr(x, COLD_SHIFT)
+	f = x & ((1 << COLD_SHIFT) - 1)
+	return COLD[i] + asr((COLD[i + 1] - COLD[i]) * f, COLD_SHIFT)
+
+def fw_hot16(uv):
+	"""Firmware's temperature [1/16 C] from voltage [uV]."""
+	x = uv - HOT_MIN_UV
+	x = max(0, min(x, ((HOT_COUNT - 1) << HOT_SHIFT) - 1))
+	i = asr(x, HOT_SHIFT)
+	f = x & ((1 << HOT_SHIFT) - 1)
+	return HOT[i] + asr((HOT[i + 1] - HOT[i]) * f, HOT_SHIFT)
+
+def fw_linearize(tc4, cj16):
+	"""Firmware's temperature [1/16 C] from the MAX31855's readings."""
+	uv = asr((tc4 * 4 - cj16) * MAX31855_GAIN, 12)
+	return fw_hot16(uv + fw_cold_uv(cj16))
+
+def max31855(t, cj):
+	"""MAX31855's readings [1/4 C, 1/16 C] for a hot junction at t and a cold
+	junction at cj [C]:  it adds the cold junction to the thermocouple's
+	voltage over its linear gain."""
+	tc = cj + (volts(t) - volts(cj)) / MAX31855_UV_PER_C
+	return int(math.floor(tc * 4 + 0.5)), int(math.floor(cj * 16 + 0.5))
+
+def build():
+	"""Builds TypeK.cpp on the PC, and returns its TypeKLinearize."""
+	here = os.path.dirname(os.path.abspath(__file__))
+	firmware = os.path.join(here, "..", "osPID_Firmware")
+	with tempfile.TemporaryDirectory() as work:
+		driver = os.path.join(work, "driver.cpp")
+		library = os.path.join(work, "typek.so")
+		with open(driver, "w") as f:
+			f.write('#include "TypeK.h"\n'
+				'extern "C" int16_t Linearize(int16_t tc, int16_t cj)\n'
+				'{\n\treturn TypeKLinearize(tc, cj);\n}\n')
+		subprocess.check_call([os.environ.get("CXX", "g++"), "-O2",
+			"-shared", "-fPIC", "-I", firmware, "-o", library, driver,
+			os.path.join(firmware, "TypeK.cpp")])
+		linearize = ctypes.CDLL(library).Linearize
+	linearize.argtypes = [ctypes.c_int16, ctypes.c_int16]
+	linearize.restype = ctypes.c_int16
+	return linearize
+
+def check_firmware():
+	"""Worst-case errors of the firmware's TypeKLinearize against NIST [C].
+	Returns the number of readings where it differs from fw_linearize."""
+	linearize = build()
+	mismatches = 0
+	print("TypeKLinearize (TypeK.cpp) against NIST ITS-90 type K,")
+	print("cold junction -40 to 125 C, with the MAX31855's 0.25 C steps:")
+	for lo, hi in ((-200, 0), (0, 600), (600, 1372)):
+		worst = 0.0
+		for cj in range(-40, 126, 5):
+			for t10 in range(lo * 10, hi * 10 + 1, 5):
+				tc4, cj16 = max31855(t10 / 10, cj)
+				result = linearize(tc4, cj16)
+				if result != fw_linearize(tc4, cj16):
+					mismatches += 1
+				worst = max(worst, abs(result / 16 - t10 / 10))
+		print("  %5d to %4d C: %.3f C" % (lo, hi, worst))
+	print("  readings where it differs from this script's model: %d"
+		% mismatches)
+	return mismatches
+
+def check():
+	"""Worst-case errors of the firmware math against NIST [C]."""
+	worst = {}
+	for lo, hi, step in ((-200, 0, 1), (0, 600, 1), (600, 1372, 1)):
+		e_poly = e_table = 0.0
+		for t10 in range(lo * 10, hi * 10 + 1, step * 5):
+			t = t10 / 10
+			uv = volts(t)
+			e_table = max(e_table, abs(fw_hot16(int(round(uv))) / 16 - t))
+			tn = temp_nist(uv)
+			if tn is not None:
+				e_poly = max(e_poly, abs(tn - t))
+		worst[(lo, hi)] = (e_table, e_poly)
+	e_cold = 0.0
+	for cj16 in range(-55 * 16, 125 * 16 + 1):
+		e_cold = max(e_cold, abs(fw_cold_uv(cj16) - volts(cj16 / 16)))
+	e_lin = max(abs(volts(t) / MAX31855_UV_PER_C - t) for t in range(0, 1373))
+	print("Worst-case error against NIST ITS-90 type K:")
+	for (lo, hi), (et, ep) in worst.items():
+		print("  %5d to %4d C: table %.3f C (NIST inverse polynomial %.3f C)"
+			% (lo, hi, et, ep))
+	print("  cold junction -55 to 125 C: %.2f uV (%.3f C)"
+		% (e_cold, e_cold / MAX31855_UV_PER_C))
+	print("  chip's linear approximation, 0 to 1372 C: %.1f C" % e_lin)
+
+def table(name, values, per_line=8):
+	print("const int16_t %s[%d] PROGMEM =\n{" % (name, len(values)))
+	for i in range(0, len(values), per_line):
+		print("\t" + ", ".join("%6d" % v for v in values[i:i + per_line]) + ",")
+	print("};\n")
+
+if __name__ == "__main__":
+	if "--check" not in sys.argv:
+		table("typeKTempTable", HOT)
+		table("typeKVoltTable", COLD)
+	check()
+	print()
+	if check_firmware():
+		sys.exit(1)
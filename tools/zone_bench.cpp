@@ -0,0 +1,255 @@
+/******************************************************************************
+ *
+ *	Filename:		zone_bench.cpp
+ *
+ *	Description:	Builds the firmware's zone engine (ZoneEngine.cpp) on a
+ *					PC, checks it against simulated zones, and times it.
+ *
+ *					Each zone is a first-order process (GAIN, TAU) sampled
+ *					once a second.  Even zones are heaters (direct acting);
+ *					odd zones are coolers (reverse acting), their output
+ *					pulling the process value down from a warm ambient.
+ *					The checks are:
+ *
+ *					-	bumpless:  in manual at MANUAL_OUT, switching to
+ *						automatic moves the first output by no more than one
+ *						sample's integral step.  (MANUAL_OUT is near enough
+ *						the setpoints that the integral can take up the
+ *						proportional term; with a bigger error it's clamped
+ *						to the output range, as in PID_v1, and it does move.)
+ *					-	settling:  every zone, heater or cooler, ends up
+ *						within SETTLE_BAND of its setpoint, with its output
+ *						moving the right way
+ *					-	sensor loss:  while zone 0's sensor is out, its
+ *						output is off and the other zones carry on; when it
+ *						comes back, it starts again from off (no jump) and
+ *						settles again
+ *
+ *					Then it times Compute over TIMING_RUNS samples and
+ *					reports the cost per zone.  The times are for this PC;
+ *					the controller's `g` command reports the same thing on
+ *					the AVR.
+ *
+ *	Build:			g++ -O2 -I osPID_Firmware -o zone_bench \
+ *						tools/zone_bench.cpp osPID_Firmware/ZoneEngine.cpp
+ *
+ *					Add -DZONE_COUNT=<n> (up to 8) to check & time more
+ *					zones.
+ *
+ *	Usage:			zone_bench
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include "ZoneEngine.h"
+
+// Process model
+#define GAIN			2.0				// [C/%]
+#define TAU				60.0			// time constant [seconds]
+#define HEAT_AMBIENT	20.0			// heaters' ambient [C]
+#define COOL_AMBIENT	40.0			// coolers' ambient [C]
+#define HEAT_SETPOINT	50.0			// [C]
+#define COOL_SETPOINT	25.0			// [C]
+
+// Tunings
+#define KP				3.0				// [%/C]
+#define KI				0.05			// [%/(C sec)]
+#define KD				1.0				// [% sec/C]
+
+#define PERIOD			1000			// sample period [mSec]
+#define MANUAL_OUT		14.0			// output before automatic [%]
+#define SETTLE_TIME		900				// [seconds]
+#define SETTLE_BAND		0.5				// [C]
+#define LOSS_TIME		60				// zone 0's sensor is out [seconds]
+#define TIMING_RUNS		10000000L		// Computes to time
+
+static double temp[ZONE_COUNT];			// each zone's process [C]
+static unsigned long failures;			// checks that went wrong
+
+static void Fail(const char *test, int zone, const char *what)
+{
+	failures++;
+	printf("%-12s zone %d %s\n", test, zone + 1, what);
+}
+
+static bool IsCooler(int zone)
+{
+	return (zone & 1) != 0;
+}
+
+// Run each zone's process for a sample at its output.
+static void Step(ZoneEngine *zones)
+{
+	double output;						// [%]
+	double target;						// where the process is heading [C]
+	int zone;
+
+	for (zone = 0; zone < ZONE_COUNT; zone++)
+	{
+		output = FixedToDouble(zones->GetOutput(zone));
+		target = IsCooler(zone) ? COOL_AMBIENT - GAIN * output :
+			HEAT_AMBIENT + GAIN * output;
+		temp[zone] += (1 - exp(-(PERIOD / 1000.0) / TAU)) *
+			(target - temp[zone]);
+	}
+}
+
+// Read the zones' sensors and run the engine for a sample.  Zone 0's sensor
+// is out if lost is true.
+static void Sample(ZoneEngine *zones, bool lost)
+{
+	int zone;
+
+	for (zone = 0; zone < ZONE_COUNT; zone++)
+	{
+		zones->SetInput(zone, FixedFromDouble(temp[zone]),
+			!((zone == 0) && lost));
+	}
+	zones->Compute();
+	Step(zones);
+}
+
+// Check every zone is within SETTLE_BAND of its setpoint.
+static void CheckSettled(ZoneEngine *zones, const char *test)
+{
+	int zone;
+
+	for (zone = 0; zone < ZONE_COUNT; zone++)
+	{
+		if (fabs(temp[zone] - FixedToDouble(zones->GetSetpoint(zone))) >
+			SETTLE_BAND)
+		{
+			Fail(test, zone, "didn't settle");
+		}
+	}
+}
+
+static void Check(ZoneEngine *zones)
+{
+	double before[ZONE_COUNT];			// outputs [%]
+	double step;						// most a first output can move [%]
+	double error;						// setpoint - process value [C]
+	int zone;
+	int t;								// [seconds]
+
+	zones->SetSamplePeriod(PERIOD);
+	for (zone = 0; zone < ZONE_COUNT; zone++)
+	{
+		zones->SetTunings(zone, KP, KI, KD);
+		zones->SetReverse(zone, IsCooler(zone));
+		zones->SetSetpoint(zone, FixedFromDouble(IsCooler(zone) ?
+			COOL_SETPOINT : HEAT_SETPOINT));
+		zones->SetOutput(zone, FixedFromDouble(MANUAL_OUT));
+		temp[zone] = IsCooler(zone) ? COOL_AMBIENT - GAIN * MANUAL_OUT :
+			HEAT_AMBIENT + GAIN * MANUAL_OUT;
+	}
+
+	// Settle in manual, then switch.  The first output can only differ from
+	// the manual one by the integral's step on the error.
+	for (t = 0; t < 10; t++)
+	{
+		Sample(zones, false);
+	}
+	zones->SetAutomatic(true);
+	Sample(zones, false);
+	for (zone = 0; zone < ZONE_COUNT; zone++)
+	{
+		error = FixedToDouble(zones->GetSetpoint(zone)) - temp[zone];
+		step = KI * PERIOD / 1000.0 * fabs(error) + 0.01;
+		if (fabs(FixedToDouble(zones->GetOutput(zone)) - MANUAL_OUT) > step)
+		{
+			Fail("bumpless", zone, "jumped");
+		}
+	}
+
+	for (t = 0; t < SETTLE_TIME; t++)
+	{
+		Sample(zones, false);
+	}
+	CheckSettled(zones, "settling");
+	for (zone = 0; zone < ZONE_COUNT; zone++)
+	{
+		// Heaters have to heat past ambient, coolers cool below it.
+		before[zone] = FixedToDouble(zones->GetOutput(zone));
+		if (before[zone] <= 0)
+		{
+			Fail("settling", zone, "output the wrong way");
+		}
+		printf("settled      zone %d %-6s %6.2f C at %5.1f%%\n", zone + 1,
+			IsCooler(zone) ? "cooler" : "heater", temp[zone], before[zone]);
+	}
+
+	// Lose zone 0's sensor.  Its output goes off; the others carry on.
+	for (t = 0; t < LOSS_TIME; t++)
+	{
+		Sample(zones, true);
+		if (zones->GetOutput(0) != 0)
+		{
+			Fail("sensor loss", 0, "output not off");
+			break;
+		}
+	}
+	for (zone = 1; zone < ZONE_COUNT; zone++)
+	{
+		if (fabs(FixedToDouble(zones->GetOutput(zone)) - before[zone]) > 1)
+		{
+			Fail("sensor loss", zone, "was disturbed");
+		}
+	}
+
+	// When it comes back, it starts from off:  the first output is at most
+	// the proportional & integral response to the error, without the
+	// integral it had before.
+	Sample(zones, false);
+	error = FixedToDouble(zones->GetSetpoint(0)) - FixedToDouble(
+		zones->GetInput(0));
+	if (FixedToDouble(zones->GetOutput(0)) >
+		(KP + KI * PERIOD / 1000.0) * fabs(error) + 0.01)
+	{
+		Fail("sensor loss", 0, "jumped on recovery");
+	}
+	printf("sensor back  zone 1 at %.2f C, first output %.2f%%\n",
+		temp[0], FixedToDouble(zones->GetOutput(0)));
+	for (t = 0; t < SETTLE_TIME; t++)
+	{
+		Sample(zones, false);
+	}
+	CheckSettled(zones, "recovery");
+}
+
+static void Time(ZoneEngine *zones)
+{
+	clock_t start;
+	double nSec;						// per zone [nSec]
+	long i;
+	int zone;
+
+	// Vary the inputs so every sample does the full work.
+	start = clock();
+	for (i = 0; i < TIMING_RUNS; i++)
+	{
+		for (zone = 0; zone < ZONE_COUNT; zone++)
+		{
+			zones->SetInput(zone, FIXED_FROM_INT(20) + (fixed_t)(i & 0xffff),
+				true);
+		}
+		zones->Compute();
+	}
+	nSec = (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 /
+		((double)TIMING_RUNS * ZONE_COUNT);
+	printf("compute      %d zones, %.1f nSec per zone per sample on this PC "
+		"(inputs included)\n", ZONE_COUNT, nSec);
+}
+
+int main(void)
+{
+	ZoneEngine zones;
+
+	Check(&zones);
+	Time(&zones);
+
+	printf("failures     %lu\n", failures);
+	return (failures == 0) ? 0 : 1;
+}